@@ -0,0 +1,197 @@
+#pragma once
+#ifndef ZEST_LIB_BINARYBUFFER_H
+#define ZEST_LIB_BINARYBUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <type_traits>
+
+#include "../Dynamics.h"
+#include "../Error.h"
+
+namespace Zest { namespace Lib { namespace Binary {
+
+// Writes big endian values into memory which is sized in advance.
+class BinaryWriter
+{
+public:
+	explicit BinaryWriter(uint8_t* pOutput) noexcept
+		: m_pPosition{ pOutput }
+	{
+	}
+
+	void WriteByte(uint8_t value) noexcept
+	{
+		*m_pPosition++ = value;
+	}
+
+	template<typename TValue>
+	void WriteBigEndian(TValue value) noexcept
+	{
+		static_assert(std::is_unsigned<TValue>::value, "big endian value must be unsigned");
+		for (std::size_t shift = sizeof(TValue) * 8; shift > 0; shift -= 8)
+		{
+			*m_pPosition++ = static_cast<uint8_t>(value >> (shift - 8));
+		}
+	}
+
+	void WriteBytes(const void* pData, std::size_t size) noexcept
+	{
+		if (size != 0)
+		{
+			std::memcpy(m_pPosition, pData, size);
+			m_pPosition += size;
+		}
+	}
+
+	uint8_t* GetPosition() const noexcept
+	{
+		return m_pPosition;
+	}
+
+private:
+	uint8_t* m_pPosition;
+};
+
+// Reads big endian values, throws MalFormatError when input ends early.
+class BinaryReader
+{
+public:
+	BinaryReader(const uint8_t* pData, std::size_t size) noexcept
+		: m_pPosition{ pData }, m_pEnd{ pData + size }
+	{
+	}
+
+	bool IsEnd() const noexcept
+	{
+		return m_pPosition == m_pEnd;
+	}
+
+	uint8_t PeekByte() const
+	{
+		Require(1);
+		return *m_pPosition;
+	}
+
+	uint8_t ReadByte()
+	{
+		Require(1);
+		return *m_pPosition++;
+	}
+
+	template<typename TValue>
+	TValue ReadBigEndian()
+	{
+		static_assert(std::is_unsigned<TValue>::value, "big endian value must be unsigned");
+		Require(sizeof(TValue));
+		TValue value{ 0 };
+		for (std::size_t i = 0; i < sizeof(TValue); ++i)
+		{
+			value = static_cast<TValue>((value << 8) | m_pPosition[i]);
+		}
+		m_pPosition += sizeof(TValue);
+		return value;
+	}
+
+	// Returned bytes point into input.
+	const uint8_t* ReadBytes(uint64_t size)
+	{
+		Require(size);
+		const uint8_t* pBytes{ m_pPosition };
+		m_pPosition += size;
+		return pBytes;
+	}
+
+private:
+	void Require(uint64_t size) const
+	{
+		if (size > static_cast<uint64_t>(m_pEnd - m_pPosition))
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+	}
+
+	const uint8_t* m_pPosition;
+	const uint8_t* m_pEnd;
+};
+
+// Helpers shared by binary codecs.
+struct BinaryFormat
+{
+	// Nesting deeper than this is rejected, so malicious input can't overflow stack.
+	static constexpr std::size_t c_maxDepth{ 512 };
+
+	static Dynamic MakeString(const uint8_t* pData, std::size_t size, bool isBorrowString)
+	{
+		ValueMap::StringView value{ reinterpret_cast<const char*>(pData), size };
+		return isBorrowString ? Dynamic::MakeBorrowedString(value) : Dynamic(value);
+	}
+
+	// Array allocated from current arena, so it is not copied when wrapped in Dynamic.
+	static ValueMap::Array MakeArray()
+	{
+		std::pmr::memory_resource* pMemoryResource{ ScopedDynamicArena::GetCurrentMemoryResource() };
+		return ValueMap::Array(pMemoryResource != nullptr ? pMemoryResource : std::pmr::get_default_resource());
+	}
+
+	static ValueMap::Double ToDouble(uint32_t bits) noexcept
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	static ValueMap::Double ToDouble(uint64_t bits) noexcept
+	{
+		ValueMap::Double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// True if double can be stored as float without losing precision.
+	static bool IsFloat(ValueMap::Double value) noexcept
+	{
+		return value >= -3.4028234663852886e38 && value <= 3.4028234663852886e38
+			&& static_cast<ValueMap::Double>(static_cast<float>(value)) == value;
+	}
+
+	static uint32_t ToFloatBits(ValueMap::Double value) noexcept
+	{
+		float floatValue{ static_cast<float>(value) };
+		uint32_t bits;
+		std::memcpy(&bits, &floatValue, sizeof(bits));
+		return bits;
+	}
+
+	static uint64_t ToDoubleBits(ValueMap::Double value) noexcept
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	// Integers which fit Int32 are decoded as Int32, like integers parsed from text.
+	static Dynamic MakeInteger(ValueMap::Int64 value)
+	{
+		if (value >= std::numeric_limits<ValueMap::Int32>::min() && value <= std::numeric_limits<ValueMap::Int32>::max())
+		{
+			return Dynamic(static_cast<ValueMap::Int32>(value));
+		}
+		return Dynamic(value);
+	}
+
+	static Dynamic MakeUnsigned(uint64_t value)
+	{
+		if (value > static_cast<uint64_t>(std::numeric_limits<ValueMap::Int64>::max()))
+		{
+			return Dynamic(static_cast<ValueMap::Double>(value));
+		}
+		return MakeInteger(static_cast<ValueMap::Int64>(value));
+	}
+};
+
+}}}
+
+#endif
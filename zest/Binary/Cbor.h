@@ -0,0 +1,414 @@
+#pragma once
+#ifndef ZEST_LIB_CBOR_H
+#define ZEST_LIB_CBOR_H
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BinaryBuffer.h"
+#include "../Dynamics.h"
+#include "../Error.h"
+
+namespace Zest { namespace Lib { namespace Binary {
+
+/*! CBOR (RFC 8949) codec for Dynamic.
+	Encoder computes exact size first, so output is allocated once and written in one pass.
+	Only definite lengths are written, doubles are written as single precision when it is lossless.
+	Decoder borrows definite length text and byte strings from input unless isBorrowString is false,
+	so input must outlive the decoded document. Indefinite length strings are concatenated into
+	owned strings. Byte strings are decoded as String, since Dynamic has no binary type.
+	Tags are skipped and their content is decoded, undefined and unknown simple values become null,
+	map keys must be text strings, integers out of Int64 range are decoded as Double.
+	To decode into arena, pass the arena or decode inside ScopedDynamicArena.
+*/
+class Cbor
+{
+public:
+	static std::size_t GetEncodedSize(const Dynamic& value)
+	{
+		switch (value.GetType())
+		{
+			case ValueMap::Type::Int32:
+			case ValueMap::Type::Int64:
+			{
+				ValueMap::Int64 integer{ value.GetInt64() };
+				return GetHeadSize(integer >= 0 ? static_cast<uint64_t>(integer) : ~static_cast<uint64_t>(integer));
+			}
+			case ValueMap::Type::Double:
+				return BinaryFormat::IsFloat(value.GetDouble()) ? 5 : 9;
+			case ValueMap::Type::String:
+			{
+				std::size_t size{ value.GetString().size() };
+				return GetHeadSize(size) + size;
+			}
+			case ValueMap::Type::Array:
+			{
+				const ValueMap::Array& array{ value.GetArray() };
+				std::size_t size{ GetHeadSize(array.size()) };
+				for (const Dynamic& element : array)
+				{
+					size += GetEncodedSize(element);
+				}
+				return size;
+			}
+			case ValueMap::Type::Object:
+			{
+				const ValueMap::ObjectMap& objectMap{ value.GetObjectMap() };
+				std::size_t size{ GetHeadSize(objectMap.Size()) };
+				for (const auto& entry : objectMap)
+				{
+					std::size_t nameSize{ entry.first.GetName().size() };
+					size += GetHeadSize(nameSize) + nameSize + GetEncodedSize(entry.second);
+				}
+				return size;
+			}
+			default:
+				return 1;
+		}
+	}
+
+	// Append encoded value to buffer.
+	static void Encode(const Dynamic& value, std::vector<uint8_t>& buffer)
+	{
+		std::size_t offset{ buffer.size() };
+		buffer.resize(offset + GetEncodedSize(value));
+		BinaryWriter writer{ buffer.data() + offset };
+		Write(writer, value);
+	}
+
+	static std::vector<uint8_t> Encode(const Dynamic& value)
+	{
+		std::vector<uint8_t> buffer;
+		Encode(value, buffer);
+		return buffer;
+	}
+
+	// Input must be exactly one data item.
+	static Dynamic Decode(const uint8_t* pData, std::size_t size, bool isBorrowString = true)
+	{
+		BinaryReader reader{ pData, size };
+		// Names come from input, so they are not added to the global key table.
+		DynamicKeyCache keyCache;
+		Dynamic value = Read(reader, keyCache, isBorrowString, 0);
+		if (!reader.IsEnd())
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+		return value;
+	}
+
+	static Dynamic Decode(const std::vector<uint8_t>& buffer, bool isBorrowString = true)
+	{
+		return Decode(buffer.data(), buffer.size(), isBorrowString);
+	}
+
+	// All nodes of decoded document are allocated from arena.
+	static Dynamic Decode(const uint8_t* pData, std::size_t size, DynamicArena& arena, bool isBorrowString = true)
+	{
+		ScopedDynamicArena scope{ arena };
+		return Decode(pData, size, isBorrowString);
+	}
+
+private:
+	enum MajorType : uint8_t
+	{
+		UnsignedInteger = 0,
+		NegativeInteger = 1,
+		ByteString = 2,
+		TextString = 3,
+		Array = 4,
+		Map = 5,
+		Tag = 6,
+		Simple = 7
+	};
+
+	static constexpr uint8_t c_indefinite{ 31 };
+	static constexpr uint8_t c_break{ 0xFF };
+
+	static std::size_t GetHeadSize(uint64_t argument) noexcept
+	{
+		return argument < 24 ? 1 : (argument <= 0xFF ? 2 : (argument <= 0xFFFF ? 3 : (argument <= 0xFFFFFFFF ? 5 : 9)));
+	}
+
+	static void WriteHead(BinaryWriter& writer, MajorType majorType, uint64_t argument) noexcept
+	{
+		uint8_t major{ static_cast<uint8_t>(majorType << 5) };
+		if (argument < 24)
+		{
+			writer.WriteByte(static_cast<uint8_t>(major | argument));
+		}
+		else if (argument <= 0xFF)
+		{
+			writer.WriteByte(major | 24);
+			writer.WriteByte(static_cast<uint8_t>(argument));
+		}
+		else if (argument <= 0xFFFF)
+		{
+			writer.WriteByte(major | 25);
+			writer.WriteBigEndian(static_cast<uint16_t>(argument));
+		}
+		else if (argument <= 0xFFFFFFFF)
+		{
+			writer.WriteByte(major | 26);
+			writer.WriteBigEndian(static_cast<uint32_t>(argument));
+		}
+		else
+		{
+			writer.WriteByte(major | 27);
+			writer.WriteBigEndian(argument);
+		}
+	}
+
+	static void WriteText(BinaryWriter& writer, const ValueMap::StringView value) noexcept
+	{
+		WriteHead(writer, TextString, value.size());
+		writer.WriteBytes(value.data(), value.size());
+	}
+
+	static void Write(BinaryWriter& writer, const Dynamic& value)
+	{
+		switch (value.GetType())
+		{
+			case ValueMap::Type::Bool:
+				writer.WriteByte(value.GetBool() ? 0xF5 : 0xF4);
+				break;
+			case ValueMap::Type::Int32:
+			case ValueMap::Type::Int64:
+			{
+				ValueMap::Int64 integer{ value.GetInt64() };
+				if (integer >= 0)
+				{
+					WriteHead(writer, UnsignedInteger, static_cast<uint64_t>(integer));
+				}
+				else
+				{
+					// Negative integer n is encoded as -1 - n.
+					WriteHead(writer, NegativeInteger, ~static_cast<uint64_t>(integer));
+				}
+				break;
+			}
+			case ValueMap::Type::Double:
+			{
+				ValueMap::Double doubleValue{ value.GetDouble() };
+				if (BinaryFormat::IsFloat(doubleValue))
+				{
+					writer.WriteByte(0xFA);
+					writer.WriteBigEndian(BinaryFormat::ToFloatBits(doubleValue));
+				}
+				else
+				{
+					writer.WriteByte(0xFB);
+					writer.WriteBigEndian(BinaryFormat::ToDoubleBits(doubleValue));
+				}
+				break;
+			}
+			case ValueMap::Type::String:
+				WriteText(writer, value.GetString());
+				break;
+			case ValueMap::Type::Array:
+			{
+				const ValueMap::Array& array{ value.GetArray() };
+				WriteHead(writer, Array, array.size());
+				for (const Dynamic& element : array)
+				{
+					Write(writer, element);
+				}
+				break;
+			}
+			case ValueMap::Type::Object:
+			{
+				const ValueMap::ObjectMap& objectMap{ value.GetObjectMap() };
+				WriteHead(writer, Map, objectMap.Size());
+				for (const auto& entry : objectMap)
+				{
+					WriteText(writer, entry.first.GetName());
+					Write(writer, entry.second);
+				}
+				break;
+			}
+			default:
+				writer.WriteByte(0xF6);
+				break;
+		}
+	}
+
+	static uint64_t ReadArgument(BinaryReader& reader, uint8_t additional)
+	{
+		if (additional < 24)
+		{
+			return additional;
+		}
+		switch (additional)
+		{
+			case 24:
+				return reader.ReadByte();
+			case 25:
+				return reader.ReadBigEndian<uint16_t>();
+			case 26:
+				return reader.ReadBigEndian<uint32_t>();
+			case 27:
+				return reader.ReadBigEndian<uint64_t>();
+			default:
+				Error::ThrowMalFormatErrorException();
+		}
+	}
+
+	static ValueMap::Double ToDoubleFromHalf(uint16_t half) noexcept
+	{
+		int exponent{ (half >> 10) & 0x1F };
+		int mantissa{ half & 0x3FF };
+		ValueMap::Double value;
+		if (exponent == 0)
+		{
+			value = std::ldexp(mantissa, -24);
+		}
+		else if (exponent != 31)
+		{
+			value = std::ldexp(mantissa + 1024, exponent - 25);
+		}
+		else
+		{
+			value = mantissa == 0 ? std::numeric_limits<ValueMap::Double>::infinity() : std::numeric_limits<ValueMap::Double>::quiet_NaN();
+		}
+		return (half & 0x8000) != 0 ? -value : value;
+	}
+
+	// Chunks of indefinite length string are concatenated, they can't be borrowed.
+	static Dynamic ReadString(BinaryReader& reader, uint8_t majorType, uint8_t additional, bool isBorrowString)
+	{
+		if (additional != c_indefinite)
+		{
+			uint64_t size{ ReadArgument(reader, additional) };
+			return BinaryFormat::MakeString(reader.ReadBytes(size), static_cast<std::size_t>(size), isBorrowString);
+		}
+
+		std::string value;
+		for (;;)
+		{
+			uint8_t initial{ reader.ReadByte() };
+			if (initial == c_break)
+			{
+				break;
+			}
+			if ((initial >> 5) != majorType || (initial & 0x1F) == c_indefinite)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+			uint64_t size{ ReadArgument(reader, initial & 0x1F) };
+			value.append(reinterpret_cast<const char*>(reader.ReadBytes(size)), static_cast<std::size_t>(size));
+		}
+		return Dynamic(ValueMap::StringView{ value });
+	}
+
+	static bool IsBreak(BinaryReader& reader, bool isIndefinite)
+	{
+		if (isIndefinite && reader.PeekByte() == c_break)
+		{
+			reader.ReadByte();
+			return true;
+		}
+		return false;
+	}
+
+	static Dynamic ReadArray(BinaryReader& reader, DynamicKeyCache& keyCache, uint8_t additional, bool isBorrowString, std::size_t depth)
+	{
+		bool isIndefinite{ additional == c_indefinite };
+		uint64_t count{ isIndefinite ? std::numeric_limits<uint64_t>::max() : ReadArgument(reader, additional) };
+		ValueMap::Array array = BinaryFormat::MakeArray();
+		// Each item takes at least one byte, so count from malicious input can't over reserve.
+		array.reserve(static_cast<std::size_t>(std::min<uint64_t>(count, 4096)));
+		for (uint64_t i = 0; i < count && !IsBreak(reader, isIndefinite); ++i)
+		{
+			array.push_back(Read(reader, keyCache, isBorrowString, depth + 1));
+		}
+		return Dynamic(std::move(array));
+	}
+
+	static Dynamic ReadMap(BinaryReader& reader, DynamicKeyCache& keyCache, uint8_t additional, bool isBorrowString, std::size_t depth)
+	{
+		bool isIndefinite{ additional == c_indefinite };
+		uint64_t count{ isIndefinite ? std::numeric_limits<uint64_t>::max() : ReadArgument(reader, additional) };
+		Dynamic object = Dynamic::MakeObject();
+		ValueMap::ObjectMap& objectMap{ object.GetObjectMap() };
+		objectMap.Reserve(static_cast<std::size_t>(std::min<uint64_t>(count, 4096)));
+		for (uint64_t i = 0; i < count && !IsBreak(reader, isIndefinite); ++i)
+		{
+			uint8_t initial{ reader.ReadByte() };
+			if ((initial >> 5) != TextString)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+			Dynamic name = ReadString(reader, TextString, initial & 0x1F, true);
+			ValueMap::StringView nameView{ name.GetString() };
+			DynamicKey key{ keyCache.Get(nameView.data(), nameView.size()) };
+			objectMap.Set(key, Read(reader, keyCache, isBorrowString, depth + 1));
+		}
+		return object;
+	}
+
+	static Dynamic Read(BinaryReader& reader, DynamicKeyCache& keyCache, bool isBorrowString, std::size_t depth)
+	{
+		if (depth > BinaryFormat::c_maxDepth)
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		uint8_t initial{ reader.ReadByte() };
+		uint8_t majorType{ static_cast<uint8_t>(initial >> 5) };
+		uint8_t additional{ static_cast<uint8_t>(initial & 0x1F) };
+		switch (majorType)
+		{
+			case UnsignedInteger:
+				return BinaryFormat::MakeUnsigned(ReadArgument(reader, additional));
+			case NegativeInteger:
+			{
+				uint64_t argument{ ReadArgument(reader, additional) };
+				if (argument > static_cast<uint64_t>(std::numeric_limits<ValueMap::Int64>::max()))
+				{
+					return Dynamic(-1.0 - static_cast<ValueMap::Double>(argument));
+				}
+				return BinaryFormat::MakeInteger(-1 - static_cast<ValueMap::Int64>(argument));
+			}
+			case ByteString:
+			case TextString:
+				return ReadString(reader, majorType, additional, isBorrowString);
+			case Array:
+				return ReadArray(reader, keyCache, additional, isBorrowString, depth);
+			case Map:
+				return ReadMap(reader, keyCache, additional, isBorrowString, depth);
+			case Tag:
+				ReadArgument(reader, additional);
+				return Read(reader, keyCache, isBorrowString, depth + 1);
+			default:
+				break;
+		}
+
+		switch (additional)
+		{
+			case 20:
+				return Dynamic(false);
+			case 21:
+				return Dynamic(true);
+			case 24:
+				reader.ReadByte();
+				return Dynamic{};
+			case 25:
+				return Dynamic(ToDoubleFromHalf(reader.ReadBigEndian<uint16_t>()));
+			case 26:
+				return Dynamic(BinaryFormat::ToDouble(reader.ReadBigEndian<uint32_t>()));
+			case 27:
+				return Dynamic(BinaryFormat::ToDouble(reader.ReadBigEndian<uint64_t>()));
+			case c_indefinite:
+				// Break outside of indefinite length item.
+				Error::ThrowMalFormatErrorException();
+			default:
+				return Dynamic{};
+		}
+	}
+};
+
+}}}
+
+#endif
@@ -0,0 +1,430 @@
+#pragma once
+#ifndef ZEST_LIB_MESSAGEPACK_H
+#define ZEST_LIB_MESSAGEPACK_H
+
+#include <cstdint>
+#include <vector>
+
+#include "BinaryBuffer.h"
+#include "../Dynamics.h"
+#include "../Error.h"
+
+namespace Zest { namespace Lib { namespace Binary {
+
+/*! MessagePack codec for Dynamic.
+	Encoder computes exact size first, so output is allocated once and written in one pass.
+	Integers use the shortest encoding, doubles are written as float32 when it is lossless.
+	Decoder borrows strings and bin blobs from input unless isBorrowString is false, so input must
+	outlive the decoded document. Bin is decoded as String, since Dynamic has no binary type.
+	Unsigned integers above Int64 range are decoded as Double, ext types are rejected.
+	To decode into arena, pass the arena or decode inside ScopedDynamicArena.
+*/
+class MessagePack
+{
+public:
+	static std::size_t GetEncodedSize(const Dynamic& value)
+	{
+		switch (value.GetType())
+		{
+			case ValueMap::Type::Int32:
+			case ValueMap::Type::Int64:
+				return GetIntegerSize(value.GetInt64());
+			case ValueMap::Type::Double:
+				return BinaryFormat::IsFloat(value.GetDouble()) ? 5 : 9;
+			case ValueMap::Type::String:
+			{
+				std::size_t size{ value.GetString().size() };
+				return GetStringHeaderSize(size) + size;
+			}
+			case ValueMap::Type::Array:
+			{
+				const ValueMap::Array& array{ value.GetArray() };
+				std::size_t size{ GetContainerHeaderSize(array.size()) };
+				for (const Dynamic& element : array)
+				{
+					size += GetEncodedSize(element);
+				}
+				return size;
+			}
+			case ValueMap::Type::Object:
+			{
+				const ValueMap::ObjectMap& objectMap{ value.GetObjectMap() };
+				std::size_t size{ GetContainerHeaderSize(objectMap.Size()) };
+				for (const auto& entry : objectMap)
+				{
+					std::size_t nameSize{ entry.first.GetName().size() };
+					size += GetStringHeaderSize(nameSize) + nameSize + GetEncodedSize(entry.second);
+				}
+				return size;
+			}
+			default:
+				return 1;
+		}
+	}
+
+	// Append encoded value to buffer.
+	static void Encode(const Dynamic& value, std::vector<uint8_t>& buffer)
+	{
+		std::size_t offset{ buffer.size() };
+		buffer.resize(offset + GetEncodedSize(value));
+		BinaryWriter writer{ buffer.data() + offset };
+		Write(writer, value);
+	}
+
+	static std::vector<uint8_t> Encode(const Dynamic& value)
+	{
+		std::vector<uint8_t> buffer;
+		Encode(value, buffer);
+		return buffer;
+	}
+
+	// Input must be exactly one value.
+	static Dynamic Decode(const uint8_t* pData, std::size_t size, bool isBorrowString = true)
+	{
+		BinaryReader reader{ pData, size };
+		// Names come from input, so they are not added to the global key table.
+		DynamicKeyCache keyCache;
+		Dynamic value = Read(reader, keyCache, isBorrowString, 0);
+		if (!reader.IsEnd())
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+		return value;
+	}
+
+	static Dynamic Decode(const std::vector<uint8_t>& buffer, bool isBorrowString = true)
+	{
+		return Decode(buffer.data(), buffer.size(), isBorrowString);
+	}
+
+	// All nodes of decoded document are allocated from arena.
+	static Dynamic Decode(const uint8_t* pData, std::size_t size, DynamicArena& arena, bool isBorrowString = true)
+	{
+		ScopedDynamicArena scope{ arena };
+		return Decode(pData, size, isBorrowString);
+	}
+
+private:
+	static std::size_t GetIntegerSize(ValueMap::Int64 value) noexcept
+	{
+		if (value >= -32 && value <= 127)
+		{
+			return 1;
+		}
+		if (value >= 0)
+		{
+			return value <= 0xFF ? 2 : (value <= 0xFFFF ? 3 : (value <= 0xFFFFFFFFLL ? 5 : 9));
+		}
+		return value >= -128 ? 2 : (value >= -32768 ? 3 : (value >= -2147483648LL ? 5 : 9));
+	}
+
+	static std::size_t GetStringHeaderSize(std::size_t size)
+	{
+		if (size > 0xFFFFFFFF)
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+		return size < 32 ? 1 : (size <= 0xFF ? 2 : (size <= 0xFFFF ? 3 : 5));
+	}
+
+	static std::size_t GetContainerHeaderSize(std::size_t count)
+	{
+		if (count > 0xFFFFFFFF)
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+		return count < 16 ? 1 : (count <= 0xFFFF ? 3 : 5);
+	}
+
+	static void WriteInteger(BinaryWriter& writer, ValueMap::Int64 value) noexcept
+	{
+		if (value >= -32 && value <= 127)
+		{
+			writer.WriteByte(static_cast<uint8_t>(value));
+		}
+		else if (value >= 0)
+		{
+			if (value <= 0xFF)
+			{
+				writer.WriteByte(0xCC);
+				writer.WriteByte(static_cast<uint8_t>(value));
+			}
+			else if (value <= 0xFFFF)
+			{
+				writer.WriteByte(0xCD);
+				writer.WriteBigEndian(static_cast<uint16_t>(value));
+			}
+			else if (value <= 0xFFFFFFFFLL)
+			{
+				writer.WriteByte(0xCE);
+				writer.WriteBigEndian(static_cast<uint32_t>(value));
+			}
+			else
+			{
+				writer.WriteByte(0xCF);
+				writer.WriteBigEndian(static_cast<uint64_t>(value));
+			}
+		}
+		else if (value >= -128)
+		{
+			writer.WriteByte(0xD0);
+			writer.WriteByte(static_cast<uint8_t>(value));
+		}
+		else if (value >= -32768)
+		{
+			writer.WriteByte(0xD1);
+			writer.WriteBigEndian(static_cast<uint16_t>(value));
+		}
+		else if (value >= -2147483648LL)
+		{
+			writer.WriteByte(0xD2);
+			writer.WriteBigEndian(static_cast<uint32_t>(value));
+		}
+		else
+		{
+			writer.WriteByte(0xD3);
+			writer.WriteBigEndian(static_cast<uint64_t>(value));
+		}
+	}
+
+	static void WriteString(BinaryWriter& writer, const ValueMap::StringView value) noexcept
+	{
+		std::size_t size{ value.size() };
+		if (size < 32)
+		{
+			writer.WriteByte(static_cast<uint8_t>(0xA0 | size));
+		}
+		else if (size <= 0xFF)
+		{
+			writer.WriteByte(0xD9);
+			writer.WriteByte(static_cast<uint8_t>(size));
+		}
+		else if (size <= 0xFFFF)
+		{
+			writer.WriteByte(0xDA);
+			writer.WriteBigEndian(static_cast<uint16_t>(size));
+		}
+		else
+		{
+			writer.WriteByte(0xDB);
+			writer.WriteBigEndian(static_cast<uint32_t>(size));
+		}
+		writer.WriteBytes(value.data(), size);
+	}
+
+	// Fix, 16 and 32 bit headers of array and map differ only in first byte.
+	static void WriteContainerHeader(BinaryWriter& writer, std::size_t count, uint8_t fixPrefix, uint8_t prefix16) noexcept
+	{
+		if (count < 16)
+		{
+			writer.WriteByte(static_cast<uint8_t>(fixPrefix | count));
+		}
+		else if (count <= 0xFFFF)
+		{
+			writer.WriteByte(prefix16);
+			writer.WriteBigEndian(static_cast<uint16_t>(count));
+		}
+		else
+		{
+			writer.WriteByte(static_cast<uint8_t>(prefix16 + 1));
+			writer.WriteBigEndian(static_cast<uint32_t>(count));
+		}
+	}
+
+	static void Write(BinaryWriter& writer, const Dynamic& value)
+	{
+		switch (value.GetType())
+		{
+			case ValueMap::Type::Bool:
+				writer.WriteByte(value.GetBool() ? 0xC3 : 0xC2);
+				break;
+			case ValueMap::Type::Int32:
+			case ValueMap::Type::Int64:
+				WriteInteger(writer, value.GetInt64());
+				break;
+			case ValueMap::Type::Double:
+			{
+				ValueMap::Double doubleValue{ value.GetDouble() };
+				if (BinaryFormat::IsFloat(doubleValue))
+				{
+					writer.WriteByte(0xCA);
+					writer.WriteBigEndian(BinaryFormat::ToFloatBits(doubleValue));
+				}
+				else
+				{
+					writer.WriteByte(0xCB);
+					writer.WriteBigEndian(BinaryFormat::ToDoubleBits(doubleValue));
+				}
+				break;
+			}
+			case ValueMap::Type::String:
+				WriteString(writer, value.GetString());
+				break;
+			case ValueMap::Type::Array:
+			{
+				const ValueMap::Array& array{ value.GetArray() };
+				WriteContainerHeader(writer, array.size(), 0x90, 0xDC);
+				for (const Dynamic& element : array)
+				{
+					Write(writer, element);
+				}
+				break;
+			}
+			case ValueMap::Type::Object:
+			{
+				const ValueMap::ObjectMap& objectMap{ value.GetObjectMap() };
+				WriteContainerHeader(writer, objectMap.Size(), 0x80, 0xDE);
+				for (const auto& entry : objectMap)
+				{
+					WriteString(writer, entry.first.GetName());
+					Write(writer, entry.second);
+				}
+				break;
+			}
+			default:
+				writer.WriteByte(0xC0);
+				break;
+		}
+	}
+
+	static Dynamic ReadArray(BinaryReader& reader, DynamicKeyCache& keyCache, std::size_t count, bool isBorrowString, std::size_t depth)
+	{
+		ValueMap::Array array = BinaryFormat::MakeArray();
+		// Each element takes at least one byte, so count from malicious input can't over reserve.
+		array.reserve(std::min<std::size_t>(count, 4096));
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			array.push_back(Read(reader, keyCache, isBorrowString, depth + 1));
+		}
+		return Dynamic(std::move(array));
+	}
+
+	static Dynamic ReadMap(BinaryReader& reader, DynamicKeyCache& keyCache, std::size_t count, bool isBorrowString, std::size_t depth)
+	{
+		Dynamic object = Dynamic::MakeObject();
+		ValueMap::ObjectMap& objectMap{ object.GetObjectMap() };
+		objectMap.Reserve(std::min<std::size_t>(count, 4096));
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			uint64_t nameSize{ ReadStringSize(reader) };
+			const char* pName{ reinterpret_cast<const char*>(reader.ReadBytes(nameSize)) };
+			DynamicKey key{ keyCache.Get(pName, static_cast<std::size_t>(nameSize)) };
+			objectMap.Set(key, Read(reader, keyCache, isBorrowString, depth + 1));
+		}
+		return object;
+	}
+
+	// Map keys must be strings.
+	static uint64_t ReadStringSize(BinaryReader& reader)
+	{
+		uint8_t type{ reader.ReadByte() };
+		if ((type & 0xE0) == 0xA0)
+		{
+			return type & 0x1F;
+		}
+		switch (type)
+		{
+			case 0xD9:
+				return reader.ReadByte();
+			case 0xDA:
+				return reader.ReadBigEndian<uint16_t>();
+			case 0xDB:
+				return reader.ReadBigEndian<uint32_t>();
+			default:
+				Error::ThrowMalFormatErrorException();
+		}
+	}
+
+	static Dynamic Read(BinaryReader& reader, DynamicKeyCache& keyCache, bool isBorrowString, std::size_t depth)
+	{
+		if (depth > BinaryFormat::c_maxDepth)
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		uint8_t type{ reader.ReadByte() };
+		if (type <= 0x7F)
+		{
+			return Dynamic(static_cast<ValueMap::Int32>(type));
+		}
+		if (type >= 0xE0)
+		{
+			return Dynamic(static_cast<ValueMap::Int32>(static_cast<int8_t>(type)));
+		}
+		if ((type & 0xE0) == 0xA0)
+		{
+			std::size_t size{ static_cast<std::size_t>(type & 0x1F) };
+			return BinaryFormat::MakeString(reader.ReadBytes(size), size, isBorrowString);
+		}
+		if ((type & 0xF0) == 0x90)
+		{
+			return ReadArray(reader, keyCache, type & 0x0F, isBorrowString, depth);
+		}
+		if ((type & 0xF0) == 0x80)
+		{
+			return ReadMap(reader, keyCache, type & 0x0F, isBorrowString, depth);
+		}
+
+		switch (type)
+		{
+			case 0xC0:
+				return Dynamic{};
+			case 0xC2:
+				return Dynamic(false);
+			case 0xC3:
+				return Dynamic(true);
+			case 0xCC:
+				return BinaryFormat::MakeInteger(reader.ReadByte());
+			case 0xCD:
+				return BinaryFormat::MakeInteger(reader.ReadBigEndian<uint16_t>());
+			case 0xCE:
+				return BinaryFormat::MakeInteger(reader.ReadBigEndian<uint32_t>());
+			case 0xCF:
+				return BinaryFormat::MakeUnsigned(reader.ReadBigEndian<uint64_t>());
+			case 0xD0:
+				return BinaryFormat::MakeInteger(static_cast<int8_t>(reader.ReadByte()));
+			case 0xD1:
+				return BinaryFormat::MakeInteger(static_cast<int16_t>(reader.ReadBigEndian<uint16_t>()));
+			case 0xD2:
+				return BinaryFormat::MakeInteger(static_cast<int32_t>(reader.ReadBigEndian<uint32_t>()));
+			case 0xD3:
+				return BinaryFormat::MakeInteger(static_cast<int64_t>(reader.ReadBigEndian<uint64_t>()));
+			case 0xCA:
+				return Dynamic(BinaryFormat::ToDouble(reader.ReadBigEndian<uint32_t>()));
+			case 0xCB:
+				return Dynamic(BinaryFormat::ToDouble(reader.ReadBigEndian<uint64_t>()));
+			case 0xC4:
+			case 0xD9:
+			{
+				std::size_t size{ reader.ReadByte() };
+				return BinaryFormat::MakeString(reader.ReadBytes(size), size, isBorrowString);
+			}
+			case 0xC5:
+			case 0xDA:
+			{
+				std::size_t size{ reader.ReadBigEndian<uint16_t>() };
+				return BinaryFormat::MakeString(reader.ReadBytes(size), size, isBorrowString);
+			}
+			case 0xC6:
+			case 0xDB:
+			{
+				std::size_t size{ reader.ReadBigEndian<uint32_t>() };
+				return BinaryFormat::MakeString(reader.ReadBytes(size), size, isBorrowString);
+			}
+			case 0xDC:
+				return ReadArray(reader, keyCache, reader.ReadBigEndian<uint16_t>(), isBorrowString, depth);
+			case 0xDD:
+				return ReadArray(reader, keyCache, reader.ReadBigEndian<uint32_t>(), isBorrowString, depth);
+			case 0xDE:
+				return ReadMap(reader, keyCache, reader.ReadBigEndian<uint16_t>(), isBorrowString, depth);
+			case 0xDF:
+				return ReadMap(reader, keyCache, reader.ReadBigEndian<uint32_t>(), isBorrowString, depth);
+			default:
+				Error::ThrowMalFormatErrorException();
+		}
+	}
+};
+
+}}}
+
+#endif
@@ -0,0 +1,146 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+
+#include "Binary/Cbor.h"
+#include "Binary/MessagePack.h"
+
+namespace Zest { namespace Lib { namespace Binary {
+
+namespace {
+
+Dynamic MakeDocument()
+{
+	ValueMap::Array numbers;
+	for (int i = -40; i < 300; i += 7)
+	{
+		numbers.push_back(Dynamic(i * i * i));
+	}
+	numbers.push_back(Dynamic(ValueMap::Int64{ -5000000000 }));
+	numbers.push_back(Dynamic(0.5));
+	numbers.push_back(Dynamic(0.1));
+	return Dynamic{
+		Property{ "name", "zest" },
+		Property{ "long", std::string(300, 'x') },
+		Property{ "ok", true },
+		Property{ "none", Dynamic() },
+		Property{ "numbers", Dynamic(std::move(numbers)) },
+		Property{ "nested", Dynamic{ Property{ "empty", Dynamic::MakeObject() } } }
+	};
+}
+
+}
+
+TEST(BinaryTest, MessagePack_EncodeDecode_RoundTrip)
+{
+	Dynamic document = MakeDocument();
+	std::vector<uint8_t> buffer{ MessagePack::Encode(document) };
+	EXPECT_EQ(buffer.size(), MessagePack::GetEncodedSize(document));
+
+	Dynamic decoded = MessagePack::Decode(buffer);
+	EXPECT_TRUE(decoded == document);
+	// Strings are borrowed from buffer.
+	EXPECT_EQ(decoded["name"].GetString().data(), reinterpret_cast<const char*>(buffer.data()) + 7);
+
+	EXPECT_EQ(MessagePack::Encode(Dynamic(-1)), (std::vector<uint8_t>{ 0xFF }));
+	EXPECT_EQ(MessagePack::Encode(Dynamic(200)), (std::vector<uint8_t>{ 0xCC, 0xC8 }));
+	EXPECT_EQ(MessagePack::Encode(Dynamic(1.5)), (std::vector<uint8_t>{ 0xCA, 0x3F, 0xC0, 0x00, 0x00 }));
+}
+
+TEST(BinaryTest, Cbor_EncodeDecode_RoundTrip)
+{
+	Dynamic document = MakeDocument();
+	std::vector<uint8_t> buffer{ Cbor::Encode(document) };
+	EXPECT_EQ(buffer.size(), Cbor::GetEncodedSize(document));
+	EXPECT_TRUE(Cbor::Decode(buffer, false) == document);
+
+	EXPECT_EQ(Cbor::Encode(Dynamic(-500)), (std::vector<uint8_t>{ 0x39, 0x01, 0xF3 }));
+
+	// Indefinite array [1, "ab"] with chunked string, tagged half float 1.5 and undefined.
+	std::vector<uint8_t> indefinite{ 0x9F, 0x01, 0x7F, 0x61, 0x61, 0x61, 0x62, 0xFF, 0xC1, 0xF9, 0x3E, 0x00, 0xF7, 0xFF };
+	Dynamic decoded = Cbor::Decode(indefinite);
+	ASSERT_EQ(decoded.GetArray().size(), 4u);
+	EXPECT_EQ(decoded[1].GetString(), "ab");
+	EXPECT_EQ(decoded[2].GetDouble(), 1.5);
+	EXPECT_EQ(decoded[3].GetType(), ValueMap::Type::Null);
+}
+
+TEST(BinaryTest, Decode_IntoArenaAndMalformed)
+{
+	std::vector<uint8_t> buffer{ MessagePack::Encode(MakeDocument()) };
+	DynamicArena arena;
+	Dynamic decoded = MessagePack::Decode(buffer.data(), buffer.size(), arena);
+	EXPECT_EQ(decoded["numbers"].GetArray().get_allocator().resource(), arena.GetMemoryResource());
+
+	std::vector<uint8_t> truncated(buffer.begin(), buffer.end() - 1);
+	EXPECT_THROW(MessagePack::Decode(truncated), Error::Exception);
+	std::vector<uint8_t> deep(1000, 0x91);
+	deep.push_back(0xC0);
+	EXPECT_THROW(MessagePack::Decode(deep), Error::Exception);
+	EXPECT_THROW(Cbor::Decode(std::vector<uint8_t>{ 0xA1, 0x01, 0x02 }), Error::Exception);
+}
+
+TEST(BinaryTest, Decode_TruncatedAndMalformed_Throw)
+{
+	std::vector<uint8_t> packed{ MessagePack::Encode(MakeDocument()) };
+	std::vector<uint8_t> cbor{ Cbor::Encode(MakeDocument()) };
+	for (std::size_t size = 0; size < packed.size(); ++size)
+	{
+		EXPECT_THROW(MessagePack::Decode(packed.data(), size), Error::Exception) << size;
+	}
+	for (std::size_t size = 0; size < cbor.size(); ++size)
+	{
+		EXPECT_THROW(Cbor::Decode(cbor.data(), size), Error::Exception) << size;
+	}
+
+	// Trailing byte, key which is not a string, counts larger than input and missing break.
+	packed.push_back(0xC0);
+	EXPECT_THROW(MessagePack::Decode(packed), Error::Exception);
+	EXPECT_THROW(MessagePack::Decode(std::vector<uint8_t>{ 0x81, 0x01, 0x02 }), Error::Exception);
+	EXPECT_THROW(MessagePack::Decode(std::vector<uint8_t>{ 0xDD, 0xFF, 0xFF, 0xFF, 0xFF, 0xC0 }), Error::Exception);
+	EXPECT_THROW(MessagePack::Decode(std::vector<uint8_t>{ 0xDB, 0xFF, 0xFF, 0xFF, 0xFF, 0x61 }), Error::Exception);
+	EXPECT_THROW(Cbor::Decode(std::vector<uint8_t>{ 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 }), Error::Exception);
+	EXPECT_THROW(Cbor::Decode(std::vector<uint8_t>{ 0x7B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x61 }), Error::Exception);
+	EXPECT_THROW(Cbor::Decode(std::vector<uint8_t>{ 0x9F, 0x01, 0x02 }), Error::Exception);
+	EXPECT_THROW(Cbor::Decode(std::vector<uint8_t>{ 0x7F, 0x01, 0xFF }), Error::Exception);
+}
+
+TEST(BinaryTest, Decode_DepthLimit)
+{
+	for (uint8_t arrayOfOne : { uint8_t{ 0x91 }, uint8_t{ 0x81 } })
+	{
+		bool isCbor{ arrayOfOne == 0x81 };
+		std::vector<uint8_t> atLimit(BinaryFormat::c_maxDepth, arrayOfOne);
+		atLimit.push_back(isCbor ? 0xF6 : 0xC0);
+		Dynamic decoded = isCbor ? Cbor::Decode(atLimit) : MessagePack::Decode(atLimit);
+		EXPECT_EQ(decoded.GetArray().size(), 1u);
+
+		std::vector<uint8_t> overLimit(BinaryFormat::c_maxDepth + 1, arrayOfOne);
+		overLimit.push_back(isCbor ? 0xF6 : 0xC0);
+		EXPECT_THROW(isCbor ? Cbor::Decode(overLimit) : MessagePack::Decode(overLimit), Error::Exception);
+	}
+	// Nested tags count as depth too.
+	std::vector<uint8_t> tags(BinaryFormat::c_maxDepth + 1, 0xC1);
+	tags.push_back(0x01);
+	EXPECT_THROW(Cbor::Decode(tags), Error::Exception);
+}
+
+TEST(BinaryTest, Decode_InputKeys_TableNotGrown)
+{
+	DynamicKeyCache keyCache;
+	Dynamic document = Dynamic::MakeObject();
+	for (int i = 0; i < 500; ++i)
+	{
+		std::string name{ "binary key " + std::to_string(i) };
+		document.SetObject(keyCache.Get(name.data(), name.size()), Dynamic(i));
+	}
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	Dynamic packed = MessagePack::Decode(MessagePack::Encode(document));
+	Dynamic cbor = Cbor::Decode(Cbor::Encode(document));
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_TRUE(packed == document);
+	EXPECT_TRUE(cbor == document);
+	EXPECT_EQ(cbor[DynamicKey{ "binary key 7" }].GetInt32(), 7);
+}
+
+}}}
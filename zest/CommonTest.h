@@ -4,3 +4,14 @@
 #define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
 #endif // !_SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
 
+
+#include <utility>
+
+#include "Dynamics.h"
+
+namespace Zest { namespace Lib {
+
+// Object literal in tests: Dynamic{ Property{ "name", value }, ... }
+using Property = std::pair<ValueMap::String, ValueMap::Object>;
+
+}}
@@ -0,0 +1,505 @@
+#pragma once
+#ifndef ZEST_LIB_DYNAMICCOLUMNAR_H
+#define ZEST_LIB_DYNAMICCOLUMNAR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Dynamics.h"
+#include "Error.h"
+#include "Hash.h"
+#include "Platform.h"
+
+namespace Zest { namespace Lib {
+
+enum class ColumnType : uint32_t
+{
+	// Every row is null or missing.
+	Null,
+	Bool,
+	Int64,
+	Double,
+	// Dictionary encoded, rows store codes into dictionary.
+	String,
+	// Arrays, objects or values of incompatible types, stored as Dynamic.
+	Dynamic
+};
+
+struct ColumnSchema
+{
+	DynamicKey key;
+	ColumnType type;
+};
+
+using DynamicSchema = std::vector<ColumnSchema>;
+
+/*! One property of all rows stored contiguously.
+	Only the vector matching column type is filled, rows which are null or missing
+	are cleared in validity bitmap and hold 0, false, code 0 or null.
+*/
+class DynamicColumn
+{
+public:
+	DynamicColumn(const DynamicKey& key, ColumnType type)
+		: m_key{ key }, m_type{ type }, m_size{ 0 }
+	{
+	}
+
+	const DynamicKey& GetKey() const noexcept
+	{
+		return m_key;
+	}
+
+	ColumnType GetType() const noexcept
+	{
+		return m_type;
+	}
+
+	std::size_t Size() const noexcept
+	{
+		return m_size;
+	}
+
+	bool IsValid(std::size_t row) const noexcept
+	{
+		return (m_validity[row / 64] >> (row % 64)) & 1;
+	}
+
+	// Bit (row % 64) of word (row / 64) is set if row has value.
+	const std::vector<uint64_t>& GetValidity() const noexcept
+	{
+		return m_validity;
+	}
+
+	std::size_t GetValidCount() const noexcept
+	{
+		std::size_t count{ 0 };
+		for (uint64_t word : m_validity)
+		{
+			count += Platform::PopCount(word);
+		}
+		return count;
+	}
+
+	const std::vector<ValueMap::Int64>& GetInt64s() const noexcept
+	{
+		return m_int64s;
+	}
+
+	const std::vector<ValueMap::Double>& GetDoubles() const noexcept
+	{
+		return m_doubles;
+	}
+
+	// Bool stored as one byte per row.
+	const std::vector<uint8_t>& GetBools() const noexcept
+	{
+		return m_bools;
+	}
+
+	const std::vector<uint32_t>& GetStringCodes() const noexcept
+	{
+		return m_stringCodes;
+	}
+
+	const std::vector<ValueMap::String>& GetDictionary() const noexcept
+	{
+		return m_dictionary;
+	}
+
+	const std::vector<Dynamic>& GetDynamics() const noexcept
+	{
+		return m_dynamics;
+	}
+
+	// Null if row is not valid.
+	Dynamic GetValue(std::size_t row) const
+	{
+		if (!IsValid(row))
+		{
+			return Dynamic{};
+		}
+
+		switch (m_type)
+		{
+			case ColumnType::Bool:
+				return Dynamic(m_bools[row] != 0);
+			case ColumnType::Int64:
+				return Dynamic(m_int64s[row]);
+			case ColumnType::Double:
+				return Dynamic(m_doubles[row]);
+			case ColumnType::String:
+				return Dynamic(ValueMap::StringView{ m_dictionary[m_stringCodes[row]] });
+			case ColumnType::Dynamic:
+				return m_dynamics[row];
+			default:
+				return Dynamic{};
+		}
+	}
+
+private:
+	friend class DynamicColumnar;
+
+	void Reserve(std::size_t rowCount)
+	{
+		m_validity.reserve((rowCount + 63) / 64);
+		switch (m_type)
+		{
+			case ColumnType::Bool:
+				m_bools.reserve(rowCount);
+				break;
+			case ColumnType::Int64:
+				m_int64s.reserve(rowCount);
+				break;
+			case ColumnType::Double:
+				m_doubles.reserve(rowCount);
+				break;
+			case ColumnType::String:
+				m_stringCodes.reserve(rowCount);
+				break;
+			case ColumnType::Dynamic:
+				m_dynamics.reserve(rowCount);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// Value is nullptr for missing property.
+	void Append(const Dynamic* pValue)
+	{
+		if (m_size % 64 == 0)
+		{
+			m_validity.push_back(0);
+		}
+
+		bool isValid{ pValue != nullptr && pValue->GetType() != ValueMap::Type::Null };
+		if (isValid)
+		{
+			m_validity.back() |= uint64_t{ 1 } << (m_size % 64);
+		}
+
+		switch (m_type)
+		{
+			case ColumnType::Bool:
+				m_bools.push_back(isValid && pValue->GetBool() ? 1 : 0);
+				break;
+			case ColumnType::Int64:
+				m_int64s.push_back(isValid ? pValue->GetInt64() : 0);
+				break;
+			case ColumnType::Double:
+				m_doubles.push_back(isValid ? pValue->GetDouble() : 0.0);
+				break;
+			case ColumnType::String:
+				m_stringCodes.push_back(isValid ? Encode(pValue->GetString()) : 0);
+				break;
+			case ColumnType::Dynamic:
+				m_dynamics.push_back(isValid ? *pValue : Dynamic{});
+				break;
+			default:
+				break;
+		}
+		++m_size;
+	}
+
+	uint32_t Encode(const ValueMap::StringView value)
+	{
+		// Open addressing from string hash to code, grown at half load.
+		if ((m_dictionary.size() + 1) * 2 > m_codeIndex.size())
+		{
+			Rehash(m_codeIndex.empty() ? 64 : m_codeIndex.size() * 2);
+		}
+
+		const std::size_t mask{ m_codeIndex.size() - 1 };
+		std::size_t slot{ Hash::HashString(value.data(), value.size()) & mask };
+		while (m_codeIndex[slot] != c_emptySlot)
+		{
+			uint32_t code{ m_codeIndex[slot] };
+			if (m_dictionary[code] == value)
+			{
+				return code;
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		uint32_t code{ static_cast<uint32_t>(m_dictionary.size()) };
+		m_dictionary.emplace_back(value);
+		m_codeIndex[slot] = code;
+		return code;
+	}
+
+	void Rehash(std::size_t capacity)
+	{
+		m_codeIndex.assign(capacity, c_emptySlot);
+		const std::size_t mask{ capacity - 1 };
+		for (uint32_t code = 0; code < m_dictionary.size(); ++code)
+		{
+			const ValueMap::String& value{ m_dictionary[code] };
+			std::size_t slot{ Hash::HashString(value.data(), value.size()) & mask };
+			while (m_codeIndex[slot] != c_emptySlot)
+			{
+				slot = (slot + 1) & mask;
+			}
+			m_codeIndex[slot] = code;
+		}
+	}
+
+	static constexpr uint32_t c_emptySlot{ 0xFFFFFFFF };
+
+	DynamicKey m_key;
+	ColumnType m_type;
+	std::size_t m_size;
+	std::vector<uint64_t> m_validity;
+	std::vector<ValueMap::Int64> m_int64s;
+	std::vector<ValueMap::Double> m_doubles;
+	std::vector<uint8_t> m_bools;
+	std::vector<uint32_t> m_stringCodes;
+	std::vector<ValueMap::String> m_dictionary;
+	std::vector<uint32_t> m_codeIndex;
+	std::vector<Dynamic> m_dynamics;
+};
+
+/*! Struct of arrays view of an array of objects.
+	Schema is the union of properties in order of first appearance. Int32 and Int64 become
+	Int64 column, integers mixed with doubles become Double column. Null and missing property
+	are both stored as invalid, so rows read back don't have these properties.
+*/
+class DynamicColumnar
+{
+public:
+	// Rows must be objects.
+	static DynamicSchema InferSchema(const ValueMap::Array& rows)
+	{
+		DynamicSchema schema;
+		std::vector<uint32_t> typeMasks;
+		for (const Dynamic& row : rows)
+		{
+			if (row.GetType() != ValueMap::Type::Object)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+
+			std::size_t position{ 0 };
+			for (const auto& entry : row.GetObjectMap())
+			{
+				std::size_t index{ FindColumn(schema, entry.first, position) };
+				if (index == schema.size())
+				{
+					schema.push_back(ColumnSchema{ entry.first, ColumnType::Null });
+					typeMasks.push_back(0);
+				}
+				typeMasks[index] |= 1u << static_cast<uint32_t>(entry.second.GetType());
+				position = index + 1;
+			}
+		}
+
+		for (std::size_t i = 0; i < schema.size(); ++i)
+		{
+			schema[i].type = ToColumnType(typeMasks[i]);
+		}
+		return schema;
+	}
+
+	static DynamicColumnar FromArray(const ValueMap::Array& rows)
+	{
+		return FromArray(rows, InferSchema(rows));
+	}
+
+	// Properties not in schema are dropped, values must be convertible to column type.
+	static DynamicColumnar FromArray(const ValueMap::Array& rows, const DynamicSchema& schema)
+	{
+		DynamicColumnar columnar;
+		columnar.m_rowCount = rows.size();
+		columnar.m_columns.reserve(schema.size());
+		for (const ColumnSchema& column : schema)
+		{
+			columnar.m_columns.emplace_back(column.key, column.type);
+			columnar.m_columns.back().Reserve(rows.size());
+		}
+
+		std::vector<const Dynamic*> values(schema.size());
+		for (const Dynamic& row : rows)
+		{
+			if (row.GetType() != ValueMap::Type::Object)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+
+			std::fill(values.begin(), values.end(), nullptr);
+			std::size_t position{ 0 };
+			for (const auto& entry : row.GetObjectMap())
+			{
+				std::size_t index{ FindColumn(schema, entry.first, position) };
+				if (index == schema.size())
+				{
+					continue;
+				}
+				if (!IsConvertible(entry.second.GetType(), schema[index].type))
+				{
+					Error::ThrowMalFormatErrorException();
+				}
+				values[index] = &entry.second;
+				position = index + 1;
+			}
+
+			for (std::size_t i = 0; i < values.size(); ++i)
+			{
+				columnar.m_columns[i].Append(values[i]);
+			}
+		}
+		return columnar;
+	}
+
+	std::size_t GetRowCount() const noexcept
+	{
+		return m_rowCount;
+	}
+
+	std::size_t GetColumnCount() const noexcept
+	{
+		return m_columns.size();
+	}
+
+	const DynamicColumn& GetColumn(std::size_t index) const noexcept
+	{
+		return m_columns[index];
+	}
+
+	// Nullptr if there is no such column.
+	const DynamicColumn* FindColumn(const DynamicKey& key) const noexcept
+	{
+		for (const DynamicColumn& column : m_columns)
+		{
+			if (column.GetKey() == key)
+			{
+				return &column;
+			}
+		}
+		return nullptr;
+	}
+
+	DynamicSchema GetSchema() const
+	{
+		DynamicSchema schema;
+		schema.reserve(m_columns.size());
+		for (const DynamicColumn& column : m_columns)
+		{
+			schema.push_back(ColumnSchema{ column.GetKey(), column.GetType() });
+		}
+		return schema;
+	}
+
+	// Object with valid columns of the row.
+	Dynamic GetRow(std::size_t row) const
+	{
+		Dynamic object = Dynamic::MakeObject();
+		ValueMap::ObjectMap& objectMap{ object.GetObjectMap() };
+		objectMap.Reserve(m_columns.size());
+		for (const DynamicColumn& column : m_columns)
+		{
+			if (column.IsValid(row))
+			{
+				objectMap.Set(column.GetKey(), column.GetValue(row));
+			}
+		}
+		return object;
+	}
+
+	ValueMap::Array ToArray() const
+	{
+		ValueMap::Array rows;
+		rows.reserve(m_rowCount);
+		for (std::size_t row = 0; row < m_rowCount; ++row)
+		{
+			rows.push_back(GetRow(row));
+		}
+		return rows;
+	}
+
+private:
+	DynamicColumnar()
+		: m_rowCount{ 0 }
+	{
+	}
+
+	// Rows usually have same property order, so column after the previous match is tried first.
+	static std::size_t FindColumn(const DynamicSchema& schema, const DynamicKey& key, std::size_t expected) noexcept
+	{
+		if (expected < schema.size() && schema[expected].key == key)
+		{
+			return expected;
+		}
+		for (std::size_t i = 0; i < schema.size(); ++i)
+		{
+			if (schema[i].key == key)
+			{
+				return i;
+			}
+		}
+		return schema.size();
+	}
+
+	static constexpr uint32_t TypeBit(ValueMap::Type type) noexcept
+	{
+		return 1u << static_cast<uint32_t>(type);
+	}
+
+	static ColumnType ToColumnType(uint32_t typeMask) noexcept
+	{
+		typeMask &= ~TypeBit(ValueMap::Type::Null);
+		if (typeMask == 0)
+		{
+			return ColumnType::Null;
+		}
+
+		const uint32_t integerMask{ TypeBit(ValueMap::Type::Int32) | TypeBit(ValueMap::Type::Int64) };
+		if ((typeMask & ~integerMask) == 0)
+		{
+			return ColumnType::Int64;
+		}
+		if ((typeMask & ~(integerMask | TypeBit(ValueMap::Type::Double))) == 0)
+		{
+			return ColumnType::Double;
+		}
+		if (typeMask == TypeBit(ValueMap::Type::Bool))
+		{
+			return ColumnType::Bool;
+		}
+		if (typeMask == TypeBit(ValueMap::Type::String))
+		{
+			return ColumnType::String;
+		}
+		return ColumnType::Dynamic;
+	}
+
+	static bool IsConvertible(ValueMap::Type type, ColumnType columnType) noexcept
+	{
+		if (type == ValueMap::Type::Null || columnType == ColumnType::Dynamic)
+		{
+			return true;
+		}
+
+		switch (columnType)
+		{
+			case ColumnType::Bool:
+				return type == ValueMap::Type::Bool;
+			case ColumnType::Int64:
+				return type == ValueMap::Type::Int32 || type == ValueMap::Type::Int64;
+			case ColumnType::Double:
+				return type == ValueMap::Type::Int32 || type == ValueMap::Type::Int64 || type == ValueMap::Type::Double;
+			case ColumnType::String:
+				return type == ValueMap::Type::String;
+			default:
+				return false;
+		}
+	}
+
+	std::size_t m_rowCount;
+	std::vector<DynamicColumn> m_columns;
+};
+
+}}
+#endif
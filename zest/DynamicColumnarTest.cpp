@@ -0,0 +1,147 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+
+#include "DynamicColumnar.h"
+
+namespace Zest { namespace Lib {
+
+namespace {
+
+ValueMap::Array MakeRows()
+{
+	ValueMap::Array rows;
+	rows.push_back(Dynamic{ Property{ "id", 1 }, Property{ "price", 2 }, Property{ "city", "Paris" }, Property{ "ok", true } });
+	rows.push_back(Dynamic{ Property{ "id", ValueMap::Int64{ 2 } }, Property{ "price", 3.5 }, Property{ "city", "Rome" } });
+	rows.push_back(Dynamic{ Property{ "city", "Paris" }, Property{ "id", 3 }, Property{ "price", Dynamic() }, Property{ "tags", Dynamic{ "a" } } });
+	return rows;
+}
+
+}
+
+TEST(DynamicColumnarTest, InferSchema_UnionOfProperties_WidenedTypes)
+{
+	DynamicSchema schema{ DynamicColumnar::InferSchema(MakeRows()) };
+	ASSERT_EQ(schema.size(), 5u);
+	EXPECT_EQ(schema[0].key.GetName(), "id");
+	EXPECT_EQ(schema[0].type, ColumnType::Int64);
+	EXPECT_EQ(schema[1].type, ColumnType::Double);
+	EXPECT_EQ(schema[2].type, ColumnType::String);
+	EXPECT_EQ(schema[3].type, ColumnType::Bool);
+	EXPECT_EQ(schema[4].key.GetName(), "tags");
+	EXPECT_EQ(schema[4].type, ColumnType::Dynamic);
+}
+
+TEST(DynamicColumnarTest, FromArray_TypedColumns_RowsReadBack)
+{
+	ValueMap::Array rows = MakeRows();
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows) };
+	EXPECT_EQ(columnar.GetRowCount(), 3u);
+
+	const DynamicColumn* pId{ columnar.FindColumn(DynamicKey{ "id" }) };
+	ASSERT_NE(pId, nullptr);
+	EXPECT_EQ(pId->GetInt64s(), (std::vector<ValueMap::Int64>{ 1, 2, 3 }));
+
+	const DynamicColumn* pPrice{ columnar.FindColumn(DynamicKey{ "price" }) };
+	EXPECT_EQ(pPrice->GetValidCount(), 2u);
+	EXPECT_FALSE(pPrice->IsValid(2));
+	EXPECT_EQ(pPrice->GetDoubles()[1], 3.5);
+
+	const DynamicColumn* pCity{ columnar.FindColumn(DynamicKey{ "city" }) };
+	EXPECT_EQ(pCity->GetDictionary().size(), 2u);
+	EXPECT_EQ(pCity->GetStringCodes(), (std::vector<uint32_t>{ 0, 1, 0 }));
+
+	EXPECT_TRUE(columnar.GetRow(0) == rows[0]);
+	EXPECT_TRUE(columnar.GetRow(1) == rows[1]);
+	Dynamic third = columnar.GetRow(2);
+	EXPECT_EQ(third.GetObjectMap().Size(), 3u);
+	EXPECT_TRUE(third["tags"] == rows[2]["tags"]);
+	EXPECT_EQ(columnar.ToArray().size(), 3u);
+}
+
+TEST(DynamicColumnarTest, FromArray_ValueNotMatchSchema_Throw)
+{
+	ValueMap::Array rows = MakeRows();
+	DynamicSchema schema{ DynamicColumnar::InferSchema(rows) };
+	rows.push_back(Dynamic{ Property{ "id", "four" } });
+	EXPECT_THROW(DynamicColumnar::FromArray(rows, schema), Error::Exception);
+	rows.push_back(Dynamic(4));
+	EXPECT_THROW(DynamicColumnar::InferSchema(rows), Error::Exception);
+}
+
+TEST(DynamicColumnarTest, FromArray_NullColumnsAndManyRows)
+{
+	DynamicColumnar empty{ DynamicColumnar::FromArray(ValueMap::Array{}) };
+	EXPECT_EQ(empty.GetRowCount(), 0u);
+	EXPECT_EQ(empty.GetColumnCount(), 0u);
+	EXPECT_TRUE(empty.ToArray().empty());
+
+	// Validity crosses 64 row words, dictionary grows past its first table.
+	DynamicKeyCache keyCache;
+	DynamicKey idKey{ keyCache.Get("row id", 6) };
+	DynamicKey nameKey{ keyCache.Get("row name", 8) };
+	DynamicKey noneKey{ keyCache.Get("row none", 8) };
+	ValueMap::Array rows;
+	for (int i = 0; i < 200; ++i)
+	{
+		Dynamic row = Dynamic::MakeObject();
+		if (i % 3 != 0)
+		{
+			row.SetObject(idKey, Dynamic(i));
+		}
+		row.SetObject(nameKey, Dynamic("name" + std::to_string(i % 150)));
+		row.SetObject(noneKey, Dynamic());
+		rows.push_back(row);
+	}
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows) };
+	ASSERT_EQ(columnar.GetColumnCount(), 3u);
+
+	// Keys which are not interned find columns by name.
+	const DynamicColumn* pId{ columnar.FindColumn(DynamicKey{ "row id" }) };
+	ASSERT_NE(pId, nullptr);
+	EXPECT_EQ(pId->GetType(), ColumnType::Int64);
+	EXPECT_EQ(pId->GetValidCount(), 133u);
+	EXPECT_FALSE(pId->IsValid(63));
+	EXPECT_TRUE(pId->IsValid(64));
+	EXPECT_FALSE(pId->IsValid(192));
+	EXPECT_EQ(pId->GetValue(199).GetInt64(), 199);
+	EXPECT_EQ(pId->GetValue(0).GetType(), ValueMap::Type::Null);
+
+	const DynamicColumn* pName{ columnar.FindColumn(nameKey) };
+	EXPECT_EQ(pName->GetDictionary().size(), 150u);
+	EXPECT_EQ(pName->GetStringCodes()[151], 1u);
+
+	const DynamicColumn* pNone{ columnar.FindColumn(noneKey) };
+	EXPECT_EQ(pNone->GetType(), ColumnType::Null);
+	EXPECT_EQ(pNone->GetValidCount(), 0u);
+
+	ValueMap::Array readBack = columnar.ToArray();
+	ASSERT_EQ(readBack.size(), 200u);
+	EXPECT_EQ(readBack[0].GetObjectMap().Size(), 1u);
+	EXPECT_EQ(readBack[199]["row id"].GetInt64(), 199);
+	EXPECT_EQ(readBack[199]["row name"].GetString(), "name49");
+}
+
+TEST(DynamicColumnarTest, FromArray_GivenSchema_DropsAndWidens)
+{
+	ValueMap::Array rows;
+	rows.push_back(Dynamic{ Property{ "a", 1 }, Property{ "b", "x" }, Property{ "extra", 1 } });
+	rows.push_back(Dynamic{ Property{ "b", true }, Property{ "a", ValueMap::Int64{ INT64_MAX } } });
+
+	DynamicSchema schema{ DynamicColumnar::InferSchema(rows) };
+	EXPECT_EQ(schema[0].type, ColumnType::Int64);
+	EXPECT_EQ(schema[1].type, ColumnType::Dynamic);
+
+	// Missing column is all null, property not in schema is dropped, Int64 values fit a Double column.
+	DynamicSchema given{ ColumnSchema{ DynamicKey{ "a" }, ColumnType::Double }, ColumnSchema{ DynamicKey{ "missing" }, ColumnType::String } };
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows, given) };
+	EXPECT_EQ(columnar.GetColumn(0).GetDoubles()[1], static_cast<double>(INT64_MAX));
+	EXPECT_EQ(columnar.GetColumn(1).GetValidCount(), 0u);
+	EXPECT_TRUE(columnar.GetRow(0) == (Dynamic{ Property{ "a", 1.0 } }));
+
+	EXPECT_THROW(DynamicColumnar::FromArray(rows, DynamicSchema{ ColumnSchema{ DynamicKey{ "b" }, ColumnType::String } }), Error::Exception);
+	EXPECT_THROW(DynamicColumnar::FromArray(rows, DynamicSchema{ ColumnSchema{ DynamicKey{ "a" }, ColumnType::Bool } }), Error::Exception);
+	EXPECT_THROW(DynamicColumnar::FromArray(ValueMap::Array{ Dynamic("not an object") }), Error::Exception);
+}
+
+}}
@@ -0,0 +1,615 @@
+#pragma once
+#ifndef ZEST_LIB_DYNAMICPATCH_H
+#define ZEST_LIB_DYNAMICPATCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Dynamics.h"
+#include "Error.h"
+
+namespace Zest { namespace Lib {
+
+/*! Structural diff and patch of Dynamic documents.
+	Diff produces RFC 6902 JSON Patch, an array of {"op", "path", "value"/"from"} objects,
+	MergeDiff produces RFC 7396 JSON Merge Patch. Subtrees which share data node are skipped
+	without being visited, arrays are compared element by element after their common prefix and
+	suffix are skipped, so diffing a new version of a document against the version it was copied from only walks
+	the changed paths. Values in patch share data nodes with target, nothing is deep copied.
+*/
+class DynamicPatch
+{
+public:
+	static Dynamic Diff(const Dynamic& source, const Dynamic& target)
+	{
+		ValueMap::Array operations;
+		std::string path;
+		DiffValue(source, target, path, operations);
+		return Dynamic(std::move(operations));
+	}
+
+	/*! Merge patch which turns source into target.
+		Notice: merge patch can't set a property to null or patch inside arrays,
+		null properties of target are dropped and changed arrays are replaced whole.
+	*/
+	static Dynamic MergeDiff(const Dynamic& source, const Dynamic& target)
+	{
+		if (source.GetType() != ValueMap::Type::Object || target.GetType() != ValueMap::Type::Object)
+		{
+			return RemoveNulls(target);
+		}
+
+		Dynamic patch = Dynamic::MakeObject();
+		const ValueMap::ObjectMap& sourceMap{ source.GetObjectMap() };
+		const ValueMap::ObjectMap& targetMap{ target.GetObjectMap() };
+		for (const auto& entry : sourceMap)
+		{
+			if (targetMap.Find(entry.first) == nullptr)
+			{
+				patch.SetObject(entry.first, Dynamic());
+			}
+		}
+		for (const auto& entry : targetMap)
+		{
+			const Dynamic* pSourceValue{ sourceMap.Find(entry.first) };
+			if (pSourceValue == nullptr)
+			{
+				patch.SetObject(entry.first, RemoveNulls(entry.second));
+			}
+			else if (!Equals(*pSourceValue, entry.second))
+			{
+				patch.SetObject(entry.first, MergeDiff(*pSourceValue, entry.second));
+			}
+		}
+		return patch;
+	}
+
+	/*! Apply JSON Patch to document in place, operations are add, remove, replace, move, copy and test.
+		Patch is atomic: when an operation fails, document is left unchanged and exception is thrown,
+		MalFormatError for malformed operation or path, UnexpectOperationError when path doesn't
+		exist or test fails. Only the nodes along patched paths are copied.
+	*/
+	static void Apply(Dynamic& document, const Dynamic& patch)
+	{
+		if (patch.GetType() != ValueMap::Type::Array)
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		// Patched copy shares all nodes with document until they are written.
+		Dynamic result = document;
+		// Names of added properties are read from patch, they are not interned.
+		DynamicKeyCache keyCache;
+		for (const Dynamic& operation : patch.GetArray())
+		{
+			ApplyOperation(result, operation, keyCache);
+		}
+		document = std::move(result);
+	}
+
+	// Apply JSON Merge Patch to document in place.
+	static void ApplyMerge(Dynamic& document, const Dynamic& patch)
+	{
+		if (patch.GetType() != ValueMap::Type::Object)
+		{
+			document = patch;
+			return;
+		}
+
+		if (document.GetType() != ValueMap::Type::Object)
+		{
+			document = Dynamic::MakeObject();
+		}
+		for (const auto& entry : patch.GetObjectMap())
+		{
+			if (entry.second.GetType() == ValueMap::Type::Null)
+			{
+				document.RemoveObject(entry.first);
+			}
+			else if (entry.second.GetType() != ValueMap::Type::Object)
+			{
+				document.SetObject(entry.first, entry.second);
+			}
+			else
+			{
+				Dynamic* pValue{ document.GetObjectMap().Find(entry.first) };
+				if (pValue == nullptr)
+				{
+					pValue = &document.SetObject(entry.first, Dynamic::MakeObject());
+				}
+				ApplyMerge(*pValue, entry.second);
+			}
+		}
+	}
+
+private:
+	enum class OperationType : uint32_t
+	{
+		Add,
+		Remove,
+		Replace,
+		Move,
+		Copy,
+		Test
+	};
+
+	static const DynamicKey& OperationKey()
+	{
+		static const DynamicKey key{ "op" };
+		return key;
+	}
+
+	static const DynamicKey& PathKey()
+	{
+		static const DynamicKey key{ "path" };
+		return key;
+	}
+
+	static const DynamicKey& ValueKey()
+	{
+		static const DynamicKey key{ "value" };
+		return key;
+	}
+
+	static const DynamicKey& FromKey()
+	{
+		static const DynamicKey key{ "from" };
+		return key;
+	}
+
+	// Shared node first, then deep comparison, cached hashes may be stale so they are not used.
+	static bool Equals(const Dynamic& left, const Dynamic& right)
+	{
+		if (left.IsSameNode(right))
+		{
+			return true;
+		}
+		if (left.GetType() != right.GetType() && (IsContainer(left.GetType()) || IsContainer(right.GetType())))
+		{
+			return false;
+		}
+		return left == right;
+	}
+
+	static bool IsContainer(ValueMap::Type type) noexcept
+	{
+		return type == ValueMap::Type::Array || type == ValueMap::Type::Object;
+	}
+
+	static void DiffValue(const Dynamic& source, const Dynamic& target, std::string& path, ValueMap::Array& operations)
+	{
+		if (source.IsSameNode(target))
+		{
+			return;
+		}
+
+		if (source.GetType() == ValueMap::Type::Object && target.GetType() == ValueMap::Type::Object)
+		{
+			DiffObject(source, target, path, operations);
+		}
+		else if (source.GetType() == ValueMap::Type::Array && target.GetType() == ValueMap::Type::Array)
+		{
+			DiffArray(source, target, path, operations);
+		}
+		else if (!Equals(source, target))
+		{
+			operations.push_back(MakeOperation("replace", path, &target));
+		}
+	}
+
+	static void DiffObject(const Dynamic& source, const Dynamic& target, std::string& path, ValueMap::Array& operations)
+	{
+		const ValueMap::ObjectMap& sourceMap{ source.GetObjectMap() };
+		const ValueMap::ObjectMap& targetMap{ target.GetObjectMap() };
+		std::size_t length{ path.size() };
+		for (const auto& entry : sourceMap)
+		{
+			if (targetMap.Find(entry.first) == nullptr)
+			{
+				AppendToken(path, entry.first.GetName());
+				operations.push_back(MakeOperation("remove", path, nullptr));
+				path.resize(length);
+			}
+		}
+		for (const auto& entry : targetMap)
+		{
+			const Dynamic* pSourceValue{ sourceMap.Find(entry.first) };
+			AppendToken(path, entry.first.GetName());
+			if (pSourceValue == nullptr)
+			{
+				operations.push_back(MakeOperation("add", path, &entry.second));
+			}
+			else
+			{
+				DiffValue(*pSourceValue, entry.second, path, operations);
+			}
+			path.resize(length);
+		}
+	}
+
+	/*! Common prefix and suffix are skipped, elements left in the middle are diffed pairwise,
+		then the rest of source is removed or the rest of target is inserted.
+		So a single insertion or removal anywhere in array is one operation.
+	*/
+	static void DiffArray(const Dynamic& source, const Dynamic& target, std::string& path, ValueMap::Array& operations)
+	{
+		const ValueMap::Array& sourceArray{ source.GetArray() };
+		const ValueMap::Array& targetArray{ target.GetArray() };
+		std::size_t sourceEnd{ sourceArray.size() };
+		std::size_t targetEnd{ targetArray.size() };
+		std::size_t begin{ 0 };
+		while (begin < sourceEnd && begin < targetEnd && Equals(sourceArray[begin], targetArray[begin]))
+		{
+			++begin;
+		}
+		while (sourceEnd > begin && targetEnd > begin && Equals(sourceArray[sourceEnd - 1], targetArray[targetEnd - 1]))
+		{
+			--sourceEnd;
+			--targetEnd;
+		}
+
+		std::size_t length{ path.size() };
+		std::size_t pairEnd{ begin + std::min(sourceEnd - begin, targetEnd - begin) };
+		for (std::size_t i = begin; i < pairEnd; ++i)
+		{
+			AppendIndex(path, i);
+			DiffValue(sourceArray[i], targetArray[i], path, operations);
+			path.resize(length);
+		}
+		// Remove from back, so indexes of elements still to be removed don't shift.
+		for (std::size_t i = sourceEnd; i > pairEnd; --i)
+		{
+			AppendIndex(path, i - 1);
+			operations.push_back(MakeOperation("remove", path, nullptr));
+			path.resize(length);
+		}
+		for (std::size_t i = pairEnd; i < targetEnd; ++i)
+		{
+			AppendIndex(path, i);
+			operations.push_back(MakeOperation("add", path, &targetArray[i]));
+			path.resize(length);
+		}
+	}
+
+	static Dynamic MakeOperation(const char* operationName, const std::string& path, const Dynamic* pValue)
+	{
+		Dynamic operation = Dynamic::MakeObject();
+		operation.SetObject(OperationKey(), Dynamic(operationName));
+		operation.SetObject(PathKey(), Dynamic(path));
+		if (pValue != nullptr)
+		{
+			operation.SetObject(ValueKey(), *pValue);
+		}
+		return operation;
+	}
+
+	static Dynamic RemoveNulls(const Dynamic& value)
+	{
+		if (value.GetType() != ValueMap::Type::Object)
+		{
+			return value;
+		}
+
+		Dynamic result = Dynamic::MakeObject();
+		for (const auto& entry : value.GetObjectMap())
+		{
+			if (entry.second.GetType() != ValueMap::Type::Null)
+			{
+				result.SetObject(entry.first, RemoveNulls(entry.second));
+			}
+		}
+		return result;
+	}
+
+	// Append JSON Pointer token, '~' is escaped as "~0" and '/' as "~1".
+	static void AppendToken(std::string& path, const std::string& name)
+	{
+		path += '/';
+		for (char c : name)
+		{
+			if (c == '~')
+			{
+				path += "~0";
+			}
+			else if (c == '/')
+			{
+				path += "~1";
+			}
+			else
+			{
+				path += c;
+			}
+		}
+	}
+
+	static void AppendIndex(std::string& path, std::size_t index)
+	{
+		path += '/';
+		path += std::to_string(index);
+	}
+
+	static std::vector<std::string> ParsePointer(const Dynamic& pointer)
+	{
+		if (pointer.GetType() != ValueMap::Type::String)
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		ValueMap::StringView path{ pointer.GetString() };
+		std::vector<std::string> tokens;
+		if (path.empty())
+		{
+			return tokens;
+		}
+		if (path[0] != '/')
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		tokens.emplace_back();
+		for (std::size_t i = 1; i < path.size(); ++i)
+		{
+			if (path[i] == '/')
+			{
+				tokens.emplace_back();
+			}
+			else if (path[i] != '~')
+			{
+				tokens.back() += path[i];
+			}
+			else if (i + 1 < path.size() && (path[i + 1] == '0' || path[i + 1] == '1'))
+			{
+				tokens.back() += path[++i] == '0' ? '~' : '/';
+			}
+			else
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+		}
+		return tokens;
+	}
+
+	// Index of existing element, or of the end when isEndAllowed and token is "-" or size.
+	static std::size_t ParseIndex(const std::string& token, std::size_t size, bool isEndAllowed)
+	{
+		if (isEndAllowed && token == "-")
+		{
+			return size;
+		}
+		if (token.empty() || token.size() > 18 || (token.size() > 1 && token[0] == '0'))
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		std::size_t index{ 0 };
+		for (char c : token)
+		{
+			if (c < '0' || c > '9')
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+			index = index * 10 + static_cast<std::size_t>(c - '0');
+		}
+		if (index > size || (index == size && !isEndAllowed))
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+		return index;
+	}
+
+	// Value at the first count tokens, for write.
+	static Dynamic& Resolve(Dynamic& root, const std::vector<std::string>& tokens, std::size_t count)
+	{
+		Dynamic* pValue{ &root };
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			pValue = &ResolveChild(*pValue, tokens[i]);
+		}
+		return *pValue;
+	}
+
+	static Dynamic& ResolveChild(Dynamic& parent, const std::string& token)
+	{
+		switch (parent.GetType())
+		{
+			case ValueMap::Type::Object:
+			{
+				Dynamic* pChild{ parent.GetObjectMap().Find(token) };
+				if (pChild == nullptr)
+				{
+					Error::ThrowUnexpectOperationErrorException();
+				}
+				return *pChild;
+			}
+			case ValueMap::Type::Array:
+			{
+				ValueMap::Array& array{ parent.GetArray() };
+				return array[ParseIndex(token, array.size(), false)];
+			}
+			default:
+				Error::ThrowUnexpectOperationErrorException();
+				return parent;
+		}
+	}
+
+	// Value for read, it doesn't copy nodes on the way.
+	static const Dynamic& Get(const Dynamic& root, const std::vector<std::string>& tokens)
+	{
+		const Dynamic* pValue{ &root };
+		for (const std::string& token : tokens)
+		{
+			if (pValue->GetType() == ValueMap::Type::Object)
+			{
+				pValue = pValue->GetObjectMap().Find(token);
+				if (pValue == nullptr)
+				{
+					Error::ThrowUnexpectOperationErrorException();
+				}
+			}
+			else if (pValue->GetType() == ValueMap::Type::Array)
+			{
+				const ValueMap::Array& array{ pValue->GetArray() };
+				pValue = &array[ParseIndex(token, array.size(), false)];
+			}
+			else
+			{
+				Error::ThrowUnexpectOperationErrorException();
+			}
+		}
+		return *pValue;
+	}
+
+	static void Add(Dynamic& root, const std::vector<std::string>& tokens, Dynamic value, DynamicKeyCache& keyCache)
+	{
+		if (tokens.empty())
+		{
+			root = std::move(value);
+			return;
+		}
+
+		Dynamic& parent{ Resolve(root, tokens, tokens.size() - 1) };
+		const std::string& token{ tokens.back() };
+		if (parent.GetType() == ValueMap::Type::Object)
+		{
+			parent.SetObject(keyCache.Get(token.data(), token.size()), std::move(value));
+		}
+		else if (parent.GetType() == ValueMap::Type::Array)
+		{
+			ValueMap::Array& array{ parent.GetArray() };
+			std::size_t index{ ParseIndex(token, array.size(), true) };
+			array.insert(array.begin() + static_cast<std::ptrdiff_t>(index), std::move(value));
+		}
+		else
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+	}
+
+	static void Remove(Dynamic& root, const std::vector<std::string>& tokens)
+	{
+		if (tokens.empty())
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+
+		Dynamic& parent{ Resolve(root, tokens, tokens.size() - 1) };
+		const std::string& token{ tokens.back() };
+		if (parent.GetType() == ValueMap::Type::Object)
+		{
+			if (!parent.RemoveObject(token))
+			{
+				Error::ThrowUnexpectOperationErrorException();
+			}
+		}
+		else if (parent.GetType() == ValueMap::Type::Array)
+		{
+			ValueMap::Array& array{ parent.GetArray() };
+			std::size_t index{ ParseIndex(token, array.size(), false) };
+			array.erase(array.begin() + static_cast<std::ptrdiff_t>(index));
+		}
+		else
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+	}
+
+	static OperationType ParseOperationType(const Dynamic& name)
+	{
+		if (name.GetType() == ValueMap::Type::String)
+		{
+			ValueMap::StringView value{ name.GetString() };
+			if (value == "add")
+			{
+				return OperationType::Add;
+			}
+			if (value == "remove")
+			{
+				return OperationType::Remove;
+			}
+			if (value == "replace")
+			{
+				return OperationType::Replace;
+			}
+			if (value == "move")
+			{
+				return OperationType::Move;
+			}
+			if (value == "copy")
+			{
+				return OperationType::Copy;
+			}
+			if (value == "test")
+			{
+				return OperationType::Test;
+			}
+		}
+		Error::ThrowMalFormatErrorException();
+		return OperationType::Test;
+	}
+
+	static const Dynamic& GetMember(const ValueMap::ObjectMap& operationMap, const DynamicKey& key)
+	{
+		const Dynamic* pValue{ operationMap.Find(key) };
+		if (pValue == nullptr)
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+		return *pValue;
+	}
+
+	static void ApplyOperation(Dynamic& root, const Dynamic& operation, DynamicKeyCache& keyCache)
+	{
+		if (operation.GetType() != ValueMap::Type::Object)
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		const ValueMap::ObjectMap& operationMap{ operation.GetObjectMap() };
+		OperationType type{ ParseOperationType(GetMember(operationMap, OperationKey())) };
+		std::vector<std::string> tokens{ ParsePointer(GetMember(operationMap, PathKey())) };
+		switch (type)
+		{
+			case OperationType::Add:
+				Add(root, tokens, GetMember(operationMap, ValueKey()), keyCache);
+				break;
+			case OperationType::Remove:
+				Remove(root, tokens);
+				break;
+			case OperationType::Replace:
+				Resolve(root, tokens, tokens.size()) = GetMember(operationMap, ValueKey());
+				break;
+			case OperationType::Move:
+			{
+				std::vector<std::string> fromTokens{ ParsePointer(GetMember(operationMap, FromKey())) };
+				// Value can't be moved into its own child.
+				if (fromTokens.size() < tokens.size() && std::equal(fromTokens.begin(), fromTokens.end(), tokens.begin()))
+				{
+					Error::ThrowUnexpectOperationErrorException();
+				}
+				Dynamic value = Get(root, fromTokens);
+				Remove(root, fromTokens);
+				Add(root, tokens, std::move(value), keyCache);
+				break;
+			}
+			case OperationType::Copy:
+			{
+				std::vector<std::string> fromTokens{ ParsePointer(GetMember(operationMap, FromKey())) };
+				Dynamic value = Get(root, fromTokens);
+				Add(root, tokens, std::move(value), keyCache);
+				break;
+			}
+			case OperationType::Test:
+				if (Get(root, tokens) != GetMember(operationMap, ValueKey()))
+				{
+					Error::ThrowUnexpectOperationErrorException();
+				}
+				break;
+		}
+	}
+};
+
+}}
+
+#endif
@@ -0,0 +1,179 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+
+#include "DynamicPatch.h"
+
+namespace Zest { namespace Lib {
+
+TEST(DynamicPatchTest, Diff_ChangedCopy_PatchTurnsSourceIntoTarget)
+{
+	ValueMap::Array items;
+	for (int i = 0; i < 100; ++i)
+	{
+		items.push_back(Dynamic{ Property{ "id", i } });
+	}
+	Dynamic source{
+		Property{ "name", "zest" },
+		Property{ "a/b~c", 1 },
+		Property{ "removed", true },
+		Property{ "items", Dynamic(std::move(items)) },
+		Property{ "config", Dynamic{ Property{ "depth", 3 }, Property{ "tags", Dynamic{ "x", "y" } } } }
+	};
+
+	Dynamic target = source;
+	target["a/b~c"] = Dynamic(2);
+	target.RemoveObject("removed");
+	target.SetObject("added", Dynamic{ 1, 2 });
+	ValueMap::Array& targetItems{ target["items"].GetArray() };
+	targetItems.insert(targetItems.begin() + 50, Dynamic("inserted"));
+	targetItems[10]["id"] = Dynamic(-10);
+
+	Dynamic patch = DynamicPatch::Diff(source, target);
+	const ValueMap::Array& operations{ patch.GetArray() };
+	ASSERT_EQ(operations.size(), 5u);
+	EXPECT_EQ(operations[0]["op"].GetString(), "remove");
+	EXPECT_EQ(operations[0]["path"].GetString(), "/removed");
+	EXPECT_EQ(operations[1]["path"].GetString(), "/a~1b~0c");
+	EXPECT_EQ(operations[2]["path"].GetString(), "/items/10/id");
+	EXPECT_EQ(operations[3]["op"].GetString(), "add");
+	EXPECT_EQ(operations[3]["path"].GetString(), "/items/50");
+	EXPECT_EQ(operations[4]["path"].GetString(), "/added");
+
+	Dynamic patched = source;
+	DynamicPatch::Apply(patched, patch);
+	EXPECT_TRUE(patched == target);
+	// Untouched subtree still shares node with source.
+	EXPECT_TRUE(patched["config"].IsSameNode(source["config"]));
+	EXPECT_EQ(DynamicPatch::Diff(source, source).GetArray().size(), 0u);
+	EXPECT_EQ(DynamicPatch::Diff(Dynamic(1), Dynamic(1.0)).GetArray().size(), 0u);
+}
+
+TEST(DynamicPatchTest, Apply_Operations_AtomicOnFailure)
+{
+	Dynamic document{ Property{ "a", Dynamic{ 1, 2, 3 } }, Property{ "b", Dynamic{ Property{ "c", "d" } } } };
+	Dynamic patch{
+		Dynamic{ Property{ "op", "add" }, Property{ "path", "/a/-" }, Property{ "value", 4 } },
+		Dynamic{ Property{ "op", "add" }, Property{ "path", "/a/0" }, Property{ "value", 0 } },
+		Dynamic{ Property{ "op", "remove" }, Property{ "path", "/a/1" } },
+		Dynamic{ Property{ "op", "move" }, Property{ "from", "/b/c" }, Property{ "path", "/e" } },
+		Dynamic{ Property{ "op", "copy" }, Property{ "from", "/a" }, Property{ "path", "/b/a" } },
+		Dynamic{ Property{ "op", "replace" }, Property{ "path", "/a/0" }, Property{ "value", "zero" } },
+		Dynamic{ Property{ "op", "test" }, Property{ "path", "/e" }, Property{ "value", "d" } }
+	};
+	DynamicPatch::Apply(document, patch);
+	Dynamic expected{
+		Property{ "a", Dynamic{ "zero", 2, 3, 4 } },
+		Property{ "b", Dynamic{ Property{ "a", Dynamic{ 0, 2, 3, 4 } } } },
+		Property{ "e", "d" }
+	};
+	EXPECT_TRUE(document == expected);
+
+	// Second operation fails, so the first one is not applied either.
+	Dynamic failing{
+		Dynamic{ Property{ "op", "add" }, Property{ "path", "/x" }, Property{ "value", 1 } },
+		Dynamic{ Property{ "op", "test" }, Property{ "path", "/e" }, Property{ "value", "other" } }
+	};
+	EXPECT_THROW(DynamicPatch::Apply(document, failing), Error::Exception);
+	EXPECT_TRUE(document == expected);
+
+	EXPECT_THROW(DynamicPatch::Apply(document, Dynamic{ Dynamic{ Property{ "op", "add" }, Property{ "path", "/a/9" }, Property{ "value", 1 } } }), Error::Exception);
+	EXPECT_THROW(DynamicPatch::Apply(document, Dynamic{ Dynamic{ Property{ "op", "add" }, Property{ "path", "a" }, Property{ "value", 1 } } }), Error::Exception);
+	EXPECT_THROW(DynamicPatch::Apply(document, Dynamic{ Dynamic{ Property{ "op", "jump" }, Property{ "path", "/a" }, Property{ "value", 1 } } }), Error::Exception);
+	EXPECT_THROW(DynamicPatch::Apply(document, Dynamic{ Dynamic{ Property{ "op", "move" }, Property{ "from", "/b" }, Property{ "path", "/b/x" } } }), Error::Exception);
+	EXPECT_TRUE(document == expected);
+}
+
+TEST(DynamicPatchTest, MergePatch_DiffAndApply_Rfc7396)
+{
+	Dynamic document{
+		Property{ "title", "Goodbye!" },
+		Property{ "author", Dynamic{ Property{ "givenName", "John" }, Property{ "familyName", "Doe" } } },
+		Property{ "tags", Dynamic{ "example", "sample" } },
+		Property{ "content", "This will be unchanged" }
+	};
+	Dynamic patch{
+		Property{ "title", "Hello!" },
+		Property{ "phoneNumber", "+01-123-456-7890" },
+		Property{ "author", Dynamic{ Property{ "familyName", Dynamic() } } },
+		Property{ "tags", Dynamic{ "example" } }
+	};
+	Dynamic expected{
+		Property{ "title", "Hello!" },
+		Property{ "author", Dynamic{ Property{ "givenName", "John" } } },
+		Property{ "tags", Dynamic{ "example" } },
+		Property{ "content", "This will be unchanged" },
+		Property{ "phoneNumber", "+01-123-456-7890" }
+	};
+
+	Dynamic merged = document;
+	DynamicPatch::ApplyMerge(merged, patch);
+	EXPECT_TRUE(merged == expected);
+
+	Dynamic diff = DynamicPatch::MergeDiff(document, expected);
+	EXPECT_TRUE(diff == patch);
+	EXPECT_EQ(DynamicPatch::MergeDiff(document, document).GetObjectMap().Size(), 0u);
+
+	Dynamic replaced = document;
+	DynamicPatch::ApplyMerge(replaced, Dynamic{ 1, 2 });
+	EXPECT_TRUE(replaced == (Dynamic{ 1, 2 }));
+}
+
+TEST(DynamicPatchTest, Diff_ChildMutatedAfterHash_NotStale)
+{
+	Dynamic source{ Property{ "a", Dynamic{ Property{ "y", Dynamic{ Property{ "x", 1 } } } } } };
+	Dynamic target = source;
+	Dynamic& child = target["a"]["y"];
+	child["x"] = Dynamic(2);
+	source.Hash();
+	target.Hash();
+	// Parents of child keep the hash of x = 2.
+	child["x"] = Dynamic(1);
+	EXPECT_EQ(DynamicPatch::MergeDiff(source, target).GetObjectMap().Size(), 0u);
+	EXPECT_EQ(DynamicPatch::Diff(source, target).GetArray().size(), 0u);
+
+	child["x"] = Dynamic(3);
+	Dynamic patch = DynamicPatch::Diff(source, target);
+	Dynamic patched = source;
+	DynamicPatch::Apply(patched, patch);
+	EXPECT_EQ(patched["a"]["y"]["x"].GetInt32(), 3);
+}
+
+TEST(DynamicPatchTest, Apply_FailedTestOrMove_DocumentUnchanged)
+{
+	Dynamic document{ Property{ "a", Dynamic{ 1, 2 } }, Property{ "b", Dynamic{ Property{ "c", "d" } } } };
+	const Dynamic original = document;
+	const Dynamic failing[]{
+		// Test of missing path, of wrong type and of an array with other length.
+		Dynamic{ Dynamic{ Property{ "op", "remove" }, Property{ "path", "/b" } }, Dynamic{ Property{ "op", "test" }, Property{ "path", "/missing" }, Property{ "value", 1 } } },
+		Dynamic{ Dynamic{ Property{ "op", "add" }, Property{ "path", "/x" }, Property{ "value", 1 } }, Dynamic{ Property{ "op", "test" }, Property{ "path", "/a/0" }, Property{ "value", "1" } } },
+		Dynamic{ Dynamic{ Property{ "op", "replace" }, Property{ "path", "/a/0" }, Property{ "value", 5 } }, Dynamic{ Property{ "op", "test" }, Property{ "path", "/a" }, Property{ "value", Dynamic{ 5, 2, 3 } } } },
+		// Move from missing path, into own child and to index past the end.
+		Dynamic{ Dynamic{ Property{ "op", "add" }, Property{ "path", "/x" }, Property{ "value", 1 } }, Dynamic{ Property{ "op", "move" }, Property{ "from", "/missing" }, Property{ "path", "/y" } } },
+		Dynamic{ Dynamic{ Property{ "op", "add" }, Property{ "path", "/x" }, Property{ "value", 1 } }, Dynamic{ Property{ "op", "move" }, Property{ "from", "/b" }, Property{ "path", "/b/c/d" } } },
+		Dynamic{ Dynamic{ Property{ "op", "move" }, Property{ "from", "/b/c" }, Property{ "path", "/a/5" } } }
+	};
+	for (const Dynamic& patch : failing)
+	{
+		EXPECT_THROW(DynamicPatch::Apply(document, patch), Error::Exception);
+		EXPECT_TRUE(document == original);
+		EXPECT_TRUE(document.IsSameNode(original));
+	}
+}
+
+TEST(DynamicPatchTest, Apply_AddedNames_NotInterned)
+{
+	Dynamic document{ Property{ "a", 1 } };
+	Dynamic patch{
+		Dynamic{ Property{ "op", "add" }, Property{ "path", "/patchAddedName" }, Property{ "value", 2 } },
+		Dynamic{ Property{ "op", "copy" }, Property{ "from", "/a" }, Property{ "path", "/patchCopiedName" } }
+	};
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	DynamicPatch::Apply(document, patch);
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_EQ(document["patchAddedName"].GetInt32(), 2);
+	EXPECT_EQ(document["patchCopiedName"].GetInt32(), 1);
+	EXPECT_EQ(document.GetObjectMap().Size(), 3u);
+}
+
+}}
@@ -0,0 +1,810 @@
+#pragma once
+#ifndef ZEST_LIB_DYNAMICPATH_H
+#define ZEST_LIB_DYNAMICPATH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Dynamics.h"
+#include "Error.h"
+
+namespace Zest { namespace Lib {
+
+/*! Path into Dynamic which is compiled once and evaluated many times.
+	Property names are interned when compiled, so evaluation never hashes or copies strings,
+	and matches are returned as pointers into the document without touching reference counts.
+	Supported syntax:
+		JSON Pointer:  "/store/book/0/title", "~0" is '~' and "~1" is '/'.
+		JSONPath:      "$.store.book[0].title", "$['store']", "$.book[-1]",
+		               wildcard "$.book[*]" or "$.store.*",
+		               slice "$.book[1:10:2]",
+		               filter "$.book[?(@.price < 10)]", "$.book[?(@.isbn)]".
+		Filter compares with ==, !=, <, <=, >, >= against number, 'string', true, false or null.
+*/
+class DynamicPath
+{
+public:
+	// Path starting with '$' is JSONPath, otherwise JSON Pointer.
+	static DynamicPath Compile(const ValueMap::StringView path)
+	{
+		if (!path.empty() && path[0] == '$')
+		{
+			return CompileJsonPath(path);
+		}
+		return CompilePointer(path);
+	}
+
+	static DynamicPath CompilePointer(const ValueMap::StringView path)
+	{
+		DynamicPath dynamicPath;
+		if (path.empty())
+		{
+			return dynamicPath;
+		}
+		if (path[0] != '/')
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		std::size_t position{ 1 };
+		for (;;)
+		{
+			std::size_t next{ path.find('/', position) };
+			ValueMap::StringView token{ path.substr(position, next == ValueMap::StringView::npos ? ValueMap::StringView::npos : next - position) };
+
+			std::string name;
+			name.reserve(token.size());
+			for (std::size_t i = 0; i < token.size(); ++i)
+			{
+				if (token[i] != '~')
+				{
+					name += token[i];
+				}
+				else if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1'))
+				{
+					name += token[++i] == '0' ? '~' : '/';
+				}
+				else
+				{
+					Error::ThrowMalFormatErrorException();
+				}
+			}
+			dynamicPath.m_steps.push_back(Step::MakeMember(name));
+
+			if (next == ValueMap::StringView::npos)
+			{
+				break;
+			}
+			position = next + 1;
+		}
+		return dynamicPath;
+	}
+
+	static DynamicPath CompileJsonPath(const ValueMap::StringView path)
+	{
+		JsonPathParser parser{ path };
+		if (parser.Read() != '$')
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+
+		DynamicPath dynamicPath;
+		while (!parser.IsEnd())
+		{
+			dynamicPath.m_steps.push_back(parser.ParseStep(true));
+		}
+		return dynamicPath;
+	}
+
+	// True if path matches at most one value, i.e. there is no wildcard, slice or filter.
+	bool IsSingular() const noexcept
+	{
+		for (const Step& step : m_steps)
+		{
+			if (step.kind != StepKind::Member)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// First match in document order, nullptr if nothing matches.
+	const Dynamic* SelectFirst(const Dynamic& root) const
+	{
+		const Dynamic* pResult{ nullptr };
+		auto selectFirst = [&pResult](const Dynamic& value)
+		{
+			pResult = &value;
+			return false;
+		};
+		Visit(root, 0, selectFirst);
+		return pResult;
+	}
+
+	// Append all matches of document to results.
+	void Select(const Dynamic& root, std::vector<const Dynamic*>& results) const
+	{
+		auto select = [&results](const Dynamic& value)
+		{
+			results.push_back(&value);
+			return true;
+		};
+		Visit(root, 0, select);
+	}
+
+	// Copy of all matches.
+	std::vector<Dynamic> Evaluate(const Dynamic& root) const
+	{
+		std::vector<Dynamic> results;
+		auto evaluate = [&results](const Dynamic& value)
+		{
+			results.push_back(value);
+			return true;
+		};
+		Visit(root, 0, evaluate);
+		return results;
+	}
+
+	/*! First match of every document, results[i] is nullptr if documents[i] doesn't match.
+		Plan is shared by the whole batch, so per document cost is only the walk itself.
+	*/
+	void SelectBatch(const Dynamic* documents, std::size_t count, std::vector<const Dynamic*>& results) const
+	{
+		results.resize(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			results[i] = SelectFirst(documents[i]);
+		}
+	}
+
+	void SelectBatch(const ValueMap::Array& documents, std::vector<const Dynamic*>& results) const
+	{
+		SelectBatch(documents.data(), documents.size(), results);
+	}
+
+	// Visit matches in document order until func returns false.
+	template<typename TFunc>
+	void ForEach(const Dynamic& root, TFunc&& func) const
+	{
+		Visit(root, 0, func);
+	}
+
+private:
+	enum class StepKind : uint32_t
+	{
+		Member,
+		Wildcard,
+		Slice,
+		Filter
+	};
+
+	enum class FilterOperator : uint32_t
+	{
+		Exists,
+		Equal,
+		NotEqual,
+		Less,
+		LessEqual,
+		Larger,
+		LargerEqual
+	};
+
+	struct Filter;
+
+	struct Step
+	{
+		static constexpr int64_t c_noIndex{ INT64_MIN };
+
+		// Name which is also a decimal index can address both object and array.
+		static Step MakeMember(const std::string& name)
+		{
+			Step step;
+			step.kind = StepKind::Member;
+			step.key = DynamicKey{ name };
+			step.index = ParseIndex(name);
+			return step;
+		}
+
+		static Step MakeIndex(int64_t index)
+		{
+			Step step;
+			step.kind = StepKind::Member;
+			step.index = index;
+			return step;
+		}
+
+		static int64_t ParseIndex(const std::string& name) noexcept
+		{
+			if (name.empty() || name.size() > 18 || (name.size() > 1 && name[0] == '0'))
+			{
+				return c_noIndex;
+			}
+			int64_t index{ 0 };
+			for (char c : name)
+			{
+				if (c < '0' || c > '9')
+				{
+					return c_noIndex;
+				}
+				index = index * 10 + (c - '0');
+			}
+			return index;
+		}
+
+		StepKind kind{ StepKind::Member };
+		DynamicKey key;
+		int64_t index{ c_noIndex };
+		// Slice
+		int64_t start{ 0 };
+		int64_t end{ 0 };
+		int64_t stride{ 1 };
+		bool hasStart{ false };
+		bool hasEnd{ false };
+		std::shared_ptr<const Filter> spFilter;
+	};
+
+	struct Filter
+	{
+		std::vector<Step> steps;
+		FilterOperator op{ FilterOperator::Exists };
+		Dynamic literal;
+
+		bool Match(const Dynamic& candidate) const
+		{
+			const Dynamic* pValue{ &candidate };
+			for (const Step& step : steps)
+			{
+				pValue = SelectMember(*pValue, step);
+				if (pValue == nullptr)
+				{
+					return op == FilterOperator::NotEqual;
+				}
+			}
+
+			if (op == FilterOperator::Exists)
+			{
+				return true;
+			}
+
+			int order{ 0 };
+			if (!CompareLiteral(*pValue, order))
+			{
+				return op == FilterOperator::NotEqual;
+			}
+
+			switch (op)
+			{
+				case FilterOperator::Equal:
+					return order == 0;
+				case FilterOperator::NotEqual:
+					return order != 0;
+				case FilterOperator::Less:
+					return order < 0;
+				case FilterOperator::LessEqual:
+					return order <= 0;
+				case FilterOperator::Larger:
+					return order > 0;
+				case FilterOperator::LargerEqual:
+					return order >= 0;
+				default:
+					return false;
+			}
+		}
+
+		// False if value and literal are not comparable.
+		bool CompareLiteral(const Dynamic& value, int& order) const
+		{
+			ValueMap::Type type{ value.GetType() };
+			ValueMap::Type literalType{ literal.GetType() };
+			if (IsNumber(type) && IsNumber(literalType))
+			{
+				if (type != ValueMap::Type::Double && literalType != ValueMap::Type::Double)
+				{
+					ValueMap::Int64 left{ value.GetInt64() };
+					ValueMap::Int64 right{ literal.GetInt64() };
+					order = left < right ? -1 : (left > right ? 1 : 0);
+				}
+				else
+				{
+					ValueMap::Double left{ value.GetDouble() };
+					ValueMap::Double right{ literal.GetDouble() };
+					if (left != left || right != right)
+					{
+						return false;
+					}
+					order = left < right ? -1 : (left > right ? 1 : 0);
+				}
+				return true;
+			}
+
+			if (type != literalType)
+			{
+				return false;
+			}
+
+			switch (type)
+			{
+				case ValueMap::Type::String:
+				{
+					int result{ value.GetString().compare(literal.GetString()) };
+					order = result < 0 ? -1 : (result > 0 ? 1 : 0);
+					return true;
+				}
+				case ValueMap::Type::Bool:
+					order = static_cast<int>(value.GetBool()) - static_cast<int>(literal.GetBool());
+					return true;
+				case ValueMap::Type::Null:
+					order = 0;
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		static bool IsNumber(ValueMap::Type type) noexcept
+		{
+			return type == ValueMap::Type::Int32 || type == ValueMap::Type::Int64 || type == ValueMap::Type::Double;
+		}
+	};
+
+	class JsonPathParser
+	{
+	public:
+		explicit JsonPathParser(const ValueMap::StringView path) noexcept
+			: m_path{ path }, m_position{ 0 }
+		{
+		}
+
+		bool IsEnd() const noexcept
+		{
+			return m_position >= m_path.size();
+		}
+
+		char Peek() const noexcept
+		{
+			return IsEnd() ? '\0' : m_path[m_position];
+		}
+
+		char Read() noexcept
+		{
+			return IsEnd() ? '\0' : m_path[m_position++];
+		}
+
+		void Expect(char c)
+		{
+			SkipWhite();
+			if (Read() != c)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+		}
+
+		void SkipWhite() noexcept
+		{
+			while (Peek() == ' ' || Peek() == '\t')
+			{
+				++m_position;
+			}
+		}
+
+		// Parse ".name", ".*" or "[...]"; filters and slices only in top level path.
+		Step ParseStep(bool isTopLevel)
+		{
+			char c{ Read() };
+			if (c == '.')
+			{
+				if (Peek() == '.')
+				{
+					// Recursive descent is not supported.
+					Error::ThrowMalFormatErrorException();
+				}
+				if (Peek() == '*')
+				{
+					++m_position;
+					Step step;
+					step.kind = StepKind::Wildcard;
+					return step;
+				}
+				return Step::MakeMember(ParseIdentifier());
+			}
+
+			if (c != '[')
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+
+			SkipWhite();
+			Step step;
+			c = Peek();
+			if (c == '\'' || c == '"')
+			{
+				step = Step::MakeMember(ParseQuoted());
+			}
+			else if (c == '*' && isTopLevel)
+			{
+				++m_position;
+				step.kind = StepKind::Wildcard;
+			}
+			else if (c == '?' && isTopLevel)
+			{
+				++m_position;
+				step.kind = StepKind::Filter;
+				step.spFilter = ParseFilter();
+			}
+			else
+			{
+				step = ParseIndexOrSlice(isTopLevel);
+			}
+			Expect(']');
+			return step;
+		}
+
+	private:
+		std::string ParseIdentifier()
+		{
+			std::size_t begin{ m_position };
+			while (!IsEnd() && Peek() != '.' && Peek() != '[' && Peek() != ' ' && Peek() != ')'
+				&& Peek() != '=' && Peek() != '!' && Peek() != '<' && Peek() != '>')
+			{
+				++m_position;
+			}
+			if (begin == m_position)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+			return std::string{ m_path.substr(begin, m_position - begin) };
+		}
+
+		std::string ParseQuoted()
+		{
+			char quote{ Read() };
+			std::string text;
+			for (;;)
+			{
+				if (IsEnd())
+				{
+					Error::ThrowMalFormatErrorException();
+				}
+				char c{ Read() };
+				if (c == quote)
+				{
+					return text;
+				}
+				if (c == '\\')
+				{
+					if (IsEnd())
+					{
+						Error::ThrowMalFormatErrorException();
+					}
+					c = Read();
+				}
+				text += c;
+			}
+		}
+
+		bool ParseInteger(int64_t& value)
+		{
+			SkipWhite();
+			bool isNegative{ false };
+			if (Peek() == '-')
+			{
+				isNegative = true;
+				++m_position;
+			}
+			if (Peek() < '0' || Peek() > '9')
+			{
+				if (isNegative)
+				{
+					Error::ThrowMalFormatErrorException();
+				}
+				return false;
+			}
+			value = 0;
+			while (Peek() >= '0' && Peek() <= '9')
+			{
+				if (value > (INT64_MAX - 9) / 10)
+				{
+					Error::ThrowMalFormatErrorException();
+				}
+				value = value * 10 + (Read() - '0');
+			}
+			value = isNegative ? -value : value;
+			SkipWhite();
+			return true;
+		}
+
+		Step ParseIndexOrSlice(bool isTopLevel)
+		{
+			Step step;
+			int64_t value{ 0 };
+			bool hasStart{ ParseInteger(value) };
+			if (Peek() != ':')
+			{
+				if (!hasStart)
+				{
+					Error::ThrowMalFormatErrorException();
+				}
+				return Step::MakeIndex(value);
+			}
+			if (!isTopLevel)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+
+			step.kind = StepKind::Slice;
+			step.hasStart = hasStart;
+			step.start = value;
+			++m_position;
+			step.hasEnd = ParseInteger(step.end);
+			if (Peek() == ':')
+			{
+				++m_position;
+				if (ParseInteger(value))
+				{
+					if (value == 0)
+					{
+						Error::ThrowMalFormatErrorException();
+					}
+					step.stride = value;
+				}
+			}
+			return step;
+		}
+
+		std::shared_ptr<const Filter> ParseFilter()
+		{
+			std::shared_ptr<Filter> spFilter{ std::make_shared<Filter>() };
+			Expect('(');
+			Expect('@');
+			while (Peek() == '.' || Peek() == '[')
+			{
+				spFilter->steps.push_back(ParseStep(false));
+			}
+
+			SkipWhite();
+			spFilter->op = ParseOperator();
+			if (spFilter->op != FilterOperator::Exists)
+			{
+				SkipWhite();
+				spFilter->literal = ParseLiteral();
+			}
+			Expect(')');
+			return spFilter;
+		}
+
+		FilterOperator ParseOperator()
+		{
+			char c{ Peek() };
+			if (c == ')')
+			{
+				return FilterOperator::Exists;
+			}
+
+			++m_position;
+			bool hasEqual{ Peek() == '=' };
+			if (hasEqual)
+			{
+				++m_position;
+			}
+			switch (c)
+			{
+				case '=':
+					if (!hasEqual)
+					{
+						Error::ThrowMalFormatErrorException();
+					}
+					return FilterOperator::Equal;
+				case '!':
+					if (!hasEqual)
+					{
+						Error::ThrowMalFormatErrorException();
+					}
+					return FilterOperator::NotEqual;
+				case '<':
+					return hasEqual ? FilterOperator::LessEqual : FilterOperator::Less;
+				case '>':
+					return hasEqual ? FilterOperator::LargerEqual : FilterOperator::Larger;
+				default:
+					Error::ThrowMalFormatErrorException();
+			}
+		}
+
+		Dynamic ParseLiteral()
+		{
+			char c{ Peek() };
+			if (c == '\'' || c == '"')
+			{
+				return Dynamic(ParseQuoted());
+			}
+
+			std::size_t begin{ m_position };
+			while (!IsEnd() && Peek() != ')' && Peek() != ' ')
+			{
+				++m_position;
+			}
+			ValueMap::StringView token{ m_path.substr(begin, m_position - begin) };
+			if (token == "true")
+			{
+				return Dynamic(true);
+			}
+			if (token == "false")
+			{
+				return Dynamic(false);
+			}
+			if (token == "null")
+			{
+				return Dynamic();
+			}
+			return ParseNumber(token);
+		}
+
+		static Dynamic ParseNumber(const ValueMap::StringView token)
+		{
+			std::size_t i{ 0 };
+			bool isNegative{ i < token.size() && token[i] == '-' };
+			if (isNegative)
+			{
+				++i;
+			}
+			if (i == token.size())
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+
+			ValueMap::Int64 integer{ 0 };
+			bool isInteger{ true };
+			for (std::size_t j = i; j < token.size(); ++j)
+			{
+				if (token[j] < '0' || token[j] > '9' || j - i >= 18)
+				{
+					isInteger = false;
+					break;
+				}
+				integer = integer * 10 + (token[j] - '0');
+			}
+			if (isInteger)
+			{
+				return Dynamic(isNegative ? -integer : integer);
+			}
+
+			std::string text{ token };
+			std::size_t parsedSize{ 0 };
+			ValueMap::Double value{ 0 };
+			try
+			{
+				value = std::stod(text, &parsedSize);
+			}
+			catch (const std::exception&)
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+			if (parsedSize != text.size())
+			{
+				Error::ThrowMalFormatErrorException();
+			}
+			return Dynamic(value);
+		}
+
+		ValueMap::StringView m_path;
+		std::size_t m_position;
+	};
+
+	static const Dynamic* SelectMember(const Dynamic& node, const Step& step)
+	{
+		ValueMap::Type type{ node.GetType() };
+		if (type == ValueMap::Type::Object && !step.key.IsEmpty())
+		{
+			return node.GetObjectMap().Find(step.key);
+		}
+
+		if (type == ValueMap::Type::Array && step.index != Step::c_noIndex)
+		{
+			const ValueMap::Array& array{ node.GetArray() };
+			int64_t size{ static_cast<int64_t>(array.size()) };
+			int64_t index{ step.index < 0 ? step.index + size : step.index };
+			if (index >= 0 && index < size)
+			{
+				return &array[static_cast<std::size_t>(index)];
+			}
+		}
+		return nullptr;
+	}
+
+	// Return false to stop visiting.
+	template<typename TFunc>
+	bool Visit(const Dynamic& node, std::size_t stepIndex, TFunc& func) const
+	{
+		if (stepIndex == m_steps.size())
+		{
+			return func(node);
+		}
+
+		const Step& step{ m_steps[stepIndex] };
+		switch (step.kind)
+		{
+			case StepKind::Member:
+			{
+				const Dynamic* pChild{ SelectMember(node, step) };
+				return pChild == nullptr || Visit(*pChild, stepIndex + 1, func);
+			}
+			case StepKind::Wildcard:
+			case StepKind::Filter:
+			{
+				if (node.GetType() == ValueMap::Type::Array)
+				{
+					for (const Dynamic& child : node.GetArray())
+					{
+						if ((step.kind == StepKind::Wildcard || step.spFilter->Match(child)) && !Visit(child, stepIndex + 1, func))
+						{
+							return false;
+						}
+					}
+				}
+				else if (node.GetType() == ValueMap::Type::Object)
+				{
+					for (const auto& entry : node.GetObjectMap())
+					{
+						if ((step.kind == StepKind::Wildcard || step.spFilter->Match(entry.second)) && !Visit(entry.second, stepIndex + 1, func))
+						{
+							return false;
+						}
+					}
+				}
+				return true;
+			}
+			case StepKind::Slice:
+			{
+				if (node.GetType() != ValueMap::Type::Array)
+				{
+					return true;
+				}
+				const ValueMap::Array& array{ node.GetArray() };
+				int64_t size{ static_cast<int64_t>(array.size()) };
+				auto normalize = [size](int64_t index, int64_t low, int64_t high)
+				{
+					index = index < 0 ? index + size : index;
+					return index < low ? low : (index > high ? high : index);
+				};
+				// Stride longer than array steps out of it at once, clamped so index can't overflow.
+				int64_t limit{ size > 0 ? size : 1 };
+				int64_t stride{ step.stride > limit ? limit : (step.stride < -limit ? -limit : step.stride) };
+
+				if (stride > 0)
+				{
+					int64_t start{ step.hasStart ? normalize(step.start, 0, size) : 0 };
+					int64_t end{ step.hasEnd ? normalize(step.end, 0, size) : size };
+					for (int64_t i = start; i < end; i += stride)
+					{
+						if (!Visit(array[static_cast<std::size_t>(i)], stepIndex + 1, func))
+						{
+							return false;
+						}
+					}
+				}
+				else
+				{
+					int64_t start{ step.hasStart ? normalize(step.start, -1, size - 1) : size - 1 };
+					int64_t end{ step.hasEnd ? normalize(step.end, -1, size - 1) : -1 };
+					for (int64_t i = start; i > end; i += stride)
+					{
+						if (!Visit(array[static_cast<std::size_t>(i)], stepIndex + 1, func))
+						{
+							return false;
+						}
+					}
+				}
+				return true;
+			}
+			default:
+				return true;
+		}
+	}
+
+	std::vector<Step> m_steps;
+};
+
+}}
+#endif
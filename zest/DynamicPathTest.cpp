@@ -0,0 +1,119 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+
+#include "DynamicPath.h"
+
+namespace Zest { namespace Lib {
+
+namespace {
+
+Dynamic MakeStore()
+{
+	Dynamic books{
+		Dynamic{ Property{ "title", "A" }, Property{ "price", 8 } },
+		Dynamic{ Property{ "title", "B" }, Property{ "price", 12.5 }, Property{ "isbn", "0-1" } },
+		Dynamic{ Property{ "title", "C" }, Property{ "price", 9 } },
+		Dynamic{ Property{ "title", "D" }, Property{ "price", 22 }, Property{ "isbn", "0-2" } }
+	};
+	return Dynamic{ Property{ "store", Dynamic{ Property{ "book", books }, Property{ "a/b", "slash" } } } };
+}
+
+std::vector<std::string> Titles(const DynamicPath& path, const Dynamic& root)
+{
+	std::vector<const Dynamic*> results;
+	path.Select(root, results);
+	std::vector<std::string> titles;
+	for (const Dynamic* pResult : results)
+	{
+		titles.emplace_back(pResult->GetString());
+	}
+	return titles;
+}
+
+}
+
+TEST(DynamicPathTest, JsonPointer_SelectFirst)
+{
+	Dynamic store = MakeStore();
+	const Dynamic* pTitle{ DynamicPath::Compile("/store/book/1/title").SelectFirst(store) };
+	ASSERT_NE(pTitle, nullptr);
+	EXPECT_EQ(pTitle->GetString(), "B");
+
+	const Dynamic* pSlash{ DynamicPath::Compile("/store/a~1b").SelectFirst(store) };
+	ASSERT_NE(pSlash, nullptr);
+	EXPECT_EQ(pSlash->GetString(), "slash");
+
+	EXPECT_EQ(DynamicPath::Compile("/store/book/9").SelectFirst(store), nullptr);
+	EXPECT_EQ(DynamicPath::Compile("").SelectFirst(store), &store);
+	EXPECT_TRUE(DynamicPath::Compile("/store/book/0").IsSingular());
+}
+
+TEST(DynamicPathTest, JsonPath_WildcardSliceFilter)
+{
+	Dynamic store = MakeStore();
+	using Titles_t = std::vector<std::string>;
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store.book[*].title"), store), (Titles_t{ "A", "B", "C", "D" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$['store'].book[-1].title"), store), (Titles_t{ "D" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store.book[1:3].title"), store), (Titles_t{ "B", "C" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store.book[::-2].title"), store), (Titles_t{ "D", "B" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store.book[?(@.price < 10)].title"), store), (Titles_t{ "A", "C" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store.book[?(@.isbn)].title"), store), (Titles_t{ "B", "D" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store.book[?(@.title == 'C')].title"), store), (Titles_t{ "C" }));
+	EXPECT_FALSE(DynamicPath::Compile("$.store.book[*]").IsSingular());
+
+	EXPECT_THROW(DynamicPath::Compile("$..book"), Error::Exception);
+	EXPECT_THROW(DynamicPath::Compile("$.store.book[?(@.price <> 1)]"), Error::Exception);
+}
+
+TEST(DynamicPathTest, Slice_StrideAndBoundsOutOfRange)
+{
+	Dynamic store = MakeStore();
+	using Titles_t = std::vector<std::string>;
+	auto titles = [&store](const char* slice)
+	{
+		return Titles(DynamicPath::Compile(std::string("$.store.book") + slice + ".title"), store);
+	};
+	EXPECT_EQ(titles("[3::9223372036854775799]"), (Titles_t{ "D" }));
+	EXPECT_EQ(titles("[::-9223372036854775799]"), (Titles_t{ "D" }));
+	EXPECT_EQ(titles("[1::4]"), (Titles_t{ "B" }));
+	EXPECT_EQ(titles("[-9223372036854775799:2]"), (Titles_t{ "A", "B" }));
+	EXPECT_EQ(titles("[2:9223372036854775799]"), (Titles_t{ "C", "D" }));
+	EXPECT_EQ(titles("[10:20]"), Titles_t{});
+	EXPECT_EQ(titles("[-10:-3]"), (Titles_t{ "A" }));
+	EXPECT_EQ(titles("[1:1]"), Titles_t{});
+	EXPECT_EQ(titles("[3:1]"), Titles_t{});
+	EXPECT_EQ(titles("[5:0:-1]"), (Titles_t{ "D", "C", "B" }));
+	EXPECT_EQ(titles("[0:3:-1]"), Titles_t{});
+	EXPECT_EQ(titles("[-1:-10:-3]"), (Titles_t{ "D", "A" }));
+	EXPECT_EQ(Titles(DynamicPath::Compile("$.store[0:1]"), store), Titles_t{});
+	EXPECT_EQ(Titles(DynamicPath::Compile("$[::-1]"), Dynamic(ValueMap::Array{})), Titles_t{});
+
+	EXPECT_EQ(DynamicPath::Compile("$.store.book[-5]").SelectFirst(store), nullptr);
+	EXPECT_EQ(DynamicPath::Compile("$.store.book[4]").SelectFirst(store), nullptr);
+	EXPECT_EQ(DynamicPath::Compile("$.store.book[-9223372036854775799]").SelectFirst(store), nullptr);
+	EXPECT_EQ(DynamicPath::Compile("/store/book/-1").SelectFirst(store), nullptr);
+	EXPECT_EQ(DynamicPath::Compile("/store/book/01").SelectFirst(store), nullptr);
+
+	EXPECT_THROW(DynamicPath::Compile("$.store.book[::0]"), Error::Exception);
+	EXPECT_THROW(DynamicPath::Compile("$.store.book[99999999999999999999]"), Error::Exception);
+	EXPECT_THROW(DynamicPath::Compile("$.store.book[-]"), Error::Exception);
+	EXPECT_THROW(DynamicPath::Compile("$.store.book[1:2"), Error::Exception);
+}
+
+TEST(DynamicPathTest, SelectBatch_OneResultPerDocument)
+{
+	ValueMap::Array documents;
+	documents.push_back(Dynamic{ Property{ "id", 1 } });
+	documents.push_back(Dynamic{ Property{ "name", "no id" } });
+	documents.push_back(Dynamic{ Property{ "id", 3 } });
+
+	std::vector<const Dynamic*> results;
+	DynamicPath::Compile("$.id").SelectBatch(documents, results);
+	ASSERT_EQ(results.size(), 3u);
+	EXPECT_EQ(results[0]->GetInt32(), 1);
+	EXPECT_EQ(results[1], nullptr);
+	EXPECT_EQ(results[2]->GetInt32(), 3);
+}
+
+}}
@@ -0,0 +1,765 @@
+#pragma once
+#ifndef ZEST_LIB_DYNAMICQUERY_H
+#define ZEST_LIB_DYNAMICQUERY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <vector>
+
+#include "DynamicColumnar.h"
+#include "DynamicSort.h"
+#include "Dynamics.h"
+#include "Error.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+
+namespace Zest { namespace Lib {
+
+enum class QueryOperator : uint32_t
+{
+	Equal,
+	NotEqual,
+	Less,
+	LessEqual,
+	Larger,
+	LargerEqual,
+	IsNull,
+	IsNotNull
+};
+
+enum class AggregateFunction : uint32_t
+{
+	// Rows of group if column is empty, otherwise valid values of column.
+	Count,
+	Sum,
+	Min,
+	Max,
+	Avg
+};
+
+/*! Filter, projection, group by and aggregation over DynamicColumnar.
+	Rows are processed in batches: each filter narrows a selection vector of row indices with
+	a tight loop over one typed column, then selected rows are projected or folded into groups.
+	Filters compare in the order of Dynamic::Compare, null and missing values match only IsNull.
+	Sum, Min, Max and Avg need Int64 or Double column, Sum, Min and Max of Int64 stay Int64.
+	Sum of Int64 which overflows continues, and is returned, as Double.
+		DynamicColumnar sales{ DynamicColumnar::FromArray(rows) };
+		ValueMap::Array result = DynamicQuery{ sales }
+			.Where(DynamicKey{ "price" }, QueryOperator::Larger, Dynamic(10))
+			.GroupBy({ DynamicKey{ "city" } })
+			.Aggregate(AggregateFunction::Sum, DynamicKey{ "price" }, DynamicKey{ "total" })
+			.OrderBy(DynamicKey{ "total" }, true)
+			.Limit(3)
+			.Execute();
+	Query keeps reference to columnar, which must outlive it.
+*/
+class DynamicQuery
+{
+public:
+	explicit DynamicQuery(const DynamicColumnar& columnar)
+		: m_columnar{ columnar }, m_limit{ std::numeric_limits<std::size_t>::max() }, m_isDescending{ false }
+	{
+	}
+
+	DynamicQuery& Where(const DynamicKey& column, QueryOperator op, const Dynamic& literal = Dynamic{})
+	{
+		m_filters.push_back(Filter{ &GetColumn(column), op, literal });
+		return *this;
+	}
+
+	// Columns of result rows when there is no aggregation, all columns if not set.
+	DynamicQuery& Select(const std::vector<DynamicKey>& columns)
+	{
+		m_projections.clear();
+		for (const DynamicKey& column : columns)
+		{
+			m_projections.push_back(&GetColumn(column));
+		}
+		return *this;
+	}
+
+	DynamicQuery& GroupBy(const std::vector<DynamicKey>& columns)
+	{
+		if (columns.size() > 64)
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+
+		m_groups.clear();
+		for (const DynamicKey& column : columns)
+		{
+			m_groups.push_back(&GetColumn(column));
+		}
+		return *this;
+	}
+
+	// Result is stored in property alias of result rows.
+	DynamicQuery& Aggregate(AggregateFunction function, const DynamicKey& column, const DynamicKey& alias)
+	{
+		const DynamicColumn* pColumn{ nullptr };
+		if (!column.IsEmpty())
+		{
+			pColumn = &GetColumn(column);
+		}
+		if (function != AggregateFunction::Count
+			&& (pColumn == nullptr || (pColumn->GetType() != ColumnType::Int64 && pColumn->GetType() != ColumnType::Double)))
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+
+		m_aggregates.push_back(Aggregation{ function, pColumn, alias });
+		return *this;
+	}
+
+	// Sort result rows by a property, usually an aggregate alias.
+	DynamicQuery& OrderBy(const DynamicKey& property, bool isDescending = false)
+	{
+		m_orderBy = property;
+		m_isDescending = isDescending;
+		return *this;
+	}
+
+	DynamicQuery& Limit(std::size_t count) noexcept
+	{
+		m_limit = count;
+		return *this;
+	}
+
+	ValueMap::Array Execute() const
+	{
+		Partition partition{ CreatePartition() };
+		Run(partition, 0, m_columnar.GetRowCount());
+		return MakeResult(partition);
+	}
+
+	// Rows are split into partitions which run on pool, results are same as Execute.
+	ValueMap::Array Execute(ThreadPool& pool, std::size_t partitionCount) const
+	{
+		const std::size_t rowCount{ m_columnar.GetRowCount() };
+		partitionCount = std::max<std::size_t>(1, std::min(partitionCount, (rowCount + c_batchSize - 1) / c_batchSize));
+
+		std::vector<Partition> partitions(partitionCount, CreatePartition());
+		std::vector<std::future<void>> futures;
+		futures.reserve(partitionCount);
+		const std::size_t rowsPerPartition{ (rowCount + partitionCount - 1) / partitionCount };
+		for (std::size_t i = 0; i < partitionCount; ++i)
+		{
+			std::size_t begin{ std::min(rowCount, i * rowsPerPartition) };
+			std::size_t end{ std::min(rowCount, begin + rowsPerPartition) };
+			Partition* pPartition{ &partitions[i] };
+			futures.push_back(pool.Post([this, pPartition, begin, end]()
+			{
+				Run(*pPartition, begin, end);
+			}));
+		}
+		for (std::future<void>& future : futures)
+		{
+			future.get();
+		}
+
+		for (std::size_t i = 1; i < partitionCount; ++i)
+		{
+			Merge(partitions[0], partitions[i]);
+		}
+		return MakeResult(partitions[0]);
+	}
+
+private:
+	static constexpr std::size_t c_batchSize{ 1024 };
+	static constexpr uint32_t c_emptySlot{ 0xFFFFFFFF };
+
+	struct Filter
+	{
+		const DynamicColumn* pColumn;
+		QueryOperator op;
+		Dynamic literal;
+	};
+
+	struct Aggregation
+	{
+		AggregateFunction function;
+		// Nullptr for count of rows.
+		const DynamicColumn* pColumn;
+		DynamicKey alias;
+	};
+
+	struct AggregateState
+	{
+		std::size_t count;
+		ValueMap::Int64 intValue;
+		ValueMap::Double doubleValue;
+		// Int64 sum overflowed, it is in doubleValue since.
+		bool isOverflow;
+	};
+
+	// Groups in order of first appearance, one key word for null mask and one for each group column.
+	struct GroupTable
+	{
+		std::vector<uint64_t> keys;
+		std::vector<std::size_t> representatives;
+		std::vector<AggregateState> states;
+		std::vector<uint32_t> slots;
+		std::size_t count{ 0 };
+	};
+
+	struct Partition
+	{
+		// Selected rows when there is no aggregation.
+		std::vector<std::size_t> rows;
+		GroupTable groups;
+	};
+
+	const DynamicColumn& GetColumn(const DynamicKey& key) const
+	{
+		const DynamicColumn* pColumn{ m_columnar.FindColumn(key) };
+		if (pColumn == nullptr)
+		{
+			Error::ThrowUnexpectOperationErrorException();
+		}
+		return *pColumn;
+	}
+
+	bool IsAggregation() const noexcept
+	{
+		return !m_groups.empty() || !m_aggregates.empty();
+	}
+
+	Partition CreatePartition() const
+	{
+		Partition partition;
+		partition.groups.slots.assign(64, c_emptySlot);
+		return partition;
+	}
+
+	static bool IsValid(const uint64_t* pValidity, std::size_t row) noexcept
+	{
+		return (pValidity[row >> 6] >> (row & 63)) & 1;
+	}
+
+	template<typename TFunc>
+	static auto DispatchOperator(QueryOperator op, TFunc&& func)
+	{
+		switch (op)
+		{
+			case QueryOperator::Equal:
+				return func([](auto left, auto right) { return left == right; });
+			case QueryOperator::NotEqual:
+				return func([](auto left, auto right) { return left != right; });
+			case QueryOperator::Less:
+				return func([](auto left, auto right) { return left < right; });
+			case QueryOperator::LessEqual:
+				return func([](auto left, auto right) { return left <= right; });
+			case QueryOperator::Larger:
+				return func([](auto left, auto right) { return left > right; });
+			default:
+				return func([](auto left, auto right) { return left >= right; });
+		}
+	}
+
+	static bool MatchOrder(QueryOperator op, int order) noexcept
+	{
+		return DispatchOperator(op, [order](auto compare) -> bool { return compare(order, 0); });
+	}
+
+	// Branch free compaction of selection, loop over contiguous values can be vectorized.
+	template<typename TPredicate>
+	static std::size_t Narrow(std::size_t* pSelection, std::size_t count, TPredicate&& predicate)
+	{
+		std::size_t selected{ 0 };
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::size_t row{ pSelection[i] };
+			pSelection[selected] = row;
+			selected += predicate(row) ? 1 : 0;
+		}
+		return selected;
+	}
+
+	static std::size_t ApplyFilter(const Filter& filter, std::size_t* pSelection, std::size_t count)
+	{
+		const DynamicColumn& column{ *filter.pColumn };
+		const uint64_t* pValidity{ column.GetValidity().data() };
+		if (filter.op == QueryOperator::IsNull || filter.op == QueryOperator::IsNotNull)
+		{
+			bool isNull{ filter.op == QueryOperator::IsNull };
+			return Narrow(pSelection, count, [pValidity, isNull](std::size_t row) { return IsValid(pValidity, row) != isNull; });
+		}
+
+		ValueMap::Type literalType{ filter.literal.GetType() };
+		bool isNumberLiteral{ literalType == ValueMap::Type::Int32 || literalType == ValueMap::Type::Int64 || literalType == ValueMap::Type::Double };
+		if (column.GetType() == ColumnType::Int64 && isNumberLiteral && literalType != ValueMap::Type::Double)
+		{
+			const ValueMap::Int64* pValues{ column.GetInt64s().data() };
+			ValueMap::Int64 literal{ filter.literal.GetInt64() };
+			return DispatchOperator(filter.op, [&](auto compare)
+			{
+				return Narrow(pSelection, count, [&](std::size_t row) { return IsValid(pValidity, row) & compare(pValues[row], literal); });
+			});
+		}
+		if ((column.GetType() == ColumnType::Int64 || column.GetType() == ColumnType::Double) && isNumberLiteral)
+		{
+			// Exact comparison of integers with double literal is done by order of Dynamic::Compare.
+			if (column.GetType() == ColumnType::Int64)
+			{
+				const ValueMap::Int64* pValues{ column.GetInt64s().data() };
+				ValueMap::Double literal{ filter.literal.GetDouble() };
+				QueryOperator op{ filter.op };
+				return Narrow(pSelection, count, [&](std::size_t row)
+				{
+					return IsValid(pValidity, row) && MatchOrder(op, DynamicOrdering::CompareIntegerDouble(pValues[row], literal));
+				});
+			}
+
+			const ValueMap::Double* pValues{ column.GetDoubles().data() };
+			ValueMap::Double literal{ filter.literal.GetDouble() };
+			QueryOperator op{ filter.op };
+			if (literal != literal)
+			{
+				return Narrow(pSelection, count, [&](std::size_t row)
+				{
+					return IsValid(pValidity, row) && MatchOrder(op, DynamicOrdering::CompareDoubles(pValues[row], literal));
+				});
+			}
+			// NaN is above every number in Dynamic::Compare, operators of double would never match it.
+			bool isNanMatch{ op == QueryOperator::NotEqual || op == QueryOperator::Larger || op == QueryOperator::LargerEqual };
+			return DispatchOperator(op, [&](auto compare)
+			{
+				return Narrow(pSelection, count, [&](std::size_t row)
+				{
+					ValueMap::Double value{ pValues[row] };
+					return IsValid(pValidity, row) & (value != value ? isNanMatch : compare(value, literal));
+				});
+			});
+		}
+
+		switch (column.GetType())
+		{
+			case ColumnType::String:
+			case ColumnType::Bool:
+			{
+				// Predicate is evaluated once for each distinct value.
+				std::vector<uint8_t> matches;
+				if (column.GetType() == ColumnType::String)
+				{
+					for (const ValueMap::String& value : column.GetDictionary())
+					{
+						matches.push_back(MatchOrder(filter.op, Dynamic::Compare(Dynamic(ValueMap::StringView{ value }), filter.literal)));
+					}
+					const uint32_t* pCodes{ column.GetStringCodes().data() };
+					const uint8_t* pMatches{ matches.data() };
+					return Narrow(pSelection, count, [&](std::size_t row) { return IsValid(pValidity, row) && pMatches[pCodes[row]] != 0; });
+				}
+
+				matches.push_back(MatchOrder(filter.op, Dynamic::Compare(Dynamic(false), filter.literal)));
+				matches.push_back(MatchOrder(filter.op, Dynamic::Compare(Dynamic(true), filter.literal)));
+				const uint8_t* pValues{ column.GetBools().data() };
+				const uint8_t* pMatches{ matches.data() };
+				return Narrow(pSelection, count, [&](std::size_t row) { return IsValid(pValidity, row) & (pMatches[pValues[row]] != 0); });
+			}
+			case ColumnType::Dynamic:
+			{
+				const Dynamic* pValues{ column.GetDynamics().data() };
+				return Narrow(pSelection, count, [&](std::size_t row)
+				{
+					return IsValid(pValidity, row) && MatchOrder(filter.op, Dynamic::Compare(pValues[row], filter.literal));
+				});
+			}
+			case ColumnType::Null:
+				return 0;
+			default:
+			{
+				// Numeric column with literal of other type, order is same for all values.
+				Dynamic sample = column.GetType() == ColumnType::Int64 ? Dynamic(ValueMap::Int64{ 0 }) : Dynamic(0.0);
+				bool isMatch{ MatchOrder(filter.op, Dynamic::Compare(sample, filter.literal)) };
+				return Narrow(pSelection, count, [&](std::size_t row) { return isMatch && IsValid(pValidity, row); });
+			}
+		}
+	}
+
+	void Run(Partition& partition, std::size_t begin, std::size_t end) const
+	{
+		std::vector<std::size_t> selection(c_batchSize);
+		std::vector<uint64_t> key(m_groups.size() + 1);
+		for (std::size_t batch = begin; batch < end; batch += c_batchSize)
+		{
+			std::size_t count{ std::min(c_batchSize, end - batch) };
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				selection[i] = batch + i;
+			}
+			for (const Filter& filter : m_filters)
+			{
+				count = ApplyFilter(filter, selection.data(), count);
+			}
+
+			if (!IsAggregation())
+			{
+				partition.rows.insert(partition.rows.end(), selection.begin(), selection.begin() + count);
+				continue;
+			}
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				std::size_t row{ selection[i] };
+				MakeGroupKey(row, key.data());
+				std::size_t group{ FindOrAddGroup(partition.groups, key.data(), row) };
+				Accumulate(partition.groups.states.data() + group * m_aggregates.size(), row);
+			}
+		}
+	}
+
+	void MakeGroupKey(std::size_t row, uint64_t* pKey) const
+	{
+		uint64_t nullMask{ 0 };
+		for (std::size_t i = 0; i < m_groups.size(); ++i)
+		{
+			const DynamicColumn& column{ *m_groups[i] };
+			uint64_t word{ 0 };
+			if (!column.IsValid(row))
+			{
+				nullMask |= uint64_t{ 1 } << i;
+			}
+			else
+			{
+				switch (column.GetType())
+				{
+					case ColumnType::Bool:
+						word = column.GetBools()[row];
+						break;
+					case ColumnType::Int64:
+						word = static_cast<uint64_t>(column.GetInt64s()[row]);
+						break;
+					case ColumnType::Double:
+						word = DynamicSort::ToOrderedBits(column.GetDoubles()[row]);
+						break;
+					case ColumnType::String:
+						word = column.GetStringCodes()[row];
+						break;
+					case ColumnType::Dynamic:
+						word = column.GetDynamics()[row].Hash();
+						break;
+					default:
+						break;
+				}
+			}
+			pKey[i + 1] = word;
+		}
+		pKey[0] = nullMask;
+	}
+
+	uint64_t HashKey(const uint64_t* pKey) const noexcept
+	{
+		uint64_t hash{ 0 };
+		for (std::size_t i = 0; i <= m_groups.size(); ++i)
+		{
+			hash = Hash::Combine(hash, pKey[i]);
+		}
+		return hash;
+	}
+
+	// Words of Dynamic columns are hashes, so their values are compared through representative rows.
+	bool IsSameGroup(const uint64_t* pKey, std::size_t row, const uint64_t* pGroupKey, std::size_t groupRow) const
+	{
+		if (!std::equal(pKey, pKey + m_groups.size() + 1, pGroupKey))
+		{
+			return false;
+		}
+		for (std::size_t i = 0; i < m_groups.size(); ++i)
+		{
+			const DynamicColumn& column{ *m_groups[i] };
+			if (column.GetType() == ColumnType::Dynamic && column.IsValid(row)
+				&& column.GetDynamics()[row] != column.GetDynamics()[groupRow])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::size_t FindOrAddGroup(GroupTable& table, const uint64_t* pKey, std::size_t row) const
+	{
+		const std::size_t keyWidth{ m_groups.size() + 1 };
+		std::size_t mask{ table.slots.size() - 1 };
+		std::size_t slot{ HashKey(pKey) & mask };
+		while (table.slots[slot] != c_emptySlot)
+		{
+			uint32_t group{ table.slots[slot] };
+			if (IsSameGroup(pKey, row, table.keys.data() + group * keyWidth, table.representatives[group]))
+			{
+				return group;
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		std::size_t group{ table.count++ };
+		table.slots[slot] = static_cast<uint32_t>(group);
+		table.keys.insert(table.keys.end(), pKey, pKey + keyWidth);
+		table.representatives.push_back(row);
+		for (const Aggregation& aggregation : m_aggregates)
+		{
+			table.states.push_back(MakeInitialState(aggregation));
+		}
+
+		// Grow at half load.
+		if (table.count * 2 > table.slots.size())
+		{
+			table.slots.assign(table.slots.size() * 2, c_emptySlot);
+			mask = table.slots.size() - 1;
+			for (std::size_t i = 0; i < table.count; ++i)
+			{
+				std::size_t newSlot{ HashKey(table.keys.data() + i * keyWidth) & mask };
+				while (table.slots[newSlot] != c_emptySlot)
+				{
+					newSlot = (newSlot + 1) & mask;
+				}
+				table.slots[newSlot] = static_cast<uint32_t>(i);
+			}
+		}
+		return group;
+	}
+
+	static AggregateState MakeInitialState(const Aggregation& aggregation) noexcept
+	{
+		AggregateState state{ 0, 0, 0.0, false };
+		if (aggregation.function == AggregateFunction::Min)
+		{
+			state.intValue = std::numeric_limits<ValueMap::Int64>::max();
+			state.doubleValue = std::numeric_limits<ValueMap::Double>::infinity();
+		}
+		else if (aggregation.function == AggregateFunction::Max)
+		{
+			state.intValue = std::numeric_limits<ValueMap::Int64>::min();
+			state.doubleValue = -std::numeric_limits<ValueMap::Double>::infinity();
+		}
+		return state;
+	}
+
+	void Accumulate(AggregateState* pStates, std::size_t row) const
+	{
+		for (std::size_t i = 0; i < m_aggregates.size(); ++i)
+		{
+			const Aggregation& aggregation{ m_aggregates[i] };
+			AggregateState& state{ pStates[i] };
+			if (aggregation.pColumn == nullptr)
+			{
+				++state.count;
+				continue;
+			}
+
+			const DynamicColumn& column{ *aggregation.pColumn };
+			if (!column.IsValid(row))
+			{
+				continue;
+			}
+			++state.count;
+			if (aggregation.function == AggregateFunction::Count)
+			{
+				continue;
+			}
+
+			if (column.GetType() == ColumnType::Int64)
+			{
+				ValueMap::Int64 value{ column.GetInt64s()[row] };
+				if (IsSum(aggregation.function))
+				{
+					AddInt64(state, value);
+				}
+				else
+				{
+					Fold(aggregation.function, state.intValue, value);
+				}
+			}
+			else
+			{
+				ValueMap::Double value{ column.GetDoubles()[row] };
+				Fold(aggregation.function, state.doubleValue, value);
+			}
+		}
+	}
+
+	static bool IsSum(AggregateFunction function) noexcept
+	{
+		return function == AggregateFunction::Sum || function == AggregateFunction::Avg;
+	}
+
+	static void AddInt64(AggregateState& state, ValueMap::Int64 value) noexcept
+	{
+		if (!state.isOverflow)
+		{
+			bool isOverflow{ value > 0 ? state.intValue > std::numeric_limits<ValueMap::Int64>::max() - value
+				: state.intValue < std::numeric_limits<ValueMap::Int64>::min() - value };
+			if (!isOverflow)
+			{
+				state.intValue += value;
+				return;
+			}
+			state.isOverflow = true;
+			state.doubleValue = static_cast<ValueMap::Double>(state.intValue);
+		}
+		state.doubleValue += static_cast<ValueMap::Double>(value);
+	}
+
+	static void MergeInt64Sum(AggregateState& state, const AggregateState& other) noexcept
+	{
+		if (!other.isOverflow)
+		{
+			AddInt64(state, other.intValue);
+			return;
+		}
+		if (!state.isOverflow)
+		{
+			state.isOverflow = true;
+			state.doubleValue = static_cast<ValueMap::Double>(state.intValue);
+		}
+		state.doubleValue += other.doubleValue;
+	}
+
+	template<typename TValue>
+	static void Fold(AggregateFunction function, TValue& state, TValue value) noexcept
+	{
+		switch (function)
+		{
+			case AggregateFunction::Min:
+				state = std::min(state, value);
+				break;
+			case AggregateFunction::Max:
+				state = std::max(state, value);
+				break;
+			default:
+				state += value;
+				break;
+		}
+	}
+
+	void Merge(Partition& target, const Partition& source) const
+	{
+		if (!IsAggregation())
+		{
+			target.rows.insert(target.rows.end(), source.rows.begin(), source.rows.end());
+			return;
+		}
+
+		const std::size_t keyWidth{ m_groups.size() + 1 };
+		for (std::size_t i = 0; i < source.groups.count; ++i)
+		{
+			std::size_t group{ FindOrAddGroup(target.groups, source.groups.keys.data() + i * keyWidth, source.groups.representatives[i]) };
+			for (std::size_t j = 0; j < m_aggregates.size(); ++j)
+			{
+				AggregateState& state{ target.groups.states[group * m_aggregates.size() + j] };
+				const AggregateState& other{ source.groups.states[i * m_aggregates.size() + j] };
+				const Aggregation& aggregation{ m_aggregates[j] };
+				state.count += other.count;
+				if (aggregation.pColumn != nullptr && aggregation.pColumn->GetType() == ColumnType::Int64 && IsSum(aggregation.function))
+				{
+					MergeInt64Sum(state, other);
+					continue;
+				}
+				Fold(aggregation.function, state.intValue, other.intValue);
+				Fold(aggregation.function, state.doubleValue, other.doubleValue);
+			}
+		}
+	}
+
+	Dynamic MakeAggregateValue(const Aggregation& aggregation, const AggregateState& state) const
+	{
+		if (aggregation.function == AggregateFunction::Count)
+		{
+			return Dynamic(static_cast<ValueMap::Int64>(state.count));
+		}
+		if (state.count == 0)
+		{
+			return Dynamic{};
+		}
+
+		bool isInt64{ aggregation.pColumn->GetType() == ColumnType::Int64 && !state.isOverflow };
+		if (aggregation.function == AggregateFunction::Avg)
+		{
+			ValueMap::Double sum{ isInt64 ? static_cast<ValueMap::Double>(state.intValue) : state.doubleValue };
+			return Dynamic(sum / static_cast<ValueMap::Double>(state.count));
+		}
+		return isInt64 ? Dynamic(state.intValue) : Dynamic(state.doubleValue);
+	}
+
+	ValueMap::Array MakeResult(Partition& partition) const
+	{
+		ValueMap::Array result;
+		if (!IsAggregation())
+		{
+			result.reserve(partition.rows.size());
+			for (std::size_t row : partition.rows)
+			{
+				result.push_back(MakeProjectedRow(row));
+			}
+		}
+		else
+		{
+			// Aggregation without group by has one row even if no row is selected.
+			if (m_groups.empty() && partition.groups.count == 0)
+			{
+				std::vector<uint64_t> key(1, 0);
+				FindOrAddGroup(partition.groups, key.data(), 0);
+			}
+
+			result.reserve(partition.groups.count);
+			for (std::size_t group = 0; group < partition.groups.count; ++group)
+			{
+				Dynamic row = Dynamic::MakeObject();
+				ValueMap::ObjectMap& objectMap{ row.GetObjectMap() };
+				std::size_t representative{ partition.groups.representatives[group] };
+				for (const DynamicColumn* pColumn : m_groups)
+				{
+					objectMap.Set(pColumn->GetKey(), pColumn->GetValue(representative));
+				}
+				for (std::size_t i = 0; i < m_aggregates.size(); ++i)
+				{
+					objectMap.Set(m_aggregates[i].alias, MakeAggregateValue(m_aggregates[i], partition.groups.states[group * m_aggregates.size() + i]));
+				}
+				result.push_back(std::move(row));
+			}
+		}
+
+		if (!m_orderBy.IsEmpty())
+		{
+			DynamicSort::SortBy(result, m_orderBy, m_isDescending);
+		}
+		if (result.size() > m_limit)
+		{
+			result.erase(result.begin() + m_limit, result.end());
+		}
+		return result;
+	}
+
+	Dynamic MakeProjectedRow(std::size_t row) const
+	{
+		if (m_projections.empty())
+		{
+			return m_columnar.GetRow(row);
+		}
+
+		Dynamic object = Dynamic::MakeObject();
+		ValueMap::ObjectMap& objectMap{ object.GetObjectMap() };
+		for (const DynamicColumn* pColumn : m_projections)
+		{
+			if (pColumn->IsValid(row))
+			{
+				objectMap.Set(pColumn->GetKey(), pColumn->GetValue(row));
+			}
+		}
+		return object;
+	}
+
+	const DynamicColumnar& m_columnar;
+	std::vector<Filter> m_filters;
+	std::vector<const DynamicColumn*> m_projections;
+	std::vector<const DynamicColumn*> m_groups;
+	std::vector<Aggregation> m_aggregates;
+	DynamicKey m_orderBy;
+	std::size_t m_limit;
+	bool m_isDescending;
+};
+
+}}
+#endif
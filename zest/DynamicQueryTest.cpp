@@ -0,0 +1,199 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+
+#include "DynamicQuery.h"
+
+namespace Zest { namespace Lib {
+
+namespace {
+
+ValueMap::Array MakeSales(int count)
+{
+	const char* cities[]{ "Paris", "Rome", "Oslo" };
+	ValueMap::Array rows;
+	for (int i = 0; i < count; ++i)
+	{
+		rows.push_back(Dynamic{ Property{ "id", i }, Property{ "city", cities[i % 3] }, Property{ "price", (i % 10) * 1.5 } });
+	}
+	return rows;
+}
+
+}
+
+TEST(DynamicQueryTest, WhereSelect_FilteredProjection)
+{
+	DynamicColumnar sales{ DynamicColumnar::FromArray(MakeSales(30)) };
+	ValueMap::Array result = DynamicQuery{ sales }
+		.Where(DynamicKey{ "city" }, QueryOperator::Equal, Dynamic("Rome"))
+		.Where(DynamicKey{ "id" }, QueryOperator::Less, Dynamic(10.5))
+		.Select({ DynamicKey{ "id" } })
+		.Execute();
+
+	ASSERT_EQ(result.size(), 4u);
+	EXPECT_EQ(result[0]["id"].GetInt64(), 1);
+	EXPECT_EQ(result[3]["id"].GetInt64(), 10);
+	EXPECT_EQ(result[0].GetObjectMap().Size(), 1u);
+}
+
+TEST(DynamicQueryTest, GroupByAggregate_SameOnThreadPool)
+{
+	DynamicColumnar sales{ DynamicColumnar::FromArray(MakeSales(10000)) };
+	DynamicQuery query{ sales };
+	query.Where(DynamicKey{ "price" }, QueryOperator::LargerEqual, Dynamic(3))
+		.GroupBy({ DynamicKey{ "city" } })
+		.Aggregate(AggregateFunction::Count, DynamicKey{}, DynamicKey{ "count" })
+		.Aggregate(AggregateFunction::Sum, DynamicKey{ "price" }, DynamicKey{ "total" })
+		.Aggregate(AggregateFunction::Max, DynamicKey{ "id" }, DynamicKey{ "last" })
+		.Aggregate(AggregateFunction::Avg, DynamicKey{ "price" }, DynamicKey{ "average" })
+		.OrderBy(DynamicKey{ "city" });
+
+	ValueMap::Array serial = query.Execute();
+	ASSERT_EQ(serial.size(), 3u);
+	EXPECT_EQ(serial[0]["city"].GetString(), "Oslo");
+	EXPECT_EQ(serial[1]["city"].GetString(), "Paris");
+
+	std::size_t count{ 0 };
+	for (const Dynamic& row : serial)
+	{
+		count += static_cast<std::size_t>(row["count"].GetInt64());
+	}
+	EXPECT_EQ(count, 8000u);
+	EXPECT_EQ(serial[1]["last"].GetInt64(), 9999);
+	EXPECT_DOUBLE_EQ(serial[1]["average"].GetDouble(), serial[1]["total"].GetDouble() / serial[1]["count"].GetInt64());
+
+	ThreadPool pool{ 4 };
+	ValueMap::Array parallel = query.Execute(pool, 4);
+	ASSERT_EQ(parallel.size(), serial.size());
+	for (std::size_t i = 0; i < serial.size(); ++i)
+	{
+		EXPECT_TRUE(parallel[i] == serial[i]);
+	}
+	pool.Stop(true);
+}
+
+TEST(DynamicQueryTest, AggregateWithoutGroup_OneRowAndLimit)
+{
+	DynamicColumnar sales{ DynamicColumnar::FromArray(MakeSales(100)) };
+	ValueMap::Array total = DynamicQuery{ sales }
+		.Where(DynamicKey{ "id" }, QueryOperator::Larger, Dynamic(1000))
+		.Aggregate(AggregateFunction::Count, DynamicKey{}, DynamicKey{ "count" })
+		.Aggregate(AggregateFunction::Min, DynamicKey{ "price" }, DynamicKey{ "min" })
+		.Execute();
+	ASSERT_EQ(total.size(), 1u);
+	EXPECT_EQ(total[0]["count"].GetInt64(), 0);
+	EXPECT_EQ(total[0]["min"].GetType(), ValueMap::Type::Null);
+
+	ValueMap::Array top = DynamicQuery{ sales }.OrderBy(DynamicKey{ "id" }, true).Limit(2).Execute();
+	ASSERT_EQ(top.size(), 2u);
+	EXPECT_EQ(top[0]["id"].GetInt64(), 99);
+
+	EXPECT_THROW(DynamicQuery{ sales }.Aggregate(AggregateFunction::Sum, DynamicKey{ "city" }, DynamicKey{ "x" }), Error::Exception);
+}
+
+TEST(DynamicQueryTest, Int64Sum_OverflowBecomesDouble)
+{
+	const ValueMap::Int64 large{ ValueMap::Int64{ 1 } << 53 };
+	ValueMap::Array rows;
+	for (int i = 0; i < 4096; ++i)
+	{
+		rows.push_back(Dynamic{ Property{ "id", i }, Property{ "value", large } });
+	}
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows) };
+	DynamicQuery query{ columnar };
+	query.Aggregate(AggregateFunction::Sum, DynamicKey{ "value" }, DynamicKey{ "sum" })
+		.Aggregate(AggregateFunction::Avg, DynamicKey{ "value" }, DynamicKey{ "average" })
+		.Aggregate(AggregateFunction::Max, DynamicKey{ "value" }, DynamicKey{ "max" });
+
+	ValueMap::Array serial = query.Execute();
+	ASSERT_EQ(serial.size(), 1u);
+	ASSERT_EQ(serial[0]["sum"].GetType(), ValueMap::Type::Double);
+	EXPECT_EQ(serial[0]["sum"].GetDouble(), 4096.0 * static_cast<ValueMap::Double>(large));
+	EXPECT_DOUBLE_EQ(serial[0]["average"].GetDouble(), static_cast<ValueMap::Double>(large));
+	EXPECT_EQ(serial[0]["max"].GetInt64(), large);
+
+	ThreadPool pool{ 4 };
+	ValueMap::Array parallel = query.Execute(pool, 4);
+	ASSERT_EQ(parallel.size(), 1u);
+	ASSERT_EQ(parallel[0]["sum"].GetType(), ValueMap::Type::Double);
+	EXPECT_EQ(parallel[0]["sum"].GetDouble(), serial[0]["sum"].GetDouble());
+	pool.Stop(true);
+}
+
+TEST(DynamicQueryTest, Int64Extremes_NoOverflowStayInt64)
+{
+	const ValueMap::Int64 values[]{ std::numeric_limits<ValueMap::Int64>::max(), std::numeric_limits<ValueMap::Int64>::min(), 5 };
+	ValueMap::Array rows;
+	for (ValueMap::Int64 value : values)
+	{
+		rows.push_back(Dynamic{ Property{ "value", value } });
+	}
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows) };
+	ValueMap::Array result = DynamicQuery{ columnar }
+		.Aggregate(AggregateFunction::Sum, DynamicKey{ "value" }, DynamicKey{ "sum" })
+		.Aggregate(AggregateFunction::Min, DynamicKey{ "value" }, DynamicKey{ "min" })
+		.Aggregate(AggregateFunction::Max, DynamicKey{ "value" }, DynamicKey{ "max" })
+		.Execute();
+
+	ASSERT_EQ(result.size(), 1u);
+	ASSERT_EQ(result[0]["sum"].GetType(), ValueMap::Type::Int64);
+	EXPECT_EQ(result[0]["sum"].GetInt64(), 4);
+	EXPECT_EQ(result[0]["min"].GetInt64(), std::numeric_limits<ValueMap::Int64>::min());
+	EXPECT_EQ(result[0]["max"].GetInt64(), std::numeric_limits<ValueMap::Int64>::max());
+}
+
+TEST(DynamicQueryTest, GroupBy_NegativeZeroAndNaN_OneGroupEach)
+{
+	const ValueMap::Double values[]{ 0.0, -0.0, std::numeric_limits<ValueMap::Double>::quiet_NaN(), -std::numeric_limits<ValueMap::Double>::quiet_NaN(), 0.0 };
+	ValueMap::Array rows;
+	for (ValueMap::Double value : values)
+	{
+		rows.push_back(Dynamic{ Property{ "key", value } });
+	}
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows) };
+	ValueMap::Array result = DynamicQuery{ columnar }
+		.GroupBy({ DynamicKey{ "key" } })
+		.Aggregate(AggregateFunction::Count, DynamicKey{}, DynamicKey{ "count" })
+		.Execute();
+
+	ASSERT_EQ(result.size(), 2u);
+	EXPECT_EQ(result[0]["key"].GetDouble(), 0.0);
+	EXPECT_EQ(result[0]["count"].GetInt64(), 3);
+	EXPECT_TRUE(std::isnan(result[1]["key"].GetDouble()));
+	EXPECT_EQ(result[1]["count"].GetInt64(), 2);
+}
+TEST(DynamicQueryTest, WhereDouble_NaN_SameOrderAsCompare)
+{
+	const ValueMap::Double nan{ std::numeric_limits<ValueMap::Double>::quiet_NaN() };
+	const ValueMap::Double infinity{ std::numeric_limits<ValueMap::Double>::infinity() };
+	const ValueMap::Double values[]{ nan, -1.0, 0.0, 1.5, infinity, nan };
+	ValueMap::Array rows;
+	for (ValueMap::Double value : values)
+	{
+		rows.push_back(Dynamic{ Property{ "value", value } });
+	}
+	DynamicColumnar columnar{ DynamicColumnar::FromArray(rows) };
+
+	for (ValueMap::Double literal : { 0.0, 1.5, nan, -infinity })
+	{
+		for (QueryOperator op : { QueryOperator::Equal, QueryOperator::NotEqual, QueryOperator::Less,
+			QueryOperator::LessEqual, QueryOperator::Larger, QueryOperator::LargerEqual })
+		{
+			ValueMap::Array result = DynamicQuery{ columnar }.Where(DynamicKey{ "value" }, op, Dynamic(literal)).Execute();
+			std::size_t expected{ 0 };
+			for (ValueMap::Double value : values)
+			{
+				int order{ Dynamic::Compare(Dynamic(value), Dynamic(literal)) };
+				bool isMatch{ op == QueryOperator::Equal ? order == 0 : op == QueryOperator::NotEqual ? order != 0
+					: op == QueryOperator::Less ? order < 0 : op == QueryOperator::LessEqual ? order <= 0
+					: op == QueryOperator::Larger ? order > 0 : order >= 0 };
+				expected += isMatch ? 1 : 0;
+			}
+			EXPECT_EQ(result.size(), expected) << literal << " " << static_cast<int>(op);
+		}
+	}
+}
+
+}}
@@ -0,0 +1,250 @@
+#pragma once
+#ifndef ZEST_LIB_DYNAMICSORT_H
+#define ZEST_LIB_DYNAMICSORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "Dynamics.h"
+#include "DynamicPath.h"
+
+namespace Zest { namespace Lib {
+
+/*! Sorting and partitioning of ValueMap::Array in the total ordering of Dynamic::Compare.
+	Sort is stable. When all sort keys are integers, or all are doubles, keys are extracted
+	into 64 bit words and radix sorted, otherwise keys are compared through Dynamic::Compare.
+*/
+class DynamicSort
+{
+public:
+	static void Sort(ValueMap::Array& array, bool descending = false)
+	{
+		SortByKeys(array, [](const Dynamic& element) -> const Dynamic& { return element; }, descending);
+	}
+
+	// Sort objects by a property, elements without the property are sorted as null.
+	static void SortBy(ValueMap::Array& array, const DynamicKey& propertyKey, bool descending = false)
+	{
+		SortByKeys(array, [&propertyKey](const Dynamic& element) -> const Dynamic&
+		{
+			return SelectKey(element, propertyKey);
+		}, descending);
+	}
+
+	// Sort by first value selected by path, elements without match are sorted as null.
+	static void SortBy(ValueMap::Array& array, const DynamicPath& path, bool descending = false)
+	{
+		SortByKeys(array, [&path](const Dynamic& element) -> const Dynamic&
+		{
+			const Dynamic* pValue{ path.SelectFirst(element) };
+			return pValue != nullptr ? *pValue : GetNull();
+		}, descending);
+	}
+
+	// Move elements less than pivot to the front, returns their count. Order is not kept.
+	static std::size_t Partition(ValueMap::Array& array, const Dynamic& pivot)
+	{
+		ValueMap::Array::iterator middle;
+		if (IsInteger(pivot.GetType()) && GetKeyKind(array.begin(), array.end(), [](const Dynamic& element) -> const Dynamic& { return element; }) == KeyKind::Integer)
+		{
+			ValueMap::Int64 pivotValue{ DynamicOrdering::ReadInteger(pivot) };
+			middle = std::partition(array.begin(), array.end(), [pivotValue](const Dynamic& element)
+			{
+				return DynamicOrdering::ReadInteger(element) < pivotValue;
+			});
+		}
+		else
+		{
+			middle = std::partition(array.begin(), array.end(), [&pivot](const Dynamic& element)
+			{
+				return Dynamic::Compare(element, pivot) < 0;
+			});
+		}
+		return static_cast<std::size_t>(middle - array.begin());
+	}
+
+	// Unsigned key with same order as value.
+	static uint64_t ToOrderedBits(ValueMap::Int64 value) noexcept
+	{
+		return static_cast<uint64_t>(value) ^ c_signBit;
+	}
+
+	// Unsigned key with same order as Dynamic::Compare, -0 is 0 and NaN is after all numbers.
+	static uint64_t ToOrderedBits(ValueMap::Double value) noexcept
+	{
+		if (value != value)
+		{
+			value = std::numeric_limits<ValueMap::Double>::quiet_NaN();
+		}
+		value += 0.0;
+
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		if (value != value)
+		{
+			bits &= ~c_signBit;
+		}
+		return (bits & c_signBit) != 0 ? ~bits : bits | c_signBit;
+	}
+
+private:
+	enum class KeyKind
+	{
+		Mixed,
+		Integer,
+		Double
+	};
+
+	struct RadixItem
+	{
+		uint64_t key;
+		std::size_t index;
+	};
+
+	static constexpr uint64_t c_signBit{ uint64_t{ 1 } << 63 };
+
+	// Below this size comparison sort is faster than radix passes.
+	static constexpr std::size_t c_radixSortThreshold{ 64 };
+
+	static bool IsInteger(ValueMap::Type type) noexcept
+	{
+		return type == ValueMap::Type::Int32 || type == ValueMap::Type::Int64;
+	}
+
+	static const Dynamic& GetNull()
+	{
+		static const Dynamic nullValue;
+		return nullValue;
+	}
+
+	static const Dynamic& SelectKey(const Dynamic& element, const DynamicKey& propertyKey)
+	{
+		if (element.GetType() != ValueMap::Type::Object)
+		{
+			return GetNull();
+		}
+		const ValueMap::Object* pValue{ element.GetObjectMap().Find(propertyKey) };
+		return pValue != nullptr ? *pValue : GetNull();
+	}
+
+	template<typename TIterator, typename TKeyOf>
+	static KeyKind GetKeyKind(TIterator first, TIterator last, TKeyOf&& keyOf)
+	{
+		if (first == last)
+		{
+			return KeyKind::Mixed;
+		}
+
+		KeyKind kind{ KeyKind::Mixed };
+		for (; first != last; ++first)
+		{
+			ValueMap::Type type{ keyOf(*first).GetType() };
+			KeyKind elementKind{ IsInteger(type) ? KeyKind::Integer : (type == ValueMap::Type::Double ? KeyKind::Double : KeyKind::Mixed) };
+			if (elementKind == KeyKind::Mixed || (kind != KeyKind::Mixed && kind != elementKind))
+			{
+				return KeyKind::Mixed;
+			}
+			kind = elementKind;
+		}
+		return kind;
+	}
+
+	template<typename TKeyOf>
+	static void SortByKeys(ValueMap::Array& array, TKeyOf&& keyOf, bool descending)
+	{
+		const std::size_t size{ array.size() };
+		if (size < 2)
+		{
+			return;
+		}
+
+		std::vector<std::size_t> order(size);
+		KeyKind kind{ GetKeyKind(array.begin(), array.end(), keyOf) };
+		if (kind != KeyKind::Mixed && size >= c_radixSortThreshold)
+		{
+			std::vector<RadixItem> items(size);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				const Dynamic& key{ keyOf(array[i]) };
+				uint64_t bits{ kind == KeyKind::Integer ? ToOrderedBits(DynamicOrdering::ReadInteger(key)) : ToOrderedBits(DynamicOrdering::ReadDouble(key)) };
+				items[i] = RadixItem{ descending ? ~bits : bits, i };
+			}
+			RadixSort(items);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				order[i] = items[i].index;
+			}
+		}
+		else
+		{
+			std::vector<const Dynamic*> keys(size);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				keys[i] = &keyOf(array[i]);
+			}
+			std::iota(order.begin(), order.end(), std::size_t{ 0 });
+			std::stable_sort(order.begin(), order.end(), [&keys, descending](std::size_t left, std::size_t right)
+			{
+				int result{ Dynamic::Compare(*keys[left], *keys[right]) };
+				return descending ? result > 0 : result < 0;
+			});
+		}
+
+		Permute(array, order);
+	}
+
+	// LSD radix sort by bytes, stable, passes where all keys have same byte are skipped.
+	static void RadixSort(std::vector<RadixItem>& items)
+	{
+		const std::size_t size{ items.size() };
+		std::vector<std::size_t> counts(8 * 256, 0);
+		for (const RadixItem& item : items)
+		{
+			for (std::size_t pass = 0; pass < 8; ++pass)
+			{
+				++counts[pass * 256 + ((item.key >> (pass * 8)) & 0xFF)];
+			}
+		}
+
+		std::vector<RadixItem> buffer(size);
+		for (std::size_t pass = 0; pass < 8; ++pass)
+		{
+			std::size_t* pCounts{ counts.data() + pass * 256 };
+			if (pCounts[(items[0].key >> (pass * 8)) & 0xFF] == size)
+			{
+				continue;
+			}
+
+			std::size_t offset{ 0 };
+			for (std::size_t bucket = 0; bucket < 256; ++bucket)
+			{
+				std::size_t count{ pCounts[bucket] };
+				pCounts[bucket] = offset;
+				offset += count;
+			}
+			for (const RadixItem& item : items)
+			{
+				buffer[pCounts[(item.key >> (pass * 8)) & 0xFF]++] = item;
+			}
+			items.swap(buffer);
+		}
+	}
+
+	static void Permute(ValueMap::Array& array, const std::vector<std::size_t>& order)
+	{
+		ValueMap::Array sorted(array.get_allocator());
+		sorted.reserve(array.size());
+		for (std::size_t index : order)
+		{
+			sorted.push_back(std::move(array[index]));
+		}
+		array.swap(sorted);
+	}
+};
+
+}}
+#endif
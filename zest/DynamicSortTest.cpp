@@ -0,0 +1,152 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include "DynamicSort.h"
+
+namespace Zest { namespace Lib {
+
+TEST(DynamicSortTest, Compare_MixedTypes_TotalOrder)
+{
+	EXPECT_LT(Dynamic::Compare(Dynamic(), Dynamic(false)), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic(true), Dynamic(-100)), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic(ValueMap::Int64{ 2 }), Dynamic(2.5)), 0);
+	EXPECT_EQ(Dynamic::Compare(Dynamic(2.0), Dynamic(2)), 0);
+	EXPECT_GT(Dynamic::Compare(Dynamic(ValueMap::Int64{ 9007199254740993 }), Dynamic(9007199254740992.0)), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic(1e300), Dynamic(std::numeric_limits<double>::quiet_NaN())), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic(1e300), Dynamic("")), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic("a"), Dynamic("b")), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic("z"), Dynamic{ 1, 2 }), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic{ 1, 2 }, Dynamic{ 1, 2, 0 }), 0);
+	EXPECT_LT(Dynamic::Compare(Dynamic{ 1, 2 }, Dynamic::MakeObject()), 0);
+	EXPECT_EQ(Dynamic::Compare(Dynamic{ Property{ "a", 1 }, Property{ "b", 2 } }, Dynamic{ Property{ "b", 2 }, Property{ "a", 1 } }), 0);
+	EXPECT_TRUE(Dynamic("b") > Dynamic(3));
+	EXPECT_TRUE(Dynamic(3) <= Dynamic(3.0));
+}
+
+TEST(DynamicSortTest, Sort_HomogeneousAndMixed_Sorted)
+{
+	ValueMap::Array integers;
+	ValueMap::Array doubles;
+	for (int i = 0; i < 1000; ++i)
+	{
+		int value{ (i * 7919) % 1000 - 500 };
+		integers.push_back(Dynamic(static_cast<ValueMap::Int64>(value) * 1000000000));
+		doubles.push_back(Dynamic(value * 0.25));
+	}
+	doubles.push_back(Dynamic(-0.0));
+	doubles.push_back(Dynamic(std::numeric_limits<double>::quiet_NaN()));
+
+	DynamicSort::Sort(integers);
+	DynamicSort::Sort(doubles, true);
+	EXPECT_TRUE(std::is_sorted(integers.begin(), integers.end()));
+	EXPECT_EQ(integers.front().GetInt64(), -500000000000);
+	EXPECT_TRUE(std::isnan(doubles.front().GetDouble()));
+	EXPECT_TRUE(std::is_sorted(doubles.begin() + 1, doubles.end(), [](const Dynamic& left, const Dynamic& right) { return left > right; }));
+
+	ValueMap::Array mixed{ Dynamic("b"), Dynamic(2.5), Dynamic(), Dynamic(1), Dynamic("a") };
+	DynamicSort::Sort(mixed);
+	EXPECT_TRUE(mixed[0] == Dynamic());
+	EXPECT_EQ(mixed[1].GetInt32(), 1);
+	EXPECT_EQ(mixed[2].GetDouble(), 2.5);
+	EXPECT_EQ(mixed[3].GetString(), "a");
+}
+
+TEST(DynamicSortTest, SortBy_Property_StableAndPartition)
+{
+	ValueMap::Array rows;
+	for (int i = 0; i < 200; ++i)
+	{
+		rows.push_back(Dynamic{ Property{ "id", i }, Property{ "group", i % 3 } });
+	}
+
+	DynamicSort::SortBy(rows, DynamicKey{ "group" });
+	for (std::size_t i = 1; i < rows.size(); ++i)
+	{
+		ASSERT_LE(rows[i - 1]["group"].GetInt32(), rows[i]["group"].GetInt32());
+		if (rows[i - 1]["group"].GetInt32() == rows[i]["group"].GetInt32())
+		{
+			ASSERT_LT(rows[i - 1]["id"].GetInt32(), rows[i]["id"].GetInt32());
+		}
+	}
+
+	DynamicSort::SortBy(rows, DynamicPath::Compile("$.id"), true);
+	EXPECT_EQ(rows.front()["id"].GetInt32(), 199);
+
+	ValueMap::Array values{ Dynamic(5), Dynamic(1), Dynamic(8), Dynamic(3), Dynamic(9) };
+	std::size_t count{ DynamicSort::Partition(values, Dynamic(5)) };
+	EXPECT_EQ(count, 2u);
+	EXPECT_LT(values[0].GetInt32(), 5);
+	EXPECT_LT(values[1].GetInt32(), 5);
+}
+
+TEST(DynamicSortTest, Sort_ExtremeKeys_RadixMatchesCompare)
+{
+	const double infinity{ std::numeric_limits<double>::infinity() };
+	const double nan{ std::numeric_limits<double>::quiet_NaN() };
+	ValueMap::Array integers;
+	ValueMap::Array doubles;
+	for (int i = 0; i < 100; ++i)
+	{
+		// Int32 and Int64 keys are both integers, extremes keep their order.
+		ValueMap::Int64 values[]{ INT64_MIN, INT64_MAX, -1, 0, i - 50 };
+		integers.push_back(i % 2 == 0 ? Dynamic(static_cast<ValueMap::Int32>(i - 50)) : Dynamic(values[i % 5]));
+
+		double doubleValues[]{ -0.0, 0.0, -infinity, infinity, nan, -nan, 1e-310, -1e308 };
+		doubles.push_back(Dynamic(doubleValues[i % 8]));
+	}
+	ValueMap::Array expectedIntegers{ integers };
+	ValueMap::Array expectedDoubles{ doubles };
+	auto less = [](const Dynamic& left, const Dynamic& right) { return Dynamic::Compare(left, right) < 0; };
+	std::stable_sort(expectedIntegers.begin(), expectedIntegers.end(), less);
+	std::stable_sort(expectedDoubles.begin(), expectedDoubles.end(), less);
+
+	DynamicSort::Sort(integers);
+	DynamicSort::Sort(doubles);
+	EXPECT_EQ(integers.front().GetInt64(), INT64_MIN);
+	EXPECT_EQ(integers.back().GetInt64(), INT64_MAX);
+	for (std::size_t i = 0; i < integers.size(); ++i)
+	{
+		ASSERT_TRUE(integers[i].IsSameNode(expectedIntegers[i])) << i;
+	}
+	// -0 and 0 are equal so stay in input order, NaNs of either sign are last.
+	EXPECT_EQ(doubles.front().GetDouble(), -infinity);
+	EXPECT_TRUE(std::isnan(doubles.back().GetDouble()));
+	for (std::size_t i = 0; i < doubles.size(); ++i)
+	{
+		ASSERT_TRUE(doubles[i].IsSameNode(expectedDoubles[i])) << i;
+	}
+	EXPECT_EQ(DynamicSort::ToOrderedBits(-0.0), DynamicSort::ToOrderedBits(0.0));
+	EXPECT_EQ(DynamicSort::ToOrderedBits(nan), DynamicSort::ToOrderedBits(-nan));
+	EXPECT_LT(DynamicSort::ToOrderedBits(infinity), DynamicSort::ToOrderedBits(nan));
+}
+
+TEST(DynamicSortTest, SortBy_MissingKeysAndEmptyArrays)
+{
+	ValueMap::Array empty;
+	DynamicSort::Sort(empty);
+	DynamicSort::SortBy(empty, DynamicKey{ "id" }, true);
+	EXPECT_TRUE(empty.empty());
+	EXPECT_EQ(DynamicSort::Partition(empty, Dynamic(1)), 0u);
+
+	ValueMap::Array single{ Dynamic("only") };
+	DynamicSort::Sort(single, true);
+	EXPECT_EQ(single[0].GetString(), "only");
+
+	// Elements without the key, or which are not objects, sort as null before every value.
+	ValueMap::Array rows{ Dynamic{ Property{ "id", 2 } }, Dynamic(7), Dynamic{ Property{ "name", "x" } }, Dynamic{ Property{ "id", "a" } }, Dynamic{ Property{ "id", 1 } } };
+	DynamicSort::SortBy(rows, DynamicKey{ "id" });
+	EXPECT_EQ(rows[0].GetInt32(), 7);
+	EXPECT_EQ(rows[1]["name"].GetString(), "x");
+	EXPECT_EQ(rows[2]["id"].GetInt32(), 1);
+	EXPECT_EQ(rows[3]["id"].GetInt32(), 2);
+	EXPECT_EQ(rows[4]["id"].GetString(), "a");
+
+	// Pivot of another type partitions by type order.
+	ValueMap::Array values{ Dynamic("b"), Dynamic(3), Dynamic(), Dynamic(2.5) };
+	EXPECT_EQ(DynamicSort::Partition(values, Dynamic("a")), 3u);
+	EXPECT_EQ(values[3].GetString(), "b");
+}
+
+}}
@@ -3,29 +3,42 @@
 #define ZEST_LIB_DYNAMIC_H
 
 #include <cstdint>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <type_traits>
-#include <unordered_map>
 #include <limits>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <mutex>
+#include <memory_resource>
+#include <string_view>
 
 #include "Error.h"
+#include "Hash.h"
+#include "Platform.h"
 
 namespace Zest { namespace Lib {
 
 class IDynamicData;
 class Dynamic;
+class DynamicKey;
+class DynamicKeyCache;
+class DynamicObjectMap;
 
 struct ValueMap
 {
 	using Null = struct {};
 	using Object = Dynamic;
-	using Array = std::vector<Dynamic>;
+	using Array = std::pmr::vector<Dynamic>;
+	using ObjectMap = DynamicObjectMap;
 	using Bool = bool;
 	using Int32 = int32_t;
 	using Int64 = int64_t;
 	using Double = double;
 	using String = std::string;
+	using StringView = std::string_view;
 
 	enum class Type :uint32_t
 	{
@@ -41,746 +54,2102 @@ struct ValueMap
 
 };
 
+/*! Reference counting policy of dynamic data nodes.
+	Atomic nodes can be shared between threads, SingleThreaded nodes skip
+	the interlocked instructions and must stay in one thread.
+*/
+enum class RefCountPolicy : uint32_t
+{
+	Atomic,
+	SingleThreaded
+};
+
+/*! Dynamic has value semantics: copies share the same data until one of them is
+	mutated through operator[], GetObject or GetArray, then only the touched node is cloned.
+	Reference returned by these methods is invalid after the owner is copied.
+*/
 class Dynamic
 {
 public:
 	Dynamic();
+	~Dynamic();
 	Dynamic(Dynamic&& dynamicValue);
 	Dynamic(const Dynamic& dynamicValue);
 	Dynamic(ValueMap::Array&& arrayValue);
 	Dynamic(std::initializer_list<ValueMap::Object> initlist);
 	Dynamic(std::initializer_list<std::pair<ValueMap::String, ValueMap::Object>> initlist);
 	Dynamic(const ValueMap::String& stringValue);
+	Dynamic(const ValueMap::StringView stringValue);
 	Dynamic(const char* charValue);
 	Dynamic(const ValueMap::Bool boolValue);
 	Dynamic(const ValueMap::Int32 int32Value);
 	Dynamic(const ValueMap::Int64 int64Value);
 	Dynamic(const ValueMap::Double doubleValue);
 
+	// Object without properties.
+	static Dynamic MakeObject();
+
+	// Turns borrowed source into string value, it must not throw.
+	using StringDecoder = void (*)(const ValueMap::StringView source, std::pmr::string& value);
+
+	/*! String which views characters owned by caller instead of copying them.
+		Notice: characters must outlive the Dynamic and all of its copies.
+	*/
+	static Dynamic MakeBorrowedString(const ValueMap::StringView stringValue);
+
+	/*! String decoded from borrowed source when it is first read, e.g. escaped text.
+		Decoded value is kept in the node, allocated from its memory resource.
+		Notice: source must outlive the Dynamic and all of its copies.
+	*/
+	static Dynamic MakeBorrowedString(const ValueMap::StringView source, StringDecoder decoder);
+
+	/*! Copy of value in which every borrowed string owns its characters, so the borrowed buffer can be released.
+		Subtrees without borrowed strings are shared with value, not copied.
+	*/
+	static Dynamic MakeOwned(const Dynamic& value);
+
 	ValueMap::Array& GetArray();
+	const ValueMap::Array& GetArray() const;
 	ValueMap::Bool GetBool() const;
 	ValueMap::Int32 GetInt32() const;
 	ValueMap::Int64 GetInt64() const;
 	ValueMap::Double GetDouble() const;
-	const ValueMap::String& GetString() const;
+	ValueMap::StringView GetString() const;
 	ValueMap::Object& GetObject(const std::size_t index);
 	ValueMap::Object& GetObject(const ValueMap::String& propertyName);
-
+	const ValueMap::Object& GetObject(const std::size_t index) const;
+	const ValueMap::Object& GetObject(const ValueMap::String& propertyName) const;
+	ValueMap::Object& GetObject(const DynamicKey& propertyKey);
+	const ValueMap::Object& GetObject(const DynamicKey& propertyKey) const;
+	ValueMap::ObjectMap& GetObjectMap();
+	const ValueMap::ObjectMap& GetObjectMap() const;
+
+	// Add or replace property of object.
+	ValueMap::Object& SetObject(const ValueMap::String& propertyName, ValueMap::Object value);
+	ValueMap::Object& SetObject(const DynamicKey& propertyKey, ValueMap::Object value);
+	bool RemoveObject(const ValueMap::String& propertyName);
+	bool RemoveObject(const DynamicKey& propertyKey);
+
+	// Deep equality, numbers of different types are equal if they have same value.
 	bool operator==(const Dynamic& other)const;
+	bool operator!=(const Dynamic& other)const;
 	bool operator()() const;
 	bool operator>(const Dynamic& other) const;
 	bool operator<(const Dynamic& other) const;
+	bool operator>=(const Dynamic& other) const;
+	bool operator<=(const Dynamic& other) const;
+
+	/*! Total ordering over all types, negative if left is less, 0 if equal, positive if larger.
+		Null < Bool < numbers < String < Array < Object. Numbers of different types are compared
+		by value and NaN is larger than other numbers. Arrays are compared lexicographically,
+		objects by size then by properties in name order, so property order doesn't matter.
+	*/
+	static int Compare(const Dynamic& left, const Dynamic& right);
 	Dynamic& operator=(const Dynamic& other);
 	Dynamic& operator=(Dynamic&& other);
 
 	ValueMap::Object& operator[](const std::size_t index);
-	ValueMap::Object& operator[](const ValueMap::String propertyName);
+	ValueMap::Object& operator[](const ValueMap::String& propertyName);
+	const ValueMap::Object& operator[](const std::size_t index) const;
+	const ValueMap::Object& operator[](const ValueMap::String& propertyName) const;
+	ValueMap::Object& operator[](const DynamicKey& propertyKey);
+	const ValueMap::Object& operator[](const DynamicKey& propertyKey) const;
 
 	ValueMap::Type GetType() const noexcept;
 
+	// True if the data node is referenced by more than one Dynamic.
+	bool IsShared() const noexcept;
+
+	// True if both refer to the same data node, so they are equal without being compared.
+	bool IsSameNode(const Dynamic& other) const noexcept;
+
+	/*! Structural hash, consistent with operator==.
+		Property order doesn't change hash of object. Hash is cached in data node and
+		dropped when the node is accessed for write. Write through a kept reference to a
+		child doesn't drop hashes of its parents, so Hash and hashed containers may see a
+		stale hash then. operator== never uses cached hashes.
+	*/
+	uint64_t Hash() const;
+
 private:
+	friend class DynamicOrdering;
+
+	explicit Dynamic(IDynamicData* pDynamicData) noexcept;
+
+	// Make the data node exclusively owned and drop its cached hash before it is mutated.
+	void Detach();
+
+	uint64_t ComputeHash() const;
+	static bool IsNumber(ValueMap::Type type) noexcept;
+	static bool NumberEquals(const Dynamic& left, const Dynamic& right);
+
 	ValueMap::Type m_type;
-	std::shared_ptr<IDynamicData> m_spDynamicData;
+	IDynamicData* m_pDynamicData;
 };
 
-class IDynamicData
+struct DynamicKeyData
+{
+	ValueMap::String name;
+	uint32_t hash;
+	// Only counted for keys which are not interned and not in an arena.
+	mutable std::atomic<uint32_t> refCount{ 1 };
+};
+
+/*! Property name.
+	Interned keys with same name share one DynamicKeyData, so they are equal by pointer,
+	keys with other data are compared by hash and name.
+	Create hot keys once and reuse them to skip hashing and string compare:
+		static const DynamicKey c_idKey{ "id" };
+		document[c_idKey];
+	Keys of names read from input are not interned, see DynamicKeyCache. They own their data,
+	or live in the arena they were read under, and are compared by name.
+*/
+class DynamicKey
 {
 public:
-	friend class Dynamic;
-	enum class CompareResult : uint32_t
+	DynamicKey() noexcept
+		: m_keyData{ 0 }
 	{
-		NotComparable,
-		Less,
-		Larger,
-		Equal
-	};
-
-	virtual CompareResult Compare(const Dynamic& other) const noexcept = 0;
+	}
 
-	virtual ValueMap::Type GetType() const noexcept = 0;
+	explicit DynamicKey(const ValueMap::String& name);
+	explicit DynamicKey(const char* name);
 
-protected:
-	virtual ValueMap::Array& GetArray()
+	DynamicKey(const DynamicKey& other) noexcept
+		: m_keyData{ other.m_keyData }
 	{
-		Error::ThrowAcessDeniedErrorException();
+		AddRef(m_keyData);
 	}
 
-	virtual ValueMap::Bool GetBool() const
+	DynamicKey(DynamicKey&& other) noexcept
+		: m_keyData{ other.m_keyData }
 	{
-		Error::ThrowAcessDeniedErrorException();
+		other.m_keyData = 0;
 	}
 
-	virtual ValueMap::Int32 GetInt32() const
+	~DynamicKey()
 	{
-		Error::ThrowAcessDeniedErrorException();
+		Release(m_keyData);
 	}
 
-	virtual ValueMap::Int64 GetInt64() const
+	DynamicKey& operator=(const DynamicKey& other) noexcept
 	{
-		Error::ThrowAcessDeniedErrorException();
+		AddRef(other.m_keyData);
+		Release(m_keyData);
+		m_keyData = other.m_keyData;
+		return *this;
 	}
 
-	virtual ValueMap::Double GetDouble() const
+	DynamicKey& operator=(DynamicKey&& other) noexcept
 	{
-		Error::ThrowAcessDeniedErrorException();
+		std::swap(m_keyData, other.m_keyData);
+		return *this;
 	}
 
-	virtual const ValueMap::String& GetString() const
+	const ValueMap::String& GetName() const noexcept
 	{
-		Error::ThrowAcessDeniedErrorException();
+		static const ValueMap::String emptyName;
+		const DynamicKeyData* pKeyData{ GetData() };
+		return pKeyData != nullptr ? pKeyData->name : emptyName;
 	}
 
-	virtual ValueMap::Object& GetObject(const std::size_t index)
+	uint32_t GetHash() const noexcept
 	{
-		Error::ThrowAcessDeniedErrorException();
+		const DynamicKeyData* pKeyData{ GetData() };
+		return pKeyData != nullptr ? pKeyData->hash : 0;
 	}
 
-	virtual ValueMap::Object& GetObject(const ValueMap::String& propertyName)
+	bool IsEmpty() const noexcept
 	{
-		Error::ThrowAcessDeniedErrorException();
+		return m_keyData == 0;
 	}
 
-	virtual ValueMap::Object& GetEmptyObject() noexcept
+	bool IsInterned() const noexcept
 	{
-		return m_emptyObject;
+		return m_keyData != 0 && (m_keyData & c_tagMask) == 0;
 	}
-private:
-	ValueMap::Object m_emptyObject;
-};
-
-template<enum class ValueMap::Type>
-class DynamicData : public IDynamicData
-{
-};
 
-template<>
-class DynamicData<ValueMap::Type::Array> : public IDynamicData
-{
-public:
-	DynamicData(ValueMap::Array&& arrayValue)
-		: m_array(std::move(arrayValue))
+	bool operator==(const DynamicKey& other) const noexcept
 	{
+		if (m_keyData == other.m_keyData)
+		{
+			return true;
+		}
+		// Keys interned by different tables, or not interned, have their own data with same name.
+		const DynamicKeyData* pKeyData{ GetData() };
+		const DynamicKeyData* pOtherData{ other.GetData() };
+		return pKeyData != nullptr && pOtherData != nullptr && pKeyData->hash == pOtherData->hash && pKeyData->name == pOtherData->name;
 	}
 
-	DynamicData(std::initializer_list<ValueMap::Object> initlist)
-		: m_array{ initlist }
+	bool operator!=(const DynamicKey& other) const noexcept
 	{
+		return !(*this == other);
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+private:
+	friend class DynamicKeyTable;
+
+	// Low bits of data pointer tell who owns data, none for interned.
+	static constexpr std::uintptr_t c_ownedTag{ 1 };
+	static constexpr std::uintptr_t c_arenaTag{ 2 };
+	static constexpr std::uintptr_t c_tagMask{ 3 };
+
+	DynamicKey(const DynamicKeyData* pKeyData, std::uintptr_t tag) noexcept
+		: m_keyData{ reinterpret_cast<std::uintptr_t>(pKeyData) | tag }
 	{
-		return CompareResult::NotComparable;
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	const DynamicKeyData* GetData() const noexcept
 	{
-		return ValueMap::Type::Array;
+		return reinterpret_cast<const DynamicKeyData*>(m_keyData & ~c_tagMask);
 	}
 
-protected:
-	ValueMap::Object& GetObject(std::size_t index) noexcept override
+	// Interned and arena data is never dereferenced here, arena keys may outlive a parser's cache.
+	static void AddRef(std::uintptr_t keyData) noexcept
 	{
-		if (index >= m_array.size())
+		if ((keyData & c_tagMask) == c_ownedTag)
 		{
-			return GetEmptyObject();
+			reinterpret_cast<const DynamicKeyData*>(keyData & ~c_tagMask)->refCount.fetch_add(1, std::memory_order_relaxed);
 		}
-		return m_array[index];
 	}
 
-	ValueMap::Array& GetArray() override
+	static void Release(std::uintptr_t keyData) noexcept
 	{
-		return m_array;
+		if ((keyData & c_tagMask) == c_ownedTag)
+		{
+			const DynamicKeyData* pKeyData{ reinterpret_cast<const DynamicKeyData*>(keyData & ~c_tagMask) };
+			if (pKeyData->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				delete pKeyData;
+			}
+		}
 	}
-private:
-	ValueMap::Array m_array;
+
+	std::uintptr_t m_keyData;
 };
 
-template<>
-class DynamicData<ValueMap::Type::Object> : public IDynamicData
+/*! Table of interned keys, it is thread safe.
+	Interned keys live as long as their table, for the process wide instance until the process exits.
+	So intern only names known ahead of time, like literals, reflected fields and schema properties,
+	names read from input go through DynamicKeyCache. Table holds at most maxSize keys, beyond it
+	Intern returns keys which are not interned, so memory stays bounded whatever is interned.
+*/
+class DynamicKeyTable
 {
 public:
-	DynamicData(std::initializer_list<std::pair<ValueMap::String, ValueMap::Object>> initlist)
-		: m_objectMap{ initlist.begin(), initlist.end() }
+	static constexpr std::size_t c_defaultMaxSize{ 64 * 1024 };
+
+	static DynamicKeyTable& GetInstance()
 	{
+		static DynamicKeyTable keyTable;
+		return keyTable;
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+	// Table of its own, e.g. for one kind of document. Its keys must not outlive it.
+	explicit DynamicKeyTable(std::size_t maxSize = c_defaultMaxSize)
+		: m_maxShardSize{ (maxSize + c_shardCount - 1) / c_shardCount }
 	{
-		return CompareResult::NotComparable;
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	DynamicKeyTable(const DynamicKeyTable&) = delete;
+	DynamicKeyTable& operator=(const DynamicKeyTable&) = delete;
+
+	~DynamicKeyTable()
 	{
-		return ValueMap::Type::Object;
+		for (Shard& shard : m_shards)
+		{
+			for (const DynamicKeyData* pKeyData : shard.slots)
+			{
+				delete pKeyData;
+			}
+		}
 	}
 
-protected:
-	ValueMap::Object& GetObject(const ValueMap::String& propertyName) override
+	DynamicKey Intern(const char* name, std::size_t size)
 	{
-		if (m_objectMap.find(propertyName) == m_objectMap.end())
+		uint32_t hash{ Hash::HashString(name, size) };
+		Shard& shard{ GetShard(hash) };
+
+		std::unique_lock<std::mutex> lock{ shard.mutex };
+		std::size_t slot;
+		const DynamicKeyData* pKeyData{ FindSlot(shard, name, size, hash, slot) };
+		if (pKeyData != nullptr)
 		{
-			return GetEmptyObject();
+			return DynamicKey{ pKeyData, 0 };
+		}
+		if (shard.size >= m_maxShardSize)
+		{
+			lock.unlock();
+			return CreateUninterned(name, size, hash);
+		}
+
+		pKeyData = new DynamicKeyData{ ValueMap::String(name, size), hash };
+		shard.slots[slot] = pKeyData;
+		if (++shard.size * 2 > shard.slots.size())
+		{
+			Grow(shard);
 		}
-		return m_objectMap[propertyName];
+		return DynamicKey{ pKeyData, 0 };
 	}
-private:
-	std::unordered_map<ValueMap::String, ValueMap::Object> m_objectMap;
-};
 
-template<>
-class DynamicData<ValueMap::Type::Bool> : public IDynamicData
-{
-public:
-	DynamicData(ValueMap::Bool boolValue)
-		: m_bool(boolValue)
+	DynamicKey Intern(const ValueMap::String& name)
 	{
+		return Intern(name.data(), name.size());
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+	// Intern keys ahead of time, e.g. all field names of a known schema.
+	void Intern(std::initializer_list<const char*> names)
 	{
-		return CompareResult::NotComparable;
+		for (const char* name : names)
+		{
+			Intern(name, std::strlen(name));
+		}
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	// Interned key of name, empty key when name isn't interned. hash is Hash::HashString of name.
+	DynamicKey Find(const char* name, std::size_t size, uint32_t hash)
 	{
-		return ValueMap::Type::Object;
+		Shard& shard{ GetShard(hash) };
+		std::unique_lock<std::mutex> lock{ shard.mutex };
+		std::size_t slot;
+		const DynamicKeyData* pKeyData{ FindSlot(shard, name, size, hash, slot) };
+		return pKeyData != nullptr ? DynamicKey{ pKeyData, 0 } : DynamicKey{};
 	}
 
-protected:
-	ValueMap::Bool GetBool() const override
+	// Key which is not interned, it is in arena of current thread if there is one.
+	static DynamicKey CreateUninterned(const char* name, std::size_t size, uint32_t hash);
+
+	std::size_t Size()
 	{
-		return m_bool;
+		std::size_t size{ 0 };
+		for (Shard& shard : m_shards)
+		{
+			std::unique_lock<std::mutex> lock{ shard.mutex };
+			size += shard.size;
+		}
+		return size;
 	}
+
 private:
-	ValueMap::Bool m_bool;
-};
+	static constexpr uint32_t c_shardBits{ 4 };
+	static constexpr std::size_t c_shardCount{ 1 << c_shardBits };
 
-template<>
-class DynamicData<ValueMap::Type::Int32> : public IDynamicData
-{
-public:
-	DynamicData(ValueMap::Int32 int32Value)
-		: m_int32(int32Value)
+	struct Shard
+	{
+		std::mutex mutex;
+		std::vector<const DynamicKeyData*> slots = std::vector<const DynamicKeyData*>(64, nullptr);
+		std::size_t size{ 0 };
+	};
+
+	Shard& GetShard(uint32_t hash) noexcept
 	{
+		// Top bits select shard, low bits select slot in shard.
+		return m_shards[hash >> (32 - c_shardBits)];
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+	// Data of name, or nullptr and slot is the empty slot where name belongs.
+	static const DynamicKeyData* FindSlot(const Shard& shard, const char* name, std::size_t size, uint32_t hash, std::size_t& slot) noexcept
 	{
-		switch (other.GetType())
+		std::size_t mask{ shard.slots.size() - 1 };
+		for (slot = hash & mask; shard.slots[slot] != nullptr; slot = (slot + 1) & mask)
 		{
-			case ValueMap::Type::Double:
+			const DynamicKeyData* pKeyData{ shard.slots[slot] };
+			if (pKeyData->hash == hash && pKeyData->name.size() == size && std::memcmp(pKeyData->name.data(), name, size) == 0)
 			{
-				ValueMap::Double value{ GetDouble() };
-
-				if (value > other.GetDouble())
-				{
-					return CompareResult::Larger;
-				}
-				else if (value == other.GetDouble())
-				{
-					return CompareResult::Equal;
-				}
-				else
-				{
-					return CompareResult::Less;
-				}
-				break;
+				return pKeyData;
 			}
-			case ValueMap::Type::Int32:
+		}
+		return nullptr;
+	}
+
+	static void Grow(Shard& shard)
+	{
+		std::vector<const DynamicKeyData*> slots(shard.slots.size() * 2, nullptr);
+		std::size_t mask{ slots.size() - 1 };
+		for (const DynamicKeyData* pKeyData : shard.slots)
+		{
+			if (pKeyData == nullptr)
 			{
-				ValueMap::Int32 value{ GetInt32() };
-				if (value > other.GetInt32())
-				{
-					return CompareResult::Larger;
-				}
-				else if (value == other.GetInt32())
-				{
-					return CompareResult::Equal;
-				}
-				else
-				{
-					return CompareResult::Less;
-				}
-				break;
+				continue;
 			}
-			case ValueMap::Type::Int64:
+			std::size_t slot{ pKeyData->hash & mask };
+			while (slots[slot] != nullptr)
 			{
-				ValueMap::Int64 value{ GetInt64() };
-				if (value > other.GetInt64())
-				{
-					return CompareResult::Larger;
-				}
-				else if (value == other.GetInt64())
-				{
-					return CompareResult::Equal;
-				}
-				else
-				{
-					return CompareResult::Less;
-				}
-				break;
+				slot = (slot + 1) & mask;
 			}
-			default:
-				return CompareResult::NotComparable;
+			slots[slot] = pKeyData;
 		}
+		shard.slots.swap(slots);
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	std::size_t m_maxShardSize;
+	Shard m_shards[c_shardCount];
+};
+
+inline DynamicKey::DynamicKey(const ValueMap::String& name)
+	: DynamicKey(DynamicKeyTable::GetInstance().Intern(name))
+{
+}
+
+inline DynamicKey::DynamicKey(const char* name)
+	: DynamicKey(DynamicKeyTable::GetInstance().Intern(name ? name : "", name ? std::strlen(name) : 0))
+{
+}
+
+/*! Properties of dynamic object, kept in insertion order.
+	Small objects are a flat array searched by key hash, larger ones are
+	indexed by an open addressing table over the same array.
+	Lookup compares key hashes first, then key data pointers, names only when pointers differ.
+*/
+class DynamicObjectMap
+{
+public:
+	using Entry = std::pair<DynamicKey, ValueMap::Object>;
+	using Iterator = std::pmr::vector<Entry>::iterator;
+	using ConstIterator = std::pmr::vector<Entry>::const_iterator;
+
+	// Objects with more properties than this are indexed.
+	static constexpr std::size_t c_linearSearchLimit{ 16 };
+
+	DynamicObjectMap() = default;
+	DynamicObjectMap(const DynamicObjectMap&) = default;
+	DynamicObjectMap(DynamicObjectMap&&) noexcept = default;
+	DynamicObjectMap& operator=(const DynamicObjectMap&) = default;
+	DynamicObjectMap& operator=(DynamicObjectMap&&) = default;
+
+	explicit DynamicObjectMap(std::pmr::memory_resource* pMemoryResource)
+		: m_entries{ pMemoryResource }, m_hashes{ pMemoryResource }, m_index{ pMemoryResource }
 	{
-		return ValueMap::Type::Int32;
 	}
 
-protected:
-	ValueMap::Int32 GetInt32() const override
+	DynamicObjectMap(const DynamicObjectMap& other, std::pmr::memory_resource* pMemoryResource)
+		: m_entries{ other.m_entries, pMemoryResource }, m_hashes{ other.m_hashes, pMemoryResource },
+		m_index{ other.m_index, pMemoryResource }
 	{
-		return m_int32;
 	}
 
-	ValueMap::Int64 GetInt64() const override
+	DynamicObjectMap(std::initializer_list<std::pair<ValueMap::String, ValueMap::Object>> initlist, std::pmr::memory_resource* pMemoryResource)
+		: DynamicObjectMap(pMemoryResource)
 	{
-		return static_cast<ValueMap::Int64>(GetInt32());
+		Reserve(initlist.size());
+		for (const auto& property : initlist)
+		{
+			Set(property.first, property.second);
+		}
 	}
 
-	ValueMap::Double GetDouble() const override
+	std::size_t Size() const noexcept
 	{
-		return static_cast<ValueMap::Double>(GetInt32());
+		return m_entries.size();
 	}
-private:
-	ValueMap::Int32 m_int32;
-};
 
-template<>
-class DynamicData<ValueMap::Type::Int64> : public IDynamicData
-{
-public:
-	DynamicData(ValueMap::Int64 int64Value)
-		: m_int64(int64Value)
+	bool IsEmpty() const noexcept
 	{
+		return m_entries.empty();
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+	Iterator begin() noexcept { return m_entries.begin(); }
+	Iterator end() noexcept { return m_entries.end(); }
+	ConstIterator begin() const noexcept { return m_entries.begin(); }
+	ConstIterator end() const noexcept { return m_entries.end(); }
+
+	void Reserve(std::size_t size)
 	{
-		switch (other.GetType())
-		{
-			case ValueMap::Type::Double:
-			{
-				ValueMap::Double value{ static_cast<ValueMap::Double>(GetInt64()) };
+		m_entries.reserve(size);
+		m_hashes.reserve(size);
+	}
 
-				if (value > other.GetDouble())
-				{
-					return CompareResult::Larger;
-				}
-				else if (value == other.GetDouble())
-				{
-					return CompareResult::Equal;
-				}
-				else
-				{
-					return CompareResult::Less;
-				}
-				break;
-			}
-			case ValueMap::Type::Int32:
-			{
-				ValueMap::Int64 value{ GetInt64() };
-				ValueMap::Int64 otherValue{ static_cast<ValueMap::Int64>(other.GetInt32()) };
-				if (value > otherValue)
-				{
-					return CompareResult::Larger;
-				}
-				else if (value == otherValue)
-				{
-					return CompareResult::Equal;
-				}
-				else
-				{
-					return CompareResult::Less;
-				}
-				break;
-			}
-			case ValueMap::Type::Int64:
-			{
-				ValueMap::Int64 value{ static_cast<int64_t>(GetInt32()) };
-				if (value > other.GetInt64())
-				{
-					return CompareResult::Larger;
-				}
-				else if (value == other.GetInt64())
-				{
-					return CompareResult::Equal;
-				}
-				else
-				{
-					return CompareResult::Less;
-				}
-				break;
-			}
-			default:
-				return CompareResult::NotComparable;
-		}
+	ValueMap::Object* Find(const ValueMap::String& key) noexcept
+	{
+		std::size_t position{ FindPosition(NameMatcher{ key }) };
+		return position == c_npos ? nullptr : &m_entries[position].second;
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	const ValueMap::Object* Find(const ValueMap::String& key) const noexcept
 	{
-		return ValueMap::Type::Int64;
+		std::size_t position{ FindPosition(NameMatcher{ key }) };
+		return position == c_npos ? nullptr : &m_entries[position].second;
 	}
 
-protected:
-	ValueMap::Int64 GetInt64() const override
+	ValueMap::Object* Find(const DynamicKey& key) noexcept
 	{
-		return m_int64;
+		std::size_t position{ FindPosition(KeyMatcher{ key }) };
+		return position == c_npos ? nullptr : &m_entries[position].second;
 	}
 
-	ValueMap::Int32 GetInt32() const override
+	const ValueMap::Object* Find(const DynamicKey& key) const noexcept
 	{
-		if (m_int64 > static_cast<ValueMap::Int64>(std::numeric_limits<ValueMap::Int32>::max()))
+		std::size_t position{ FindPosition(KeyMatcher{ key }) };
+		return position == c_npos ? nullptr : &m_entries[position].second;
+	}
+
+	ValueMap::Object& Set(const ValueMap::String& key, ValueMap::Object value)
+	{
+		return Set(DynamicKey{ key }, std::move(value));
+	}
+
+	ValueMap::Object& Set(const DynamicKey& key, ValueMap::Object value)
+	{
+		std::size_t position{ FindPosition(KeyMatcher{ key }) };
+		if (position != c_npos)
 		{
-			return std::numeric_limits<ValueMap::Int32>::max();
+			m_entries[position].second = std::move(value);
+			return m_entries[position].second;
 		}
 
-		if (m_int64 < static_cast<ValueMap::Int64>(std::numeric_limits<ValueMap::Int32>::min()))
+		m_entries.emplace_back(key, std::move(value));
+		m_hashes.push_back(key.GetHash());
+		if (!m_index.empty() && m_entries.size() * 2 <= m_index.size())
 		{
-			return std::numeric_limits<ValueMap::Int32>::min();
+			InsertIndex(m_entries.size() - 1);
 		}
-
-		return static_cast<ValueMap::Int32>(m_int64);
+		else if (m_entries.size() > c_linearSearchLimit)
+		{
+			RebuildIndex();
+		}
+		return m_entries.back().second;
 	}
 
-	ValueMap::Double GetDouble() const override
+	bool Erase(const ValueMap::String& key)
 	{
-		return static_cast<ValueMap::Double>(GetInt32());
+		return ErasePosition(FindPosition(NameMatcher{ key }));
 	}
-private:
-	ValueMap::Int64 m_int64;
-};
 
-template<>
-class DynamicData<ValueMap::Type::Double> : public IDynamicData
-{
-public:
-	DynamicData(ValueMap::Double doubleValue)
-		: m_double(doubleValue)
+	bool Erase(const DynamicKey& key)
 	{
+		return ErasePosition(FindPosition(KeyMatcher{ key }));
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+private:
+	static constexpr std::size_t c_npos{ static_cast<std::size_t>(-1) };
+
+	struct NameMatcher
 	{
-		switch (other.GetType())
+		explicit NameMatcher(const ValueMap::String& name) noexcept
+			: name{ name }, hash{ Hash::HashString(name.data(), name.size()) }
 		{
-		case ValueMap::Type::Double:
+		}
+
+		bool operator()(const DynamicKey& key) const noexcept
 		{
-			ValueMap::Double value{ GetDouble() };
-			ValueMap::Double otherValue{ other.GetDouble() };
-			if (value > otherValue)
-			{
-				return CompareResult::Larger;
-			}
-			else if (value == otherValue)
-			{
-				return CompareResult::Equal;
-			}
-			else
-			{
-				return CompareResult::Less;
-			}
-			break;
+			return key.GetName() == name;
 		}
-		case ValueMap::Type::Int32:
+
+		const ValueMap::String& name;
+		uint32_t hash;
+	};
+
+	struct KeyMatcher
+	{
+		explicit KeyMatcher(const DynamicKey& key) noexcept
+			: key{ key }, hash{ key.GetHash() }
 		{
-			ValueMap::Double value{ GetDouble() };
-			ValueMap::Double otherValue{ static_cast<ValueMap::Double>(other.GetInt32()) };
-			if (value > otherValue)
-			{
-				return CompareResult::Larger;
-			}
-			else if (value == otherValue)
-			{
-				return CompareResult::Equal;
-			}
-			else
-			{
-				return CompareResult::Less;
-			}
-			break;
 		}
-		case ValueMap::Type::Int64:
+
+		bool operator()(const DynamicKey& other) const noexcept
 		{
-			ValueMap::Double value{ GetDouble() };
-			ValueMap::Double otherValue{ static_cast<ValueMap::Double>(other.GetInt64()) };
-			if (value > otherValue)
+			return key == other;
+		}
+
+		const DynamicKey& key;
+		uint32_t hash;
+	};
+
+	template<typename TMatcher>
+	std::size_t FindPosition(const TMatcher& matcher) const noexcept
+	{
+		const uint32_t hash{ matcher.hash };
+		if (!m_index.empty())
+		{
+			std::size_t mask{ m_index.size() - 1 };
+			for (std::size_t slot{ hash & mask };; slot = (slot + 1) & mask)
 			{
-				return CompareResult::Larger;
+				uint32_t position{ m_index[slot] };
+				if (position == 0)
+				{
+					return c_npos;
+				}
+				if (m_hashes[position - 1] == hash && matcher(m_entries[position - 1].first))
+				{
+					return position - 1;
+				}
 			}
-			else if (value == otherValue)
+		}
+
+		const uint32_t* pHashes{ m_hashes.data() };
+		std::size_t size{ m_hashes.size() };
+		std::size_t i{ 0 };
+#ifdef ZEST_LIB_SSE2
+		const __m128i needle{ _mm_set1_epi32(static_cast<int>(hash)) };
+		for (; i + 4 <= size; i += 4)
+		{
+			__m128i block{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHashes + i)) };
+			uint32_t mask{ static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)))) };
+			while (mask != 0)
 			{
-				return CompareResult::Equal;
+				std::size_t position{ i + Platform::CountTrailingZeros(mask) };
+				if (matcher(m_entries[position].first))
+				{
+					return position;
+				}
+				mask &= mask - 1;
 			}
-			else
+		}
+#endif
+		for (; i < size; ++i)
+		{
+			if (pHashes[i] == hash && matcher(m_entries[i].first))
 			{
-				return CompareResult::Less;
+				return i;
 			}
-			break;
 		}
-		default:
-			return CompareResult::NotComparable;
+		return c_npos;
+	}
+
+	bool ErasePosition(std::size_t position)
+	{
+		if (position == c_npos)
+		{
+			return false;
+		}
+
+		m_entries.erase(m_entries.begin() + position);
+		m_hashes.erase(m_hashes.begin() + position);
+		if (!m_index.empty())
+		{
+			RebuildIndex();
 		}
+		return true;
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	void InsertIndex(std::size_t position) noexcept
 	{
-		return ValueMap::Type::Double;
+		std::size_t mask{ m_index.size() - 1 };
+		std::size_t slot{ m_hashes[position] & mask };
+		while (m_index[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_index[slot] = static_cast<uint32_t>(position + 1);
 	}
 
-protected:
-	ValueMap::Int64 GetInt64() const override
+	void RebuildIndex()
 	{
-		return static_cast<ValueMap::Int64>(m_double);
+		if (m_entries.size() <= c_linearSearchLimit)
+		{
+			m_index.clear();
+			return;
+		}
+
+		// Keep load factor under 1/2 so probe sequences stay short.
+		std::size_t capacity{ 32 };
+		while (capacity < m_entries.size() * 4)
+		{
+			capacity <<= 1;
+		}
+		m_index.assign(capacity, 0);
+		for (std::size_t i = 0; i < m_entries.size(); ++i)
+		{
+			InsertIndex(i);
+		}
 	}
 
-	ValueMap::Int32 GetInt32() const override
+	std::pmr::vector<Entry> m_entries;
+	// Hash of m_entries[i].first, contiguous to be scanned quickly.
+	std::pmr::vector<uint32_t> m_hashes;
+	// Slot holds position in m_entries plus 1, 0 for empty slot.
+	std::pmr::vector<uint32_t> m_index;
+};
+
+/*! Set default RefCountPolicy for dynamic data created in current thread.
+	Usage:
+		{
+			ScopedRefCountPolicy policy{ RefCountPolicy::SingleThreaded };
+			Dynamic document{ ... }; // All nodes of document use non-atomic reference count.
+		}
+*/
+class ScopedRefCountPolicy
+{
+public:
+	explicit ScopedRefCountPolicy(RefCountPolicy policy) noexcept
+		: m_previousPolicy{ GetCurrentPolicy() }
 	{
-		return static_cast<ValueMap::Int32>(m_double);
+		GetCurrentPolicy() = policy;
 	}
 
+	ScopedRefCountPolicy(const ScopedRefCountPolicy&) = delete;
+	ScopedRefCountPolicy& operator=(const ScopedRefCountPolicy&) = delete;
 
-	ValueMap::Double GetDouble() const override
+	~ScopedRefCountPolicy()
 	{
-		return m_double;
+		GetCurrentPolicy() = m_previousPolicy;
+	}
+
+	static RefCountPolicy& GetCurrentPolicy() noexcept
+	{
+		thread_local RefCountPolicy currentPolicy{ RefCountPolicy::Atomic };
+		return currentPolicy;
 	}
+
 private:
-	ValueMap::Double m_double;
+	RefCountPolicy m_previousPolicy;
 };
 
-template<>
-class DynamicData<ValueMap::Type::String> : public IDynamicData
+/*! Monotonic memory for dynamic documents.
+	Nodes, arrays, object maps and strings created in a ScopedDynamicArena are carved
+	from a few large blocks. They are never destructed one by one: the whole document
+	is freed at once when the arena is destructed.
+	Notice:
+		1. Arena must outlive every Dynamic which references its nodes.
+		2. Values created outside the arena and stored into an arena document are never
+		   released, use Copy to bring them into the arena first.
+		3. Keys which DynamicKeyCache creates in the arena live as long as the arena.
+		4. Arena itself is not thread safe.
+*/
+class DynamicArena
 {
 public:
-	DynamicData(const ValueMap::String& stringValue)
-		: m_string(stringValue)
+	static constexpr std::size_t c_defaultBlockSize{ 64 * 1024 };
+
+	explicit DynamicArena(std::size_t initialBlockSize = c_defaultBlockSize,
+		std::pmr::memory_resource* pUpstream = std::pmr::get_default_resource())
+		: m_memoryResource{ initialBlockSize, pUpstream }, m_id{ GetNextId() }
 	{
 	}
 
-	DynamicData(ValueMap::String&& stringValue)
-		: m_string(std::move(stringValue))
+	DynamicArena(const DynamicArena&) = delete;
+	DynamicArena& operator=(const DynamicArena&) = delete;
+
+	std::pmr::memory_resource* GetMemoryResource() noexcept
 	{
+		return &m_memoryResource;
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+	// Unique among arenas of the process, never 0.
+	uint64_t GetId() const noexcept
 	{
-		return CompareResult::NotComparable;
+		return m_id;
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	// Data of a key which is not interned, freed with the arena.
+	const DynamicKeyData* AddKey(const char* name, std::size_t size, uint32_t hash)
 	{
-		return ValueMap::Type::String;
+		m_keys.push_back(std::unique_ptr<DynamicKeyData>(new DynamicKeyData{ ValueMap::String(name, size), hash }));
+		return m_keys.back().get();
 	}
 
-protected:
-	const ValueMap::String& GetString() const override
+	// Deep copy value into this arena.
+	Dynamic Copy(const Dynamic& value);
+
+private:
+	static uint64_t GetNextId() noexcept
 	{
-		return m_string;
+		static std::atomic<uint64_t> nextId{ 1 };
+		return nextId.fetch_add(1, std::memory_order_relaxed);
 	}
-private:
-	ValueMap::String m_string;
+
+	static Dynamic CopyValue(const Dynamic& value, DynamicKeyCache& keyCache);
+
+	std::pmr::monotonic_buffer_resource m_memoryResource;
+	uint64_t m_id;
+	std::vector<std::unique_ptr<DynamicKeyData>> m_keys;
 };
 
-template<>
-class DynamicData<ValueMap::Type::Null> : public IDynamicData
+/*! Allocate dynamic data created in current thread from arena.
+	Usage:
+		DynamicArena arena;
+		{
+			ScopedDynamicArena scope{ arena };
+			Dynamic document{ ... }; // All nodes of document are in arena.
+		}
+*/
+class ScopedDynamicArena
 {
 public:
-	DynamicData()
+	explicit ScopedDynamicArena(DynamicArena& arena) noexcept
+		: m_pPreviousArena{ GetCurrentArena() }, m_pPreviousMemoryResource{ GetCurrentMemoryResource() }
 	{
+		GetCurrentArena() = &arena;
+		GetCurrentMemoryResource() = arena.GetMemoryResource();
 	}
 
-	CompareResult Compare(const Dynamic& other) const noexcept override
+	ScopedDynamicArena(const ScopedDynamicArena&) = delete;
+	ScopedDynamicArena& operator=(const ScopedDynamicArena&) = delete;
+
+	~ScopedDynamicArena()
 	{
-		return CompareResult::NotComparable;
+		GetCurrentArena() = m_pPreviousArena;
+		GetCurrentMemoryResource() = m_pPreviousMemoryResource;
 	}
 
-	ValueMap::Type GetType() const noexcept override
+	// nullptr means there is no arena in current thread.
+	static DynamicArena*& GetCurrentArena() noexcept
 	{
-		return ValueMap::Type::Null;
+		thread_local DynamicArena* pCurrentArena{ nullptr };
+		return pCurrentArena;
 	}
-};
 
+	// nullptr means dynamic data is allocated from heap.
+	static std::pmr::memory_resource*& GetCurrentMemoryResource() noexcept
+	{
+		thread_local std::pmr::memory_resource* pCurrentMemoryResource{ nullptr };
+		return pCurrentMemoryResource;
+	}
 
-inline Dynamic::Dynamic()
-	: m_type(ValueMap::Type::Null)
-{
-}
+private:
+	DynamicArena* m_pPreviousArena;
+	std::pmr::memory_resource* m_pPreviousMemoryResource;
+};
 
-inline Dynamic::Dynamic(Dynamic&& dynamicValue)
-	: m_type(dynamicValue.GetType()),
-	m_spDynamicData{ std::move(dynamicValue.m_spDynamicData) }
+inline DynamicKey DynamicKeyTable::CreateUninterned(const char* name, std::size_t size, uint32_t hash)
 {
+	DynamicArena* pArena{ ScopedDynamicArena::GetCurrentArena() };
+	if (pArena != nullptr)
+	{
+		return DynamicKey{ pArena->AddKey(name, size, hash), DynamicKey::c_arenaTag };
+	}
+	return DynamicKey{ new DynamicKeyData{ ValueMap::String(name, size), hash }, DynamicKey::c_ownedTag };
 }
 
-inline Dynamic::Dynamic(const Dynamic& dynamicValue)
-	: m_type(dynamicValue.GetType()),
-	m_spDynamicData{ std::move(dynamicValue.m_spDynamicData) }
+/*! Keys of names read from input by one parser or decoder.
+	Names interned ahead of time get their interned key, others a key which is not interned,
+	so untrusted input can't grow the process wide table. Repeated names of a document share
+	one key through a small direct mapped cache, which keeps its keys until they are replaced.
+*/
+class DynamicKeyCache
 {
-}
+public:
+	DynamicKey Get(const char* name, std::size_t size)
+	{
+		return Get(name, size, Hash::HashString(name, size));
+	}
 
-inline Dynamic::Dynamic(ValueMap::Array&& arrayValue)
-	: m_type(ValueMap::Type::Array),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Array>>(std::move(arrayValue)) }
-{
-}
+	// hash must be Hash::HashString of name.
+	DynamicKey Get(const char* name, std::size_t size, uint32_t hash)
+	{
+		DynamicArena* pArena{ ScopedDynamicArena::GetCurrentArena() };
+		uint64_t arenaId{ pArena != nullptr ? pArena->GetId() : 0 };
+		Slot& slot{ m_slots[hash & (c_size - 1)] };
+		// Key of another arena may be freed already, so it is not read.
+		if (slot.arenaId != arenaId || slot.key.IsEmpty() || slot.key.GetHash() != hash
+			|| slot.key.GetName().size() != size || std::memcmp(slot.key.GetName().data(), name, size) != 0)
+		{
+			slot.key = DynamicKeyTable::GetInstance().Find(name, size, hash);
+			if (slot.key.IsEmpty())
+			{
+				slot.key = DynamicKeyTable::CreateUninterned(name, size, hash);
+			}
+			slot.arenaId = arenaId;
+		}
+		return slot.key;
+	}
 
-inline Dynamic::Dynamic(std::initializer_list<ValueMap::Object> initlist)
-	: m_type(ValueMap::Type::Array),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Array>>(initlist) }
-{
-}
+private:
+	static constexpr std::size_t c_size{ 256 };
 
-inline Dynamic::Dynamic(std::initializer_list<std::pair<ValueMap::String, ValueMap::Object>> initlist)
-	: m_type(ValueMap::Type::Object),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Object>>(initlist) }
-{
-}
+	struct Slot
+	{
+		DynamicKey key;
+		uint64_t arenaId{ 0 };
+	};
 
-inline Dynamic::Dynamic(const ValueMap::String& stringValue)
-	: m_type(ValueMap::Type::String),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::String>>(stringValue) }
-{
-}
+	Slot m_slots[c_size];
+};
 
-inline Dynamic::Dynamic(const char* charValue)
-	: m_type(ValueMap::Type::String),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::String>>(charValue?std::string(charValue):std::string()) }
+class IDynamicData
 {
-}
+public:
+	friend class Dynamic;
+	IDynamicData() noexcept
+		: m_refCount{ 0 }, m_refCountPolicy{ ScopedRefCountPolicy::GetCurrentPolicy() },
+		m_pMemoryResource{ ScopedDynamicArena::GetCurrentMemoryResource() }, m_hash{ 0 }
+	{
+	}
 
-inline Dynamic::Dynamic(const ValueMap::Bool boolValue)
-	: m_type(ValueMap::Type::Bool),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Bool>>(boolValue) }
-{
-}
+	// Clone keeps policy and memory of source, but never its references.
+	IDynamicData(const IDynamicData& other) noexcept
+		: m_refCount{ 0 }, m_refCountPolicy{ other.m_refCountPolicy },
+		m_pMemoryResource{ other.m_pMemoryResource }, m_hash{ 0 }
+	{
+	}
 
-inline Dynamic::Dynamic(const ValueMap::Int32 int32Value)
-	: m_type(ValueMap::Type::Int32),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Int32>>(int32Value) }
-{
-}
+	IDynamicData& operator=(const IDynamicData&) = delete;
 
-inline Dynamic::Dynamic(const ValueMap::Int64 int64Value)
-	: m_type(ValueMap::Type::Int64),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Int64>>(int64Value) }
-{
-}
+	virtual ~IDynamicData()
+	{
+	}
 
-inline Dynamic::Dynamic(const ValueMap::Double doubleValue)
-	: m_type(ValueMap::Type::Int64),
-	m_spDynamicData{ std::make_shared<DynamicData<ValueMap::Type::Double>>(doubleValue) }
-{
-}
+	virtual ValueMap::Type GetType() const noexcept = 0;
 
-inline ValueMap::Array& Dynamic::GetArray()
-{
-	return m_spDynamicData->GetArray();
-}
+	// Shallow copy, children are shared with the source node.
+	virtual IDynamicData* Clone() const = 0;
 
-inline ValueMap::Bool Dynamic::GetBool() const
-{
-	return m_spDynamicData->GetBool();
-}
+	RefCountPolicy GetRefCountPolicy() const noexcept
+	{
+		return m_refCountPolicy;
+	}
 
-inline ValueMap::Int32 Dynamic::GetInt32() const
-{
-	return m_spDynamicData->GetInt32();
-}
+	// Allocate from arena of current thread, or heap if there is none.
+	template<typename TData, typename... TArgs>
+	static TData* Create(TArgs&&... args)
+	{
+		return Allocate<TData>(ScopedDynamicArena::GetCurrentMemoryResource(), std::forward<TArgs>(args)...);
+	}
 
-inline ValueMap::Int64 Dynamic::GetInt64() const
-{
-	return m_spDynamicData->GetInt64();
-}
+protected:
+	template<typename TData>
+	static TData* CloneData(const TData& data)
+	{
+		return Allocate<TData>(data.m_pMemoryResource, data);
+	}
 
-inline ValueMap::Double Dynamic::GetDouble() const
-{
-	return m_spDynamicData->GetDouble();
-}
+	std::pmr::polymorphic_allocator<std::byte> GetAllocator() const noexcept
+	{
+		return { m_pMemoryResource != nullptr ? m_pMemoryResource : std::pmr::get_default_resource() };
+	}
 
-inline const ValueMap::String& Dynamic::GetString() const
-{
-	return m_spDynamicData->GetString();
-}
+	void AddRef() noexcept
+	{
+		if (m_refCountPolicy == RefCountPolicy::SingleThreaded)
+		{
+			// Relaxed load and store don't emit interlocked instruction.
+			m_refCount.store(m_refCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		else
+		{
+			m_refCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
 
-inline ValueMap::Object& Dynamic::GetObject(const std::size_t index)
-{
-	return m_spDynamicData->GetObject(index);
-}
+	void Release() noexcept
+	{
+		if (m_refCountPolicy == RefCountPolicy::SingleThreaded)
+		{
+			uint32_t refCount{ m_refCount.load(std::memory_order_relaxed) - 1 };
+			m_refCount.store(refCount, std::memory_order_relaxed);
+			if (refCount == 0)
+			{
+				Destroy();
+			}
+		}
+		else if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Destroy();
+		}
+	}
 
-inline ValueMap::Object& Dynamic::GetObject(const ValueMap::String& propertyName)
-{
-	return m_spDynamicData->GetObject(propertyName);
-}
+	bool IsShared() const noexcept
+	{
+		return m_refCount.load(std::memory_order_acquire) > 1;
+	}
 
-inline bool Dynamic::operator==(const Dynamic& other)const
-{
-	if (this == &other)
+	// True if node views characters it doesn't own.
+	virtual bool IsBorrowed() const noexcept
 	{
-		return true;
+		return false;
 	}
 
-	IDynamicData::CompareResult result{ m_spDynamicData->Compare(other) };
-	return result != IDynamicData::CompareResult::Equal;
-}
+	// 0 means hash is not computed yet.
+	uint64_t GetCachedHash() const noexcept
+	{
+		return m_hash.load(std::memory_order_relaxed);
+	}
 
-inline bool Dynamic::operator()() const
-{
-	return m_spDynamicData->GetBool();
-}
+	void SetCachedHash(uint64_t hash) const noexcept
+	{
+		m_hash.store(hash, std::memory_order_relaxed);
+	}
 
-inline bool Dynamic::operator>(const Dynamic& other) const
-{
-	IDynamicData::CompareResult result{ m_spDynamicData->Compare(other) };
-	if (result == IDynamicData::CompareResult::NotComparable)
+	void InvalidateHash() noexcept
 	{
-		Error::ThrowCannotCompareErrorException();
+		m_hash.store(0, std::memory_order_relaxed);
 	}
 
-	return result == IDynamicData::CompareResult::Larger;
-}
+	virtual ValueMap::Array& GetArray()
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
 
-inline bool Dynamic::operator<(const Dynamic& other) const
-{
-	IDynamicData::CompareResult result{ m_spDynamicData->Compare(other) };
-	if (result == IDynamicData::CompareResult::NotComparable)
+	virtual const ValueMap::Array& GetArray() const
 	{
-		Error::ThrowCannotCompareErrorException();
+		Error::ThrowAcessDeniedErrorException();
 	}
 
-	return result == IDynamicData::CompareResult::Less;
-}
+	virtual ValueMap::Bool GetBool() const
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
 
-inline ValueMap::Object& Dynamic::operator[](const std::size_t index)
-{
-	if (GetType() != ValueMap::Type::Array)
+	virtual ValueMap::Int32 GetInt32() const
 	{
 		Error::ThrowAcessDeniedErrorException();
 	}
-	return m_spDynamicData->GetObject(index);
-}
 
-inline ValueMap::Object& Dynamic::operator[](const ValueMap::String propertyName)
-{
-	if (GetType() != ValueMap::Type::Object)
+	virtual ValueMap::Int64 GetInt64() const
 	{
 		Error::ThrowAcessDeniedErrorException();
 	}
-	return m_spDynamicData->GetObject(propertyName);
-}
 
-inline Dynamic& Dynamic::operator=(const Dynamic& other)
-{
-	m_type = other.GetType();
-	m_spDynamicData = other.m_spDynamicData;
-	return *this;
-}
-inline Dynamic& Dynamic::operator=(Dynamic&& other)
-{
-	m_type = other.GetType();
-	m_spDynamicData = other.m_spDynamicData;
+	virtual ValueMap::Double GetDouble() const
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual ValueMap::StringView GetString() const
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual ValueMap::Object& GetObject(const std::size_t index)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual ValueMap::Object& GetObject(const ValueMap::String& propertyName)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual const ValueMap::Object& GetObject(const std::size_t index) const
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual const ValueMap::Object& GetObject(const ValueMap::String& propertyName) const
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual ValueMap::ObjectMap& GetObjectMap()
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual const ValueMap::ObjectMap& GetObjectMap() const
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+
+	virtual ValueMap::Object& GetEmptyObject() noexcept
+	{
+		return m_emptyObject;
+	}
+
+	static const ValueMap::Object& GetNullObject() noexcept
+	{
+		static const ValueMap::Object nullObject;
+		return nullObject;
+	}
+private:
+	template<typename TData, typename... TArgs>
+	static TData* Allocate(std::pmr::memory_resource* pMemoryResource, TArgs&&... args)
+	{
+		if (pMemoryResource == nullptr)
+		{
+			return new TData(std::forward<TArgs>(args)...);
+		}
+		void* pData{ pMemoryResource->allocate(sizeof(TData), alignof(TData)) };
+		return ::new (pData) TData(std::forward<TArgs>(args)...);
+	}
+
+	void Destroy() noexcept
+	{
+		// Arena data is reclaimed together with its arena.
+		if (m_pMemoryResource == nullptr)
+		{
+			delete this;
+		}
+	}
+
+	ValueMap::Object m_emptyObject;
+	std::atomic<uint32_t> m_refCount;
+	const RefCountPolicy m_refCountPolicy;
+	std::pmr::memory_resource* const m_pMemoryResource;
+	mutable std::atomic<uint64_t> m_hash;
+};
+
+template<enum class ValueMap::Type>
+class DynamicData : public IDynamicData
+{
+};
+
+template<>
+class DynamicData<ValueMap::Type::Array> : public IDynamicData
+{
+public:
+	DynamicData(ValueMap::Array&& arrayValue)
+		: m_array(std::move(arrayValue), GetAllocator())
+	{
+	}
+
+	DynamicData(std::initializer_list<ValueMap::Object> initlist)
+		: m_array(initlist, GetAllocator())
+	{
+	}
+
+	DynamicData(const DynamicData& other)
+		: IDynamicData(other), m_array(other.m_array, GetAllocator())
+	{
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Array;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::Object& GetObject(std::size_t index) noexcept override
+	{
+		if (index >= m_array.size())
+		{
+			return GetEmptyObject();
+		}
+		return m_array[index];
+	}
+
+	const ValueMap::Object& GetObject(std::size_t index) const noexcept override
+	{
+		if (index >= m_array.size())
+		{
+			return GetNullObject();
+		}
+		return m_array[index];
+	}
+
+	ValueMap::Array& GetArray() override
+	{
+		return m_array;
+	}
+
+	const ValueMap::Array& GetArray() const override
+	{
+		return m_array;
+	}
+private:
+	ValueMap::Array m_array;
+};
+
+template<>
+class DynamicData<ValueMap::Type::Object> : public IDynamicData
+{
+public:
+	DynamicData()
+		: m_objectMap(GetAllocator().resource())
+	{
+	}
+
+	DynamicData(std::initializer_list<std::pair<ValueMap::String, ValueMap::Object>> initlist)
+		: m_objectMap(initlist, GetAllocator().resource())
+	{
+	}
+
+	DynamicData(const DynamicData& other)
+		: IDynamicData(other), m_objectMap(other.m_objectMap, GetAllocator().resource())
+	{
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Object;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::Object& GetObject(const ValueMap::String& propertyName) override
+	{
+		ValueMap::Object* pObject{ m_objectMap.Find(propertyName) };
+		if (pObject == nullptr)
+		{
+			return GetEmptyObject();
+		}
+		return *pObject;
+	}
+
+	const ValueMap::Object& GetObject(const ValueMap::String& propertyName) const override
+	{
+		const ValueMap::Object* pObject{ m_objectMap.Find(propertyName) };
+		if (pObject == nullptr)
+		{
+			return GetNullObject();
+		}
+		return *pObject;
+	}
+
+	ValueMap::ObjectMap& GetObjectMap() override
+	{
+		return m_objectMap;
+	}
+
+	const ValueMap::ObjectMap& GetObjectMap() const override
+	{
+		return m_objectMap;
+	}
+private:
+	ValueMap::ObjectMap m_objectMap;
+};
+
+template<>
+class DynamicData<ValueMap::Type::Bool> : public IDynamicData
+{
+public:
+	DynamicData(ValueMap::Bool boolValue)
+		: m_bool(boolValue)
+	{
+	}
+
+	// Non virtual read for callers which already know the type.
+	ValueMap::Bool GetValue() const noexcept
+	{
+		return m_bool;
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Bool;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::Bool GetBool() const override
+	{
+		return m_bool;
+	}
+private:
+	ValueMap::Bool m_bool;
+};
+
+template<>
+class DynamicData<ValueMap::Type::Int32> : public IDynamicData
+{
+public:
+	DynamicData(ValueMap::Int32 int32Value)
+		: m_int32(int32Value)
+	{
+	}
+
+	// Non virtual read for callers which already know the type.
+	ValueMap::Int32 GetValue() const noexcept
+	{
+		return m_int32;
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Int32;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::Int32 GetInt32() const override
+	{
+		return m_int32;
+	}
+
+	ValueMap::Int64 GetInt64() const override
+	{
+		return static_cast<ValueMap::Int64>(GetInt32());
+	}
+
+	ValueMap::Double GetDouble() const override
+	{
+		return static_cast<ValueMap::Double>(GetInt32());
+	}
+private:
+	ValueMap::Int32 m_int32;
+};
+
+template<>
+class DynamicData<ValueMap::Type::Int64> : public IDynamicData
+{
+public:
+	DynamicData(ValueMap::Int64 int64Value)
+		: m_int64(int64Value)
+	{
+	}
+
+	// Non virtual read for callers which already know the type.
+	ValueMap::Int64 GetValue() const noexcept
+	{
+		return m_int64;
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Int64;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::Int64 GetInt64() const override
+	{
+		return m_int64;
+	}
+
+	ValueMap::Int32 GetInt32() const override
+	{
+		if (m_int64 > static_cast<ValueMap::Int64>(std::numeric_limits<ValueMap::Int32>::max()))
+		{
+			return std::numeric_limits<ValueMap::Int32>::max();
+		}
+
+		if (m_int64 < static_cast<ValueMap::Int64>(std::numeric_limits<ValueMap::Int32>::min()))
+		{
+			return std::numeric_limits<ValueMap::Int32>::min();
+		}
+
+		return static_cast<ValueMap::Int32>(m_int64);
+	}
+
+	ValueMap::Double GetDouble() const override
+	{
+		return static_cast<ValueMap::Double>(m_int64);
+	}
+private:
+	ValueMap::Int64 m_int64;
+};
+
+template<>
+class DynamicData<ValueMap::Type::Double> : public IDynamicData
+{
+public:
+	DynamicData(ValueMap::Double doubleValue)
+		: m_double(doubleValue)
+	{
+	}
+
+	// Non virtual read for callers which already know the type.
+	ValueMap::Double GetValue() const noexcept
+	{
+		return m_double;
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Double;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::Int64 GetInt64() const override
+	{
+		return static_cast<ValueMap::Int64>(m_double);
+	}
+
+	ValueMap::Int32 GetInt32() const override
+	{
+		return static_cast<ValueMap::Int32>(m_double);
+	}
+
+
+	ValueMap::Double GetDouble() const override
+	{
+		return m_double;
+	}
+private:
+	ValueMap::Double m_double;
+};
+
+template<>
+class DynamicData<ValueMap::Type::String> : public IDynamicData
+{
+public:
+	DynamicData(const ValueMap::StringView stringValue)
+		: m_string(stringValue, GetAllocator())
+	{
+	}
+
+	DynamicData(const DynamicData& other)
+		: IDynamicData(other), m_string(other.m_string, GetAllocator())
+	{
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::String;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+protected:
+	ValueMap::StringView GetString() const override
+	{
+		return m_string;
+	}
+private:
+	std::pmr::string m_string;
+};
+
+// String node of MakeBorrowedString, it doesn't own the characters.
+class DynamicStringView : public IDynamicData
+{
+public:
+	DynamicStringView(const ValueMap::StringView stringValue) noexcept
+		: m_string{ stringValue }
+	{
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::String;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+	bool IsBorrowed() const noexcept override
+	{
+		return true;
+	}
+
+protected:
+	ValueMap::StringView GetString() const override
+	{
+		return m_string;
+	}
+private:
+	ValueMap::StringView m_string;
+};
+
+// String node of MakeBorrowedString with decoder, decoded once by the first reader.
+class DynamicDecodedStringView : public IDynamicData
+{
+public:
+	DynamicDecodedStringView(const ValueMap::StringView source, Dynamic::StringDecoder decoder) noexcept
+		: m_source{ source }, m_decoder{ decoder }, m_string(GetAllocator())
+	{
+	}
+
+	// Clone decodes again, once flag can't be copied.
+	DynamicDecodedStringView(const DynamicDecodedStringView& other) noexcept
+		: IDynamicData(other), m_source{ other.m_source }, m_decoder{ other.m_decoder }, m_string(GetAllocator())
+	{
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::String;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+
+	bool IsBorrowed() const noexcept override
+	{
+		return true;
+	}
+
+protected:
+	ValueMap::StringView GetString() const override
+	{
+		std::call_once(m_decodeFlag, [this]() { m_decoder(m_source, m_string); });
+		return m_string;
+	}
+private:
+	ValueMap::StringView m_source;
+	Dynamic::StringDecoder m_decoder;
+	mutable std::once_flag m_decodeFlag;
+	// Arena nodes are never destructed, so decoded characters must come from the arena too.
+	mutable std::pmr::string m_string;
+};
+
+template<>
+class DynamicData<ValueMap::Type::Null> : public IDynamicData
+{
+public:
+	DynamicData()
+	{
+	}
+
+	ValueMap::Type GetType() const noexcept override
+	{
+		return ValueMap::Type::Null;
+	}
+
+	IDynamicData* Clone() const override
+	{
+		return CloneData(*this);
+	}
+};
+
+
+inline Dynamic::Dynamic()
+	: m_type(ValueMap::Type::Null), m_pDynamicData{ nullptr }
+{
+}
+
+inline Dynamic::Dynamic(IDynamicData* pDynamicData) noexcept
+	: m_type(pDynamicData->GetType()), m_pDynamicData{ pDynamicData }
+{
+	m_pDynamicData->AddRef();
+}
+
+inline Dynamic::~Dynamic()
+{
+	if (m_pDynamicData != nullptr)
+	{
+		m_pDynamicData->Release();
+	}
+}
+
+inline Dynamic::Dynamic(Dynamic&& dynamicValue)
+	: m_type(dynamicValue.GetType()),
+	m_pDynamicData{ dynamicValue.m_pDynamicData }
+{
+	dynamicValue.m_type = ValueMap::Type::Null;
+	dynamicValue.m_pDynamicData = nullptr;
+}
+
+inline Dynamic::Dynamic(const Dynamic& dynamicValue)
+	: m_type(dynamicValue.GetType()),
+	m_pDynamicData{ dynamicValue.m_pDynamicData }
+{
+	if (m_pDynamicData != nullptr)
+	{
+		m_pDynamicData->AddRef();
+	}
+}
+
+inline Dynamic::Dynamic(ValueMap::Array&& arrayValue)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Array>>(std::move(arrayValue)))
+{
+}
+
+inline Dynamic::Dynamic(std::initializer_list<ValueMap::Object> initlist)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Array>>(initlist))
+{
+}
+
+inline Dynamic::Dynamic(std::initializer_list<std::pair<ValueMap::String, ValueMap::Object>> initlist)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Object>>(initlist))
+{
+}
+
+inline Dynamic::Dynamic(const ValueMap::String& stringValue)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::String>>(ValueMap::StringView{ stringValue }))
+{
+}
+
+inline Dynamic::Dynamic(const ValueMap::StringView stringValue)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::String>>(stringValue))
+{
+}
+
+inline Dynamic::Dynamic(const char* charValue)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::String>>(charValue ? ValueMap::StringView{ charValue } : ValueMap::StringView{}))
+{
+}
+
+inline Dynamic::Dynamic(const ValueMap::Bool boolValue)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Bool>>(boolValue))
+{
+}
+
+inline Dynamic::Dynamic(const ValueMap::Int32 int32Value)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Int32>>(int32Value))
+{
+}
+
+inline Dynamic::Dynamic(const ValueMap::Int64 int64Value)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Int64>>(int64Value))
+{
+}
+
+inline Dynamic::Dynamic(const ValueMap::Double doubleValue)
+	: Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Double>>(doubleValue))
+{
+}
+
+inline Dynamic Dynamic::MakeObject()
+{
+	return Dynamic(IDynamicData::Create<DynamicData<ValueMap::Type::Object>>());
+}
+
+inline Dynamic Dynamic::MakeBorrowedString(const ValueMap::StringView stringValue)
+{
+	return Dynamic(IDynamicData::Create<DynamicStringView>(stringValue));
+}
+
+inline Dynamic Dynamic::MakeBorrowedString(const ValueMap::StringView source, StringDecoder decoder)
+{
+	return Dynamic(IDynamicData::Create<DynamicDecodedStringView>(source, decoder));
+}
+
+inline Dynamic Dynamic::MakeOwned(const Dynamic& value)
+{
+	switch (value.GetType())
+	{
+		case ValueMap::Type::String:
+			return value.m_pDynamicData->IsBorrowed() ? Dynamic(value.GetString()) : value;
+		case ValueMap::Type::Object:
+		{
+			// Owned shares node with value until first changed child, then it is cloned.
+			Dynamic owned = value;
+			for (const auto& entry : value.GetObjectMap())
+			{
+				Dynamic child = MakeOwned(entry.second);
+				if (!child.IsSameNode(entry.second))
+				{
+					owned.GetObjectMap().Set(entry.first, std::move(child));
+				}
+			}
+			return owned;
+		}
+		case ValueMap::Type::Array:
+		{
+			Dynamic owned = value;
+			const ValueMap::Array& array{ value.GetArray() };
+			for (std::size_t i = 0; i < array.size(); ++i)
+			{
+				Dynamic child = MakeOwned(array[i]);
+				if (!child.IsSameNode(array[i]))
+				{
+					owned.GetArray()[i] = std::move(child);
+				}
+			}
+			return owned;
+		}
+		default:
+			return value;
+	}
+}
+
+inline void Dynamic::Detach()
+{
+	if (m_pDynamicData == nullptr)
+	{
+		return;
+	}
+
+	if (m_pDynamicData->IsShared())
+	{
+		IDynamicData* pClone{ m_pDynamicData->Clone() };
+		pClone->AddRef();
+		m_pDynamicData->Release();
+		m_pDynamicData = pClone;
+	}
+	else
+	{
+		m_pDynamicData->InvalidateHash();
+	}
+}
+
+inline bool Dynamic::IsShared() const noexcept
+{
+	return m_pDynamicData != nullptr && m_pDynamicData->IsShared();
+}
+
+inline bool Dynamic::IsSameNode(const Dynamic& other) const noexcept
+{
+	return m_pDynamicData == other.m_pDynamicData && m_type == other.m_type;
+}
+
+inline ValueMap::Array& Dynamic::GetArray()
+{
+	Detach();
+	return m_pDynamicData->GetArray();
+}
+
+inline const ValueMap::Array& Dynamic::GetArray() const
+{
+	return static_cast<const IDynamicData*>(m_pDynamicData)->GetArray();
+}
+
+inline ValueMap::Bool Dynamic::GetBool() const
+{
+	return m_pDynamicData->GetBool();
+}
+
+inline ValueMap::Int32 Dynamic::GetInt32() const
+{
+	return m_pDynamicData->GetInt32();
+}
+
+inline ValueMap::Int64 Dynamic::GetInt64() const
+{
+	return m_pDynamicData->GetInt64();
+}
+
+inline ValueMap::Double Dynamic::GetDouble() const
+{
+	return m_pDynamicData->GetDouble();
+}
+
+inline ValueMap::StringView Dynamic::GetString() const
+{
+	return m_pDynamicData->GetString();
+}
+
+inline ValueMap::Object& Dynamic::GetObject(const std::size_t index)
+{
+	Detach();
+	return m_pDynamicData->GetObject(index);
+}
+
+inline ValueMap::Object& Dynamic::GetObject(const ValueMap::String& propertyName)
+{
+	Detach();
+	return m_pDynamicData->GetObject(propertyName);
+}
+
+inline const ValueMap::Object& Dynamic::GetObject(const std::size_t index) const
+{
+	return static_cast<const IDynamicData*>(m_pDynamicData)->GetObject(index);
+}
+
+inline const ValueMap::Object& Dynamic::GetObject(const ValueMap::String& propertyName) const
+{
+	return static_cast<const IDynamicData*>(m_pDynamicData)->GetObject(propertyName);
+}
+
+inline ValueMap::Object& Dynamic::GetObject(const DynamicKey& propertyKey)
+{
+	ValueMap::Object* pObject{ GetObjectMap().Find(propertyKey) };
+	return pObject != nullptr ? *pObject : m_pDynamicData->GetEmptyObject();
+}
+
+inline const ValueMap::Object& Dynamic::GetObject(const DynamicKey& propertyKey) const
+{
+	const ValueMap::Object* pObject{ GetObjectMap().Find(propertyKey) };
+	return pObject != nullptr ? *pObject : IDynamicData::GetNullObject();
+}
+
+inline ValueMap::ObjectMap& Dynamic::GetObjectMap()
+{
+	if (GetType() != ValueMap::Type::Object)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	Detach();
+	return m_pDynamicData->GetObjectMap();
+}
+
+inline const ValueMap::ObjectMap& Dynamic::GetObjectMap() const
+{
+	if (GetType() != ValueMap::Type::Object)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return static_cast<const IDynamicData*>(m_pDynamicData)->GetObjectMap();
+}
+
+inline ValueMap::Object& Dynamic::SetObject(const ValueMap::String& propertyName, ValueMap::Object value)
+{
+	return GetObjectMap().Set(propertyName, std::move(value));
+}
+
+inline ValueMap::Object& Dynamic::SetObject(const DynamicKey& propertyKey, ValueMap::Object value)
+{
+	return GetObjectMap().Set(propertyKey, std::move(value));
+}
+
+inline bool Dynamic::RemoveObject(const ValueMap::String& propertyName)
+{
+	return GetObjectMap().Erase(propertyName);
+}
+
+inline bool Dynamic::RemoveObject(const DynamicKey& propertyKey)
+{
+	return GetObjectMap().Erase(propertyKey);
+}
+
+inline bool Dynamic::IsNumber(ValueMap::Type type) noexcept
+{
+	return type == ValueMap::Type::Int32 || type == ValueMap::Type::Int64 || type == ValueMap::Type::Double;
+}
+
+inline bool Dynamic::NumberEquals(const Dynamic& left, const Dynamic& right)
+{
+	bool isLeftDouble{ left.GetType() == ValueMap::Type::Double };
+	bool isRightDouble{ right.GetType() == ValueMap::Type::Double };
+	if (!isLeftDouble && !isRightDouble)
+	{
+		return left.GetInt64() == right.GetInt64();
+	}
+	if (isLeftDouble && isRightDouble)
+	{
+		return left.GetDouble() == right.GetDouble();
+	}
+
+	// Compare integer with double exactly, without rounding integer to double.
+	ValueMap::Double doubleValue{ isLeftDouble ? left.GetDouble() : right.GetDouble() };
+	ValueMap::Int64 int64Value{ isLeftDouble ? right.GetInt64() : left.GetInt64() };
+	if (!(doubleValue >= -9223372036854775808.0 && doubleValue < 9223372036854775808.0))
+	{
+		return false;
+	}
+	ValueMap::Int64 truncated{ static_cast<ValueMap::Int64>(doubleValue) };
+	return static_cast<ValueMap::Double>(truncated) == doubleValue && truncated == int64Value;
+}
+
+inline bool Dynamic::operator==(const Dynamic& other)const
+{
+	// Same node, or both null.
+	if (m_pDynamicData == other.m_pDynamicData)
+	{
+		return true;
+	}
+
+	if (IsNumber(m_type) && IsNumber(other.m_type))
+	{
+		return NumberEquals(*this, other);
+	}
+
+	if (m_type != other.m_type)
+	{
+		return false;
+	}
+
+	if (m_type == ValueMap::Type::Null)
+	{
+		return true;
+	}
+
+	switch (m_type)
+	{
+		case ValueMap::Type::Bool:
+			return GetBool() == other.GetBool();
+		case ValueMap::Type::String:
+			return GetString() == other.GetString();
+		case ValueMap::Type::Array:
+		{
+			const ValueMap::Array& array{ GetArray() };
+			const ValueMap::Array& otherArray{ other.GetArray() };
+			if (array.size() != otherArray.size())
+			{
+				return false;
+			}
+			for (std::size_t i = 0; i < array.size(); ++i)
+			{
+				if (!(array[i] == otherArray[i]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		case ValueMap::Type::Object:
+		{
+			const ValueMap::ObjectMap& objectMap{ GetObjectMap() };
+			const ValueMap::ObjectMap& otherObjectMap{ other.GetObjectMap() };
+			if (objectMap.Size() != otherObjectMap.Size())
+			{
+				return false;
+			}
+			for (const auto& entry : objectMap)
+			{
+				const ValueMap::Object* pOther{ otherObjectMap.Find(entry.first) };
+				if (pOther == nullptr || !(entry.second == *pOther))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+inline bool Dynamic::operator!=(const Dynamic& other)const
+{
+	return !(*this == other);
+}
+
+inline uint64_t Dynamic::Hash() const
+{
+	if (m_pDynamicData == nullptr)
+	{
+		return ComputeHash();
+	}
+
+	uint64_t hash{ m_pDynamicData->GetCachedHash() };
+	if (hash == 0)
+	{
+		hash = ComputeHash();
+		// 0 is reserved for hash which is not computed.
+		hash = hash != 0 ? hash : 1;
+		m_pDynamicData->SetCachedHash(hash);
+	}
+	return hash;
+}
+
+inline uint64_t Dynamic::ComputeHash() const
+{
+	const uint64_t typeSeed{ Lib::Hash::Mix(static_cast<uint64_t>(m_type) + 1) };
+	switch (m_type)
+	{
+		case ValueMap::Type::Bool:
+			return Lib::Hash::Combine(typeSeed, GetBool() ? 1 : 0);
+		case ValueMap::Type::Int32:
+		case ValueMap::Type::Int64:
+			// Numbers share one seed, since 1 and 1.0 are equal.
+			return Lib::Hash::Combine(Lib::Hash::Mix(static_cast<uint64_t>(ValueMap::Type::Int64) + 1), static_cast<uint64_t>(GetInt64()));
+		case ValueMap::Type::Double:
+		{
+			ValueMap::Double value{ GetDouble() };
+			if (value >= -9223372036854775808.0 && value < 9223372036854775808.0
+				&& static_cast<ValueMap::Double>(static_cast<ValueMap::Int64>(value)) == value)
+			{
+				return Lib::Hash::Combine(Lib::Hash::Mix(static_cast<uint64_t>(ValueMap::Type::Int64) + 1), static_cast<uint64_t>(static_cast<ValueMap::Int64>(value)));
+			}
+			uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return Lib::Hash::Combine(typeSeed, bits);
+		}
+		case ValueMap::Type::String:
+		{
+			ValueMap::StringView value{ GetString() };
+			return Lib::Hash::HashBytes(value.data(), value.size(), typeSeed);
+		}
+		case ValueMap::Type::Array:
+		{
+			uint64_t hash{ typeSeed };
+			for (const Dynamic& element : GetArray())
+			{
+				hash = Lib::Hash::Combine(hash, element.Hash());
+			}
+			return hash;
+		}
+		case ValueMap::Type::Object:
+		{
+			// Sum is commutative, so property order doesn't matter.
+			const ValueMap::ObjectMap& objectMap{ GetObjectMap() };
+			uint64_t sum{ 0 };
+			for (const auto& entry : objectMap)
+			{
+				sum += Lib::Hash::Combine(entry.first.GetHash(), entry.second.Hash());
+			}
+			return Lib::Hash::Combine(typeSeed, sum + objectMap.Size());
+		}
+		default:
+			return typeSeed;
+	}
+}
+
+inline bool Dynamic::operator()() const
+{
+	return m_pDynamicData->GetBool();
+}
+
+inline bool Dynamic::operator>(const Dynamic& other) const
+{
+	return Compare(*this, other) > 0;
+}
+
+inline bool Dynamic::operator<(const Dynamic& other) const
+{
+	return Compare(*this, other) < 0;
+}
+
+inline bool Dynamic::operator>=(const Dynamic& other) const
+{
+	return Compare(*this, other) >= 0;
+}
+
+inline bool Dynamic::operator<=(const Dynamic& other) const
+{
+	return Compare(*this, other) <= 0;
+}
+
+inline ValueMap::Object& Dynamic::operator[](const std::size_t index)
+{
+	if (GetType() != ValueMap::Type::Array)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	Detach();
+	return m_pDynamicData->GetObject(index);
+}
+
+inline ValueMap::Object& Dynamic::operator[](const ValueMap::String& propertyName)
+{
+	if (GetType() != ValueMap::Type::Object)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	Detach();
+	return m_pDynamicData->GetObject(propertyName);
+}
+
+inline const ValueMap::Object& Dynamic::operator[](const std::size_t index) const
+{
+	if (GetType() != ValueMap::Type::Array)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return static_cast<const IDynamicData*>(m_pDynamicData)->GetObject(index);
+}
+
+inline const ValueMap::Object& Dynamic::operator[](const ValueMap::String& propertyName) const
+{
+	if (GetType() != ValueMap::Type::Object)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return static_cast<const IDynamicData*>(m_pDynamicData)->GetObject(propertyName);
+}
+
+inline ValueMap::Object& Dynamic::operator[](const DynamicKey& propertyKey)
+{
+	return GetObject(propertyKey);
+}
+
+inline const ValueMap::Object& Dynamic::operator[](const DynamicKey& propertyKey) const
+{
+	return GetObject(propertyKey);
+}
+
+inline Dynamic& Dynamic::operator=(const Dynamic& other)
+{
+	// AddRef before Release, so self assignment is safe.
+	if (other.m_pDynamicData != nullptr)
+	{
+		other.m_pDynamicData->AddRef();
+	}
+	if (m_pDynamicData != nullptr)
+	{
+		m_pDynamicData->Release();
+	}
+	m_type = other.GetType();
+	m_pDynamicData = other.m_pDynamicData;
+	return *this;
+}
+inline Dynamic& Dynamic::operator=(Dynamic&& other)
+{
+	std::swap(m_type, other.m_type);
+	std::swap(m_pDynamicData, other.m_pDynamicData);
 	return *this;
 }
 
@@ -789,5 +2158,321 @@ inline ValueMap::Type Dynamic::GetType() const noexcept
 	return m_type;
 }
 
+inline Dynamic DynamicArena::Copy(const Dynamic& value)
+{
+	ScopedDynamicArena scope{ *this };
+	DynamicKeyCache keyCache;
+	return CopyValue(value, keyCache);
+}
+
+inline Dynamic DynamicArena::CopyValue(const Dynamic& value, DynamicKeyCache& keyCache)
+{
+	switch (value.GetType())
+	{
+		case ValueMap::Type::Object:
+		{
+			const ValueMap::ObjectMap& objectMap{ value.GetObjectMap() };
+			Dynamic object = Dynamic::MakeObject();
+			ValueMap::ObjectMap& copyMap{ object.GetObjectMap() };
+			copyMap.Reserve(objectMap.Size());
+			for (const auto& entry : objectMap)
+			{
+				// Arena maps never release their keys, so only interned ones are shared.
+				const ValueMap::String& name{ entry.first.GetName() };
+				copyMap.Set(entry.first.IsInterned() ? entry.first : keyCache.Get(name.data(), name.size()), CopyValue(entry.second, keyCache));
+			}
+			return object;
+		}
+		case ValueMap::Type::Array:
+		{
+			const ValueMap::Array& array{ value.GetArray() };
+			ValueMap::Array copyArray(ScopedDynamicArena::GetCurrentMemoryResource());
+			copyArray.reserve(array.size());
+			for (const Dynamic& element : array)
+			{
+				copyArray.push_back(CopyValue(element, keyCache));
+			}
+			return Dynamic(std::move(copyArray));
+		}
+		case ValueMap::Type::Bool:
+			return Dynamic(value.GetBool());
+		case ValueMap::Type::Int32:
+			return Dynamic(value.GetInt32());
+		case ValueMap::Type::Int64:
+			return Dynamic(value.GetInt64());
+		case ValueMap::Type::Double:
+			return Dynamic(value.GetDouble());
+		case ValueMap::Type::String:
+			return Dynamic(value.GetString());
+		default:
+			return Dynamic();
+	}
+}
+
+/*! Comparison of Dynamic values dispatched by a flat table indexed by both types.
+	One indirect call selects the comparison and values are read without virtual getters.
+*/
+class DynamicOrdering
+{
+	// Defined first, since its return type is deduced.
+	template<ValueMap::Type type>
+	static auto Read(const Dynamic& value) noexcept
+	{
+		return static_cast<const DynamicData<type>*>(value.m_pDynamicData)->GetValue();
+	}
+
+public:
+	static int Compare(const Dynamic& left, const Dynamic& right)
+	{
+		// Same node, or both null.
+		if (left.m_pDynamicData == right.m_pDynamicData)
+		{
+			return 0;
+		}
+		return c_compareTable[ToIndex(left.m_type)][ToIndex(right.m_type)](left, right);
+	}
+
+	// Numbers share one rank, so they are ordered by value.
+	static int GetTypeRank(ValueMap::Type type) noexcept
+	{
+		switch (type)
+		{
+			case ValueMap::Type::Null:
+				return 0;
+			case ValueMap::Type::Bool:
+				return 1;
+			case ValueMap::Type::Int32:
+			case ValueMap::Type::Int64:
+			case ValueMap::Type::Double:
+				return 2;
+			case ValueMap::Type::String:
+				return 3;
+			case ValueMap::Type::Array:
+				return 4;
+			default:
+				return 5;
+		}
+	}
+
+	// Value must be Int32 or Int64.
+	static ValueMap::Int64 ReadInteger(const Dynamic& value) noexcept
+	{
+		if (value.m_type == ValueMap::Type::Int32)
+		{
+			return Read<ValueMap::Type::Int32>(value);
+		}
+		return Read<ValueMap::Type::Int64>(value);
+	}
+
+	// Value must be Double.
+	static ValueMap::Double ReadDouble(const Dynamic& value) noexcept
+	{
+		return Read<ValueMap::Type::Double>(value);
+	}
+
+	static int CompareDoubles(ValueMap::Double left, ValueMap::Double right) noexcept
+	{
+		bool isLeftNan{ left != left };
+		bool isRightNan{ right != right };
+		if (isLeftNan || isRightNan)
+		{
+			return static_cast<int>(isLeftNan) - static_cast<int>(isRightNan);
+		}
+		return left < right ? -1 : (left > right ? 1 : 0);
+	}
+
+	// Exact, integer is not rounded to double.
+	static int CompareIntegerDouble(ValueMap::Int64 left, ValueMap::Double right) noexcept
+	{
+		if (right != right || right >= 9223372036854775808.0)
+		{
+			return -1;
+		}
+		if (right < -9223372036854775808.0)
+		{
+			return 1;
+		}
+
+		ValueMap::Int64 truncated{ static_cast<ValueMap::Int64>(right) };
+		if (left != truncated)
+		{
+			return left < truncated ? -1 : 1;
+		}
+		ValueMap::Double fraction{ right - static_cast<ValueMap::Double>(truncated) };
+		return fraction > 0 ? -1 : (fraction < 0 ? 1 : 0);
+	}
+
+private:
+	using CompareFunction = int(*)(const Dynamic&, const Dynamic&);
+
+	static constexpr std::size_t c_typeCount{ static_cast<std::size_t>(ValueMap::Type::String) + 1 };
+
+	static constexpr std::size_t ToIndex(ValueMap::Type type) noexcept
+	{
+		return static_cast<std::size_t>(type);
+	}
+
+	static int CompareRank(const Dynamic& left, const Dynamic& right)
+	{
+		return GetTypeRank(left.m_type) < GetTypeRank(right.m_type) ? -1 : 1;
+	}
+
+	static int CompareNull(const Dynamic&, const Dynamic&)
+	{
+		return 0;
+	}
+
+	static int CompareBool(const Dynamic& left, const Dynamic& right)
+	{
+		return static_cast<int>(Read<ValueMap::Type::Bool>(left)) - static_cast<int>(Read<ValueMap::Type::Bool>(right));
+	}
+
+	template<ValueMap::Type leftType, ValueMap::Type rightType>
+	static int CompareInteger(const Dynamic& left, const Dynamic& right)
+	{
+		ValueMap::Int64 leftValue{ Read<leftType>(left) };
+		ValueMap::Int64 rightValue{ Read<rightType>(right) };
+		return leftValue < rightValue ? -1 : (leftValue > rightValue ? 1 : 0);
+	}
+
+	template<ValueMap::Type leftType>
+	static int CompareIntegerDouble(const Dynamic& left, const Dynamic& right)
+	{
+		return CompareIntegerDouble(Read<leftType>(left), Read<ValueMap::Type::Double>(right));
+	}
+
+	template<ValueMap::Type rightType>
+	static int CompareDoubleInteger(const Dynamic& left, const Dynamic& right)
+	{
+		return -CompareIntegerDouble(Read<rightType>(right), Read<ValueMap::Type::Double>(left));
+	}
+
+	static int CompareDouble(const Dynamic& left, const Dynamic& right)
+	{
+		return CompareDoubles(Read<ValueMap::Type::Double>(left), Read<ValueMap::Type::Double>(right));
+	}
+
+	static int CompareString(const Dynamic& left, const Dynamic& right)
+	{
+		int result{ left.GetString().compare(right.GetString()) };
+		return result < 0 ? -1 : (result > 0 ? 1 : 0);
+	}
+
+	static int CompareArray(const Dynamic& left, const Dynamic& right)
+	{
+		const ValueMap::Array& leftArray{ left.GetArray() };
+		const ValueMap::Array& rightArray{ right.GetArray() };
+		std::size_t size{ std::min(leftArray.size(), rightArray.size()) };
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			int result{ Compare(leftArray[i], rightArray[i]) };
+			if (result != 0)
+			{
+				return result;
+			}
+		}
+		return leftArray.size() < rightArray.size() ? -1 : (leftArray.size() > rightArray.size() ? 1 : 0);
+	}
+
+	static int CompareObject(const Dynamic& left, const Dynamic& right)
+	{
+		const ValueMap::ObjectMap& leftMap{ left.GetObjectMap() };
+		const ValueMap::ObjectMap& rightMap{ right.GetObjectMap() };
+		if (leftMap.Size() != rightMap.Size())
+		{
+			return leftMap.Size() < rightMap.Size() ? -1 : 1;
+		}
+
+		std::vector<const DynamicObjectMap::Entry*> leftEntries{ SortByName(leftMap) };
+		std::vector<const DynamicObjectMap::Entry*> rightEntries{ SortByName(rightMap) };
+		for (std::size_t i = 0; i < leftEntries.size(); ++i)
+		{
+			if (leftEntries[i]->first != rightEntries[i]->first)
+			{
+				return leftEntries[i]->first.GetName() < rightEntries[i]->first.GetName() ? -1 : 1;
+			}
+			int result{ Compare(leftEntries[i]->second, rightEntries[i]->second) };
+			if (result != 0)
+			{
+				return result;
+			}
+		}
+		return 0;
+	}
+
+	static std::vector<const DynamicObjectMap::Entry*> SortByName(const ValueMap::ObjectMap& objectMap)
+	{
+		std::vector<const DynamicObjectMap::Entry*> entries;
+		entries.reserve(objectMap.Size());
+		for (const auto& entry : objectMap)
+		{
+			entries.push_back(&entry);
+		}
+		std::sort(entries.begin(), entries.end(), [](const DynamicObjectMap::Entry* pLeft, const DynamicObjectMap::Entry* pRight)
+		{
+			return pLeft->first.GetName() < pRight->first.GetName();
+		});
+		return entries;
+	}
+
+	// Rows are type of left value, columns are type of right value, in order of ValueMap::Type.
+	static constexpr CompareFunction c_compareTable[c_typeCount][c_typeCount]
+	{
+		// Null
+		{ &CompareNull, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank },
+		// Object
+		{ &CompareRank, &CompareObject, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank },
+		// Array
+		{ &CompareRank, &CompareRank, &CompareArray, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank },
+		// Bool
+		{ &CompareRank, &CompareRank, &CompareRank, &CompareBool, &CompareRank, &CompareRank, &CompareRank, &CompareRank },
+		// Int32
+		{
+			&CompareRank, &CompareRank, &CompareRank, &CompareRank,
+			&CompareInteger<ValueMap::Type::Int32, ValueMap::Type::Int32>,
+			&CompareInteger<ValueMap::Type::Int32, ValueMap::Type::Int64>,
+			&CompareIntegerDouble<ValueMap::Type::Int32>,
+			&CompareRank
+		},
+		// Int64
+		{
+			&CompareRank, &CompareRank, &CompareRank, &CompareRank,
+			&CompareInteger<ValueMap::Type::Int64, ValueMap::Type::Int32>,
+			&CompareInteger<ValueMap::Type::Int64, ValueMap::Type::Int64>,
+			&CompareIntegerDouble<ValueMap::Type::Int64>,
+			&CompareRank
+		},
+		// Double
+		{
+			&CompareRank, &CompareRank, &CompareRank, &CompareRank,
+			&CompareDoubleInteger<ValueMap::Type::Int32>,
+			&CompareDoubleInteger<ValueMap::Type::Int64>,
+			&CompareDouble,
+			&CompareRank
+		},
+		// String
+		{ &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareRank, &CompareString }
+	};
+};
+
+inline int Dynamic::Compare(const Dynamic& left, const Dynamic& right)
+{
+	return DynamicOrdering::Compare(left, right);
+}
+
 }}
+
+namespace std {
+
+template<>
+struct hash<Zest::Lib::Dynamic>
+{
+	std::size_t operator()(const Zest::Lib::Dynamic& value) const
+	{
+		return static_cast<std::size_t>(value.Hash());
+	}
+};
+
+}
+
 #endif
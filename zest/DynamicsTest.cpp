@@ -1,6 +1,8 @@
 #include "CommonTest.h"
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <unordered_set>
 
 #include "Dynamics.h"
 
@@ -10,12 +12,307 @@ TEST(DynamicsTest, CreateDynamicArray_GetObjectByIndex)
 {
 	Dynamic dynamic1({ "one", "two" });
 	EXPECT_EQ(dynamic1.GetType(), ValueMap::Type::Array);
-	Dynamic dynamic2{ std::move(dynamic1[0]) };
+	Dynamic dynamic2(std::move(dynamic1[0]));
 	EXPECT_EQ(dynamic2.GetType(), ValueMap::Type::String);
 
-	Dynamic dynamic3{ std::move(dynamic1[2]) };
+	Dynamic dynamic3(std::move(dynamic1[2]));
 	EXPECT_EQ(dynamic3.GetType(), ValueMap::Type::Null);
 }
 
-}}
+TEST(DynamicsTest, CopyDynamic_Mutate_OriginalUnchanged)
+{
+	Dynamic dynamic1{ Property{ "name", "zest" }, Property{ "list", Dynamic{ 1, 2 } } };
+	Dynamic dynamic2(dynamic1);
+	EXPECT_TRUE(dynamic1.IsShared());
+
+	dynamic2["name"] = Dynamic("copy");
+	EXPECT_FALSE(dynamic1.IsShared());
+	EXPECT_EQ(dynamic1["name"].GetString(), "zest");
+	EXPECT_EQ(dynamic2["name"].GetString(), "copy");
+
+	// Untouched child is still shared by both copies.
+	const Dynamic& constDynamic1{ dynamic1 };
+	EXPECT_TRUE(constDynamic1["list"].IsShared());
+
+	dynamic2["list"].GetArray().push_back(Dynamic(3));
+	EXPECT_EQ(constDynamic1["list"].GetArray().size(), 2u);
+	EXPECT_EQ(dynamic2["list"].GetArray().size(), 3u);
+}
+
+TEST(DynamicsTest, MoveDynamic_SourceBecomeNull)
+{
+	Dynamic dynamic1("one");
+	Dynamic dynamic2(std::move(dynamic1));
+	EXPECT_EQ(dynamic1.GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(dynamic2.GetType(), ValueMap::Type::String);
+
+	Dynamic dynamic3;
+	dynamic3 = std::move(dynamic2);
+	EXPECT_EQ(dynamic3.GetString(), "one");
+	EXPECT_FALSE(dynamic3.IsShared());
+}
+
+TEST(DynamicsTest, SingleThreadedPolicy_CopyAndDetach)
+{
+	ScopedRefCountPolicy policy{ RefCountPolicy::SingleThreaded };
+	Dynamic dynamic1{ "one", "two" };
+	Dynamic dynamic2(dynamic1);
+	EXPECT_TRUE(dynamic2.IsShared());
+
+	dynamic2[0] = Dynamic("three");
+	EXPECT_FALSE(dynamic2.IsShared());
+	EXPECT_EQ(static_cast<const Dynamic&>(dynamic1)[0].GetString(), "one");
+}
+
+TEST(DynamicsTest, ObjectMap_SmallAndLarge_FindInInsertionOrder)
+{
+	Dynamic dynamic = Dynamic::MakeObject();
+	for (int i = 0; i < 100; ++i)
+	{
+		dynamic.SetObject("key" + std::to_string(i), Dynamic(i));
+		EXPECT_EQ(dynamic["key0"].GetInt32(), 0);
+		EXPECT_EQ(dynamic["key" + std::to_string(i)].GetInt32(), i);
+	}
+	EXPECT_EQ(dynamic["missing"].GetType(), ValueMap::Type::Null);
+
+	EXPECT_TRUE(dynamic.RemoveObject("key50"));
+	EXPECT_FALSE(dynamic.RemoveObject("key50"));
+	EXPECT_EQ(dynamic["key50"].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(dynamic["key51"].GetInt32(), 51);
 
+	int expected{ 0 };
+	for (const auto& entry : static_cast<const Dynamic&>(dynamic).GetObjectMap())
+	{
+		if (expected == 50)
+		{
+			++expected;
+		}
+		EXPECT_EQ(entry.first.GetName(), "key" + std::to_string(expected));
+		++expected;
+	}
+	EXPECT_EQ(expected, 100);
+}
+
+TEST(DynamicsTest, ObjectMap_Move_KeepsEntries)
+{
+	static_assert(std::is_nothrow_move_constructible<DynamicObjectMap>::value, "Move of object map must not copy");
+	DynamicObjectMap objectMap;
+	for (int i = 0; i < 40; ++i)
+	{
+		objectMap.Set("key" + std::to_string(i), Dynamic(i));
+	}
+	const DynamicObjectMap::Entry* pEntries{ &*objectMap.begin() };
+
+	DynamicObjectMap moved{ std::move(objectMap) };
+	EXPECT_EQ(&*moved.begin(), pEntries);
+	EXPECT_EQ(moved.Find(ValueMap::String("key39"))->GetInt32(), 39);
+
+	DynamicObjectMap assigned;
+	assigned = std::move(moved);
+	EXPECT_EQ(&*assigned.begin(), pEntries);
+	EXPECT_EQ(assigned.Size(), 40u);
+	EXPECT_EQ(assigned.Find(ValueMap::String("key0"))->GetInt32(), 0);
+}
+
+TEST(DynamicsTest, DynamicKey_SameName_SameKey)
+{
+	DynamicKeyTable::GetInstance().Intern({ "id", "name" });
+	DynamicKey idKey{ "id" };
+	DynamicKey nameKey{ std::string("name") };
+	EXPECT_EQ(idKey, DynamicKey{ "id" });
+	EXPECT_NE(idKey, nameKey);
+	EXPECT_EQ(idKey.GetName(), "id");
+	EXPECT_TRUE(DynamicKey{}.IsEmpty());
+
+	Dynamic dynamic{ Property{ "id", 1 }, Property{ "name", "zest" } };
+	EXPECT_EQ(dynamic[idKey].GetInt32(), 1);
+	EXPECT_EQ(dynamic[nameKey].GetString(), "zest");
+	EXPECT_EQ(dynamic[DynamicKey{ "missing" }].GetType(), ValueMap::Type::Null);
+
+	dynamic.SetObject(idKey, Dynamic(2));
+	EXPECT_EQ(dynamic["id"].GetInt32(), 2);
+	EXPECT_TRUE(dynamic.RemoveObject(nameKey));
+	EXPECT_EQ(dynamic.GetObjectMap().Size(), 1u);
+}
+
+TEST(DynamicsTest, DynamicKeyTable_Full_KeysNotInterned)
+{
+	DynamicKeyTable keyTable{ 160 };
+	std::vector<DynamicKey> keys;
+	for (int i = 0; i < 1000; ++i)
+	{
+		keys.push_back(keyTable.Intern("name" + std::to_string(i)));
+	}
+	EXPECT_LE(keyTable.Size(), 160u);
+	EXPECT_TRUE(keys[0].IsInterned());
+	EXPECT_FALSE(std::all_of(keys.begin(), keys.end(), [](const DynamicKey& key) { return key.IsInterned(); }));
+
+	// Keys of same name are equal whether interned or not.
+	DynamicObjectMap objectMap;
+	for (int i = 0; i < 1000; ++i)
+	{
+		DynamicKey key{ keyTable.Intern("name" + std::to_string(i)) };
+		EXPECT_EQ(key, keys[i]);
+		EXPECT_NE(key, keys[(i + 1) % 1000]);
+		objectMap.Set(key, Dynamic(i));
+	}
+	EXPECT_EQ(objectMap.Size(), 1000u);
+	for (int i = 0; i < 1000; ++i)
+	{
+		EXPECT_EQ(objectMap.Find(keys[i])->GetInt32(), i);
+	}
+}
+
+TEST(DynamicsTest, DynamicKeyTable_OwnTable_SameAsGlobalKey)
+{
+	DynamicKeyTable keyTable;
+	DynamicKey tableKey{ keyTable.Intern("id") };
+	DynamicKey globalKey{ "id" };
+	EXPECT_TRUE(tableKey.IsInterned());
+	EXPECT_EQ(tableKey, globalKey);
+
+	Dynamic left = Dynamic::MakeObject();
+	left.SetObject(tableKey, Dynamic(1));
+	left.SetObject(globalKey, Dynamic(2));
+	EXPECT_EQ(left.GetObjectMap().Size(), 1u);
+	EXPECT_EQ(left[tableKey].GetInt32(), 2);
+
+	Dynamic right = Dynamic::MakeObject();
+	right.SetObject(globalKey, Dynamic(2));
+	EXPECT_TRUE(left == right);
+	EXPECT_EQ(left.Hash(), right.Hash());
+	EXPECT_EQ(DynamicOrdering::Compare(left, right), 0);
+	EXPECT_EQ(DynamicOrdering::Compare(right, left), 0);
+}
+
+TEST(DynamicsTest, DynamicKeyCache_InputNames_TableNotGrown)
+{
+	DynamicKeyTable::GetInstance().Intern({ "known" });
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	DynamicKeyCache keyCache;
+	DynamicKey first{ keyCache.Get("input name", 10) };
+	EXPECT_FALSE(first.IsInterned());
+	EXPECT_EQ(keyCache.Get("input name", 10), first);
+	EXPECT_TRUE(keyCache.Get("known", 5).IsInterned());
+	EXPECT_EQ(keyCache.Get("known", 5), DynamicKey{ "known" });
+	for (int i = 0; i < 1000; ++i)
+	{
+		std::string name{ "untrusted" + std::to_string(i) };
+		EXPECT_EQ(keyCache.Get(name.data(), name.size()).GetName(), name);
+	}
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+
+	// Found by interned key of same name.
+	Dynamic object = Dynamic::MakeObject();
+	object.SetObject(first, Dynamic(1));
+	EXPECT_EQ(object[DynamicKey{ "input name" }].GetInt32(), 1);
+
+	// Keys created under an arena are freed with it, cache then creates new ones.
+	for (int round = 0; round < 2; ++round)
+	{
+		DynamicArena arena;
+		ScopedDynamicArena scope{ arena };
+		Dynamic document = Dynamic::MakeObject();
+		document.SetObject(keyCache.Get("input name", 10), Dynamic(round));
+		document.SetObject(keyCache.Get("arena only", 10), Dynamic(round));
+		EXPECT_EQ(document[first].GetInt32(), round);
+		EXPECT_EQ(arena.Copy(object)[first].GetInt32(), 1);
+	}
+	EXPECT_EQ(keyCache.Get("arena only", 10).GetName(), "arena only");
+}
+
+TEST(DynamicsTest, DynamicArena_BuildDocument_FewBlockAllocations)
+{
+	struct CountingMemoryResource : std::pmr::memory_resource
+	{
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			++allocationCount;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+		{
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		int allocationCount{ 0 };
+	} upstream;
+
+	Dynamic heapValue("a string which is too long for small string optimization");
+	{
+		DynamicArena arena{ 4096, &upstream };
+		ScopedDynamicArena scope{ arena };
+
+		Dynamic document = Dynamic::MakeObject();
+		ValueMap::Array& array{ document.SetObject("items", Dynamic(ValueMap::Array{})).GetArray() };
+		for (int i = 0; i < 1000; ++i)
+		{
+			array.push_back(Dynamic{ std::pair<ValueMap::String, ValueMap::Object>{ "id", i } });
+		}
+		document.SetObject("copy", arena.Copy(heapValue));
+
+		EXPECT_LT(upstream.allocationCount, 16);
+		EXPECT_EQ(document["items"][999]["id"].GetInt32(), 999);
+		EXPECT_EQ(document["copy"].GetString(), heapValue.GetString());
+
+		// Copy on write clones into the same arena.
+		Dynamic copy(document);
+		copy["items"][0].SetObject("id", Dynamic(-1));
+		EXPECT_EQ(document["items"][0]["id"].GetInt32(), 0);
+		EXPECT_EQ(copy["items"][0]["id"].GetInt32(), -1);
+	}
+	EXPECT_FALSE(heapValue.IsShared());
+}
+
+TEST(DynamicsTest, Equality_PropertyOrderAndNumberType_EqualWithSameHash)
+{
+	Dynamic first{ Property{ "a", 1 }, Property{ "b", Dynamic{ 1.5, "x" } } };
+	Dynamic second{ Property{ "b", Dynamic{ 1.5, "x" } }, Property{ "a", 1.0 } };
+
+	EXPECT_TRUE(first == second);
+	EXPECT_EQ(first.Hash(), second.Hash());
+	EXPECT_TRUE(Dynamic(ValueMap::Int64{ 7 }) == Dynamic(7));
+	EXPECT_TRUE(Dynamic(7) != Dynamic(7.5));
+	EXPECT_TRUE(Dynamic(true) != Dynamic(1));
+	EXPECT_TRUE(Dynamic() == Dynamic());
+
+	std::unordered_set<Dynamic> set{ first, second, Dynamic("x") };
+	EXPECT_EQ(set.size(), 2u);
+}
+
+TEST(DynamicsTest, Hash_MutateChild_HashChanged)
+{
+	Dynamic document{ Property{ "items", Dynamic{ 1, 2, 3 } } };
+	Dynamic copy(document);
+	uint64_t hash{ document.Hash() };
+	EXPECT_EQ(copy.Hash(), hash);
+
+	copy["items"][1] = Dynamic(20);
+	EXPECT_NE(copy.Hash(), hash);
+	EXPECT_TRUE(copy != document);
+	EXPECT_EQ(document.Hash(), hash);
+}
+
+TEST(DynamicsTest, Equality_MutateChildAfterHash_ComparedByValue)
+{
+	Dynamic document{ Property{ "a", Dynamic{ Property{ "x", 1 } } } };
+	Dynamic equalDocument{ Property{ "a", Dynamic{ Property{ "x", 2 } } } };
+	equalDocument.Hash();
+
+	Dynamic& child{ document["a"] };
+	document.Hash();
+	child["x"] = Dynamic(2);
+	EXPECT_TRUE(document == equalDocument);
+	EXPECT_FALSE(document != equalDocument);
+
+	child["x"] = Dynamic(3);
+	EXPECT_TRUE(document != equalDocument);
+}
+
+}}
@@ -2,10 +2,19 @@
 #ifndef ZEST_LIB_ENCODING_H
 #define ZEST_LIB_ENCODING_H
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <string>
+#include "Platform.h"
 
 namespace Zest { namespace Lib {
 
+/*! Unicode encodings of text and conversion between them.
+	Routines work on bytes, UTF-16 and UTF-32 in the byte order of their type whatever the
+	platform's is. Runs of ASCII, the common case of json, logs and identifiers, are found and
+	copied 16 or 32 bytes at a time with SSE2 or AVX2, UTF-8 is validated with AVX2 lookups.
+*/
 struct Encoding
 {
 	using CODEPONT = char;
@@ -19,9 +28,678 @@ struct Encoding
 		UTF32BE,
 		UTF32LE
 	};
+
+	static constexpr uint32_t c_maxCodePoint{ 0x10FFFF };
+	static constexpr std::size_t c_maxUtf8Length{ 4 };
+
+	static constexpr std::size_t GetUnitSize(Type type) noexcept
+	{
+		return type == Type::UTF16BE || type == Type::UTF16LE ? 2 : type == Type::UTF32BE || type == Type::UTF32LE ? 4 : 1;
+	}
+
+	static constexpr bool IsBigEndian(Type type) noexcept
+	{
+		return type == Type::UTF16BE || type == Type::UTF32BE;
+	}
+
+	/*! Encoding of text from its byte order mark, bomLength is set to the length of the mark.
+		Without a mark, zero bytes of the first character tell UTF-16 and UTF-32 from UTF-8,
+		which is reliable for text that starts with an ASCII character, like json (RFC 4627).
+	*/
+	static Type DetectType(const char* pData, std::size_t size, std::size_t& bomLength) noexcept
+	{
+		const uint8_t* p{ reinterpret_cast<const uint8_t*>(pData) };
+		bomLength = 0;
+		if (size >= 4 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0xFE && p[3] == 0xFF)
+		{
+			bomLength = 4;
+			return Type::UTF32BE;
+		}
+		// Before UTF-16LE, whose mark is its prefix.
+		if (size >= 4 && p[0] == 0xFF && p[1] == 0xFE && p[2] == 0x00 && p[3] == 0x00)
+		{
+			bomLength = 4;
+			return Type::UTF32LE;
+		}
+		if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+		{
+			bomLength = 3;
+			return Type::UTF8;
+		}
+		if (size >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+		{
+			bomLength = 2;
+			return Type::UTF16BE;
+		}
+		if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+		{
+			bomLength = 2;
+			return Type::UTF16LE;
+		}
+
+		if (size >= 4 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] != 0x00)
+		{
+			return Type::UTF32BE;
+		}
+		if (size >= 4 && p[0] != 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x00)
+		{
+			return Type::UTF32LE;
+		}
+		if (size >= 2 && p[0] == 0x00 && p[1] != 0x00)
+		{
+			return Type::UTF16BE;
+		}
+		if (size >= 2 && p[0] != 0x00 && p[1] == 0x00)
+		{
+			return Type::UTF16LE;
+		}
+		return Type::UTF8;
+	}
+
+	/*! Length of the UTF-8 sequence at pData, 0 when it is invalid or cut by the end of data.
+		Rejects overlong forms, surrogates and code points above U+10FFFF.
+	*/
+	static std::size_t GetUtf8SequenceLength(const uint8_t* pData, std::size_t size) noexcept
+	{
+		uint8_t lead{ pData[0] };
+		if (lead < 0x80)
+		{
+			return 1;
+		}
+		std::size_t length;
+		uint8_t low{ 0x80 };
+		uint8_t high{ 0xBF };
+		if (lead >= 0xC2 && lead <= 0xDF)
+		{
+			length = 2;
+		}
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			length = 3;
+			low = lead == 0xE0 ? 0xA0 : 0x80;
+			high = lead == 0xED ? 0x9F : 0xBF;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			low = lead == 0xF0 ? 0x90 : 0x80;
+			high = lead == 0xF4 ? 0x8F : 0xBF;
+		}
+		else
+		{
+			return 0;
+		}
+
+		if (length > size || pData[1] < low || pData[1] > high)
+		{
+			return 0;
+		}
+		for (std::size_t i = 2; i < length; ++i)
+		{
+			if ((pData[i] & 0xC0) != 0x80)
+			{
+				return 0;
+			}
+		}
+		return length;
+	}
+
+	// Offset of first invalid sequence, size when whole data is valid UTF-8.
+	static std::size_t FindInvalidUtf8(const char* pData, std::size_t size) noexcept
+	{
+		const uint8_t* p{ reinterpret_cast<const uint8_t*>(pData) };
+#if defined(ZEST_LIB_AVX2)
+		if (size >= c_avx2Size)
+		{
+			return FindInvalidUtf8Avx2(p, size);
+		}
+#endif
+		return FindInvalidUtf8From(p, size, 0);
+	}
+
+	// Length of the ASCII prefix of data.
+	static std::size_t CountAscii(const char* pData, std::size_t size) noexcept
+	{
+		return CountAsciiUnits<Type::UTF8>(reinterpret_cast<const uint8_t*>(pData), size);
+	}
+
+	// Code points of valid text, UTF-8 counts every byte which doesn't continue a sequence.
+	static std::size_t CountCodePoints(Type type, const char* pData, std::size_t size) noexcept
+	{
+		const uint8_t* p{ reinterpret_cast<const uint8_t*>(pData) };
+		switch (type)
+		{
+			case Type::UTF16BE:
+			case Type::UTF16LE:
+			{
+				// Low surrogates end a pair which is counted by its high one.
+				std::size_t count{ size / 2 };
+				std::size_t high{ IsBigEndian(type) ? 0u : 1u };
+				for (std::size_t position = 0; position + 1 < size; position += 2)
+				{
+					count -= (p[position + high] & 0xFC) == 0xDC ? 1 : 0;
+				}
+				return count;
+			}
+			case Type::UTF32BE:
+			case Type::UTF32LE:
+				return size / 4;
+			default:
+				return CountUtf8CodePoints(p, size);
+		}
+	}
+
+	/*! Append input converted from one encoding to another to output.
+		Returns size when whole input was converted, else offset of the first invalid code unit,
+		output then ends with the text before it. Invalid are malformed UTF-8, lone surrogates,
+		code points above U+10FFFF, a cut last code unit, and code points above 0x7F for ASCII.
+	*/
+	static std::size_t Transcode(Type from, const char* pInput, std::size_t size, Type to, std::string& output)
+	{
+		switch (from)
+		{
+			case Type::ASCII:
+				return TranscodeFrom<Type::ASCII>(pInput, size, to, output);
+			case Type::UTF8:
+				return TranscodeFrom<Type::UTF8>(pInput, size, to, output);
+			case Type::UTF16BE:
+				return TranscodeFrom<Type::UTF16BE>(pInput, size, to, output);
+			case Type::UTF16LE:
+				return TranscodeFrom<Type::UTF16LE>(pInput, size, to, output);
+			case Type::UTF32BE:
+				return TranscodeFrom<Type::UTF32BE>(pInput, size, to, output);
+			default:
+				return TranscodeFrom<Type::UTF32LE>(pInput, size, to, output);
+		}
+	}
+
+private:
+	// Validation starting at a sequence boundary, ASCII is skipped a vector at a time.
+	static std::size_t FindInvalidUtf8From(const uint8_t* p, std::size_t size, std::size_t position) noexcept
+	{
+		while (position < size)
+		{
+			if (p[position] < 0x80)
+			{
+				position += CountAsciiUnits<Type::UTF8>(p + position, size - position);
+				continue;
+			}
+			std::size_t length{ GetUtf8SequenceLength(p + position, size - position) };
+			if (length == 0)
+			{
+				return position;
+			}
+			position += length;
+		}
+		return size;
+	}
+
+	static std::size_t CountUtf8CodePoints(const uint8_t* p, std::size_t size) noexcept
+	{
+		std::size_t count{ 0 };
+		std::size_t position{ 0 };
+#if defined(ZEST_LIB_AVX2)
+		// Continuation bytes are 0x80 to 0xBF, signed -128 to -65.
+		for (; position + 32 <= size; position += 32)
+		{
+			__m256i chunk{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + position)) };
+			count += Platform::PopCount(static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(-65))))));
+		}
+#elif defined(ZEST_LIB_SSE2)
+		for (; position + 16 <= size; position += 16)
+		{
+			__m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + position)) };
+			count += Platform::PopCount(static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(-65)))));
+		}
+#endif
+		for (; position < size; ++position)
+		{
+			count += (p[position] & 0xC0) != 0x80 ? 1 : 0;
+		}
+		return count;
+	}
+
+	template<Type t_type>
+	static uint32_t ReadUnit(const uint8_t* p) noexcept
+	{
+		constexpr std::size_t unitSize{ GetUnitSize(t_type) };
+		uint32_t value{ 0 };
+		for (std::size_t i = 0; i < unitSize; ++i)
+		{
+			value |= static_cast<uint32_t>(p[i]) << (8 * (IsBigEndian(t_type) ? unitSize - 1 - i : i));
+		}
+		return value;
+	}
+
+	template<Type t_type>
+	static uint8_t* WriteUnit(uint8_t* pOutput, uint32_t value) noexcept
+	{
+		constexpr std::size_t unitSize{ GetUnitSize(t_type) };
+		for (std::size_t i = 0; i < unitSize; ++i)
+		{
+			pOutput[i] = static_cast<uint8_t>(value >> (8 * (IsBigEndian(t_type) ? unitSize - 1 - i : i)));
+		}
+		return pOutput + unitSize;
+	}
+
+	// Count of leading code units below 0x80 in unitCount units.
+	template<Type t_type>
+	static std::size_t CountAsciiUnits(const uint8_t* p, std::size_t unitCount) noexcept
+	{
+		constexpr std::size_t unitSize{ GetUnitSize(t_type) };
+		std::size_t unit{ 0 };
+#if defined(ZEST_LIB_AVX2)
+		if constexpr (unitSize == 1)
+		{
+			for (; unit + 32 <= unitCount; unit += 32)
+			{
+				uint32_t nonAscii{ static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + unit)))) };
+				if (nonAscii != 0)
+				{
+					return unit + Platform::CountTrailingZeros(nonAscii);
+				}
+			}
+		}
+#endif
+#if defined(ZEST_LIB_SSE2)
+		constexpr std::size_t unitsPerVector{ 16 / unitSize };
+		for (; unit + unitsPerVector <= unitCount; unit += unitsPerVector)
+		{
+			__m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + unit * unitSize)) };
+			uint32_t nonAscii;
+			if constexpr (unitSize == 1)
+			{
+				nonAscii = static_cast<uint32_t>(_mm_movemask_epi8(chunk));
+			}
+			else if constexpr (unitSize == 2)
+			{
+				// Units are loaded little endian, so the bytes of a big endian unit are swapped.
+				__m128i bits{ _mm_and_si128(chunk, _mm_set1_epi16(static_cast<int16_t>(IsBigEndian(t_type) ? 0x80FF : 0xFF80))) };
+				nonAscii = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128()))) & 0xFFFF;
+			}
+			else
+			{
+				__m128i bits{ _mm_and_si128(chunk, _mm_set1_epi32(static_cast<int32_t>(IsBigEndian(t_type) ? 0x80FFFFFFu : 0xFFFFFF80u))) };
+				nonAscii = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi32(bits, _mm_setzero_si128()))) & 0xFFFF;
+			}
+			if (nonAscii != 0)
+			{
+				return unit + Platform::CountTrailingZeros(nonAscii) / unitSize;
+			}
+		}
+#endif
+		while (unit < unitCount && ReadUnit<t_type>(p + unit * unitSize) < 0x80)
+		{
+			++unit;
+		}
+		return unit;
+	}
+
+	// ASCII units widened or narrowed to the unit of the target, returns end of output.
+	template<Type t_from, Type t_to>
+	static uint8_t* AppendAscii(const uint8_t* p, std::size_t count, uint8_t* pOutput) noexcept
+	{
+		constexpr std::size_t fromSize{ GetUnitSize(t_from) };
+		constexpr std::size_t toSize{ GetUnitSize(t_to) };
+		if constexpr (fromSize == 1 && toSize == 1)
+		{
+			std::memcpy(pOutput, p, count);
+			return pOutput + count;
+		}
+		std::size_t i{ 0 };
+#if defined(ZEST_LIB_SSE2)
+		if constexpr (fromSize == 1 && toSize == 2)
+		{
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)) };
+				__m128i zero{ _mm_setzero_si128() };
+				__m128i low{ IsBigEndian(t_to) ? _mm_unpacklo_epi8(zero, chunk) : _mm_unpacklo_epi8(chunk, zero) };
+				__m128i high{ IsBigEndian(t_to) ? _mm_unpackhi_epi8(zero, chunk) : _mm_unpackhi_epi8(chunk, zero) };
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pOutput + 2 * i), low);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pOutput + 2 * i + 16), high);
+			}
+		}
+		else if constexpr (fromSize == 2 && toSize == 1)
+		{
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i low{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2 * i)) };
+				__m128i high{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2 * i + 16)) };
+				if constexpr (IsBigEndian(t_from))
+				{
+					low = _mm_srli_epi16(low, 8);
+					high = _mm_srli_epi16(high, 8);
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pOutput + i), _mm_packus_epi16(low, high));
+			}
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			WriteUnit<t_to>(pOutput + i * toSize, ReadUnit<t_from>(p + i * fromSize));
+		}
+		return pOutput + count * toSize;
+	}
+
+	// Length in bytes of code point at p, 0 when it is invalid.
+	template<Type t_type>
+	static std::size_t DecodeCodePoint(const uint8_t* p, std::size_t size, uint32_t& codePoint) noexcept
+	{
+		if constexpr (t_type == Type::ASCII)
+		{
+			codePoint = p[0];
+			return codePoint < 0x80 ? 1 : 0;
+		}
+		else if constexpr (t_type == Type::UTF8)
+		{
+			std::size_t length{ GetUtf8SequenceLength(p, size) };
+			switch (length)
+			{
+				case 1:
+					codePoint = p[0];
+					break;
+				case 2:
+					codePoint = (static_cast<uint32_t>(p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+					break;
+				case 3:
+					codePoint = (static_cast<uint32_t>(p[0] & 0x0F) << 12) | (static_cast<uint32_t>(p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+					break;
+				case 4:
+					codePoint = (static_cast<uint32_t>(p[0] & 0x07) << 18) | (static_cast<uint32_t>(p[1] & 0x3F) << 12) | (static_cast<uint32_t>(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+					break;
+				default:
+					break;
+			}
+			return length;
+		}
+		else if constexpr (GetUnitSize(t_type) == 2)
+		{
+			codePoint = ReadUnit<t_type>(p);
+			if (codePoint < 0xD800 || codePoint > 0xDFFF)
+			{
+				return 2;
+			}
+			if (codePoint > 0xDBFF || size < 4)
+			{
+				return 0;
+			}
+			uint32_t low{ ReadUnit<t_type>(p + 2) };
+			if (low < 0xDC00 || low > 0xDFFF)
+			{
+				return 0;
+			}
+			codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+			return 4;
+		}
+		else
+		{
+			codePoint = ReadUnit<t_type>(p);
+			return codePoint > c_maxCodePoint || (codePoint >= 0xD800 && codePoint <= 0xDFFF) ? 0 : 4;
+		}
+	}
+
+	// Code point is valid, and below 0x80 for ASCII.
+	template<Type t_type>
+	static uint8_t* EncodeCodePoint(uint32_t codePoint, uint8_t* pOutput) noexcept
+	{
+		if constexpr (t_type == Type::ASCII)
+		{
+			*pOutput = static_cast<uint8_t>(codePoint);
+			return pOutput + 1;
+		}
+		else if constexpr (t_type == Type::UTF8)
+		{
+			if (codePoint < 0x80)
+			{
+				*pOutput++ = static_cast<uint8_t>(codePoint);
+			}
+			else if (codePoint < 0x800)
+			{
+				*pOutput++ = static_cast<uint8_t>(0xC0 | (codePoint >> 6));
+				*pOutput++ = static_cast<uint8_t>(0x80 | (codePoint & 0x3F));
+			}
+			else if (codePoint < 0x10000)
+			{
+				*pOutput++ = static_cast<uint8_t>(0xE0 | (codePoint >> 12));
+				*pOutput++ = static_cast<uint8_t>(0x80 | ((codePoint >> 6) & 0x3F));
+				*pOutput++ = static_cast<uint8_t>(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				*pOutput++ = static_cast<uint8_t>(0xF0 | (codePoint >> 18));
+				*pOutput++ = static_cast<uint8_t>(0x80 | ((codePoint >> 12) & 0x3F));
+				*pOutput++ = static_cast<uint8_t>(0x80 | ((codePoint >> 6) & 0x3F));
+				*pOutput++ = static_cast<uint8_t>(0x80 | (codePoint & 0x3F));
+			}
+			return pOutput;
+		}
+		else if constexpr (GetUnitSize(t_type) == 2)
+		{
+			if (codePoint < 0x10000)
+			{
+				return WriteUnit<t_type>(pOutput, codePoint);
+			}
+			codePoint -= 0x10000;
+			pOutput = WriteUnit<t_type>(pOutput, 0xD800 + (codePoint >> 10));
+			return WriteUnit<t_type>(pOutput, 0xDC00 + (codePoint & 0x3FF));
+		}
+		else
+		{
+			return WriteUnit<t_type>(pOutput, codePoint);
+		}
+	}
+
+	// Output never takes more bytes per input code unit than this.
+	static constexpr std::size_t GetMaxOutputPerUnit(Type from, Type to) noexcept
+	{
+		std::size_t fromSize{ GetUnitSize(from) };
+		switch (to)
+		{
+			case Type::ASCII:
+				return 1;
+			case Type::UTF8:
+				return fromSize == 1 ? 1 : fromSize == 2 ? 3 : 4;
+			case Type::UTF16BE:
+			case Type::UTF16LE:
+				return fromSize == 4 ? 4 : 2;
+			default:
+				return 4;
+		}
+	}
+
+	template<Type t_from>
+	static std::size_t TranscodeFrom(const char* pInput, std::size_t size, Type to, std::string& output)
+	{
+		switch (to)
+		{
+			case Type::ASCII:
+				return TranscodeTo<t_from, Type::ASCII>(pInput, size, output);
+			case Type::UTF8:
+				return TranscodeTo<t_from, Type::UTF8>(pInput, size, output);
+			case Type::UTF16BE:
+				return TranscodeTo<t_from, Type::UTF16BE>(pInput, size, output);
+			case Type::UTF16LE:
+				return TranscodeTo<t_from, Type::UTF16LE>(pInput, size, output);
+			case Type::UTF32BE:
+				return TranscodeTo<t_from, Type::UTF32BE>(pInput, size, output);
+			default:
+				return TranscodeTo<t_from, Type::UTF32LE>(pInput, size, output);
+		}
+	}
+
+	// Output is sized for the worst case once and shrunk at the end.
+	template<Type t_from, Type t_to>
+	static std::size_t TranscodeTo(const char* pInput, std::size_t size, std::string& output)
+	{
+		constexpr std::size_t fromSize{ GetUnitSize(t_from) };
+		const uint8_t* p{ reinterpret_cast<const uint8_t*>(pInput) };
+		std::size_t end{ size / fromSize * fromSize };
+		std::size_t outputSize{ output.size() };
+		output.resize(outputSize + end / fromSize * GetMaxOutputPerUnit(t_from, t_to));
+		uint8_t* pOutputBegin{ reinterpret_cast<uint8_t*>(&output[0]) };
+		uint8_t* pOutput{ pOutputBegin + outputSize };
+
+		std::size_t position{ 0 };
+		while (position < end)
+		{
+			if (ReadUnit<t_from>(p + position) < 0x80)
+			{
+				std::size_t count{ CountAsciiUnits<t_from>(p + position, (end - position) / fromSize) };
+				pOutput = AppendAscii<t_from, t_to>(p + position, count, pOutput);
+				position += count * fromSize;
+				continue;
+			}
+			uint32_t codePoint{ 0 };
+			std::size_t length{ DecodeCodePoint<t_from>(p + position, end - position, codePoint) };
+			if (length == 0 || t_to == Type::ASCII)
+			{
+				break;
+			}
+			pOutput = EncodeCodePoint<t_to>(codePoint, pOutput);
+			position += length;
+		}
+		output.resize(static_cast<std::size_t>(pOutput - pOutputBegin));
+		return position == size ? size : position;
+	}
+
+#if defined(ZEST_LIB_AVX2)
+	static constexpr std::size_t c_avx2Size{ 32 };
+
+	/*! Error bits of the lookup validator of Keiser and Lemire. Three lookups, by high nibble
+		and low nibble of the previous byte and by high nibble of the byte, share a bit only
+		when the pair of bytes is invalid. Lengths of 3 and 4 byte sequences are checked apart.
+	*/
+	static constexpr uint8_t c_tooShort{ 1 << 0 };
+	static constexpr uint8_t c_tooLong{ 1 << 1 };
+	static constexpr uint8_t c_overlong3{ 1 << 2 };
+	static constexpr uint8_t c_tooLarge{ 1 << 3 };
+	static constexpr uint8_t c_surrogate{ 1 << 4 };
+	static constexpr uint8_t c_overlong2{ 1 << 5 };
+	static constexpr uint8_t c_tooLarge1000{ 1 << 6 };
+	static constexpr uint8_t c_overlong4{ 1 << 6 };
+	static constexpr uint8_t c_twoContinuations{ 1 << 7 };
+	static constexpr uint8_t c_carry{ c_tooShort | c_tooLong | c_twoContinuations };
+
+	static __m256i LoadTable(const uint8_t (&table)[16]) noexcept
+	{
+		return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+	}
+
+	static __m256i HighNibble(__m256i value) noexcept
+	{
+		return _mm256_and_si256(_mm256_srli_epi16(value, 4), _mm256_set1_epi8(0x0F));
+	}
+
+	// Bytes of input shifted by count, with the last bytes of previous in front.
+	template<int t_count>
+	static __m256i Previous(__m256i input, __m256i previous) noexcept
+	{
+		return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - t_count);
+	}
+
+	static __m256i CheckUtf8Block(__m256i input, __m256i previous) noexcept
+	{
+		static constexpr uint8_t byte1High[16]{
+			// ASCII
+			c_tooLong, c_tooLong, c_tooLong, c_tooLong, c_tooLong, c_tooLong, c_tooLong, c_tooLong,
+			// Continuation
+			c_twoContinuations, c_twoContinuations, c_twoContinuations, c_twoContinuations,
+			// 1100, 1101, 1110, 1111
+			c_tooShort | c_overlong2,
+			c_tooShort,
+			c_tooShort | c_overlong3 | c_surrogate,
+			c_tooShort | c_tooLarge | c_tooLarge1000 | c_overlong4
+		};
+		static constexpr uint8_t byte1Low[16]{
+			c_carry | c_overlong3 | c_overlong2 | c_overlong4,
+			c_carry | c_overlong2,
+			c_carry,
+			c_carry,
+			c_carry | c_tooLarge,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000 | c_surrogate,
+			c_carry | c_tooLarge | c_tooLarge1000,
+			c_carry | c_tooLarge | c_tooLarge1000
+		};
+		static constexpr uint8_t byte2High[16]{
+			// ASCII
+			c_tooShort, c_tooShort, c_tooShort, c_tooShort, c_tooShort, c_tooShort, c_tooShort, c_tooShort,
+			// 1000, 1001, 1010, 1011
+			c_tooLong | c_overlong2 | c_twoContinuations | c_overlong3 | c_tooLarge1000 | c_overlong4,
+			c_tooLong | c_overlong2 | c_twoContinuations | c_overlong3 | c_tooLarge,
+			c_tooLong | c_overlong2 | c_twoContinuations | c_surrogate | c_tooLarge,
+			c_tooLong | c_overlong2 | c_twoContinuations | c_surrogate | c_tooLarge,
+			// Lead
+			c_tooShort, c_tooShort, c_tooShort, c_tooShort
+		};
+
+		__m256i previous1{ Previous<1>(input, previous) };
+		__m256i special{ _mm256_and_si256(
+			_mm256_and_si256(
+				_mm256_shuffle_epi8(LoadTable(byte1High), HighNibble(previous1)),
+				_mm256_shuffle_epi8(LoadTable(byte1Low), _mm256_and_si256(previous1, _mm256_set1_epi8(0x0F)))),
+			_mm256_shuffle_epi8(LoadTable(byte2High), HighNibble(input))) };
+
+		// Third byte after 111_____ and fourth after 1111____ must be continuations.
+		__m256i isThird{ _mm256_subs_epu8(Previous<2>(input, previous), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80))) };
+		__m256i isFourth{ _mm256_subs_epu8(Previous<3>(input, previous), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80))) };
+		__m256i mustContinue{ _mm256_and_si256(_mm256_or_si256(isThird, isFourth), _mm256_set1_epi8(static_cast<char>(0x80))) };
+		return _mm256_xor_si256(mustContinue, special);
+	}
+
+	static std::size_t FindInvalidUtf8Avx2(const uint8_t* p, std::size_t size) noexcept
+	{
+		__m256i previous{ _mm256_setzero_si256() };
+		std::size_t position{ 0 };
+		for (; position + c_avx2Size <= size; position += c_avx2Size)
+		{
+			__m256i input{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + position)) };
+			// ASCII block after ASCII block can't be invalid, nothing is left open.
+			if (_mm256_movemask_epi8(_mm256_or_si256(input, previous)) != 0)
+			{
+				__m256i error{ CheckUtf8Block(input, previous) };
+				if (!_mm256_testz_si256(error, error))
+				{
+					return FindInvalidUtf8At(p, size, position);
+				}
+			}
+			previous = input;
+		}
+		// Zero padding completes no sequence, so one cut by the end is found too.
+		alignas(32) uint8_t block[c_avx2Size]{};
+		std::memcpy(block, p + position, size - position);
+		__m256i error{ CheckUtf8Block(_mm256_load_si256(reinterpret_cast<const __m256i*>(block)), previous) };
+		return _mm256_testz_si256(error, error) ? size : FindInvalidUtf8At(p, size, position);
+	}
+
+	/*! Exact offset of error in block at position, data before block is valid except a sequence
+		cut by the block start, so scalar validation starts at the last lead before the block.
+	*/
+	static std::size_t FindInvalidUtf8At(const uint8_t* p, std::size_t size, std::size_t position) noexcept
+	{
+		std::size_t start{ position };
+		for (std::size_t back = 1; back < c_maxUtf8Length && back <= position; ++back)
+		{
+			if ((p[position - back] & 0xC0) != 0x80)
+			{
+				start = position - back;
+				break;
+			}
+		}
+		return FindInvalidUtf8From(p, size, start);
+	}
+#endif
 };
 
 
 }}
 
-#endif
\ No newline at end of file
+#endif
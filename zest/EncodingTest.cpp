@@ -0,0 +1,282 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+#include "Encoding.h"
+#include "Stream.h"
+#include "json/json.h"
+
+namespace Zest { namespace Lib {
+
+namespace {
+
+using Type = Encoding::Type;
+
+const Type c_unicodeTypes[]{ Type::UTF8, Type::UTF16BE, Type::UTF16LE, Type::UTF32BE, Type::UTF32LE };
+
+// "a€😀" in each unicode type.
+const std::string c_sample[]{
+	std::string("\x61\xE2\x82\xAC\xF0\x9F\x98\x80", 8),
+	std::string("\x00\x61\x20\xAC\xD8\x3D\xDE\x00", 8),
+	std::string("\x61\x00\xAC\x20\x3D\xD8\x00\xDE", 8),
+	std::string("\x00\x00\x00\x61\x00\x00\x20\xAC\x00\x01\xF6\x00", 12),
+	std::string("\x61\x00\x00\x00\xAC\x20\x00\x00\x00\xF6\x01\x00", 12)
+};
+
+std::string Convert(Type from, const std::string& input, Type to)
+{
+	std::string output;
+	EXPECT_EQ(Encoding::Transcode(from, input.data(), input.size(), to, output), input.size());
+	return output;
+}
+
+// UTF-8 text with ASCII runs of every length between 1 to 4 byte characters.
+std::string MakeText(std::size_t size)
+{
+	const char* characters[]{ "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xC2\x80", "\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF" };
+	std::string text;
+	for (std::size_t i = 0; text.size() < size; ++i)
+	{
+		text.append(i % 71, static_cast<char>('a' + i % 26));
+		text += characters[i % 6];
+	}
+	return text;
+}
+
+// Source which returns at most chunkSize bytes a read.
+class ChunkedStream: public IStream
+{
+public:
+	ChunkedStream(const std::string& data, std::size_t chunkSize)
+		: m_data{ data }, m_chunkSize{ chunkSize }
+	{
+	}
+
+	std::size_t Read(char* pBuffer, std::size_t size) override
+	{
+		std::size_t readSize{ std::min({ size, m_chunkSize, m_data.size() - m_position }) };
+		m_data.copy(pBuffer, readSize, m_position);
+		m_position += readSize;
+		return readSize;
+	}
+
+private:
+	const std::string& m_data;
+	std::size_t m_chunkSize;
+	std::size_t m_position{ 0 };
+};
+
+std::string ReadAll(IStream& stream, std::size_t readSize)
+{
+	std::string result;
+	std::string buffer(readSize, '\0');
+	for (std::size_t size = stream.Read(&buffer[0], readSize); size != 0; size = stream.Read(&buffer[0], readSize))
+	{
+		result.append(buffer, 0, size);
+	}
+	return result;
+}
+
+}
+
+TEST(EncodingTest, DetectType_ByteOrderMarkOrZeroBytes)
+{
+	struct Case
+	{
+		std::string data;
+		Type type;
+		std::size_t bomLength;
+	};
+	const Case cases[]{
+		{ std::string("\xEF\xBB\xBF{}", 5), Type::UTF8, 3 },
+		{ std::string("\xFE\xFF\x00{", 4), Type::UTF16BE, 2 },
+		{ std::string("\xFF\xFE{\x00", 4), Type::UTF16LE, 2 },
+		{ std::string("\x00\x00\xFE\xFF", 4), Type::UTF32BE, 4 },
+		{ std::string("\xFF\xFE\x00\x00", 4), Type::UTF32LE, 4 },
+		{ std::string("\x00\x00\x00{", 4), Type::UTF32BE, 0 },
+		{ std::string("{\x00\x00\x00", 4), Type::UTF32LE, 0 },
+		{ std::string("\x00{\x00}", 4), Type::UTF16BE, 0 },
+		{ std::string("{\x00}\x00", 4), Type::UTF16LE, 0 },
+		{ std::string("\x00{", 2), Type::UTF16BE, 0 },
+		{ std::string("{}", 2), Type::UTF8, 0 },
+		{ std::string("1"), Type::UTF8, 0 },
+		{ std::string(), Type::UTF8, 0 }
+	};
+	for (const Case& c : cases)
+	{
+		std::size_t bomLength{ 99 };
+		EXPECT_EQ(Encoding::DetectType(c.data.data(), c.data.size(), bomLength), c.type) << c.data;
+		EXPECT_EQ(bomLength, c.bomLength) << c.data;
+	}
+}
+
+TEST(EncodingTest, FindInvalidUtf8_FirstInvalidOffset)
+{
+	std::string text{ MakeText(300) };
+	EXPECT_EQ(Encoding::FindInvalidUtf8(text.data(), text.size()), text.size());
+	EXPECT_EQ(Encoding::FindInvalidUtf8(text.data(), 0), 0u);
+
+	// Stray continuation, bad lead, overlong, surrogate, above U+10FFFF, cut sequence.
+	const std::string corruptions[]{ "\x80", "\xFF", "\xC0\x80", "\xE0\x80\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xE2\x82", "\xC3" };
+	for (std::size_t size : { 1, 15, 31, 32, 33, 63, 64, 65, 100 })
+	{
+		std::string valid(size, 'x');
+		valid.replace(size / 3, 0, "\xE2\x82\xAC");
+		for (std::size_t position = 0; position <= valid.size(); ++position)
+		{
+			if (position < valid.size() && (static_cast<uint8_t>(valid[position]) & 0xC0) == 0x80)
+			{
+				continue;
+			}
+			for (const std::string& corruption : corruptions)
+			{
+				std::string data{ valid };
+				data.insert(position, corruption);
+				// A cut sequence followed by ASCII or a lead is invalid at its lead.
+				ASSERT_EQ(Encoding::FindInvalidUtf8(data.data(), data.size()), position) << size << " " << position;
+			}
+		}
+	}
+}
+
+TEST(EncodingTest, GetUtf8SequenceLength_RejectsInvalidForms)
+{
+	auto length = [](const std::string& data) { return Encoding::GetUtf8SequenceLength(reinterpret_cast<const uint8_t*>(data.data()), data.size()); };
+	EXPECT_EQ(length("a"), 1u);
+	EXPECT_EQ(length("\xC2\x80"), 2u);
+	EXPECT_EQ(length("\xE0\xA0\x80"), 3u);
+	EXPECT_EQ(length("\xEF\xBF\xBF"), 3u);
+	EXPECT_EQ(length("\xF0\x90\x80\x80"), 4u);
+	EXPECT_EQ(length("\xF4\x8F\xBF\xBF"), 4u);
+	EXPECT_EQ(length("\xC1\xBF"), 0u);
+	EXPECT_EQ(length("\xE0\x9F\xBF"), 0u);
+	EXPECT_EQ(length("\xED\xA0\x80"), 0u);
+	EXPECT_EQ(length("\xF0\x8F\xBF\xBF"), 0u);
+	EXPECT_EQ(length("\xF4\x90\x80\x80"), 0u);
+	EXPECT_EQ(length("\xE2\x82"), 0u);
+	EXPECT_EQ(length("\xE2\x82x"), 0u);
+}
+
+TEST(EncodingTest, Transcode_AllTypesRoundTrip)
+{
+	for (std::size_t from = 0; from < 5; ++from)
+	{
+		for (std::size_t to = 0; to < 5; ++to)
+		{
+			EXPECT_EQ(Convert(c_unicodeTypes[from], c_sample[from], c_unicodeTypes[to]), c_sample[to]) << from << " " << to;
+		}
+		EXPECT_EQ(Encoding::CountCodePoints(c_unicodeTypes[from], c_sample[from].data(), c_sample[from].size()), 3u);
+	}
+
+	for (std::size_t size : { 0, 1, 31, 100, 1000 })
+	{
+		std::string text{ MakeText(size) };
+		std::size_t codePoints{ Encoding::CountCodePoints(Type::UTF8, text.data(), text.size()) };
+		for (Type type : c_unicodeTypes)
+		{
+			std::string converted{ Convert(Type::UTF8, text, type) };
+			EXPECT_EQ(Encoding::CountCodePoints(type, converted.data(), converted.size()), codePoints);
+			for (Type to : c_unicodeTypes)
+			{
+				EXPECT_EQ(Convert(to, Convert(type, converted, to), Type::UTF8), text) << size;
+			}
+		}
+	}
+
+	// Output is appended to.
+	std::string output{ "x" };
+	EXPECT_EQ(Encoding::Transcode(Type::UTF16LE, "a\0b\0", 4, Type::UTF8, output), 4u);
+	EXPECT_EQ(output, "xab");
+}
+
+TEST(EncodingTest, Transcode_InvalidInputStopsAtOffset)
+{
+	std::string output;
+	std::string ascii(40, 'a');
+
+	// Non-ASCII for ASCII target, converted prefix is kept.
+	std::string text{ ascii + "\xC3\xA9" };
+	EXPECT_EQ(Encoding::Transcode(Type::UTF8, text.data(), text.size(), Type::ASCII, output), 40u);
+	EXPECT_EQ(output, ascii);
+
+	// Lone surrogates and cut units.
+	std::string utf16{ Convert(Type::UTF8, ascii, Type::UTF16LE) };
+	for (const std::string& tail : { std::string("\x00\xDC", 2), std::string("\x3D\xD8", 2), std::string("\x3D\xD8" "a\x00", 4), std::string("a") })
+	{
+		std::string data{ utf16 + tail };
+		output.clear();
+		EXPECT_EQ(Encoding::Transcode(Type::UTF16LE, data.data(), data.size(), Type::UTF8, output), 80u);
+		EXPECT_EQ(output, ascii);
+	}
+	std::string utf32{ Convert(Type::UTF8, ascii, Type::UTF32BE) + std::string("\x00\x11\x00\x00", 4) };
+	output.clear();
+	EXPECT_EQ(Encoding::Transcode(Type::UTF32BE, utf32.data(), utf32.size(), Type::UTF16BE, output), 160u);
+
+	text = ascii + "\xED\xA0\x80";
+	output.clear();
+	EXPECT_EQ(Encoding::Transcode(Type::UTF8, text.data(), text.size(), Type::UTF32LE, output), 40u);
+}
+
+TEST(EncodingTest, TranscodeStream_SmallReads)
+{
+	std::string text{ MakeText(5000) };
+	for (Type type : c_unicodeTypes)
+	{
+		std::string encoded{ Convert(Type::UTF8, text, type) };
+		std::string withBom{ Convert(Type::UTF8, "\xEF\xBB\xBF", type) + encoded };
+		for (std::size_t chunkSize : { 1, 3, 7, 64, 4096 })
+		{
+			ChunkedStream source{ withBom, chunkSize };
+			TranscodeStream stream{ source, 13 };
+			EXPECT_EQ(ReadAll(stream, 5), text) << chunkSize;
+			EXPECT_EQ(stream.GetType(), type);
+
+			ChunkedStream givenSource{ encoded, chunkSize };
+			TranscodeStream givenStream{ givenSource, type, 16 };
+			EXPECT_EQ(ReadAll(givenStream, 100), text) << chunkSize;
+		}
+	}
+
+	std::string empty;
+	ChunkedStream emptySource{ empty, 1 };
+	TranscodeStream emptyStream{ emptySource };
+	EXPECT_EQ(ReadAll(emptyStream, 10), "");
+
+	// Cut last character and invalid text inside a buffer.
+	std::string cut{ Convert(Type::UTF8, text, Type::UTF16BE) + "\xD8" };
+	ChunkedStream cutSource{ cut, 64 };
+	TranscodeStream cutStream{ cutSource, Type::UTF16BE };
+	EXPECT_THROW(ReadAll(cutStream, 100), Error::Exception);
+	std::string invalid{ text + "\xFF" + text };
+	ChunkedStream invalidSource{ invalid, 64 };
+	TranscodeStream invalidStream{ invalidSource };
+	EXPECT_THROW(ReadAll(invalidStream, 100), Error::Exception);
+}
+
+TEST(EncodingTest, ParseJsonAnyEncoding_ConvertsToUtf8)
+{
+	std::string json{ u8"{\"name\":\"café \U0001F600\",\"values\":[1,2.5,true]}" };
+	Dynamic expected = Json::JsonParser::ParseJson(json);
+	for (Type type : c_unicodeTypes)
+	{
+		std::string encoded{ Convert(Type::UTF8, json, type) };
+		EXPECT_EQ(Json::JsonParser::ParseJsonAnyEncoding(encoded.data(), encoded.size()), expected);
+		std::string withBom{ Convert(Type::UTF8, "\xEF\xBB\xBF", type) + encoded };
+		EXPECT_EQ(Json::JsonParser::ParseJsonAnyEncoding(withBom.data(), withBom.size()), expected);
+	}
+
+	std::string invalid{ Convert(Type::UTF8, "[\"a\"]", Type::UTF16LE) + std::string("\x00\xDC", 2) };
+	try
+	{
+		Json::JsonParser::ParseJsonAnyEncoding(invalid.data(), invalid.size());
+		FAIL();
+	}
+	catch (const Json::JsonError& e)
+	{
+		EXPECT_EQ(e.GetErrorCode(), Json::JsonErrorCode::Parse_InvalidEncoding);
+		EXPECT_STREQ(e.what(), "Invalid encoding at offset 10");
+	}
+}
+
+}}
@@ -24,6 +24,7 @@ struct IError
 	defineError(UnexpectOperationError)\
 	defineError(CannotCompareError)\
 	defineError(MalFormatError)\
+	defineError(FileError)\
 
 #define ZEST_DEFINE_ERRORCODE_VALUE(value) value##,
 #define ZEST_DEFINE_DEFINE_ERRORCODE(List) enum class ErrorCode : uint32_t { List(ZEST_DEFINE_ERRORCODE_VALUE) }
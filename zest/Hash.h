@@ -0,0 +1,63 @@
+#pragma once
+#ifndef ZEST_LIB_HASH_H
+#define ZEST_LIB_HASH_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace Zest { namespace Lib { namespace Hash {
+
+// Finalizer of MurmurHash3, every input bit affects every output bit.
+inline uint64_t Mix(uint64_t value) noexcept
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+	return value;
+}
+
+inline uint64_t Combine(uint64_t seed, uint64_t value) noexcept
+{
+	return Mix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+// Non-cryptographic hash which consumes 8 bytes per step.
+inline uint64_t HashBytes(const void* data, std::size_t size, uint64_t seed = 0) noexcept
+{
+	const unsigned char* pData{ static_cast<const unsigned char*>(data) };
+	uint64_t hash{ seed ^ (static_cast<uint64_t>(size) * 0x9e3779b97f4a7c15ULL) };
+
+	while (size >= 8)
+	{
+		uint64_t block;
+		std::memcpy(&block, pData, 8);
+		block *= 0x87c37b91114253d5ULL;
+		block = (block << 31) | (block >> 33);
+		hash = (hash ^ block) * 0x4cf5ad432745937fULL;
+		hash = (hash << 27) | (hash >> 37);
+		pData += 8;
+		size -= 8;
+	}
+
+	if (size > 0)
+	{
+		uint64_t block{ 0 };
+		std::memcpy(&block, pData, size);
+		block *= 0x87c37b91114253d5ULL;
+		hash ^= (block << 31) | (block >> 33);
+	}
+
+	return Mix(hash);
+}
+
+inline uint32_t HashString(const char* data, std::size_t size) noexcept
+{
+	uint64_t hash{ HashBytes(data, size) };
+	return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+}}}
+
+#endif
@@ -3,10 +3,21 @@
 #ifndef ZEST_LIB_JSON_H
 #define ZEST_LIB_JSON_H
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <type_traits>
+#include <vector>
+#include "../Dynamics.h"
 #include "../Error.h"
+#include "../Stream.h"
+#include "JsonError.h"
+#include "JsonNumber.h"
+#include "JsonString.h"
+#include "JsonStructuralIndex.h"
 
 namespace Zest { namespace Lib { namespace Json {
 
@@ -28,6 +39,9 @@ class JsonArray;
 template<JsonValueType, typename TValue = void>
 struct JsonValueTypeMap;
 
+template<typename T>
+struct RVToJVMap;
+
 template<>
 struct JsonValueTypeMap<JsonValueType::Boolean>
 {
@@ -70,68 +84,6 @@ struct JsonValueTypeMap<JsonValueType::Null>
 	using Type = void;
 };
 
-template<typename T>
-struct RVToJVMap;
-
-template<>
-struct RVToJVMap<int>
-{
-	using Type = JsonValue<JsonValueType::Integer>;
-};
-
-template<>
-struct RVToJVMap<int>
-{
-	using Type = JsonValue<JsonValueType::Integer>;
-};
-
-template<>
-struct RVToJVMap<long>
-{
-	using Type = JsonValue<JsonValueType::Integer>;
-};
-
-template<>
-struct RVToJVMap<bool>
-{
-	using Type = JsonValue<JsonValueType::Boolean>;
-};
-
-template<>
-struct RVToJVMap<std::string>
-{
-	using Type = JsonValue<JsonValueType::String>;
-};
-
-template<>
-struct RVToJVMap<const char*>
-{
-	using Type = JsonValue<JsonValueType::String>;
-};
-
-template<>
-struct RVToJVMap<double>
-{
-	using Type = JsonValue<JsonValueType::Double>;
-};
-
-template<>
-struct RVToJVMap<JsonObject>
-{
-	using Type = JsonValue<JsonValueType::Object>;
-};
-
-template<>
-struct RVToJVMap<JsonArray>
-{
-	using Type = JsonValue<JsonValueType::Array>;
-};
-
-template<>
-struct RVToJVMap<void>
-{
-	using Type = JsonValue<JsonValueType::Null>;
-};
 // Null Value
 struct TNull {};
 const struct TNull null_t {};
@@ -156,7 +108,7 @@ public:
 	template<typename T>
 	void SetValue(const std::string& property, const T& value)
 	{
-		std::shared_ptr<RVToJVMap<T>> spValue{ std::make_shared<RVToJVMap<T>>(value) };
+		std::shared_ptr<typename RVToJVMap<T>::Type> spValue{ std::make_shared<typename RVToJVMap<T>::Type>(value) };
 		m_objectMap[property] = spValue;
 	}
 
@@ -183,6 +135,10 @@ private:
 
 struct IJsonValue
 {
+	virtual ~IJsonValue()
+	{
+	}
+
 	virtual JsonValueType GetType() = 0;
 
 	virtual typename JsonValueTypeMap<JsonValueType::Boolean>::Type GetBoolean()
@@ -225,31 +181,31 @@ public:
 		return valueType;
 	}
 
-	template<typename=std::enable_if_t<valueType == JsonValueType::Boolean>>
+	template<JsonValueType type = valueType, typename = std::enable_if_t<type == JsonValueType::Boolean>>
 	typename JsonValueTypeMap<JsonValueType::Boolean>::Type GetBoolean()
 	{
 		return m_value;
 	}
 
-	template<typename = std::enable_if_t<valueType == JsonValueType::Integer>>
+	template<JsonValueType type = valueType, typename = std::enable_if_t<type == JsonValueType::Integer>>
 	typename JsonValueTypeMap<JsonValueType::Integer>::Type GetInteger()
 	{
 		return m_value;
 	}
 
-	template<typename = std::enable_if_t<valueType == JsonValueType::String>>
+	template<JsonValueType type = valueType, typename = std::enable_if_t<type == JsonValueType::String>>
 	typename JsonValueTypeMap<JsonValueType::String>::Type& GetString()
 	{
 		return m_value;
 	}
 
-	template<typename = std::enable_if_t<valueType == JsonValueType::Double>>
+	template<JsonValueType type = valueType, typename = std::enable_if_t<type == JsonValueType::Double>>
 	typename JsonValueTypeMap<JsonValueType::Double>::Type GetDouble()
 	{
 		return m_value;
 	}
 
-	template<typename = std::enable_if_t<valueType == JsonValueType::Object>>
+	template<JsonValueType type = valueType, typename = std::enable_if_t<type == JsonValueType::Object>>
 	typename JsonValueTypeMap<JsonValueType::Object>::Type& GetObject()
 	{
 		return m_value;
@@ -303,11 +259,65 @@ public:
 	}
 };
 
+template<>
+struct RVToJVMap<int>
+{
+	using Type = JsonValue<JsonValueType::Integer>;
+};
+
+template<>
+struct RVToJVMap<long>
+{
+	using Type = JsonValue<JsonValueType::Integer>;
+};
+
+template<>
+struct RVToJVMap<bool>
+{
+	using Type = JsonValue<JsonValueType::Boolean>;
+};
+
+template<>
+struct RVToJVMap<std::string>
+{
+	using Type = JsonValue<JsonValueType::String>;
+};
+
+template<>
+struct RVToJVMap<const char*>
+{
+	using Type = JsonValue<JsonValueType::String>;
+};
+
+template<>
+struct RVToJVMap<double>
+{
+	using Type = JsonValue<JsonValueType::Double>;
+};
+
+template<>
+struct RVToJVMap<JsonObject>
+{
+	using Type = JsonValue<JsonValueType::Object>;
+};
+
+template<>
+struct RVToJVMap<JsonArray>
+{
+	using Type = JsonValue<JsonValueType::Array>;
+};
+
+template<>
+struct RVToJVMap<void>
+{
+	using Type = JsonValue<JsonValueType::Null>;
+};
+
 
 /*! Stream to store json data.
 	Please don't  destruct orginal string when stream is in use.
 */
-class JsonStringStream
+class JsonStringStream: public IStream
 {
 public:
 	JsonStringStream(const std::string& jsonString)
@@ -348,136 +358,325 @@ public:
 		return c;
 	}
 
+	std::size_t Read(char* pBuffer, std::size_t size) override
+	{
+		std::size_t readSize{ size < GetRemainingSize() ? size : GetRemainingSize() };
+		std::memcpy(pBuffer, m_cur, readSize);
+		m_cur += readSize;
+		return readSize;
+	}
+
+	const char* GetCurrent() const
+	{
+		return m_cur;
+	}
+
+	size_t GetRemainingSize() const
+	{
+		return static_cast<size_t>(m_end - m_cur);
+	}
+
 private:
-	const char* m_cur;
 	const char* m_begin;
-	const char* m_current;
+	const char* m_cur;
 	const char* m_end;
 	size_t m_size;
 };
 
-enum class JsonErrorCode: uint32_t
-{
-	Parse_EmptyBody,
-	Parse_Malformat,
-};
-
-class JsonError: public std::exception
+/*! Parse json text into Dynamic in two stages.
+	Stage 1 builds JsonStructuralIndex of the whole input with SIMD, stage 2 walks the index
+	to build values, so it never scans whitespace or string content byte by byte.
+	Integers which fit Int32 are Int32, larger ones Int64, others are Double.
+	Parser can be reused for many documents, index memory and key cache are kept.
+	With isBorrowString strings are not copied, they view input and escaped ones are unescaped
+	when first read. Input must then outlive the result, or be released after Dynamic::MakeOwned.
+*/
+class JsonParser
 {
 public:
-	JsonError(const JsonErrorCode errorCode, const char* errorMsg)
-		: m_errorCode{ errorCode }, m_errorMsg{ errorMsg ? errorMsg : "" }
+	// Nesting deeper than this is rejected, so malicious input can't overflow stack.
+	static constexpr std::size_t c_maxDepth{ 1024 };
+
+	JsonParser() = default;
+	JsonParser(const JsonParser&) = delete;
+	JsonParser& operator=(const JsonParser&) = delete;
+
+	static Dynamic ParseJson(const std::string& jsonString)
+	{
+		return ParseJson(jsonString.c_str(), jsonString.size());
+	}
+
+	static Dynamic ParseJson(const char* jsonString)
+	{
+		return ParseJson(jsonString, strlen(jsonString));
+	}
+
+	static Dynamic ParseJson(const char* jsonString, size_t size, bool isBorrowString = false)
 	{
+		JsonParser parser;
+		return parser.Parse(jsonString, size, isBorrowString);
 	}
 
-	const char* what() const noexcept
+	// Parses UTF-8, UTF-16 or UTF-32 text with or without byte order mark, see Encoding::DetectType.
+	// Other than UTF-8 is converted to UTF-8 first, offsets of errors are then in converted text.
+	static Dynamic ParseJsonAnyEncoding(const char* jsonString, size_t size)
 	{
-		return m_errorMsg.c_str();
+		std::size_t bomLength;
+		Encoding::Type type{ Encoding::DetectType(jsonString, size, bomLength) };
+		if (type == Encoding::Type::UTF8 || type == Encoding::Type::ASCII)
+		{
+			return ParseJson(jsonString + bomLength, size - bomLength);
+		}
+
+		std::string utf8;
+		std::size_t end{ Encoding::Transcode(type, jsonString + bomLength, size - bomLength, Encoding::Type::UTF8, utf8) };
+		if (end != size - bomLength)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_InvalidEncoding, "Invalid encoding", bomLength + end);
+		}
+		return ParseJson(utf8.data(), utf8.size());
 	}
 
-	JsonErrorCode GetErrorCode() const
+	Dynamic Parse(const char* jsonString, size_t size, bool isBorrowString = false)
 	{
-		return m_errorCode;
+		m_index.Build(jsonString, size);
+		if (m_index.Size() == 0)
+		{
+			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+		}
+
+		m_pInput = jsonString;
+		m_inputSize = size;
+		m_next = 0;
+		m_isBorrowString = isBorrowString;
+		Dynamic value = ParseValue(0);
+		if (m_next != m_index.Size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected content after value", m_index[m_next]);
+		}
+		return value;
 	}
+
 private:
-	JsonErrorCode m_errorCode;
-	std::string m_errorMsg;
-};
+	uint32_t NextPosition()
+	{
+		if (m_next == m_index.Size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected end", m_inputSize);
+		}
+		return m_index[m_next++];
+	}
 
-class JsonParser
-{
-public:
-	static std::shared_ptr<IJsonValue> ParseJson(const std::string& jsonString)
+	char PeekCharacter() const noexcept
 	{
-		return ParseJson(jsonString.c_str(), jsonString.size());
+		return m_next < m_index.Size() ? m_pInput[m_index[m_next]] : '\0';
 	}
 
-	static std::shared_ptr<IJsonValue> ParseJson(const char* jsonString)
+	[[noreturn]] static void ThrowUnexpected(std::size_t position)
 	{
-		return ParseJson(jsonString, strlen(jsonString));
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", position);
 	}
 
-	static std::shared_ptr<IJsonValue> ParseJson(const char* jsonString, size_t size)
+	Dynamic ParseValue(std::size_t depth)
 	{
-		JsonStringStream jsonStream{ jsonString, size };
-		SkipWhiteAndNewLine(jsonStream);
-		if (jsonStream.IsEnd())
+		uint32_t position{ NextPosition() };
+		switch (m_pInput[position])
 		{
-			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+			case '{':
+				return ParseObject(position, depth + 1);
+			case '[':
+				return ParseArray(position, depth + 1);
+			case '"':
+				return m_isBorrowString ? ReadBorrowedString(position) : Dynamic(ReadString(position));
+			case 't':
+				ParseLiteral(position, "true", 4);
+				return Dynamic(true);
+			case 'f':
+				ParseLiteral(position, "false", 5);
+				return Dynamic(false);
+			case 'n':
+				ParseLiteral(position, "null", 4);
+				return Dynamic();
+			default:
+				return ParseNumber(position);
 		}
+	}
 
-		char c{ jsonStream.Peek() };
+	Dynamic ParseObject(uint32_t position, std::size_t depth)
+	{
+		if (depth > c_maxDepth)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", position);
+		}
 
-		if (c == '{') // if object
+		Dynamic object = Dynamic::MakeObject();
+		if (PeekCharacter() == '}')
 		{
-			return  ParseObject(jsonStream);
+			++m_next;
+			return object;
 		}
-		else if (c == '[') // if array
+
+		ValueMap::ObjectMap& objectMap{ object.GetObjectMap() };
+		for (;;)
 		{
-			return ParseArray(jsonStream);
+			position = NextPosition();
+			if (m_pInput[position] != '"')
+			{
+				ThrowUnexpected(position);
+			}
+			DynamicKey key{ ReadKey(position) };
+
+			position = NextPosition();
+			if (m_pInput[position] != ':')
+			{
+				ThrowUnexpected(position);
+			}
+			objectMap.Set(key, ParseValue(depth));
+
+			position = NextPosition();
+			if (m_pInput[position] == '}')
+			{
+				return object;
+			}
+			if (m_pInput[position] != ',')
+			{
+				ThrowUnexpected(position);
+			}
 		}
-		else if ((c == 'n' || c == 'N') && CheckIsNull(jsonStream))
+	}
+
+	Dynamic ParseArray(uint32_t position, std::size_t depth)
+	{
+		if (depth > c_maxDepth)
 		{
-			return nullptr;
+			throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", position);
 		}
-		else
+
+		// Array allocated from current arena, so it is not copied when wrapped in Dynamic.
+		std::pmr::memory_resource* pMemoryResource{ ScopedDynamicArena::GetCurrentMemoryResource() };
+		ValueMap::Array array(pMemoryResource != nullptr ? pMemoryResource : std::pmr::get_default_resource());
+		if (PeekCharacter() == ']')
 		{
-			std::string errorMsg{ "Unknown start of json: " };
-			errorMsg += c;
-			throw JsonError{JsonErrorCode::Parse_Malformat, errorMsg.c_str() };
+			++m_next;
+			return Dynamic(std::move(array));
 		}
 
-		std::string errorMsg{ "Cannot parse content: " };
-		errorMsg += jsonString;
-		throw JsonError{ JsonErrorCode::Parse_Malformat, errorMsg.c_str() };
+		for (;;)
+		{
+			array.push_back(ParseValue(depth));
+			position = NextPosition();
+			if (m_pInput[position] == ']')
+			{
+				return Dynamic(std::move(array));
+			}
+			if (m_pInput[position] != ',')
+			{
+				ThrowUnexpected(position);
+			}
+		}
+	}
+
+	// Content between opening quote at position and closing quote, which is the next index entry.
+	ValueMap::StringView ReadRawString(uint32_t position)
+	{
+		uint32_t end{ NextPosition() };
+		return ValueMap::StringView{ m_pInput + position + 1, end - position - 1 };
 	}
-private:
 
-	static std::shared_ptr<IJsonValue> ParseObject(JsonStringStream& jss)
+	ValueMap::String ReadString(uint32_t position)
 	{
-		SkipWhiteAndNewLine(jss);
-		assert(jss.Peek() == '{');
+		ValueMap::StringView raw{ ReadRawString(position) };
+		if (std::memchr(raw.data(), '\\', raw.size()) == nullptr)
+		{
+			return ValueMap::String(raw);
+		}
+		ValueMap::String value;
+		JsonString::Unescape(raw, position + 1, value);
+		return value;
+	}
 
+	Dynamic ReadBorrowedString(uint32_t position)
+	{
+		ValueMap::StringView raw{ ReadRawString(position) };
+		if (std::memchr(raw.data(), '\\', raw.size()) == nullptr)
+		{
+			return Dynamic::MakeBorrowedString(raw);
+		}
+		// Escapes are checked now into reused scratch, so decoding on first read can't fail.
+		m_scratch.clear();
+		JsonString::Unescape(raw, position + 1, m_scratch);
+		return Dynamic::MakeBorrowedString(raw, [](const ValueMap::StringView source, std::pmr::string& value)
+		{
+			JsonString::Unescape(source, 0, value);
+		});
+	}
 
+	// Keys repeat across objects of a document, cache avoids locking the process wide key table,
+	// and names from input are not added to it.
+	DynamicKey ReadKey(uint32_t position)
+	{
+		ValueMap::StringView raw{ ReadRawString(position) };
+		if (std::memchr(raw.data(), '\\', raw.size()) != nullptr)
+		{
+			m_scratch.clear();
+			JsonString::Unescape(raw, position + 1, m_scratch);
+			return m_keyCache.Get(m_scratch.data(), m_scratch.size());
+		}
+		return m_keyCache.Get(raw.data(), raw.size());
 	}
 
-	static std::shared_ptr<IJsonValue> ParseArray(JsonStringStream& jss)
+	// Number or literal must end at whitespace, operator or end of input.
+	bool IsTokenEnd(std::size_t position) const noexcept
 	{
-		SkipWhiteAndNewLine(jss);
-		assert(jss.Peek() == '[');
+		if (position >= m_inputSize)
+		{
+			return true;
+		}
+		switch (m_pInput[position])
+		{
+			case ' ': case '\t': case '\n': case '\r':
+			case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+				return true;
+			default:
+				return false;
+		}
 	}
 
+	void ParseLiteral(uint32_t position, const char* literal, std::size_t length) const
+	{
+		if (m_inputSize - position < length || std::memcmp(m_pInput + position, literal, length) != 0 || !IsTokenEnd(position + length))
+		{
+			ThrowUnexpected(position);
+		}
+	}
 
-	static void SkipWhiteAndNewLine(JsonStringStream& jss)
+	Dynamic ParseNumber(uint32_t position) const
 	{
-		char c;
-		while (!jss.IsEnd() && ((c = jss.Peek()) == ' ' || c == '\n' || c == '\r' || c == '\t'))
+		JsonNumber number;
+		const char* pEnd{ JsonNumber::Parse(m_pInput + position, m_pInput + m_inputSize, position, number) };
+		if (!IsTokenEnd(static_cast<std::size_t>(pEnd - m_pInput)))
 		{
-			jss.Skip(1);
+			ThrowUnexpected(static_cast<std::size_t>(pEnd - m_pInput));
 		}
-		return;
-	}
-
-	static bool CheckIsNull(JsonStringStream& jss) noexcept
-	{
-		SkipWhiteAndNewLine(jss);
-		char c;
-		c = jss.Peek();
-		if (c != 'N' && c != 'n')
-			return false;
-		jss.Skip(1);
-		if (c != 'U' && c != 'u')
-			return false;
-		jss.Skip(1);
-		if (c != 'l' && c != 'l')
-			return false;
-		jss.Skip(1);
-		if (c != 'l' && c != 'l')
-			return false;
-		jss.Skip(1);
 
-		return true;
+		if (!number.isInteger)
+		{
+			return Dynamic(number.value);
+		}
+		if (number.integer >= std::numeric_limits<ValueMap::Int32>::min() && number.integer <= std::numeric_limits<ValueMap::Int32>::max())
+		{
+			return Dynamic(static_cast<ValueMap::Int32>(number.integer));
+		}
+		return Dynamic(static_cast<ValueMap::Int64>(number.integer));
 	}
+
+	JsonStructuralIndex m_index;
+	const char* m_pInput{ nullptr };
+	std::size_t m_inputSize{ 0 };
+	std::size_t m_next{ 0 };
+	bool m_isBorrowString{ false };
+	ValueMap::String m_scratch;
+	DynamicKeyCache m_keyCache;
 };
 
 }}}
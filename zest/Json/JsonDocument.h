@@ -0,0 +1,522 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONDOCUMENT_H
+#define ZEST_LIB_JSONDOCUMENT_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../Error.h"
+#include "Json.h"
+#include "JsonError.h"
+#include "JsonNumber.h"
+#include "JsonString.h"
+#include "JsonStructuralIndex.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+class JsonDocument;
+
+/*! Position of a value in JsonDocument, value is decoded only by its getters.
+	Cursor is two words and is only valid while its document and the input are.
+	Cursor of a missing property or element is empty, its type is Null.
+	Getters of another type throw AcessDenied error, like Dynamic does.
+*/
+class JsonCursor
+{
+public:
+	JsonCursor() noexcept = default;
+
+	bool IsEmpty() const noexcept
+	{
+		return m_pDocument == nullptr;
+	}
+
+	JsonValueType GetType() const;
+	bool IsNull() const;
+	bool GetBool() const;
+	int64_t GetInt64() const;
+	// Integers are converted too.
+	double GetDouble() const;
+	// Points into input when string has no escapes, otherwise into document.
+	std::string_view GetString() const;
+
+	// Number of elements or properties, found by jumping over each of them.
+	std::size_t Size() const;
+	JsonCursor Find(std::string_view propertyName) const;
+	JsonCursor operator[](std::string_view propertyName) const;
+	JsonCursor operator[](std::size_t index) const;
+
+	template<typename TFunc>
+	void ForEachProperty(TFunc&& func) const;
+
+	template<typename TFunc>
+	void ForEachElement(TFunc&& func) const;
+
+private:
+	friend class JsonDocument;
+
+	JsonCursor(const JsonDocument* pDocument, uint32_t entry) noexcept
+		: m_pDocument{ pDocument }, m_entry{ entry }
+	{
+	}
+
+	char GetCharacter() const;
+	void ReadNumber(JsonNumber& number) const;
+	// Entry of first property key or element, or of closing bracket when container is empty.
+	uint32_t GetFirstEntry(char container) const;
+
+	const JsonDocument* m_pDocument{ nullptr };
+	// Entry of value in structural index.
+	uint32_t m_entry{ 0 };
+};
+
+/*! On-demand json document, for reading a few fields of large documents.
+	Parse builds JsonStructuralIndex and validates structure of brackets, keys, commas and colons
+	and literals up front. Numbers are checked when they are read, strings are unescaped when they are read.
+	Each bracket knows its matching bracket, so untouched containers are jumped over in constant time.
+	Input must outlive the document and its cursors. Document can be reused, which invalidates cursors.
+*/
+class JsonDocument
+{
+public:
+	static constexpr std::size_t c_maxDepth{ 1024 };
+
+	JsonDocument() = default;
+	JsonDocument(const JsonDocument&) = delete;
+	JsonDocument& operator=(const JsonDocument&) = delete;
+
+	JsonCursor Parse(const std::string& jsonString)
+	{
+		return Parse(jsonString.data(), jsonString.size());
+	}
+
+	JsonCursor Parse(const char* jsonString, size_t size)
+	{
+		m_pInput = jsonString;
+		m_inputSize = size;
+		m_unescapedStrings.clear();
+		m_index.Build(jsonString, size);
+		if (m_index.Size() == 0)
+		{
+			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+		}
+		if (m_jumpCapacity < m_index.Size())
+		{
+			m_jumpCapacity = m_index.Size();
+			m_spJumps.reset(new uint32_t[m_jumpCapacity]);
+		}
+		Validate();
+		return GetRoot();
+	}
+
+	JsonCursor GetRoot() const noexcept
+	{
+		return JsonCursor{ this, 0 };
+	}
+
+private:
+	friend class JsonCursor;
+
+	enum class Expect
+	{
+		Value,
+		ValueOrEnd,
+		Key,
+		KeyOrEnd,
+		Colon,
+		SeparatorOrEnd
+	};
+
+	[[noreturn]] void ThrowUnexpected(uint32_t entry) const
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", m_index[entry]);
+	}
+
+	// Walk structural index once, checking grammar and recording matching brackets.
+	void Validate()
+	{
+		m_openEntries.clear();
+		uint32_t count{ static_cast<uint32_t>(m_index.Size()) };
+		Expect expect{ Expect::Value };
+		for (uint32_t entry = 0; entry < count; ++entry)
+		{
+			uint32_t position{ m_index[entry] };
+			char c{ m_pInput[position] };
+			switch (expect)
+			{
+				case Expect::ValueOrEnd:
+					if (c == ']')
+					{
+						Close(entry, '[');
+						expect = Expect::SeparatorOrEnd;
+						break;
+					}
+					// fallthrough
+				case Expect::Value:
+					expect = Expect::SeparatorOrEnd;
+					switch (c)
+					{
+						case '{':
+						case '[':
+							if (m_openEntries.size() == c_maxDepth)
+							{
+								throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", position);
+							}
+							m_openEntries.push_back(entry);
+							expect = c == '{' ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+							break;
+						case '"':
+							// Closing quote is always next entry.
+							++entry;
+							break;
+						case 't':
+							ValidateLiteral(entry, "true", 4);
+							break;
+						case 'f':
+							ValidateLiteral(entry, "false", 5);
+							break;
+						case 'n':
+							ValidateLiteral(entry, "null", 4);
+							break;
+						default:
+							// Numbers are checked when they are read.
+							if (c != '-' && (c < '0' || c > '9'))
+							{
+								ThrowUnexpected(entry);
+							}
+							break;
+					}
+					break;
+				case Expect::KeyOrEnd:
+					if (c == '}')
+					{
+						Close(entry, '{');
+						expect = Expect::SeparatorOrEnd;
+						break;
+					}
+					// fallthrough
+				case Expect::Key:
+					if (c != '"')
+					{
+						ThrowUnexpected(entry);
+					}
+					++entry;
+					expect = Expect::Colon;
+					break;
+				case Expect::Colon:
+					if (c != ':')
+					{
+						ThrowUnexpected(entry);
+					}
+					expect = Expect::Value;
+					break;
+				case Expect::SeparatorOrEnd:
+					if (m_openEntries.empty())
+					{
+						throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected content after value", position);
+					}
+					if (c == ',')
+					{
+						expect = m_pInput[m_index[m_openEntries.back()]] == '{' ? Expect::Key : Expect::Value;
+					}
+					else if (c == '}' || c == ']')
+					{
+						Close(entry, c == '}' ? '{' : '[');
+					}
+					else
+					{
+						ThrowUnexpected(entry);
+					}
+					break;
+			}
+		}
+		if (expect != Expect::SeparatorOrEnd || !m_openEntries.empty())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected end", m_inputSize);
+		}
+	}
+
+	void Close(uint32_t entry, char container)
+	{
+		if (m_openEntries.empty() || m_pInput[m_index[m_openEntries.back()]] != container)
+		{
+			ThrowUnexpected(entry);
+		}
+		m_spJumps[m_openEntries.back()] = entry;
+		m_openEntries.pop_back();
+	}
+
+	void ValidateLiteral(uint32_t entry, const char* literal, std::size_t length) const
+	{
+		uint32_t position{ m_index[entry] };
+		if (m_inputSize - position < length || std::memcmp(m_pInput + position, literal, length) != 0 || !IsTokenEnd(position + length))
+		{
+			ThrowUnexpected(entry);
+		}
+	}
+
+	// Number or literal must end at whitespace, operator or end of input.
+	bool IsTokenEnd(std::size_t position) const noexcept
+	{
+		if (position >= m_inputSize)
+		{
+			return true;
+		}
+		switch (m_pInput[position])
+		{
+			case ' ': case '\t': case '\n': case '\r':
+			case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	// Entry after value starting at entry.
+	uint32_t Next(uint32_t entry) const noexcept
+	{
+		switch (m_pInput[m_index[entry]])
+		{
+			case '{':
+			case '[':
+				return m_spJumps[entry] + 1;
+			case '"':
+				return entry + 2;
+			default:
+				return entry + 1;
+		}
+	}
+
+	// Content between quote at entry and closing quote at next entry.
+	std::string_view GetRawString(uint32_t entry) const noexcept
+	{
+		uint32_t position{ m_index[entry] + 1 };
+		return std::string_view{ m_pInput + position, m_index[entry + 1] - position };
+	}
+
+	std::string_view GetString(uint32_t entry) const
+	{
+		std::string_view raw{ GetRawString(entry) };
+		if (std::memchr(raw.data(), '\\', raw.size()) == nullptr)
+		{
+			return raw;
+		}
+		std::string& value{ m_unescapedStrings[entry] };
+		if (value.empty())
+		{
+			JsonString::Unescape(raw, m_index[entry] + 1, value);
+		}
+		return value;
+	}
+
+	JsonStructuralIndex m_index;
+	std::unique_ptr<uint32_t[]> m_spJumps;
+	std::size_t m_jumpCapacity{ 0 };
+	std::vector<uint32_t> m_openEntries;
+	const char* m_pInput{ nullptr };
+	std::size_t m_inputSize{ 0 };
+	// Escaped strings decoded by cursors, by entry of opening quote.
+	mutable std::unordered_map<uint32_t, std::string> m_unescapedStrings;
+};
+
+inline char JsonCursor::GetCharacter() const
+{
+	if (IsEmpty())
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return m_pDocument->m_pInput[m_pDocument->m_index[m_entry]];
+}
+
+inline void JsonCursor::ReadNumber(JsonNumber& number) const
+{
+	char c{ GetCharacter() };
+	if (c != '-' && (c < '0' || c > '9'))
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	const char* pInput{ m_pDocument->m_pInput };
+	uint32_t position{ m_pDocument->m_index[m_entry] };
+	const char* pEnd{ JsonNumber::Parse(pInput + position, pInput + m_pDocument->m_inputSize, position, number) };
+	if (!m_pDocument->IsTokenEnd(static_cast<std::size_t>(pEnd - pInput)))
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", static_cast<std::size_t>(pEnd - pInput));
+	}
+}
+
+inline JsonValueType JsonCursor::GetType() const
+{
+	if (IsEmpty())
+	{
+		return JsonValueType::Null;
+	}
+	switch (GetCharacter())
+	{
+		case '{':
+			return JsonValueType::Object;
+		case '[':
+			return JsonValueType::Array;
+		case '"':
+			return JsonValueType::String;
+		case 't':
+		case 'f':
+			return JsonValueType::Boolean;
+		case 'n':
+			return JsonValueType::Null;
+		default:
+		{
+			JsonNumber number;
+			ReadNumber(number);
+			return number.isInteger ? JsonValueType::Integer : JsonValueType::Double;
+		}
+	}
+}
+
+inline bool JsonCursor::IsNull() const
+{
+	return IsEmpty() || GetCharacter() == 'n';
+}
+
+inline bool JsonCursor::GetBool() const
+{
+	char c{ GetCharacter() };
+	if (c != 't' && c != 'f')
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return c == 't';
+}
+
+inline int64_t JsonCursor::GetInt64() const
+{
+	JsonNumber number;
+	ReadNumber(number);
+	if (!number.isInteger)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return number.integer;
+}
+
+inline double JsonCursor::GetDouble() const
+{
+	JsonNumber number;
+	ReadNumber(number);
+	return number.isInteger ? static_cast<double>(number.integer) : number.value;
+}
+
+inline std::string_view JsonCursor::GetString() const
+{
+	if (GetCharacter() != '"')
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return m_pDocument->GetString(m_entry);
+}
+
+inline uint32_t JsonCursor::GetFirstEntry(char container) const
+{
+	if (GetCharacter() != container)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return m_entry + 1;
+}
+
+inline std::size_t JsonCursor::Size() const
+{
+	std::size_t size{ 0 };
+	if (GetCharacter() == '{')
+	{
+		ForEachProperty([&size](std::string_view, const JsonCursor&) { ++size; });
+	}
+	else
+	{
+		ForEachElement([&size](const JsonCursor&) { ++size; });
+	}
+	return size;
+}
+
+inline JsonCursor JsonCursor::Find(std::string_view propertyName) const
+{
+	const JsonDocument& document{ *m_pDocument };
+	uint32_t entry{ GetFirstEntry('{') };
+	uint32_t end{ document.m_spJumps[m_entry] };
+	while (entry != end)
+	{
+		// Key quotes, colon, then value.
+		std::string_view raw{ document.GetRawString(entry) };
+		bool isMatched{ raw.size() == propertyName.size() && raw == propertyName };
+		if (!isMatched && raw.size() >= propertyName.size() && std::memchr(raw.data(), '\\', raw.size()) != nullptr)
+		{
+			isMatched = document.GetString(entry) == propertyName;
+		}
+		if (isMatched)
+		{
+			return JsonCursor{ m_pDocument, entry + 3 };
+		}
+		entry = document.Next(entry + 3);
+		// Skip comma.
+		entry += entry != end ? 1 : 0;
+	}
+	return JsonCursor{};
+}
+
+inline JsonCursor JsonCursor::operator[](std::string_view propertyName) const
+{
+	return Find(propertyName);
+}
+
+inline JsonCursor JsonCursor::operator[](std::size_t index) const
+{
+	const JsonDocument& document{ *m_pDocument };
+	uint32_t entry{ GetFirstEntry('[') };
+	uint32_t end{ document.m_spJumps[m_entry] };
+	for (; entry != end; --index)
+	{
+		if (index == 0)
+		{
+			return JsonCursor{ m_pDocument, entry };
+		}
+		entry = document.Next(entry);
+		entry += entry != end ? 1 : 0;
+	}
+	return JsonCursor{};
+}
+
+template<typename TFunc>
+inline void JsonCursor::ForEachProperty(TFunc&& func) const
+{
+	const JsonDocument& document{ *m_pDocument };
+	uint32_t entry{ GetFirstEntry('{') };
+	uint32_t end{ document.m_spJumps[m_entry] };
+	while (entry != end)
+	{
+		func(document.GetString(entry), JsonCursor{ m_pDocument, entry + 3 });
+		entry = document.Next(entry + 3);
+		entry += entry != end ? 1 : 0;
+	}
+}
+
+template<typename TFunc>
+inline void JsonCursor::ForEachElement(TFunc&& func) const
+{
+	const JsonDocument& document{ *m_pDocument };
+	uint32_t entry{ GetFirstEntry('[') };
+	uint32_t end{ document.m_spJumps[m_entry] };
+	while (entry != end)
+	{
+		func(JsonCursor{ m_pDocument, entry });
+		entry = document.Next(entry);
+		entry += entry != end ? 1 : 0;
+	}
+}
+
+}}}
+
+#endif
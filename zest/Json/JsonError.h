@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONERROR_H
+#define ZEST_LIB_JSONERROR_H
+
+#include <cstdint>
+#include <exception>
+#include <string>
+
+namespace Zest { namespace Lib { namespace Json {
+
+enum class JsonErrorCode: uint32_t
+{
+	Parse_EmptyBody,
+	Parse_Malformat,
+	Parse_InvalidEncoding,
+	Parse_TooDeep,
+	// Schema given to JsonSchema::Compile is malformed or uses an unsupported keyword.
+	Schema_Invalid,
+	// Document doesn't match its schema.
+	Schema_Violation,
+};
+
+class JsonError: public std::exception
+{
+public:
+	JsonError(const JsonErrorCode errorCode, const char* errorMsg)
+		: m_errorCode{ errorCode }, m_errorMsg{ errorMsg ? errorMsg : "" }
+	{
+	}
+
+	const char* what() const noexcept
+	{
+		return m_errorMsg.c_str();
+	}
+
+	JsonErrorCode GetErrorCode() const
+	{
+		return m_errorCode;
+	}
+
+	// Error with byte offset of input where it was found, e.g. "Unexpected character at offset 12".
+	static JsonError AtOffset(const JsonErrorCode errorCode, const char* errorMsg, std::size_t offset)
+	{
+		std::string message{ errorMsg };
+		message += " at offset ";
+		message += std::to_string(offset);
+		return JsonError{ errorCode, message.c_str() };
+	}
+private:
+	JsonErrorCode m_errorCode;
+	std::string m_errorMsg;
+};
+
+}}}
+
+#endif
@@ -0,0 +1,286 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONLINESREADER_H
+#define ZEST_LIB_JSONLINESREADER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../Dynamics.h"
+#include "../ThreadPool.h"
+#include "Json.h"
+#include "JsonError.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+// Order in which JsonLinesReader returns lines.
+enum class JsonLinesOrder
+{
+	// Same order as in input.
+	Ordered,
+	// Lines of a chunk stay in order, chunks come as soon as they are parsed.
+	Unordered
+};
+
+struct JsonLine
+{
+	Dynamic value;
+	// Byte offset of line in input.
+	std::size_t offset;
+};
+
+/*! Parallel reader of newline delimited json (NDJSON, JSON Lines) in memory, e.g. a mapped file.
+	Input is cut into chunks of about chunk size, each task on pool finds its own first and
+	last line, which is safe because json text never contains a raw new line. Blank lines are skipped.
+	At most max pending chunks are parsed or waiting for Read, next chunk is posted when Read
+	takes one, so memory stays bounded however slow the consumer is.
+		JsonLinesReader reader{ pool, pData, size };
+		reader.SetOrder(JsonLinesOrder::Unordered);
+		JsonLine line;
+		while (reader.Read(line)) { ... }
+	Input and pool must outlive reader, pool must not be stopped while reader has tasks.
+*/
+class JsonLinesReader
+{
+public:
+	static constexpr std::size_t c_defaultChunkSize{ 1 << 20 };
+	static constexpr std::size_t c_defaultMaxPendingChunks{ 16 };
+
+	JsonLinesReader(ThreadPool& pool, const char* pInput, std::size_t size) noexcept
+		: m_pool{ pool }, m_pInput{ pInput }, m_size{ size }
+	{
+	}
+
+	JsonLinesReader(const JsonLinesReader&) = delete;
+	JsonLinesReader& operator=(const JsonLinesReader&) = delete;
+
+	// Waits for posted tasks, which stop at their next line.
+	~JsonLinesReader()
+	{
+		m_isCancelled = true;
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		m_chunkChanged.wait(lock, [this]() { return m_runningCount == 0; });
+	}
+
+	// Setters are only valid before first Read.
+	JsonLinesReader& SetOrder(JsonLinesOrder order) noexcept
+	{
+		assert(!m_isStarted);
+		m_order = order;
+		return *this;
+	}
+
+	JsonLinesReader& SetChunkSize(std::size_t chunkSize) noexcept
+	{
+		assert(!m_isStarted);
+		m_chunkSize = std::max<std::size_t>(chunkSize, 1);
+		return *this;
+	}
+
+	JsonLinesReader& SetMaxPendingChunks(std::size_t maxPendingChunks) noexcept
+	{
+		assert(!m_isStarted);
+		m_maxPendingChunks = std::max<std::size_t>(maxPendingChunks, 1);
+		return *this;
+	}
+
+	// Strings of values view input, see JsonParser::Parse.
+	JsonLinesReader& SetBorrowString(bool isBorrowString) noexcept
+	{
+		assert(!m_isStarted);
+		m_isBorrowString = isBorrowString;
+		return *this;
+	}
+
+	/*! Next line, false after the last one. Waits while the chunk of the line is parsed.
+		Throws JsonError of an invalid line when it is reached, reader is at end after that.
+	*/
+	bool Read(JsonLine& line)
+	{
+		if (!m_isStarted)
+		{
+			Start();
+		}
+		for (;;)
+		{
+			if (m_position < m_current.lines.size())
+			{
+				line = std::move(m_current.lines[m_position++]);
+				return true;
+			}
+			if (m_current.spError != nullptr)
+			{
+				std::exception_ptr spError{ m_current.spError };
+				m_current.spError = nullptr;
+				m_consumedCount = m_chunkCount;
+				m_isCancelled = true;
+				std::rethrow_exception(spError);
+			}
+			if (m_consumedCount == m_chunkCount)
+			{
+				return false;
+			}
+			TakeChunk();
+		}
+	}
+
+private:
+	struct Chunk
+	{
+		std::size_t index{ 0 };
+		std::vector<JsonLine> lines;
+		// Lines before the invalid one are still returned.
+		std::exception_ptr spError;
+	};
+
+	void Start()
+	{
+		m_isStarted = true;
+		m_chunkCount = (m_size + m_chunkSize - 1) / m_chunkSize;
+		while (m_postedCount < std::min(m_chunkCount, m_maxPendingChunks))
+		{
+			PostChunk();
+		}
+	}
+
+	void PostChunk()
+	{
+		std::size_t index{ m_postedCount++ };
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			++m_runningCount;
+		}
+		m_pool.Post([this, index]() noexcept
+		{
+			ParseChunk(index);
+		});
+	}
+
+	void TakeChunk()
+	{
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		std::deque<Chunk>::iterator itChunk;
+		m_chunkChanged.wait(lock, [this, &itChunk]()
+		{
+			itChunk = m_order == JsonLinesOrder::Ordered
+				? std::find_if(m_completed.begin(), m_completed.end(), [this](const Chunk& chunk) { return chunk.index == m_consumedCount; })
+				: m_completed.begin();
+			return itChunk != m_completed.end();
+		});
+		m_current = std::move(*itChunk);
+		m_completed.erase(itChunk);
+		lock.unlock();
+
+		m_position = 0;
+		++m_consumedCount;
+		if (m_postedCount < m_chunkCount)
+		{
+			PostChunk();
+		}
+	}
+
+	void ParseChunk(std::size_t index) noexcept
+	{
+		Chunk chunk;
+		chunk.index = index;
+		try
+		{
+			std::size_t begin{ FindLineStart(index * m_chunkSize) };
+			std::size_t end{ FindLineStart(std::min(m_size, (index + 1) * m_chunkSize)) };
+			JsonParser parser;
+			while (begin < end && !m_isCancelled)
+			{
+				const char* pLine{ m_pInput + begin };
+				const char* pNewLine{ static_cast<const char*>(std::memchr(pLine, '\n', end - begin)) };
+				std::size_t lineEnd{ pNewLine != nullptr ? static_cast<std::size_t>(pNewLine - m_pInput) : end };
+				if (!IsBlank(pLine, m_pInput + lineEnd))
+				{
+					chunk.lines.push_back(JsonLine{ ParseLine(parser, begin, lineEnd), begin });
+				}
+				begin = lineEnd + 1;
+			}
+		}
+		catch (...)
+		{
+			chunk.spError = std::current_exception();
+		}
+
+		std::unique_lock<std::mutex> lock{ m_mutex };
+		m_completed.push_back(std::move(chunk));
+		--m_runningCount;
+		m_chunkChanged.notify_all();
+	}
+
+	Dynamic ParseLine(JsonParser& parser, std::size_t begin, std::size_t end) const
+	{
+		try
+		{
+			return parser.Parse(m_pInput + begin, end - begin, m_isBorrowString);
+		}
+		catch (const JsonError& error)
+		{
+			std::string message{ error.what() };
+			message += " of line at offset ";
+			message += std::to_string(begin);
+			throw JsonError{ error.GetErrorCode(), message.c_str() };
+		}
+	}
+
+	// First line which starts at position or after it, both neighbour chunks agree on it.
+	std::size_t FindLineStart(std::size_t position) const noexcept
+	{
+		if (position == 0 || position >= m_size)
+		{
+			return std::min(position, m_size);
+		}
+		// memchr is vectorized by every standard library, a chunk boundary costs one line scan.
+		const void* pNewLine{ std::memchr(m_pInput + position - 1, '\n', m_size - position + 1) };
+		return pNewLine != nullptr ? static_cast<std::size_t>(static_cast<const char*>(pNewLine) - m_pInput) + 1 : m_size;
+	}
+
+	static bool IsBlank(const char* p, const char* pEnd) noexcept
+	{
+		for (; p != pEnd; ++p)
+		{
+			if (*p != ' ' && *p != '\t' && *p != '\r')
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	ThreadPool& m_pool;
+	const char* m_pInput;
+	std::size_t m_size;
+	JsonLinesOrder m_order{ JsonLinesOrder::Ordered };
+	std::size_t m_chunkSize{ c_defaultChunkSize };
+	std::size_t m_maxPendingChunks{ c_defaultMaxPendingChunks };
+	bool m_isBorrowString{ false };
+
+	// Used by Read only.
+	bool m_isStarted{ false };
+	std::size_t m_chunkCount{ 0 };
+	std::size_t m_postedCount{ 0 };
+	std::size_t m_consumedCount{ 0 };
+	Chunk m_current;
+	std::size_t m_position{ 0 };
+
+	// Shared with tasks.
+	std::atomic<bool> m_isCancelled{ false };
+	std::mutex m_mutex;
+	std::condition_variable m_chunkChanged;
+	std::deque<Chunk> m_completed;
+	std::size_t m_runningCount{ 0 };
+};
+
+}}}
+
+#endif
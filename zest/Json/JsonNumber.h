@@ -0,0 +1,333 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONNUMBER_H
+#define ZEST_LIB_JSONNUMBER_H
+
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "../Platform.h"
+#include "JsonError.h"
+#include "JsonNumberTable.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! Json number literal converted to integer or double, shared by JsonParser and JsonReader.
+	Integers which fit int64 are integers, others and numbers with fraction or exponent are double.
+	Conversion is exact and independent of locale: digits are read 8 at a time, doubles take
+	the exact fast path when mantissa and power of ten fit double, else Eisel-Lemire, and
+	std::from_chars only for mantissas longer than 19 digits.
+*/
+struct JsonNumber
+{
+	// Enough for any text of Write.
+	static constexpr std::size_t c_maxWriteLength{ 32 };
+
+	bool isInteger{ true };
+	int64_t integer{ 0 };
+	double value{ 0.0 };
+
+	/*! Parse number grammar from pBegin, returns end of number, caller checks what follows.
+		offset is position of pBegin in input, for error messages.
+	*/
+	static const char* Parse(const char* pBegin, const char* pEnd, std::size_t offset, JsonNumber& number)
+	{
+		const char* p{ pBegin };
+		bool isNegative{ p != pEnd && *p == '-' };
+		p += isNegative ? 1 : 0;
+		if (p == pEnd || !IsDigit(*p))
+		{
+			ThrowUnexpected(offset + static_cast<std::size_t>(p - pBegin));
+		}
+
+		uint64_t mantissa{ 0 };
+		const char* pDigits{ p };
+		if (*p == '0')
+		{
+			++p;
+		}
+		else
+		{
+			p = ReadDigits(p, pEnd, mantissa);
+		}
+		std::size_t digitCount{ static_cast<std::size_t>(p - pDigits) };
+
+		int64_t exponent{ 0 };
+		number.isInteger = true;
+		if (p != pEnd && *p == '.')
+		{
+			number.isInteger = false;
+			const char* pFraction{ ++p };
+			p = ReadDigits(p, pEnd, mantissa);
+			if (p == pFraction)
+			{
+				ThrowUnexpected(offset + static_cast<std::size_t>(p - pBegin));
+			}
+			exponent = -static_cast<int64_t>(p - pFraction);
+			digitCount += static_cast<std::size_t>(p - pFraction);
+		}
+		if (p != pEnd && (*p == 'e' || *p == 'E'))
+		{
+			number.isInteger = false;
+			++p;
+			bool isExponentNegative{ p != pEnd && *p == '-' };
+			if (p != pEnd && (*p == '+' || *p == '-'))
+			{
+				++p;
+			}
+			if (p == pEnd || !IsDigit(*p))
+			{
+				ThrowUnexpected(offset + static_cast<std::size_t>(p - pBegin));
+			}
+			int64_t explicitExponent{ 0 };
+			for (; p != pEnd && IsDigit(*p); ++p)
+			{
+				// Larger exponents mean zero or infinity anyway.
+				if (explicitExponent < 0x10000)
+				{
+					explicitExponent = explicitExponent * 10 + (*p - '0');
+				}
+			}
+			exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+		}
+
+		if (digitCount > c_maxExactDigits)
+		{
+			// Leading zeros of fraction are not significant.
+			for (const char* pZero = pDigits; pZero != p && (*pZero == '0' || *pZero == '.'); ++pZero)
+			{
+				digitCount -= *pZero == '0' ? 1 : 0;
+			}
+			if (digitCount > c_maxExactDigits)
+			{
+				ParseLong(pBegin, p, pDigits, offset, number);
+				return p;
+			}
+		}
+
+		if (number.isInteger)
+		{
+			// Magnitude of negative int64 can be one more than positive one.
+			uint64_t limit{ static_cast<uint64_t>(INT64_MAX) + (isNegative ? 1 : 0) };
+			if (mantissa <= limit)
+			{
+				number.integer = isNegative ? static_cast<int64_t>(0 - mantissa) : static_cast<int64_t>(mantissa);
+				return p;
+			}
+			number.isInteger = false;
+		}
+
+		double value;
+		if (!ComputeDouble(mantissa, exponent, value))
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Number out of range", offset);
+		}
+		number.value = isNegative ? -value : value;
+		return p;
+	}
+
+	/*! Shortest text which parses back to the same double, like "0.1", "2.0" or "1e+100".
+		Integral value gets ".0", so it is read back as double and not as integer.
+		NaN and infinity can't be written in json, they are written as null like JavaScript does.
+		pBuffer needs c_maxWriteLength bytes, returns end of text.
+	*/
+	static char* Write(double value, char* pBuffer) noexcept
+	{
+		if (!std::isfinite(value))
+		{
+			std::memcpy(pBuffer, "null", 4);
+			return pBuffer + 4;
+		}
+		// std::to_chars without precision is shortest round trip and ignores locale.
+		char* pEnd{ std::to_chars(pBuffer, pBuffer + c_maxWriteLength, value).ptr };
+		// Fixed form is chosen only when shorter than exponent form, so at most 17 digits and sign.
+		for (const char* p = pBuffer; p != pEnd; ++p)
+		{
+			if (*p == '.' || *p == 'e')
+			{
+				return pEnd;
+			}
+		}
+		std::memcpy(pEnd, ".0", 2);
+		return pEnd + 2;
+	}
+
+	static char* Write(int64_t value, char* pBuffer) noexcept
+	{
+		return std::to_chars(pBuffer, pBuffer + c_maxWriteLength, value).ptr;
+	}
+
+private:
+	// 19 decimal digits always fit uint64.
+	static constexpr std::size_t c_maxExactDigits{ 19 };
+
+	[[noreturn]] static void ThrowUnexpected(std::size_t offset)
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", offset);
+	}
+
+	static bool IsDigit(char c) noexcept
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// Accumulate digits into mantissa, which wraps around after 19 digits.
+	static const char* ReadDigits(const char* p, const char* pEnd, uint64_t& mantissa) noexcept
+	{
+#if !defined(ZEST_LIB_BIG_ENDIAN)
+		while (pEnd - p >= 8)
+		{
+			uint64_t chunk;
+			std::memcpy(&chunk, p, sizeof(chunk));
+			if (!IsEightDigits(chunk))
+			{
+				break;
+			}
+			mantissa = mantissa * 100000000 + ParseEightDigits(chunk);
+			p += 8;
+		}
+#endif
+		for (; p != pEnd && IsDigit(*p); ++p)
+		{
+			mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+		}
+		return p;
+	}
+
+	// Every byte is '0' to '9': high nibble is 3, and adding 6 doesn't carry into it.
+	static bool IsEightDigits(uint64_t chunk) noexcept
+	{
+		return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+	}
+
+	// Little endian chunk of 8 digits, first digit in lowest byte. Pairs, then quads are combined by multiplication.
+	static uint32_t ParseEightDigits(uint64_t chunk) noexcept
+	{
+		const uint64_t mask{ 0x000000FF000000FF };
+		const uint64_t multiplier1{ 100 + (1000000ULL << 32) };
+		const uint64_t multiplier2{ 1 + (10000ULL << 32) };
+		chunk -= 0x3030303030303030;
+		chunk = (chunk * 10) + (chunk >> 8);
+		chunk = (((chunk & mask) * multiplier1) + (((chunk >> 16) & mask) * multiplier2)) >> 32;
+		return static_cast<uint32_t>(chunk);
+	}
+
+	/*! mantissa * 10^exponent rounded to nearest even double, false if it is infinite.
+		mantissa must be exact. Small values are exact double operations, others Eisel-Lemire:
+		normalized mantissa times 128 bit power of five gives enough bits of the result.
+	*/
+	static bool ComputeDouble(uint64_t mantissa, int64_t exponent, double& value) noexcept
+	{
+		static constexpr double c_exactPowersOfTen[]{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+		// Both operands are exact doubles, so one correctly rounded operation gives the result.
+		if (exponent >= -22 && exponent <= 22 && mantissa <= (uint64_t{ 1 } << 53))
+		{
+			value = static_cast<double>(mantissa);
+			value = exponent < 0 ? value / c_exactPowersOfTen[-exponent] : value * c_exactPowersOfTen[exponent];
+			return true;
+		}
+#endif
+		if (mantissa == 0 || exponent < JsonNumberTable::c_minPowerOfTen)
+		{
+			value = 0.0;
+			return true;
+		}
+		if (exponent > JsonNumberTable::c_maxPowerOfTen)
+		{
+			return false;
+		}
+
+		uint32_t leadingZeros{ Platform::CountLeadingZeros(mantissa) };
+		mantissa <<= leadingZeros;
+		std::size_t index{ 2 * static_cast<std::size_t>(exponent - JsonNumberTable::c_minPowerOfTen) };
+		uint64_t low;
+		uint64_t high{ Platform::MultiplyHigh(mantissa, JsonNumberTable::c_powersOfFive[index], low) };
+		// Lower word of power only matters when the bits below the 55 needed may carry.
+		if ((high & 0x1FF) == 0x1FF)
+		{
+			uint64_t secondLow;
+			uint64_t secondHigh{ Platform::MultiplyHigh(mantissa, JsonNumberTable::c_powersOfFive[index + 1], secondLow) };
+			low += secondHigh;
+			high += secondHigh > low ? 1 : 0;
+		}
+
+		uint32_t upperBit{ static_cast<uint32_t>(high >> 63) };
+		uint32_t shift{ upperBit + 64 - 52 - 3 };
+		uint64_t bits{ high >> shift };
+		// floor(log2(10^exponent)) + 63 through fixed point, plus exponent bias.
+		int64_t power2{ ((217706 * exponent) >> 16) + 63 + upperBit - leadingZeros + 1023 };
+		if (power2 <= 0)
+		{
+			// Subnormal, or zero when everything is shifted out.
+			if (-power2 + 1 >= 64)
+			{
+				value = 0.0;
+				return true;
+			}
+			bits >>= -power2 + 1;
+			bits += bits & 1;
+			bits >>= 1;
+			power2 = bits < (uint64_t{ 1 } << 52) ? 0 : 1;
+			return ToDouble(bits, power2, value);
+		}
+
+		// Exactly between two doubles, only possible when 5^exponent fits 64 bits, rounds to even.
+		if (low <= 1 && exponent >= -4 && exponent <= 23 && (bits & 3) == 1 && (bits << shift) == high)
+		{
+			bits &= ~uint64_t{ 1 };
+		}
+		bits += bits & 1;
+		bits >>= 1;
+		if (bits >= (uint64_t{ 2 } << 52))
+		{
+			bits = uint64_t{ 1 } << 52;
+			++power2;
+		}
+		bits &= ~(uint64_t{ 1 } << 52);
+		if (power2 >= 0x7FF)
+		{
+			return false;
+		}
+		return ToDouble(bits, power2, value);
+	}
+
+	static bool ToDouble(uint64_t bits, int64_t power2, double& value) noexcept
+	{
+		uint64_t word{ bits | (static_cast<uint64_t>(power2) << 52) };
+		std::memcpy(&value, &word, sizeof(value));
+		return true;
+	}
+
+	// Integer or mantissa longer than 19 digits, rare enough for std::from_chars.
+	static void ParseLong(const char* pBegin, const char* pEnd, const char* pDigits, std::size_t offset, JsonNumber& number)
+	{
+		if (number.isInteger)
+		{
+			std::from_chars_result result{ std::from_chars(pBegin, pEnd, number.integer) };
+			if (result.ec == std::errc() && result.ptr == pEnd)
+			{
+				return;
+			}
+			number.isInteger = false;
+		}
+
+		std::from_chars_result result{ std::from_chars(pBegin, pEnd, number.value) };
+		if (result.ec == std::errc::result_out_of_range && std::memchr(pDigits, '-', static_cast<std::size_t>(pEnd - pDigits)) != nullptr)
+		{
+			// Underflow, only the exponent can have a sign after the digits.
+			number.value = *pBegin == '-' ? -0.0 : 0.0;
+		}
+		else if (result.ec != std::errc())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Number out of range", offset);
+		}
+	}
+};
+
+}}}
+
+#endif
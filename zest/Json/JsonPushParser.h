@@ -0,0 +1,688 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONPUSHPARSER_H
+#define ZEST_LIB_JSONPUSHPARSER_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "../Dynamics.h"
+#include "JsonError.h"
+#include "JsonNumber.h"
+#include "JsonReader.h"
+#include "JsonString.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! Resumable event parser for input which arrives in chunks, e.g. packets of a request body.
+	Each Feed consumes its whole chunk and sends events of the tokens completed in it, state
+	between chunks is explicit (a state and a stack of open containers, no recursion), so a
+	chunk is never waited for and bytes are never scanned twice. Only a token which crosses
+	chunks is copied, into a buffer as long as that token. Handlers and JsonReadAction are the
+	same as for JsonReader, strings are only valid during the call.
+		JsonPushParser parser;
+		while (std::size_t size = socket.Receive(buffer, sizeof(buffer)))
+		{
+			parser.Feed(buffer, size, handler);
+		}
+		parser.Finish(handler);
+	A number at the end of input is only known to be complete in Finish. After a JsonError or
+	a Stop, Reset is needed before the next document.
+*/
+class JsonPushParser
+{
+public:
+	static constexpr std::size_t c_maxDepth{ 1024 };
+
+	JsonPushParser() = default;
+	JsonPushParser(const JsonPushParser&) = delete;
+	JsonPushParser& operator=(const JsonPushParser&) = delete;
+
+	// Returns false when handler stopped reading, now or in an earlier chunk.
+	template<typename THandler>
+	bool Feed(const char* pData, std::size_t size, THandler& handler)
+	{
+		if (m_state == State::Stopped)
+		{
+			return false;
+		}
+		m_pChunk = pData;
+		const char* p{ pData };
+		const char* pEnd{ pData + size };
+		while (p != pEnd)
+		{
+			switch (m_state)
+			{
+				case State::String:
+				case State::SkipString:
+					p = ScanString(p, pEnd, handler);
+					break;
+				case State::Number:
+					p = ScanNumber(p, pEnd, handler);
+					break;
+				case State::Literal:
+					p = ScanLiteral(p, pEnd, handler);
+					break;
+				case State::Skip:
+					p = ScanSkip(p, pEnd);
+					break;
+				default:
+				{
+					char c{ *p++ };
+					while (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+					{
+						if (p == pEnd)
+						{
+							m_offset += size;
+							return true;
+						}
+						c = *p++;
+					}
+					p = ReadStructural(c, p, handler);
+					break;
+				}
+			}
+			if (m_state == State::Stopped)
+			{
+				m_offset += static_cast<std::size_t>(p - pData);
+				return false;
+			}
+		}
+		m_offset += size;
+		return true;
+	}
+
+	template<typename THandler>
+	bool Feed(std::string_view chunk, THandler& handler)
+	{
+		return Feed(chunk.data(), chunk.size(), handler);
+	}
+
+	// End of input, throws JsonError when the value is incomplete.
+	template<typename THandler>
+	bool Finish(THandler& handler)
+	{
+		if (m_state == State::Number && m_containers.empty())
+		{
+			CompleteNumber(m_token, handler);
+		}
+		if (m_state == State::Stopped)
+		{
+			return false;
+		}
+		if (m_state == State::Value && m_containers.empty())
+		{
+			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+		}
+		if (m_state != State::Done)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected end", m_offset);
+		}
+		return true;
+	}
+
+	// Ready for the next document, buffers are kept.
+	void Reset() noexcept
+	{
+		m_state = State::Value;
+		m_containers.clear();
+		m_token.clear();
+		m_offset = 0;
+		m_isKey = false;
+		m_isEscaped = false;
+		m_isSkipNext = false;
+	}
+
+	// Whole value was read, only whitespace may follow.
+	bool IsComplete() const noexcept
+	{
+		return m_state == State::Done;
+	}
+
+private:
+	enum class State: uint8_t
+	{
+		// First character of a value.
+		Value,
+		// After '[': value or ']'.
+		ValueOrEnd,
+		// After '{': key or '}'.
+		KeyOrEnd,
+		// After ',' in object.
+		Key,
+		Colon,
+		CommaOrEnd,
+		// In string or key, m_isKey tells which.
+		String,
+		Number,
+		Literal,
+		// In a container which handler skipped, only brackets and strings are followed.
+		Skip,
+		SkipString,
+		Done,
+		Stopped
+	};
+
+	std::size_t GetOffset(const char* p) const noexcept
+	{
+		return m_offset + static_cast<std::size_t>(p - m_pChunk);
+	}
+
+	[[noreturn]] void ThrowUnexpected(const char* p) const
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", GetOffset(p));
+	}
+
+	void Apply(JsonReadAction action) noexcept
+	{
+		if (action == JsonReadAction::Stop)
+		{
+			m_state = State::Stopped;
+		}
+	}
+
+	void CompleteValue() noexcept
+	{
+		m_state = m_containers.empty() ? State::Done : State::CommaOrEnd;
+	}
+
+	// Scalar is sent unless handler skipped it with its key.
+	template<typename TSend>
+	void CompleteScalar(TSend&& send)
+	{
+		CompleteValue();
+		if (m_isSkipNext)
+		{
+			m_isSkipNext = false;
+			return;
+		}
+		Apply(send());
+	}
+
+	// c is consumed, p is after it.
+	template<typename THandler>
+	const char* ReadStructural(char c, const char* p, THandler& handler)
+	{
+		switch (m_state)
+		{
+			case State::Colon:
+				if (c != ':')
+				{
+					ThrowUnexpected(p - 1);
+				}
+				m_state = State::Value;
+				return p;
+			case State::CommaOrEnd:
+			{
+				char container{ m_containers.back() };
+				if (c == (container == '{' ? '}' : ']'))
+				{
+					CloseContainer(handler);
+					return p;
+				}
+				if (c != ',')
+				{
+					ThrowUnexpected(p - 1);
+				}
+				m_state = container == '{' ? State::Key : State::Value;
+				return p;
+			}
+			case State::KeyOrEnd:
+				if (c == '}')
+				{
+					CloseContainer(handler);
+					return p;
+				}
+				[[fallthrough]];
+			case State::Key:
+				if (c != '"')
+				{
+					ThrowUnexpected(p - 1);
+				}
+				BeginString(true, p);
+				return p;
+			case State::ValueOrEnd:
+				if (c == ']')
+				{
+					CloseContainer(handler);
+					return p;
+				}
+				[[fallthrough]];
+			case State::Value:
+				return BeginValue(c, p, handler);
+			default:
+				ThrowUnexpected(p - 1);
+		}
+	}
+
+	template<typename THandler>
+	const char* BeginValue(char c, const char* p, THandler& handler)
+	{
+		switch (c)
+		{
+			case '{':
+			case '[':
+			{
+				if (m_containers.size() == c_maxDepth)
+				{
+					throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", GetOffset(p - 1));
+				}
+				JsonReadAction action{ JsonReadAction::Skip };
+				if (!m_isSkipNext)
+				{
+					action = c == '{' ? handler.StartObject() : handler.StartArray();
+				}
+				m_isSkipNext = false;
+				m_containers.push_back(c);
+				if (action == JsonReadAction::Skip)
+				{
+					m_skipDepth = m_containers.size();
+					m_state = State::Skip;
+				}
+				else
+				{
+					m_state = c == '{' ? State::KeyOrEnd : State::ValueOrEnd;
+					Apply(action);
+				}
+				return p;
+			}
+			case '"':
+				BeginString(false, p);
+				return p;
+			case 't':
+				BeginLiteral("true", p);
+				return p;
+			case 'f':
+				BeginLiteral("false", p);
+				return p;
+			case 'n':
+				BeginLiteral("null", p);
+				return p;
+			default:
+				// First character is scanned again with the rest, it is still in this chunk.
+				m_token.clear();
+				m_tokenOffset = GetOffset(p - 1);
+				m_state = State::Number;
+				return p - 1;
+		}
+	}
+
+	template<typename THandler>
+	void CloseContainer(THandler& handler)
+	{
+		char container{ m_containers.back() };
+		m_containers.pop_back();
+		CompleteValue();
+		Apply(container == '{' ? handler.EndObject() : handler.EndArray());
+	}
+
+	// Opening quote is consumed, p is first character of content.
+	void BeginString(bool isKey, const char* p)
+	{
+		m_token.clear();
+		m_tokenOffset = GetOffset(p);
+		m_isKey = isKey;
+		m_isEscaped = false;
+		m_state = State::String;
+	}
+
+	/*! Finds closing quote, content of a string which continues in the next chunk is kept in token.
+		Strings of skipped containers are only scanned. Control characters are rejected either way.
+	*/
+	template<typename THandler>
+	const char* ScanString(const char* p, const char* pEnd, THandler& handler)
+	{
+		const char* pStart{ p };
+		if (m_isEscaped)
+		{
+			// Backslash ended the previous chunk, this character is escaped.
+			++p;
+			m_isEscaped = false;
+		}
+		while (p != pEnd)
+		{
+			char c{ *p };
+			if (c == '"')
+			{
+				break;
+			}
+			if (c == '\\')
+			{
+				if (pEnd - p < 2)
+				{
+					m_isEscaped = true;
+					p = pEnd;
+					break;
+				}
+				p += 2;
+				continue;
+			}
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Control character in string", GetOffset(p));
+			}
+			++p;
+		}
+
+		bool isSkipped{ m_state == State::SkipString };
+		if (p == pEnd)
+		{
+			if (!isSkipped)
+			{
+				m_token.append(pStart, static_cast<std::size_t>(p - pStart));
+			}
+			return p;
+		}
+		if (isSkipped)
+		{
+			m_state = State::Skip;
+			return p + 1;
+		}
+
+		std::string_view raw{ pStart, static_cast<std::size_t>(p - pStart) };
+		if (!m_token.empty())
+		{
+			m_token.append(raw.data(), raw.size());
+			raw = m_token;
+		}
+		JsonString::ValidateUtf8(raw, m_tokenOffset);
+		if (std::memchr(raw.data(), '\\', raw.size()) != nullptr)
+		{
+			m_unescaped.clear();
+			JsonString::Unescape(raw, m_tokenOffset, m_unescaped);
+			raw = m_unescaped;
+		}
+
+		if (m_isKey)
+		{
+			m_state = State::Colon;
+			JsonReadAction action{ handler.Key(raw) };
+			m_isSkipNext = action == JsonReadAction::Skip;
+			Apply(action);
+		}
+		else
+		{
+			CompleteScalar([&handler, raw]() { return handler.String(raw); });
+		}
+		return p + 1;
+	}
+
+	static bool IsNumberCharacter(char c) noexcept
+	{
+		return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+	}
+
+	// Number ends at first other character, which is left for the next state.
+	template<typename THandler>
+	const char* ScanNumber(const char* p, const char* pEnd, THandler& handler)
+	{
+		const char* pStart{ p };
+		while (p != pEnd && IsNumberCharacter(*p))
+		{
+			++p;
+		}
+		if (p == pEnd)
+		{
+			m_token.append(pStart, static_cast<std::size_t>(p - pStart));
+			return p;
+		}
+
+		std::string_view raw{ pStart, static_cast<std::size_t>(p - pStart) };
+		if (!m_token.empty())
+		{
+			m_token.append(raw.data(), raw.size());
+			raw = m_token;
+		}
+		CompleteNumber(raw, handler);
+		return p;
+	}
+
+	template<typename THandler>
+	void CompleteNumber(std::string_view raw, THandler& handler)
+	{
+		JsonNumber number;
+		const char* pEnd{ JsonNumber::Parse(raw.data(), raw.data() + raw.size(), m_tokenOffset, number) };
+		if (pEnd != raw.data() + raw.size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", m_tokenOffset + static_cast<std::size_t>(pEnd - raw.data()));
+		}
+		m_token.clear();
+		CompleteScalar([&handler, &number]() { return number.isInteger ? handler.Int(number.integer) : handler.Double(number.value); });
+	}
+
+	// First character of literal is consumed.
+	void BeginLiteral(const char* literal, const char* p)
+	{
+		m_literal = literal;
+		m_literalPosition = 1;
+		m_tokenOffset = GetOffset(p - 1);
+		m_state = State::Literal;
+	}
+
+	template<typename THandler>
+	const char* ScanLiteral(const char* p, const char* pEnd, THandler& handler)
+	{
+		for (; p != pEnd && m_literal[m_literalPosition] != '\0'; ++p, ++m_literalPosition)
+		{
+			if (*p != m_literal[m_literalPosition])
+			{
+				ThrowUnexpected(p);
+			}
+		}
+		if (m_literal[m_literalPosition] == '\0')
+		{
+			char first{ m_literal[0] };
+			CompleteScalar([&handler, first]() { return first == 'n' ? handler.Null() : handler.Bool(first == 't'); });
+		}
+		return p;
+	}
+
+	// Inside skipped container, stops after its closing bracket.
+	const char* ScanSkip(const char* p, const char* pEnd)
+	{
+		while (p != pEnd)
+		{
+			char c{ *p++ };
+			switch (c)
+			{
+				case '"':
+					m_state = State::SkipString;
+					m_isEscaped = false;
+					return p;
+				case '{':
+				case '[':
+					if (m_containers.size() == c_maxDepth)
+					{
+						throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", GetOffset(p - 1));
+					}
+					m_containers.push_back(c);
+					break;
+				case '}':
+				case ']':
+					if (m_containers.back() != (c == '}' ? '{' : '['))
+					{
+						ThrowUnexpected(p - 1);
+					}
+					m_containers.pop_back();
+					if (m_containers.size() < m_skipDepth)
+					{
+						CompleteValue();
+						return p;
+					}
+					break;
+				default:
+					break;
+			}
+		}
+		return p;
+	}
+
+	State m_state{ State::Value };
+	std::vector<char> m_containers;
+	// Start of current chunk and bytes of earlier chunks, for error offsets.
+	const char* m_pChunk{ nullptr };
+	std::size_t m_offset{ 0 };
+	// String or number which crosses chunks, and offset of its first character.
+	std::string m_token;
+	std::size_t m_tokenOffset{ 0 };
+	std::string m_unescaped;
+	bool m_isKey{ false };
+	bool m_isEscaped{ false };
+	// Handler skipped the key of the next value.
+	bool m_isSkipNext{ false };
+	// Skipping ends when container count drops below it.
+	std::size_t m_skipDepth{ 0 };
+	const char* m_literal{ nullptr };
+	std::size_t m_literalPosition{ 0 };
+};
+
+/*! Handler which builds Dynamic values from events of JsonPushParser or JsonReader.
+	Each value at emit depth is passed to the callback as soon as its last event arrives. Containers
+	above emit depth are only walked, so elements of a large top level array are processed as
+	they come, without the array being kept:
+		JsonValueBuilder builder{ 1, [](Dynamic&& record) { ... } };
+	Emit depth 0 passes the whole document.
+*/
+class JsonValueBuilder: public JsonHandler
+{
+public:
+	using Callback = std::function<void(Dynamic&&)>;
+
+	JsonValueBuilder(std::size_t emitDepth, Callback callback)
+		: m_emitDepth{ emitDepth }, m_callback{ std::move(callback) }
+	{
+	}
+
+	JsonReadAction StartObject()
+	{
+		return Open(true);
+	}
+
+	JsonReadAction Key(std::string_view name)
+	{
+		if (m_depth > m_emitDepth)
+		{
+			m_frames.back().key = m_keyCache.Get(name.data(), name.size());
+		}
+		return JsonReadAction::Continue;
+	}
+
+	JsonReadAction EndObject()
+	{
+		return Close();
+	}
+
+	JsonReadAction StartArray()
+	{
+		return Open(false);
+	}
+
+	JsonReadAction EndArray()
+	{
+		return Close();
+	}
+
+	JsonReadAction String(std::string_view value)
+	{
+		return Add([value]() { return Dynamic(ValueMap::StringView{ value }); });
+	}
+
+	JsonReadAction Int(int64_t value)
+	{
+		return Add([value]()
+		{
+			bool isInt32{ value >= std::numeric_limits<ValueMap::Int32>::min() && value <= std::numeric_limits<ValueMap::Int32>::max() };
+			return isInt32 ? Dynamic(static_cast<ValueMap::Int32>(value)) : Dynamic(static_cast<ValueMap::Int64>(value));
+		});
+	}
+
+	JsonReadAction Double(double value)
+	{
+		return Add([value]() { return Dynamic(value); });
+	}
+
+	JsonReadAction Bool(bool value)
+	{
+		return Add([value]() { return Dynamic(value); });
+	}
+
+	JsonReadAction Null()
+	{
+		return Add([]() { return Dynamic(); });
+	}
+
+private:
+	struct Frame
+	{
+		bool isObject;
+		Dynamic object;
+		ValueMap::Array array;
+		DynamicKey key;
+	};
+
+	JsonReadAction Open(bool isObject)
+	{
+		if (m_depth++ >= m_emitDepth)
+		{
+			m_frames.push_back(Frame{ isObject, isObject ? Dynamic::MakeObject() : Dynamic(), ValueMap::Array{}, DynamicKey{} });
+		}
+		return JsonReadAction::Continue;
+	}
+
+	JsonReadAction Close()
+	{
+		if (--m_depth < m_emitDepth)
+		{
+			return JsonReadAction::Continue;
+		}
+		Frame frame{ std::move(m_frames.back()) };
+		m_frames.pop_back();
+		Dynamic value = frame.isObject ? std::move(frame.object) : Dynamic(std::move(frame.array));
+		Append(std::move(value));
+		return JsonReadAction::Continue;
+	}
+
+	// Values above emit depth are not built at all.
+	template<typename TMake>
+	JsonReadAction Add(TMake&& make)
+	{
+		if (m_depth >= m_emitDepth)
+		{
+			Append(make());
+		}
+		return JsonReadAction::Continue;
+	}
+
+	void Append(Dynamic&& value)
+	{
+		if (m_depth == m_emitDepth)
+		{
+			m_callback(std::move(value));
+			return;
+		}
+		Frame& frame{ m_frames.back() };
+		if (frame.isObject)
+		{
+			frame.object.GetObjectMap().Set(frame.key, std::move(value));
+		}
+		else
+		{
+			frame.array.push_back(std::move(value));
+		}
+	}
+
+	std::size_t m_emitDepth;
+	Callback m_callback;
+	std::size_t m_depth{ 0 };
+	std::vector<Frame> m_frames;
+	DynamicKeyCache m_keyCache;
+};
+
+}}}
+
+#endif
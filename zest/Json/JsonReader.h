@@ -0,0 +1,482 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONREADER_H
+#define ZEST_LIB_JSONREADER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Stream.h"
+#include "Json.h"
+#include "JsonError.h"
+#include "JsonNumber.h"
+#include "JsonString.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! What reader does after an event.
+	Skip after StartObject or StartArray skips the container without its end event,
+	Skip after Key skips value of the property. Skip after other events is Continue.
+*/
+enum class JsonReadAction
+{
+	Continue,
+	Skip,
+	Stop
+};
+
+/*! Handler which ignores every event, derive from it and hide events you need.
+	Strings passed to Key and String are only valid during the call.
+*/
+struct JsonHandler
+{
+	JsonReadAction StartObject() { return JsonReadAction::Continue; }
+	JsonReadAction Key(std::string_view) { return JsonReadAction::Continue; }
+	JsonReadAction EndObject() { return JsonReadAction::Continue; }
+	JsonReadAction StartArray() { return JsonReadAction::Continue; }
+	JsonReadAction EndArray() { return JsonReadAction::Continue; }
+	JsonReadAction String(std::string_view) { return JsonReadAction::Continue; }
+	JsonReadAction Int(int64_t) { return JsonReadAction::Continue; }
+	JsonReadAction Double(double) { return JsonReadAction::Continue; }
+	JsonReadAction Bool(bool) { return JsonReadAction::Continue; }
+	JsonReadAction Null() { return JsonReadAction::Continue; }
+};
+
+/*! Event reader of json text which never builds values.
+	Over JsonStringStream it reads the string in place, over IStream it reads chunks into a fixed buffer,
+	so memory is bounded by buffer size, nesting depth and the longest string or number read.
+	Skipped containers and strings are not copied, skipping only checks brackets and string boundaries.
+	Numbers are delivered as Int when they are integers which fit int64, as Double otherwise.
+*/
+class JsonReader
+{
+public:
+	static constexpr std::size_t c_maxDepth{ 1024 };
+
+	explicit JsonReader(JsonStringStream& stream)
+		: m_pStringStream{ &stream },
+		m_pBegin{ stream.GetCurrent() }, m_pCur{ stream.GetCurrent() },
+		m_pEnd{ stream.GetCurrent() + stream.GetRemainingSize() }
+	{
+	}
+
+	explicit JsonReader(IStream& stream, std::size_t bufferSize = DEFAULT_READ_SIZE)
+		: m_pStream{ &stream },
+		m_spBuffer{ new char[bufferSize] }, m_bufferSize{ bufferSize }
+	{
+	}
+
+	JsonReader(const JsonReader&) = delete;
+	JsonReader& operator=(const JsonReader&) = delete;
+
+	/*! Read one json value and send its events to handler, only whitespace may follow it.
+		Returns false when handler stopped reading, then JsonStringStream is left after the last event.
+	*/
+	template<typename THandler>
+	bool Read(THandler& handler)
+	{
+		m_containers.clear();
+		int c{ NextNonSpace() };
+		if (c == c_end)
+		{
+			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+		}
+
+		for (;;)
+		{
+			// c is first character of a value.
+			JsonReadAction action{ ReadValue(c, handler) };
+			if (action == JsonReadAction::Stop)
+			{
+				return Finish(false);
+			}
+			bool isFirst{ false };
+			if (c == '{' || c == '[')
+			{
+				if (action == JsonReadAction::Skip)
+				{
+					SkipContainer(static_cast<char>(c));
+				}
+				else
+				{
+					Open(static_cast<char>(c));
+					isFirst = true;
+				}
+			}
+
+			// Close containers and read separators and keys up to first character of next value.
+			c = NextNonSpace();
+			for (;;)
+			{
+				if (m_containers.empty())
+				{
+					if (c != c_end)
+					{
+						ThrowUnexpected();
+					}
+					return Finish(true);
+				}
+
+				char container{ m_containers.back() };
+				if (c == (container == '{' ? '}' : ']'))
+				{
+					m_containers.pop_back();
+					if ((container == '{' ? handler.EndObject() : handler.EndArray()) == JsonReadAction::Stop)
+					{
+						return Finish(false);
+					}
+					isFirst = false;
+					c = NextNonSpace();
+					continue;
+				}
+				if (!isFirst)
+				{
+					if (c != ',')
+					{
+						ThrowUnexpected();
+					}
+					c = NextNonSpace();
+				}
+				isFirst = false;
+				if (container == '[')
+				{
+					break;
+				}
+
+				if (c != '"')
+				{
+					ThrowUnexpected();
+				}
+				action = handler.Key(ReadString());
+				if (action == JsonReadAction::Stop)
+				{
+					return Finish(false);
+				}
+				if (NextNonSpace() != ':')
+				{
+					ThrowUnexpected();
+				}
+				c = NextNonSpace();
+				if (action != JsonReadAction::Skip)
+				{
+					break;
+				}
+				SkipValue(c);
+				c = NextNonSpace();
+			}
+		}
+	}
+
+private:
+	static constexpr int c_end{ -1 };
+
+	// Bytes before current chunk plus position in it.
+	std::size_t GetOffset() const noexcept
+	{
+		return m_offset + static_cast<std::size_t>(m_pCur - m_pBegin);
+	}
+
+	[[noreturn]] void ThrowUnexpected() const
+	{
+		// Offending character was consumed already.
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", GetOffset() - 1);
+	}
+
+	[[noreturn]] void ThrowUnexpectedEnd() const
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected end", GetOffset());
+	}
+
+	// Make sure current chunk has a byte, returns false at end of input.
+	bool Fill()
+	{
+		if (m_pCur != m_pEnd)
+		{
+			return true;
+		}
+		if (m_pStream == nullptr)
+		{
+			return false;
+		}
+		m_offset += static_cast<std::size_t>(m_pEnd - m_pBegin);
+		std::size_t size{ m_pStream->Read(m_spBuffer.get(), m_bufferSize) };
+		m_pBegin = m_spBuffer.get();
+		m_pCur = m_pBegin;
+		m_pEnd = m_pBegin + size;
+		return size != 0;
+	}
+
+	int NextNonSpace()
+	{
+		for (;;)
+		{
+			while (m_pCur != m_pEnd)
+			{
+				char c{ *m_pCur++ };
+				if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+				{
+					return static_cast<unsigned char>(c);
+				}
+			}
+			if (!Fill())
+			{
+				return c_end;
+			}
+		}
+	}
+
+	bool Finish(bool isCompleted)
+	{
+		if (m_pStringStream != nullptr)
+		{
+			m_pStringStream->Skip(static_cast<std::size_t>(m_pCur - m_pStringStream->GetCurrent()));
+		}
+		return isCompleted;
+	}
+
+	void Open(char container)
+	{
+		if (m_containers.size() == c_maxDepth)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", GetOffset() - 1);
+		}
+		m_containers.push_back(container);
+	}
+
+	template<typename THandler>
+	JsonReadAction ReadValue(int c, THandler& handler)
+	{
+		switch (c)
+		{
+			case '{':
+				return handler.StartObject();
+			case '[':
+				return handler.StartArray();
+			case '"':
+				return handler.String(ReadString());
+			case 't':
+				ReadLiteral("rue");
+				return handler.Bool(true);
+			case 'f':
+				ReadLiteral("alse");
+				return handler.Bool(false);
+			case 'n':
+				ReadLiteral("ull");
+				return handler.Null();
+			case c_end:
+				ThrowUnexpectedEnd();
+			default:
+			{
+				JsonNumber number;
+				ReadNumber(number);
+				return number.isInteger ? handler.Int(number.integer) : handler.Double(number.value);
+			}
+		}
+	}
+
+	void SkipValue(int c)
+	{
+		if (c == '{' || c == '[')
+		{
+			SkipContainer(static_cast<char>(c));
+		}
+		else if (c == '"')
+		{
+			ScanString(false);
+		}
+		else
+		{
+			JsonHandler handler;
+			ReadValue(c, handler);
+		}
+	}
+
+	// Opening bracket is read, stops after the matching closing one.
+	void SkipContainer(char container)
+	{
+		std::size_t depth{ m_containers.size() };
+		Open(container);
+		while (m_containers.size() > depth)
+		{
+			int c{ NextNonSpace() };
+			switch (c)
+			{
+				case '{':
+				case '[':
+					Open(static_cast<char>(c));
+					break;
+				case '}':
+				case ']':
+					if (m_containers.back() != (c == '}' ? '{' : '['))
+					{
+						ThrowUnexpected();
+					}
+					m_containers.pop_back();
+					break;
+				case '"':
+					ScanString(false);
+					break;
+				case c_end:
+					ThrowUnexpectedEnd();
+				default:
+					break;
+			}
+		}
+	}
+
+	void ReadLiteral(const char* rest)
+	{
+		for (; *rest != '\0'; ++rest)
+		{
+			if (!Fill())
+			{
+				ThrowUnexpectedEnd();
+			}
+			if (*m_pCur++ != *rest)
+			{
+				ThrowUnexpected();
+			}
+		}
+	}
+
+	/*! Raw content of string whose opening quote is read, in place when it doesn't cross chunks.
+		isKept false only finds the closing quote. Control characters are rejected either way.
+	*/
+	std::string_view ScanString(bool isKept)
+	{
+		m_token.clear();
+		bool isCopied{ false };
+		bool isEscaped{ false };
+		for (;;)
+		{
+			const char* p{ m_pCur };
+			if (isEscaped)
+			{
+				++p;
+				isEscaped = false;
+			}
+			while (p != m_pEnd)
+			{
+				char c{ *p };
+				if (c == '"')
+				{
+					break;
+				}
+				if (c == '\\')
+				{
+					if (m_pEnd - p < 2)
+					{
+						isEscaped = true;
+						p = m_pEnd;
+						break;
+					}
+					p += 2;
+					continue;
+				}
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					m_pCur = p + 1;
+					throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Control character in string", GetOffset() - 1);
+				}
+				++p;
+			}
+
+			if (p != m_pEnd)
+			{
+				std::string_view raw{ m_pCur, static_cast<std::size_t>(p - m_pCur) };
+				if (isCopied)
+				{
+					m_token.append(raw.data(), raw.size());
+					raw = m_token;
+				}
+				m_pCur = p + 1;
+				return raw;
+			}
+			if (isKept)
+			{
+				m_token.append(m_pCur, static_cast<std::size_t>(m_pEnd - m_pCur));
+				isCopied = true;
+			}
+			m_pCur = m_pEnd;
+			if (!Fill())
+			{
+				ThrowUnexpectedEnd();
+			}
+		}
+	}
+
+	std::string_view ReadString()
+	{
+		std::size_t offset{ GetOffset() };
+		std::string_view raw{ ScanString(true) };
+		JsonString::ValidateUtf8(raw, offset);
+		if (std::memchr(raw.data(), '\\', raw.size()) == nullptr)
+		{
+			return raw;
+		}
+		m_unescaped.clear();
+		JsonString::Unescape(raw, offset, m_unescaped);
+		return m_unescaped;
+	}
+
+	static bool IsNumberCharacter(char c) noexcept
+	{
+		return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+	}
+
+	// First character of number is read, it is still in current chunk.
+	void ReadNumber(JsonNumber& number)
+	{
+		--m_pCur;
+		std::size_t offset{ GetOffset() };
+		m_token.clear();
+		bool isCopied{ false };
+		std::string_view raw;
+		for (;;)
+		{
+			const char* p{ m_pCur };
+			while (p != m_pEnd && IsNumberCharacter(*p))
+			{
+				++p;
+			}
+			if (p != m_pEnd && !isCopied)
+			{
+				raw = std::string_view{ m_pCur, static_cast<std::size_t>(p - m_pCur) };
+				m_pCur = p;
+				break;
+			}
+			m_token.append(m_pCur, static_cast<std::size_t>(p - m_pCur));
+			m_pCur = p;
+			isCopied = true;
+			if (p != m_pEnd || !Fill())
+			{
+				raw = m_token;
+				break;
+			}
+		}
+
+		const char* pEnd{ JsonNumber::Parse(raw.data(), raw.data() + raw.size(), offset, number) };
+		if (pEnd != raw.data() + raw.size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", offset + static_cast<std::size_t>(pEnd - raw.data()));
+		}
+	}
+
+	IStream* m_pStream{ nullptr };
+	JsonStringStream* m_pStringStream{ nullptr };
+	std::unique_ptr<char[]> m_spBuffer;
+	std::size_t m_bufferSize{ 0 };
+	const char* m_pBegin{ nullptr };
+	const char* m_pCur{ nullptr };
+	const char* m_pEnd{ nullptr };
+	std::size_t m_offset{ 0 };
+	std::vector<char> m_containers;
+	std::string m_token;
+	std::string m_unescaped;
+};
+
+}}}
+
+#endif
@@ -0,0 +1,487 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONREFLECT_H
+#define ZEST_LIB_JSONREFLECT_H
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "JsonDocument.h"
+#include "JsonError.h"
+#include "JsonWriter.h"
+
+/*! Registers fields of a struct for JsonSerializer, list of fields is an X-macro like error codes:
+		struct User { int64_t id; std::string name; std::vector<std::string> tags; };
+		#define ZEST_USER_FIELDS(field) field(id) field(name) field(tags)
+		ZEST_JSON_REFLECT(User, ZEST_USER_FIELDS)
+	Use it at namespace scope of the struct, json names are member names.
+*/
+#define ZEST_JSON_FIELD(member) ::Zest::Lib::Json::JsonField<ZestJsonType>::Make<decltype(ZestJsonType::member), &ZestJsonType::member>(#member),
+#define ZEST_JSON_REFLECT(Type, Fields) \
+inline const auto& ZestJsonGetFields(const Type*) noexcept \
+{ \
+	using ZestJsonType = Type; \
+	static constexpr ::Zest::Lib::Json::JsonField<Type> c_fields[]{ Fields(ZEST_JSON_FIELD) }; \
+	static constexpr ::Zest::Lib::Json::JsonFieldTable<Type, sizeof(c_fields) / sizeof(c_fields[0])> c_table{ c_fields }; \
+	return c_table; \
+}
+
+/*! Registers enumerators of an enum, a value read from json must be one of them:
+		enum class Role: uint8_t { Guest, Admin = 7 };
+		#define ZEST_ROLE_VALUES(value) value(Guest) value(Admin)
+		ZEST_JSON_REFLECT_ENUM(Role, ZEST_ROLE_VALUES)
+	Use it at namespace scope of the enum, every enum bound by JsonSerializer must be registered.
+*/
+#define ZEST_JSON_ENUMERATOR(name) ZestJsonEnumType::name,
+#define ZEST_JSON_REFLECT_ENUM(Type, Values) \
+inline const auto& ZestJsonGetEnumerators(const Type*) noexcept \
+{ \
+	using ZestJsonEnumType = Type; \
+	static constexpr Type c_values[]{ Values(ZEST_JSON_ENUMERATOR) }; \
+	return c_values; \
+}
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! Reads T from a cursor and writes it to a writer, specialize it for other types.
+	Defined for bool, integers, floating point, std::string, std::vector, std::optional, maps with
+	string keys, enums registered by ZEST_JSON_REFLECT_ENUM and structs registered by ZEST_JSON_REFLECT.
+*/
+template<typename T, typename = void>
+struct JsonBinder;
+
+template<typename T>
+struct JsonField
+{
+	std::string_view name;
+	void (*pRead)(const JsonCursor& cursor, T& value){ nullptr };
+	void (*pWrite)(JsonWriter& writer, const T& value){ nullptr };
+
+	template<typename TMember, TMember T::* pMember>
+	static constexpr JsonField Make(std::string_view name) noexcept
+	{
+		return JsonField{ name, &ReadMember<TMember, pMember>, &WriteMember<TMember, pMember> };
+	}
+
+private:
+	template<typename TMember, TMember T::* pMember>
+	static void ReadMember(const JsonCursor& cursor, T& value)
+	{
+		JsonBinder<TMember>::Read(cursor, value.*pMember);
+	}
+
+	template<typename TMember, TMember T::* pMember>
+	static void WriteMember(JsonWriter& writer, const T& value)
+	{
+		JsonBinder<TMember>::Write(writer, value.*pMember);
+	}
+};
+
+/*! Fields in declaration order with a perfect hash of their names, built at compile time.
+	Seed of hash is searched until every name has its own slot, so a key costs one hash and one compare.
+	Duplicate names never get a seed, which fails compilation.
+*/
+template<typename T, std::size_t N>
+class JsonFieldTable
+{
+public:
+	static_assert(N < 0xFF, "Too many fields.");
+
+	constexpr explicit JsonFieldTable(const JsonField<T> (&fields)[N])
+		: m_fields{}, m_slots{}, m_seed{ 0 }
+	{
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			m_fields[i] = fields[i];
+		}
+		for (uint32_t seed = 0; seed < c_maxSeed; ++seed)
+		{
+			if (TrySeed(seed))
+			{
+				m_seed = seed;
+				return;
+			}
+		}
+		throw JsonError{ JsonErrorCode::Parse_Malformat, "Duplicate field names." };
+	}
+
+	// Nullptr for unknown name.
+	const JsonField<T>* Find(std::string_view name) const noexcept
+	{
+		uint8_t index{ m_slots[GetSlot(name, m_seed)] };
+		return index != c_emptySlot && m_fields[index].name == name ? &m_fields[index] : nullptr;
+	}
+
+	const JsonField<T>* begin() const noexcept
+	{
+		return m_fields;
+	}
+
+	const JsonField<T>* end() const noexcept
+	{
+		return m_fields + N;
+	}
+
+private:
+	static constexpr uint8_t c_emptySlot{ 0xFF };
+	static constexpr uint32_t c_maxSeed{ 1 << 12 };
+
+	static constexpr std::size_t GetSlotCount() noexcept
+	{
+		// Square of field count keeps chance of no collision for a seed above one half.
+		std::size_t slotCount{ 4 };
+		while (slotCount < N * N)
+		{
+			slotCount *= 2;
+		}
+		return slotCount;
+	}
+
+	static constexpr std::size_t c_slotCount{ GetSlotCount() };
+
+	// FNV-1a from seed, high bits folded in because slot takes low bits only.
+	static constexpr std::size_t GetSlot(std::string_view name, uint32_t seed) noexcept
+	{
+		uint32_t hash{ 2166136261u ^ (seed * 0x9E3779B9u) };
+		for (char c : name)
+		{
+			hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+		}
+		return (hash ^ (hash >> 16)) & (c_slotCount - 1);
+	}
+
+	constexpr bool TrySeed(uint32_t seed)
+	{
+		for (std::size_t i = 0; i < c_slotCount; ++i)
+		{
+			m_slots[i] = c_emptySlot;
+		}
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			std::size_t slot{ GetSlot(m_fields[i].name, seed) };
+			if (m_slots[slot] != c_emptySlot)
+			{
+				return false;
+			}
+			m_slots[slot] = static_cast<uint8_t>(i);
+		}
+		return true;
+	}
+
+	JsonField<T> m_fields[N];
+	uint8_t m_slots[c_slotCount];
+	uint32_t m_seed;
+};
+
+template<typename T, typename = void>
+struct IsJsonReflected: std::false_type
+{
+};
+
+// Found by argument dependent lookup in namespace of T.
+template<typename T>
+struct IsJsonReflected<T, std::void_t<decltype(ZestJsonGetFields(static_cast<const T*>(nullptr)))>>: std::true_type
+{
+};
+
+template<typename T, typename = void>
+struct IsJsonEnumReflected: std::false_type
+{
+};
+
+template<typename T>
+struct IsJsonEnumReflected<T, std::void_t<decltype(ZestJsonGetEnumerators(static_cast<const T*>(nullptr)))>>: std::true_type
+{
+};
+
+/*! Binds json to structs and back without building Dynamic.
+	Input is indexed once by JsonDocument, then fields are decoded straight into members.
+	Unknown properties are skipped, missing ones keep their value, type mismatch throws
+	AcessDenied error like JsonCursor does, numbers out of range of field and enum values
+	which are not enumerators throw JsonError.
+*/
+class JsonSerializer
+{
+public:
+	template<typename T>
+	static void Read(const JsonCursor& cursor, T& value)
+	{
+		JsonBinder<T>::Read(cursor, value);
+	}
+
+	template<typename T>
+	static T Parse(const std::string& jsonString)
+	{
+		return Parse<T>(jsonString.data(), jsonString.size());
+	}
+
+	template<typename T>
+	static T Parse(const char* jsonString, std::size_t size)
+	{
+		JsonDocument document;
+		T value{};
+		JsonBinder<T>::Read(document.Parse(jsonString, size), value);
+		return value;
+	}
+
+	template<typename T>
+	static void Write(JsonWriter& writer, const T& value)
+	{
+		JsonBinder<T>::Write(writer, value);
+	}
+
+	template<typename T>
+	static std::string ToString(const T& value, std::size_t indentSize = 0)
+	{
+		JsonWriter writer;
+		writer.SetIndent(indentSize);
+		JsonBinder<T>::Write(writer, value);
+		return std::string{ writer.GetString() };
+	}
+};
+
+template<typename T>
+struct JsonBinder<T, std::enable_if_t<IsJsonReflected<T>::value>>
+{
+	static void Read(const JsonCursor& cursor, T& value)
+	{
+		const auto& fields{ ZestJsonGetFields(static_cast<const T*>(nullptr)) };
+		cursor.ForEachProperty([&fields, &value](std::string_view name, const JsonCursor& property)
+		{
+			const JsonField<T>* pField{ fields.Find(name) };
+			if (pField != nullptr)
+			{
+				pField->pRead(property, value);
+			}
+		});
+	}
+
+	static void Write(JsonWriter& writer, const T& value)
+	{
+		writer.StartObject();
+		for (const JsonField<T>& field : ZestJsonGetFields(static_cast<const T*>(nullptr)))
+		{
+			writer.Key(field.name);
+			field.pWrite(writer, value);
+		}
+		writer.EndObject();
+	}
+};
+
+template<>
+struct JsonBinder<bool>
+{
+	static void Read(const JsonCursor& cursor, bool& value)
+	{
+		value = cursor.GetBool();
+	}
+
+	static void Write(JsonWriter& writer, bool value)
+	{
+		writer.Bool(value);
+	}
+};
+
+// Integers are int64 in json, unsigned values above INT64_MAX are out of range.
+template<typename T>
+struct JsonBinder<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>>
+{
+	static void Read(const JsonCursor& cursor, T& value)
+	{
+		int64_t integer{ cursor.GetInt64() };
+		bool isInRange;
+		if constexpr (std::is_signed<T>::value)
+		{
+			isInRange = integer >= static_cast<int64_t>(std::numeric_limits<T>::min()) && integer <= static_cast<int64_t>(std::numeric_limits<T>::max());
+		}
+		else
+		{
+			isInRange = integer >= 0 && static_cast<uint64_t>(integer) <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+		}
+		if (!isInRange)
+		{
+			ThrowOutOfRange();
+		}
+		value = static_cast<T>(integer);
+	}
+
+	static void Write(JsonWriter& writer, T value)
+	{
+		if (!std::is_signed<T>::value && static_cast<uint64_t>(value) > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+		{
+			ThrowOutOfRange();
+		}
+		writer.Int(static_cast<int64_t>(value));
+	}
+
+private:
+	[[noreturn]] static void ThrowOutOfRange()
+	{
+		throw JsonError{ JsonErrorCode::Parse_Malformat, "Number out of range of field." };
+	}
+};
+
+template<typename T>
+struct JsonBinder<T, std::enable_if_t<std::is_enum<T>::value>>
+{
+	using Underlying = std::underlying_type_t<T>;
+
+	// Without enumerators any value of underlying type would be accepted.
+	static_assert(IsJsonEnumReflected<T>::value, "Enum must be registered by ZEST_JSON_REFLECT_ENUM.");
+
+	static void Read(const JsonCursor& cursor, T& value)
+	{
+		Underlying integer;
+		JsonBinder<Underlying>::Read(cursor, integer);
+		for (T enumerator : ZestJsonGetEnumerators(static_cast<const T*>(nullptr)))
+		{
+			if (static_cast<Underlying>(enumerator) == integer)
+			{
+				value = enumerator;
+				return;
+			}
+		}
+		throw JsonError{ JsonErrorCode::Parse_Malformat, "Value is not an enumerator of field." };
+	}
+
+	static void Write(JsonWriter& writer, T value)
+	{
+		JsonBinder<Underlying>::Write(writer, static_cast<Underlying>(value));
+	}
+};
+
+template<typename T>
+struct JsonBinder<T, std::enable_if_t<std::is_floating_point<T>::value>>
+{
+	static void Read(const JsonCursor& cursor, T& value)
+	{
+		value = static_cast<T>(cursor.GetDouble());
+	}
+
+	static void Write(JsonWriter& writer, T value)
+	{
+		writer.Double(static_cast<double>(value));
+	}
+};
+
+template<>
+struct JsonBinder<std::string>
+{
+	static void Read(const JsonCursor& cursor, std::string& value)
+	{
+		value = cursor.GetString();
+	}
+
+	static void Write(JsonWriter& writer, const std::string& value)
+	{
+		writer.String(value);
+	}
+};
+
+template<typename T, typename TAllocator>
+struct JsonBinder<std::vector<T, TAllocator>>
+{
+	static void Read(const JsonCursor& cursor, std::vector<T, TAllocator>& value)
+	{
+		value.clear();
+		cursor.ForEachElement([&value](const JsonCursor& element)
+		{
+			if constexpr (std::is_same<T, bool>::value)
+			{
+				// Elements of std::vector<bool> are bits, back() is a proxy and can't bind to bool&.
+				bool flag{ false };
+				JsonBinder<bool>::Read(element, flag);
+				value.push_back(flag);
+			}
+			else
+			{
+				value.emplace_back();
+				JsonBinder<T>::Read(element, value.back());
+			}
+		});
+	}
+
+	static void Write(JsonWriter& writer, const std::vector<T, TAllocator>& value)
+	{
+		writer.StartArray();
+		// Not const T&, element of std::vector<bool> is a temporary.
+		for (auto&& element : value)
+		{
+			JsonBinder<T>::Write(writer, element);
+		}
+		writer.EndArray();
+	}
+};
+
+// Null is empty optional and empty optional is null.
+template<typename T>
+struct JsonBinder<std::optional<T>>
+{
+	static void Read(const JsonCursor& cursor, std::optional<T>& value)
+	{
+		if (cursor.IsNull())
+		{
+			value.reset();
+			return;
+		}
+		value.emplace();
+		JsonBinder<T>::Read(cursor, *value);
+	}
+
+	static void Write(JsonWriter& writer, const std::optional<T>& value)
+	{
+		if (value.has_value())
+		{
+			JsonBinder<T>::Write(writer, *value);
+		}
+		else
+		{
+			writer.Null();
+		}
+	}
+};
+
+// Object with any property names, for std::map and std::unordered_map with string keys.
+template<typename TMap>
+struct JsonMapBinder
+{
+	static void Read(const JsonCursor& cursor, TMap& value)
+	{
+		value.clear();
+		cursor.ForEachProperty([&value](std::string_view name, const JsonCursor& property)
+		{
+			JsonBinder<typename TMap::mapped_type>::Read(property, value[std::string{ name }]);
+		});
+	}
+
+	static void Write(JsonWriter& writer, const TMap& value)
+	{
+		writer.StartObject();
+		for (const auto& entry : value)
+		{
+			writer.Key(entry.first);
+			JsonBinder<typename TMap::mapped_type>::Write(writer, entry.second);
+		}
+		writer.EndObject();
+	}
+};
+
+template<typename T, typename TCompare, typename TAllocator>
+struct JsonBinder<std::map<std::string, T, TCompare, TAllocator>>: JsonMapBinder<std::map<std::string, T, TCompare, TAllocator>>
+{
+};
+
+template<typename T, typename THash, typename TEqual, typename TAllocator>
+struct JsonBinder<std::unordered_map<std::string, T, THash, TEqual, TAllocator>>: JsonMapBinder<std::unordered_map<std::string, T, THash, TEqual, TAllocator>>
+{
+};
+
+}}}
+
+#endif
@@ -0,0 +1,881 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONSCHEMA_H
+#define ZEST_LIB_JSONSCHEMA_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Dynamics.h"
+#include "../Encoding.h"
+#include "../Hash.h"
+#include "Json.h"
+#include "JsonError.h"
+#include "JsonNumber.h"
+#include "JsonString.h"
+#include "JsonStructuralIndex.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! JSON Schema compiled into a tree of checks, see JsonSchemaParser.
+	Supported keywords:
+		type, enum and const of scalars, minimum, maximum, exclusiveMinimum, exclusiveMaximum,
+		minLength, maxLength, properties, required, additionalProperties, minProperties,
+		maxProperties, items with a single schema, minItems, maxItems, and true or false schemas.
+	Annotations like title, description, default or format are ignored, other keywords ($ref,
+	allOf, pattern, ...) throw Schema_Invalid instead of being skipped, so a schema is never
+	checked less strictly than it reads. Numbers are compared as double.
+	Compiled schema is immutable, copies share it and parsers on many threads can use it.
+*/
+class JsonSchema
+{
+public:
+	// Throws JsonError with Schema_Invalid.
+	static JsonSchema Compile(const Dynamic& schema)
+	{
+		JsonSchema compiled;
+		compiled.m_spRoot = CompileNode(schema);
+		return compiled;
+	}
+
+	static JsonSchema Compile(const std::string& schemaJson)
+	{
+		return Compile(JsonParser::ParseJson(schemaJson));
+	}
+
+private:
+	friend class JsonSchemaParser;
+
+	static constexpr uint32_t c_nullType{ 1 << 0 };
+	static constexpr uint32_t c_booleanType{ 1 << 1 };
+	static constexpr uint32_t c_integerType{ 1 << 2 };
+	// Number includes integer, as in JSON Schema.
+	static constexpr uint32_t c_numberType{ 1 << 3 };
+	static constexpr uint32_t c_stringType{ 1 << 4 };
+	static constexpr uint32_t c_arrayType{ 1 << 5 };
+	static constexpr uint32_t c_objectType{ 1 << 6 };
+	static constexpr uint32_t c_anyType{ (1 << 7) - 1 };
+	static constexpr std::size_t c_typeCount{ 7 };
+	static constexpr std::size_t c_notRequired{ std::numeric_limits<std::size_t>::max() };
+	static constexpr uint32_t c_emptySlot{ std::numeric_limits<uint32_t>::max() };
+	static constexpr uint64_t c_maxSeedTries{ 64 };
+
+	struct Node;
+
+	struct Property
+	{
+		DynamicKey key;
+		// Null when property is only required, its value can be anything.
+		std::unique_ptr<Node> spNode;
+		std::size_t requiredIndex{ c_notRequired };
+	};
+
+	struct Node
+	{
+		// Types of false schema is zero, it matches no value.
+		uint32_t types{ c_anyType };
+		std::vector<Dynamic> enumValues;
+		double minimum{ -std::numeric_limits<double>::infinity() };
+		double maximum{ std::numeric_limits<double>::infinity() };
+		bool isMinimumExclusive{ false };
+		bool isMaximumExclusive{ false };
+		// Length in code points.
+		std::size_t minLength{ 0 };
+		std::size_t maxLength{ std::numeric_limits<std::size_t>::max() };
+		std::size_t minItems{ 0 };
+		std::size_t maxItems{ std::numeric_limits<std::size_t>::max() };
+		std::unique_ptr<Node> spItems;
+		std::size_t minProperties{ 0 };
+		std::size_t maxProperties{ std::numeric_limits<std::size_t>::max() };
+		std::vector<Property> properties;
+		// Perfect hash of property names, slot holds index of property or c_emptySlot.
+		std::vector<uint32_t> slots;
+		uint64_t seed{ 0 };
+		std::size_t requiredCount{ 0 };
+		// Null allows any additional property.
+		std::unique_ptr<Node> spAdditional;
+
+		bool HasLengthLimit() const noexcept
+		{
+			return minLength != 0 || maxLength != std::numeric_limits<std::size_t>::max();
+		}
+
+		// One hash and one compare, there is no probing.
+		const Property* FindProperty(ValueMap::StringView name) const noexcept
+		{
+			if (slots.empty())
+			{
+				return nullptr;
+			}
+			uint32_t index{ slots[Hash::HashBytes(name.data(), name.size(), seed) & (slots.size() - 1)] };
+			if (index == c_emptySlot || properties[index].key.GetName() != name)
+			{
+				return nullptr;
+			}
+			return &properties[index];
+		}
+	};
+
+	static const char* GetTypeName(std::size_t typeIndex) noexcept
+	{
+		static const char* const typeNames[c_typeCount]{ "null", "boolean", "integer", "number", "string", "array", "object" };
+		return typeNames[typeIndex];
+	}
+
+	[[noreturn]] static void ThrowInvalid(const std::string& message)
+	{
+		throw JsonError{ JsonErrorCode::Schema_Invalid, message.c_str() };
+	}
+
+	static std::unique_ptr<Node> CompileNode(const Dynamic& schema)
+	{
+		auto spNode = std::make_unique<Node>();
+		if (schema.GetType() == ValueMap::Type::Bool)
+		{
+			spNode->types = schema.GetBool() ? c_anyType : 0;
+			return spNode;
+		}
+		if (schema.GetType() != ValueMap::Type::Object)
+		{
+			ThrowInvalid("Schema must be an object or boolean");
+		}
+
+		const Dynamic* pRequired{ nullptr };
+		for (const auto& entry : schema.GetObjectMap())
+		{
+			const ValueMap::String& keyword{ entry.first.GetName() };
+			const Dynamic& value{ entry.second };
+			if (keyword == "type")
+			{
+				spNode->types = CompileTypes(value);
+			}
+			else if (keyword == "enum")
+			{
+				if (value.GetType() != ValueMap::Type::Array)
+				{
+					ThrowInvalid("enum must be an array");
+				}
+				for (const Dynamic& element : value.GetArray())
+				{
+					AddEnumValue(*spNode, element);
+				}
+			}
+			else if (keyword == "const")
+			{
+				AddEnumValue(*spNode, value);
+			}
+			else if (keyword == "minimum" || keyword == "exclusiveMinimum")
+			{
+				SetMinimum(*spNode, ReadNumber(value, keyword), keyword == "exclusiveMinimum");
+			}
+			else if (keyword == "maximum" || keyword == "exclusiveMaximum")
+			{
+				SetMaximum(*spNode, ReadNumber(value, keyword), keyword == "exclusiveMaximum");
+			}
+			else if (keyword == "minLength")
+			{
+				spNode->minLength = ReadCount(value, keyword);
+			}
+			else if (keyword == "maxLength")
+			{
+				spNode->maxLength = ReadCount(value, keyword);
+			}
+			else if (keyword == "minItems")
+			{
+				spNode->minItems = ReadCount(value, keyword);
+			}
+			else if (keyword == "maxItems")
+			{
+				spNode->maxItems = ReadCount(value, keyword);
+			}
+			else if (keyword == "minProperties")
+			{
+				spNode->minProperties = ReadCount(value, keyword);
+			}
+			else if (keyword == "maxProperties")
+			{
+				spNode->maxProperties = ReadCount(value, keyword);
+			}
+			else if (keyword == "items")
+			{
+				if (value.GetType() == ValueMap::Type::Array)
+				{
+					ThrowInvalid("items as array of schemas is not supported");
+				}
+				spNode->spItems = CompileNode(value);
+			}
+			else if (keyword == "properties")
+			{
+				if (value.GetType() != ValueMap::Type::Object)
+				{
+					ThrowInvalid("properties must be an object");
+				}
+				for (const auto& property : value.GetObjectMap())
+				{
+					spNode->properties.push_back(Property{ property.first, CompileNode(property.second) });
+				}
+			}
+			else if (keyword == "required")
+			{
+				pRequired = &value;
+			}
+			else if (keyword == "additionalProperties")
+			{
+				spNode->spAdditional = CompileNode(value);
+			}
+			else if (!IsAnnotation(keyword))
+			{
+				ThrowInvalid("Unsupported schema keyword \"" + keyword + "\"");
+			}
+		}
+
+		// After properties, whichever order the keywords came in.
+		if (pRequired != nullptr)
+		{
+			CompileRequired(*spNode, *pRequired);
+		}
+		BuildSlots(*spNode);
+		return spNode;
+	}
+
+	static bool IsAnnotation(const ValueMap::String& keyword) noexcept
+	{
+		static const char* const annotations[]{ "$schema", "$id", "id", "$comment", "title", "description", "default", "examples", "format", "readOnly", "writeOnly", "deprecated" };
+		for (const char* annotation : annotations)
+		{
+			if (keyword == annotation)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static uint32_t CompileType(const Dynamic& value)
+	{
+		if (value.GetType() == ValueMap::Type::String)
+		{
+			for (std::size_t typeIndex = 0; typeIndex < c_typeCount; ++typeIndex)
+			{
+				if (value.GetString() == GetTypeName(typeIndex))
+				{
+					return uint32_t{ 1 } << typeIndex;
+				}
+			}
+		}
+		ThrowInvalid("type must be a type name or an array of them");
+	}
+
+	static uint32_t CompileTypes(const Dynamic& value)
+	{
+		if (value.GetType() != ValueMap::Type::Array)
+		{
+			return CompileType(value);
+		}
+		uint32_t types{ 0 };
+		for (const Dynamic& element : value.GetArray())
+		{
+			types |= CompileType(element);
+		}
+		return types;
+	}
+
+	// Containers would have to be built before they are compared, so they are rejected.
+	static void AddEnumValue(Node& node, const Dynamic& value)
+	{
+		if (value.GetType() == ValueMap::Type::Object || value.GetType() == ValueMap::Type::Array)
+		{
+			ThrowInvalid("enum and const support only scalar values");
+		}
+		node.enumValues.push_back(value);
+	}
+
+	static bool IsNumberType(ValueMap::Type type) noexcept
+	{
+		return type == ValueMap::Type::Int32 || type == ValueMap::Type::Int64 || type == ValueMap::Type::Double;
+	}
+
+	static double ReadNumber(const Dynamic& value, const ValueMap::String& keyword)
+	{
+		if (!IsNumberType(value.GetType()))
+		{
+			ThrowInvalid(keyword + " must be a number");
+		}
+		return value.GetDouble();
+	}
+
+	static std::size_t ReadCount(const Dynamic& value, const ValueMap::String& keyword)
+	{
+		double count{ IsNumberType(value.GetType()) ? value.GetDouble() : -1.0 };
+		if (count < 0.0 || std::trunc(count) != count)
+		{
+			ThrowInvalid(keyword + " must be a non-negative integer");
+		}
+		return count >= static_cast<double>(std::numeric_limits<std::size_t>::max()) ? std::numeric_limits<std::size_t>::max() : static_cast<std::size_t>(count);
+	}
+
+	// Both minimum and exclusiveMinimum may be given, the stricter one is kept.
+	static void SetMinimum(Node& node, double minimum, bool isExclusive) noexcept
+	{
+		if (minimum > node.minimum || (minimum == node.minimum && isExclusive))
+		{
+			node.minimum = minimum;
+			node.isMinimumExclusive = isExclusive;
+		}
+	}
+
+	static void SetMaximum(Node& node, double maximum, bool isExclusive) noexcept
+	{
+		if (maximum < node.maximum || (maximum == node.maximum && isExclusive))
+		{
+			node.maximum = maximum;
+			node.isMaximumExclusive = isExclusive;
+		}
+	}
+
+	// Required names without a schema in properties are added with any value allowed.
+	static void CompileRequired(Node& node, const Dynamic& required)
+	{
+		if (required.GetType() != ValueMap::Type::Array)
+		{
+			ThrowInvalid("required must be an array");
+		}
+		for (const Dynamic& name : required.GetArray())
+		{
+			if (name.GetType() != ValueMap::Type::String)
+			{
+				ThrowInvalid("required must be an array of strings");
+			}
+			Property* pProperty{ nullptr };
+			for (Property& property : node.properties)
+			{
+				if (property.key.GetName() == name.GetString())
+				{
+					pProperty = &property;
+					break;
+				}
+			}
+			if (pProperty == nullptr)
+			{
+				ValueMap::StringView nameView{ name.GetString() };
+				node.properties.push_back(Property{ DynamicKeyTable::GetInstance().Intern(nameView.data(), nameView.size()), nullptr });
+				pProperty = &node.properties.back();
+			}
+			if (pProperty->requiredIndex == c_notRequired)
+			{
+				pProperty->requiredIndex = node.requiredCount++;
+			}
+		}
+	}
+
+	/*! Seeds are tried on a table with twice the slots of properties, the table doubles when
+		none of them places every property in its own slot. Search is done once per schema,
+		tables stay near 2 to 4 slots per property for the property counts of real schemas.
+	*/
+	static void BuildSlots(Node& node)
+	{
+		if (node.properties.empty())
+		{
+			return;
+		}
+		std::size_t slotCount{ 2 };
+		while (slotCount < node.properties.size() * 2)
+		{
+			slotCount *= 2;
+		}
+		for (;; slotCount *= 2)
+		{
+			for (uint64_t seed = 1; seed <= c_maxSeedTries; ++seed)
+			{
+				node.slots.assign(slotCount, c_emptySlot);
+				bool isPerfect{ true };
+				for (std::size_t i = 0; i < node.properties.size() && isPerfect; ++i)
+				{
+					const ValueMap::String& name{ node.properties[i].key.GetName() };
+					uint32_t& slot{ node.slots[Hash::HashBytes(name.data(), name.size(), seed) & (slotCount - 1)] };
+					isPerfect = slot == c_emptySlot;
+					slot = static_cast<uint32_t>(i);
+				}
+				if (isPerfect)
+				{
+					node.seed = seed;
+					return;
+				}
+			}
+		}
+	}
+
+	std::shared_ptr<const Node> m_spRoot;
+};
+
+/*! Parser which checks a compiled JsonSchema while it parses, instead of validating a finished Dynamic.
+	Each value is checked against its schema node as soon as it is read: type by its first
+	character before its content is parsed, counts as members are added, so invalid documents
+	are rejected at the first violation without being built. Known properties are found by the
+	perfect hash of their object, and their interned key is reused.
+		JsonSchemaParser parser{ JsonSchema::Compile(schemaJson) };
+		Dynamic document = parser.Parse(jsonString);
+		parser.Validate(otherJson);
+	Violations throw JsonError with Schema_Violation and the offset of the value, malformed json
+	throws the same errors as JsonParser. Parser can be reused, index memory is kept.
+*/
+class JsonSchemaParser
+{
+public:
+	// Nesting deeper than this is rejected, so malicious input can't overflow stack.
+	static constexpr std::size_t c_maxDepth{ 1024 };
+
+	explicit JsonSchemaParser(JsonSchema schema) noexcept
+		: m_schema{ std::move(schema) }
+	{
+	}
+
+	JsonSchemaParser(const JsonSchemaParser&) = delete;
+	JsonSchemaParser& operator=(const JsonSchemaParser&) = delete;
+
+	Dynamic Parse(const std::string& jsonString)
+	{
+		return Parse(jsonString.data(), jsonString.size());
+	}
+
+	Dynamic Parse(const char* jsonString, std::size_t size)
+	{
+		return Run<true>(jsonString, size);
+	}
+
+	// Checks document without building values.
+	void Validate(const std::string& jsonString)
+	{
+		Validate(jsonString.data(), jsonString.size());
+	}
+
+	void Validate(const char* jsonString, std::size_t size)
+	{
+		Run<false>(jsonString, size);
+	}
+
+private:
+	using Node = JsonSchema::Node;
+	using Property = JsonSchema::Property;
+
+	static const Node& GetAnyNode() noexcept
+	{
+		static const Node anyNode;
+		return anyNode;
+	}
+
+	template<bool t_isBuild>
+	Dynamic Run(const char* jsonString, std::size_t size)
+	{
+		m_index.Build(jsonString, size);
+		if (m_index.Size() == 0)
+		{
+			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+		}
+
+		m_pInput = jsonString;
+		m_inputSize = size;
+		m_next = 0;
+		Dynamic value = ParseValue<t_isBuild>(m_schema.m_spRoot != nullptr ? *m_schema.m_spRoot : GetAnyNode(), 0);
+		if (m_next != m_index.Size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected content after value", m_index[m_next]);
+		}
+		return value;
+	}
+
+	uint32_t NextPosition()
+	{
+		if (m_next == m_index.Size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected end", m_inputSize);
+		}
+		return m_index[m_next++];
+	}
+
+	char PeekCharacter() const noexcept
+	{
+		return m_next < m_index.Size() ? m_pInput[m_index[m_next]] : '\0';
+	}
+
+	[[noreturn]] static void ThrowUnexpected(std::size_t position)
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", position);
+	}
+
+	[[noreturn]] static void ThrowViolation(const std::string& message, std::size_t position)
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Schema_Violation, message.c_str(), position);
+	}
+
+	[[noreturn]] static void ThrowTypeViolation(const Node& node, std::size_t position)
+	{
+		std::string message{ "Expected type" };
+		const char* separator{ " " };
+		for (std::size_t typeIndex = 0; typeIndex < JsonSchema::c_typeCount; ++typeIndex)
+		{
+			if ((node.types & (uint32_t{ 1 } << typeIndex)) != 0)
+			{
+				message += separator;
+				message += JsonSchema::GetTypeName(typeIndex);
+				separator = " or ";
+			}
+		}
+		ThrowViolation(node.types == 0 ? std::string{ "No value allowed" } : message, position);
+	}
+
+	// Enum is matched by a predicate, so scalars are compared without being built.
+	template<typename TMatch>
+	static void CheckEnum(const Node& node, std::size_t position, TMatch&& isMatch)
+	{
+		if (node.enumValues.empty())
+		{
+			return;
+		}
+		for (const Dynamic& enumValue : node.enumValues)
+		{
+			if (isMatch(enumValue))
+			{
+				return;
+			}
+		}
+		ThrowViolation("Value not in enum", position);
+	}
+
+	static uint32_t GetValueType(char character) noexcept
+	{
+		switch (character)
+		{
+			case '{':
+				return JsonSchema::c_objectType;
+			case '[':
+				return JsonSchema::c_arrayType;
+			case '"':
+				return JsonSchema::c_stringType;
+			case 't':
+			case 'f':
+				return JsonSchema::c_booleanType;
+			case 'n':
+				return JsonSchema::c_nullType;
+			default:
+				// Integer or not is known after parsing.
+				return JsonSchema::c_integerType | JsonSchema::c_numberType;
+		}
+	}
+
+	template<bool t_isBuild>
+	Dynamic ParseValue(const Node& node, std::size_t depth)
+	{
+		uint32_t position{ NextPosition() };
+		char character{ m_pInput[position] };
+		if ((node.types & GetValueType(character)) == 0)
+		{
+			ThrowTypeViolation(node, position);
+		}
+		switch (character)
+		{
+			case '{':
+				return ParseObject<t_isBuild>(node, position, depth + 1);
+			case '[':
+				return ParseArray<t_isBuild>(node, position, depth + 1);
+			case '"':
+				return ParseString<t_isBuild>(node, position);
+			case 't':
+			case 'f':
+			{
+				bool value{ character == 't' };
+				ParseLiteral(position, value ? "true" : "false", value ? 4 : 5);
+				CheckEnum(node, position, [value](const Dynamic& enumValue) { return enumValue.GetType() == ValueMap::Type::Bool && enumValue.GetBool() == value; });
+				return t_isBuild ? Dynamic(value) : Dynamic();
+			}
+			case 'n':
+				ParseLiteral(position, "null", 4);
+				CheckEnum(node, position, [](const Dynamic& enumValue) { return enumValue.GetType() == ValueMap::Type::Null; });
+				return Dynamic();
+			default:
+				return ParseNumber<t_isBuild>(node, position);
+		}
+	}
+
+	template<bool t_isBuild>
+	Dynamic ParseObject(const Node& node, uint32_t position, std::size_t depth)
+	{
+		if (depth > c_maxDepth)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", position);
+		}
+
+		Dynamic object;
+		ValueMap::ObjectMap* pObjectMap{ nullptr };
+		if constexpr (t_isBuild)
+		{
+			object = Dynamic::MakeObject();
+			pObjectMap = &object.GetObjectMap();
+		}
+		// Required properties seen, first 64 in a mask, more only for very large schemas.
+		uint64_t seenMask{ 0 };
+		std::vector<bool> seen(node.requiredCount > 64 ? node.requiredCount : 0);
+		std::size_t seenCount{ 0 };
+		std::size_t count{ 0 };
+		if (PeekCharacter() == '}')
+		{
+			++m_next;
+		}
+		else
+		{
+			for (;;)
+			{
+				uint32_t keyPosition{ NextPosition() };
+				if (m_pInput[keyPosition] != '"')
+				{
+					ThrowUnexpected(keyPosition);
+				}
+				// Name is valid until the value is parsed, which may reuse scratch.
+				ValueMap::StringView name{ ReadStringView(keyPosition, m_keyScratch) };
+				if (++count > node.maxProperties)
+				{
+					ThrowViolation("Too many properties", keyPosition);
+				}
+
+				const Property* pProperty{ node.FindProperty(name) };
+				const Node* pValueNode{ &GetAnyNode() };
+				if (pProperty != nullptr)
+				{
+					pValueNode = pProperty->spNode != nullptr ? pProperty->spNode.get() : pValueNode;
+					std::size_t requiredIndex{ pProperty->requiredIndex };
+					if (requiredIndex < 64 && (seenMask & (uint64_t{ 1 } << requiredIndex)) == 0)
+					{
+						seenMask |= uint64_t{ 1 } << requiredIndex;
+						++seenCount;
+					}
+					else if (requiredIndex >= 64 && requiredIndex != JsonSchema::c_notRequired && !seen[requiredIndex])
+					{
+						seen[requiredIndex] = true;
+						++seenCount;
+					}
+				}
+				else if (node.spAdditional != nullptr)
+				{
+					if (node.spAdditional->types == 0)
+					{
+						ThrowViolation("Property \"" + std::string{ name } + "\" not allowed", keyPosition);
+					}
+					pValueNode = node.spAdditional.get();
+				}
+
+				DynamicKey key;
+				if constexpr (t_isBuild)
+				{
+					key = pProperty != nullptr ? pProperty->key : m_keyCache.Get(name.data(), name.size());
+				}
+
+				position = NextPosition();
+				if (m_pInput[position] != ':')
+				{
+					ThrowUnexpected(position);
+				}
+				Dynamic value = ParseValue<t_isBuild>(*pValueNode, depth);
+				if constexpr (t_isBuild)
+				{
+					pObjectMap->Set(key, std::move(value));
+				}
+
+				position = NextPosition();
+				if (m_pInput[position] == '}')
+				{
+					break;
+				}
+				if (m_pInput[position] != ',')
+				{
+					ThrowUnexpected(position);
+				}
+			}
+		}
+
+		if (count < node.minProperties)
+		{
+			ThrowViolation("Too few properties", position);
+		}
+		if (seenCount != node.requiredCount)
+		{
+			for (const Property& property : node.properties)
+			{
+				std::size_t requiredIndex{ property.requiredIndex };
+				bool isMissing{ requiredIndex < 64 ? (seenMask & (uint64_t{ 1 } << requiredIndex)) == 0 : requiredIndex != JsonSchema::c_notRequired && !seen[requiredIndex] };
+				if (isMissing)
+				{
+					ThrowViolation("Missing required property \"" + property.key.GetName() + "\"", position);
+				}
+			}
+		}
+		return object;
+	}
+
+	template<bool t_isBuild>
+	Dynamic ParseArray(const Node& node, uint32_t position, std::size_t depth)
+	{
+		if (depth > c_maxDepth)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", position);
+		}
+
+		const Node& itemNode{ node.spItems != nullptr ? *node.spItems : GetAnyNode() };
+		ValueMap::Array array;
+		std::size_t count{ 0 };
+		if (PeekCharacter() == ']')
+		{
+			++m_next;
+		}
+		else
+		{
+			for (;;)
+			{
+				if (++count > node.maxItems)
+				{
+					ThrowViolation("Too many items", m_index[m_next]);
+				}
+				Dynamic element = ParseValue<t_isBuild>(itemNode, depth);
+				if constexpr (t_isBuild)
+				{
+					array.push_back(std::move(element));
+				}
+
+				position = NextPosition();
+				if (m_pInput[position] == ']')
+				{
+					break;
+				}
+				if (m_pInput[position] != ',')
+				{
+					ThrowUnexpected(position);
+				}
+			}
+		}
+
+		if (count < node.minItems)
+		{
+			ThrowViolation("Too few items", position);
+		}
+		return t_isBuild ? Dynamic(std::move(array)) : Dynamic();
+	}
+
+	// Content of string at position, unescaped into scratch when it has escapes.
+	ValueMap::StringView ReadStringView(uint32_t position, ValueMap::String& scratch)
+	{
+		uint32_t end{ NextPosition() };
+		ValueMap::StringView raw{ m_pInput + position + 1, end - position - 1 };
+		if (std::memchr(raw.data(), '\\', raw.size()) == nullptr)
+		{
+			return raw;
+		}
+		scratch.clear();
+		JsonString::Unescape(raw, position + 1, scratch);
+		return scratch;
+	}
+
+	template<bool t_isBuild>
+	Dynamic ParseString(const Node& node, uint32_t position)
+	{
+		ValueMap::StringView value{ ReadStringView(position, m_scratch) };
+		if (node.HasLengthLimit())
+		{
+			std::size_t length{ Encoding::CountCodePoints(Encoding::Type::UTF8, value.data(), value.size()) };
+			if (length < node.minLength || length > node.maxLength)
+			{
+				ThrowViolation("String length out of range", position);
+			}
+		}
+		CheckEnum(node, position, [value](const Dynamic& enumValue) { return enumValue.GetType() == ValueMap::Type::String && enumValue.GetString() == value; });
+		return t_isBuild ? Dynamic(value) : Dynamic();
+	}
+
+	// Number or literal must end at whitespace, operator or end of input.
+	bool IsTokenEnd(std::size_t position) const noexcept
+	{
+		if (position >= m_inputSize)
+		{
+			return true;
+		}
+		switch (m_pInput[position])
+		{
+			case ' ': case '\t': case '\n': case '\r':
+			case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void ParseLiteral(uint32_t position, const char* literal, std::size_t length) const
+	{
+		if (m_inputSize - position < length || std::memcmp(m_pInput + position, literal, length) != 0 || !IsTokenEnd(position + length))
+		{
+			ThrowUnexpected(position);
+		}
+	}
+
+	template<bool t_isBuild>
+	Dynamic ParseNumber(const Node& node, uint32_t position) const
+	{
+		JsonNumber number;
+		const char* pEnd{ JsonNumber::Parse(m_pInput + position, m_pInput + m_inputSize, position, number) };
+		if (!IsTokenEnd(static_cast<std::size_t>(pEnd - m_pInput)))
+		{
+			ThrowUnexpected(static_cast<std::size_t>(pEnd - m_pInput));
+		}
+
+		double value{ number.isInteger ? static_cast<double>(number.integer) : number.value };
+		// Integer type accepts numbers without fraction, like 1.0.
+		bool isInteger{ number.isInteger || (std::isfinite(value) && std::trunc(value) == value) };
+		if ((node.types & JsonSchema::c_numberType) == 0 && !isInteger)
+		{
+			ThrowTypeViolation(node, position);
+		}
+		if (node.isMinimumExclusive ? value <= node.minimum : value < node.minimum)
+		{
+			ThrowViolation("Number below minimum", position);
+		}
+		if (node.isMaximumExclusive ? value >= node.maximum : value > node.maximum)
+		{
+			ThrowViolation("Number above maximum", position);
+		}
+
+		Dynamic result;
+		if (t_isBuild || !node.enumValues.empty())
+		{
+			if (!number.isInteger)
+			{
+				result = Dynamic(number.value);
+			}
+			else if (number.integer >= std::numeric_limits<ValueMap::Int32>::min() && number.integer <= std::numeric_limits<ValueMap::Int32>::max())
+			{
+				result = Dynamic(static_cast<ValueMap::Int32>(number.integer));
+			}
+			else
+			{
+				result = Dynamic(static_cast<ValueMap::Int64>(number.integer));
+			}
+		}
+		CheckEnum(node, position, [&result](const Dynamic& enumValue) { return enumValue == result; });
+		return result;
+	}
+
+	JsonSchema m_schema;
+	JsonStructuralIndex m_index;
+	const char* m_pInput{ nullptr };
+	std::size_t m_inputSize{ 0 };
+	std::size_t m_next{ 0 };
+	ValueMap::String m_scratch;
+	ValueMap::String m_keyScratch;
+	// Names of additional properties come from input, so they are not added to the global key table.
+	DynamicKeyCache m_keyCache;
+};
+
+}}}
+
+#endif
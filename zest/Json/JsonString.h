@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONSTRING_H
+#define ZEST_LIB_JSONSTRING_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "../Encoding.h"
+#include "JsonError.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! Decoding of json string content, shared by JsonParser and JsonReader.
+*/
+class JsonString
+{
+public:
+	/*! Length of UTF-8 sequence starting at position of pInput, which must be non-ASCII.
+		Rejects overlong forms, surrogates and code points above U+10FFFF.
+		offset is position of pInput in input, for error messages.
+	*/
+	static std::size_t ReadUtf8Sequence(const uint8_t* pInput, std::size_t size, std::size_t position, std::size_t offset)
+	{
+		std::size_t length{ Encoding::GetUtf8SequenceLength(pInput + position, size - position) };
+		if (length == 0)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_InvalidEncoding, "Invalid UTF-8", offset + position);
+		}
+		return length;
+	}
+
+	// Vectorized, see Encoding::FindInvalidUtf8.
+	static void ValidateUtf8(std::string_view value, std::size_t offset)
+	{
+		std::size_t position{ Encoding::FindInvalidUtf8(value.data(), value.size()) };
+		if (position != value.size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_InvalidEncoding, "Invalid UTF-8", offset + position);
+		}
+	}
+
+	// offset is position of raw in input, for error messages. TString is std::string or std::pmr::string.
+	template<typename TString>
+	static void Unescape(std::string_view raw, std::size_t offset, TString& value)
+	{
+		value.reserve(raw.size());
+		std::size_t position{ 0 };
+		while (position < raw.size())
+		{
+			const void* pBackslash{ std::memchr(raw.data() + position, '\\', raw.size() - position) };
+			std::size_t next{ pBackslash != nullptr ? static_cast<std::size_t>(static_cast<const char*>(pBackslash) - raw.data()) : raw.size() };
+			value.append(raw.data() + position, next - position);
+			if (next == raw.size())
+			{
+				break;
+			}
+
+			// A string never ends after a lone backslash, so escaped character exists.
+			position = next + 2;
+			switch (raw[next + 1])
+			{
+				case '"': value += '"'; break;
+				case '\\': value += '\\'; break;
+				case '/': value += '/'; break;
+				case 'b': value += '\b'; break;
+				case 'f': value += '\f'; break;
+				case 'n': value += '\n'; break;
+				case 'r': value += '\r'; break;
+				case 't': value += '\t'; break;
+				case 'u':
+				{
+					uint32_t codePoint{ ReadHex4(raw, position, offset) };
+					position += 4;
+					if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+					{
+						// High surrogate must be followed by escaped low surrogate.
+						if (position + 1 >= raw.size() || raw[position] != '\\' || raw[position + 1] != 'u')
+						{
+							throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Invalid surrogate pair", offset + next);
+						}
+						uint32_t low{ ReadHex4(raw, position + 2, offset) };
+						if (low < 0xDC00 || low > 0xDFFF)
+						{
+							throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Invalid surrogate pair", offset + next);
+						}
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+						position += 6;
+					}
+					else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+					{
+						throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Invalid surrogate pair", offset + next);
+					}
+					AppendUtf8(codePoint, value);
+					break;
+				}
+				default:
+					throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Invalid escape", offset + next);
+			}
+		}
+	}
+
+
+	static uint32_t ReadHex4(std::string_view raw, std::size_t position, std::size_t offset)
+	{
+		if (position + 4 > raw.size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Invalid unicode escape", offset + position);
+		}
+		uint32_t value{ 0 };
+		for (std::size_t i = position; i < position + 4; ++i)
+		{
+			char c{ raw[i] };
+			uint32_t digit;
+			if (c >= '0' && c <= '9')
+			{
+				digit = static_cast<uint32_t>(c - '0');
+			}
+			else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+			{
+				digit = static_cast<uint32_t>((c | 0x20) - 'a' + 10);
+			}
+			else
+			{
+				throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Invalid unicode escape", offset + i);
+			}
+			value = (value << 4) | digit;
+		}
+		return value;
+	}
+
+	template<typename TString>
+	static void AppendUtf8(uint32_t codePoint, TString& value)
+	{
+		if (codePoint < 0x80)
+		{
+			value += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			value += static_cast<char>(0xC0 | (codePoint >> 6));
+			value += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			value += static_cast<char>(0xE0 | (codePoint >> 12));
+			value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			value += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			value += static_cast<char>(0xF0 | (codePoint >> 18));
+			value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			value += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+};
+
+}}}
+
+#endif
@@ -0,0 +1,338 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONSTRUCTURALINDEX_H
+#define ZEST_LIB_JSONSTRUCTURALINDEX_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include "../Platform.h"
+#include "JsonError.h"
+#include "JsonString.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! Stage 1 of parsing: offsets of structural characters of json text, in input order.
+	Index holds every '{', '}', '[', ']', ':' and ',' outside strings, the opening and
+	closing quote of every string, and the first byte of every number and literal.
+	Input is classified 64 bytes at a time with SSE2 or AVX2 when they are enabled,
+	quotes inside strings are masked out with prefix xor of unescaped quotes.
+	UTF-8 is validated and control characters inside strings are rejected in the same pass.
+	Index can be rebuilt for other documents, its memory is reused.
+*/
+class JsonStructuralIndex
+{
+public:
+	static constexpr std::size_t c_blockSize{ 64 };
+
+	JsonStructuralIndex() noexcept
+		: m_size{ 0 }, m_capacity{ 0 }
+	{
+	}
+
+	JsonStructuralIndex(const JsonStructuralIndex&) = delete;
+	JsonStructuralIndex& operator=(const JsonStructuralIndex&) = delete;
+
+	// Throws JsonError for invalid UTF-8, control character in string or unterminated string.
+	void Build(const char* pInput, std::size_t size)
+	{
+		if (size >= std::numeric_limits<uint32_t>::max())
+		{
+			throw JsonError{ JsonErrorCode::Parse_Malformat, "Json input larger than 4GB." };
+		}
+
+		m_size = 0;
+		const uint8_t* pData{ reinterpret_cast<const uint8_t*>(pInput) };
+		State state;
+		std::size_t offset{ 0 };
+		for (; offset + c_blockSize <= size; offset += c_blockSize)
+		{
+			IndexBlock(pData, size, offset, pData + offset, state);
+		}
+		if (offset < size)
+		{
+			// Last block padded with spaces, which are never structural.
+			uint8_t block[c_blockSize];
+			std::memset(block, ' ', c_blockSize);
+			std::memcpy(block, pData + offset, size - offset);
+			IndexBlock(pData, size, offset, block, state);
+		}
+
+		if (state.inString != 0)
+		{
+			throw JsonError{ JsonErrorCode::Parse_Malformat, "Unterminated string." };
+		}
+	}
+
+	std::size_t Size() const noexcept
+	{
+		return m_size;
+	}
+
+	const uint32_t* GetPositions() const noexcept
+	{
+		return m_spPositions.get();
+	}
+
+	uint32_t operator[](std::size_t index) const noexcept
+	{
+		return m_spPositions[index];
+	}
+
+private:
+	struct State
+	{
+		// 1 if last byte of previous block is an unescaped backslash.
+		uint64_t isEscaped{ 0 };
+		// All ones if previous block ends inside a string.
+		uint64_t inString{ 0 };
+		// 1 if last byte of previous block is part of a number or literal.
+		uint64_t isScalar{ 0 };
+		// Input before this offset is known to be valid UTF-8.
+		std::size_t validUtf8End{ 0 };
+	};
+
+	// Bit i is set when byte i of block is of the class.
+	struct BlockMasks
+	{
+		uint64_t quote;
+		uint64_t backslash;
+		uint64_t operators;
+		uint64_t whitespace;
+		uint64_t control;
+		uint64_t nonAscii;
+	};
+
+	void IndexBlock(const uint8_t* pInput, std::size_t size, std::size_t offset, const uint8_t* pBlock, State& state)
+	{
+		BlockMasks masks;
+		Classify(pBlock, masks);
+
+		uint64_t quote{ masks.quote & ~FindEscaped(masks.backslash, state.isEscaped) };
+		uint64_t inString{ Platform::PrefixXor(quote) ^ state.inString };
+		state.inString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+		if ((masks.control & inString) != 0)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Control character in string",
+				offset + Platform::CountTrailingZeros(masks.control & inString));
+		}
+		if (masks.nonAscii != 0)
+		{
+			ValidateUtf8(pInput, size, offset + Platform::CountTrailingZeros(masks.nonAscii), offset + c_blockSize, state);
+		}
+
+		uint64_t operators{ masks.operators & ~inString };
+		uint64_t scalar{ ~(masks.operators | masks.whitespace | quote | inString) };
+		uint64_t scalarStart{ scalar & ~((scalar << 1) | state.isScalar) };
+		state.isScalar = scalar >> 63;
+
+		Append(offset, operators | quote | scalarStart);
+	}
+
+	// Bits of characters escaped by a backslash, backslashes escaped themselves don't escape.
+	static uint64_t FindEscaped(uint64_t backslash, uint64_t& isEscaped) noexcept
+	{
+		uint64_t escaped{ isEscaped };
+		backslash &= ~isEscaped;
+		isEscaped = 0;
+		while (backslash != 0)
+		{
+			uint32_t position{ Platform::CountTrailingZeros(backslash) };
+			if (position == 63)
+			{
+				isEscaped = 1;
+				break;
+			}
+			uint64_t next{ uint64_t{ 1 } << (position + 1) };
+			escaped |= next;
+			backslash &= ~next;
+			backslash &= backslash - 1;
+		}
+		return escaped;
+	}
+
+	void Append(std::size_t offset, uint64_t bits)
+	{
+		if (m_size + c_blockSize > m_capacity)
+		{
+			std::size_t capacity{ m_capacity < 1024 ? 1024 : m_capacity * 2 };
+			std::unique_ptr<uint32_t[]> spPositions{ new uint32_t[capacity] };
+			if (m_size != 0)
+			{
+				std::memcpy(spPositions.get(), m_spPositions.get(), m_size * sizeof(uint32_t));
+			}
+			m_spPositions = std::move(spPositions);
+			m_capacity = capacity;
+		}
+
+		uint32_t* pPositions{ m_spPositions.get() + m_size };
+		m_size += Platform::PopCount(bits);
+		while (bits != 0)
+		{
+			*pPositions++ = static_cast<uint32_t>(offset + Platform::CountTrailingZeros(bits));
+			bits &= bits - 1;
+		}
+	}
+
+	// Validate sequences from first non-ASCII byte of block, last sequence may run into next block.
+	static void ValidateUtf8(const uint8_t* pInput, std::size_t size, std::size_t begin, std::size_t blockEnd, State& state)
+	{
+		std::size_t position{ begin > state.validUtf8End ? begin : state.validUtf8End };
+		std::size_t end{ blockEnd < size ? blockEnd : size };
+		while (position < end)
+		{
+			if (pInput[position] < 0x80)
+			{
+				++position;
+				continue;
+			}
+			position += JsonString::ReadUtf8Sequence(pInput, size, position, 0);
+		}
+		state.validUtf8End = position;
+	}
+
+#if defined(ZEST_LIB_AVX2)
+	static uint64_t ToMask(__m256i low, __m256i high) noexcept
+	{
+		return static_cast<uint32_t>(_mm256_movemask_epi8(low)) | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high))) << 32);
+	}
+
+	static void Classify(const uint8_t* pBlock, BlockMasks& masks) noexcept
+	{
+		__m256i chunks[2]{
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock)),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBlock + 32))
+		};
+		__m256i quote[2], backslash[2], operators[2], whitespace[2], control[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			__m256i chunk{ chunks[i] };
+			quote[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'));
+			backslash[i] = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'));
+			// Setting bit 5 maps '[' to '{' and ']' to '}'.
+			__m256i folded{ _mm256_or_si256(chunk, _mm256_set1_epi8(0x20)) };
+			operators[i] = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+				_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+			whitespace[i] = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+				_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+			control[i] = _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(0x1F));
+		}
+		masks.quote = ToMask(quote[0], quote[1]);
+		masks.backslash = ToMask(backslash[0], backslash[1]);
+		masks.operators = ToMask(operators[0], operators[1]);
+		masks.whitespace = ToMask(whitespace[0], whitespace[1]);
+		masks.control = ToMask(control[0], control[1]);
+		masks.nonAscii = ToMask(chunks[0], chunks[1]);
+	}
+#elif defined(ZEST_LIB_SSE2)
+	static uint64_t ToMask(const __m128i (&vectors)[4]) noexcept
+	{
+		uint64_t mask{ 0 };
+		for (int i = 0; i < 4; ++i)
+		{
+			mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(vectors[i]))) << (16 * i);
+		}
+		return mask;
+	}
+
+	static void Classify(const uint8_t* pBlock, BlockMasks& masks) noexcept
+	{
+		__m128i chunks[4], quote[4], backslash[4], operators[4], whitespace[4], control[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBlock + 16 * i)) };
+			chunks[i] = chunk;
+			quote[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+			backslash[i] = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+			// Setting bit 5 maps '[' to '{' and ']' to '}'.
+			__m128i folded{ _mm_or_si128(chunk, _mm_set1_epi8(0x20)) };
+			operators[i] = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+			whitespace[i] = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+			control[i] = _mm_cmpeq_epi8(_mm_max_epu8(chunk, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+		}
+		masks.quote = ToMask(quote);
+		masks.backslash = ToMask(backslash);
+		masks.operators = ToMask(operators);
+		masks.whitespace = ToMask(whitespace);
+		masks.control = ToMask(control);
+		masks.nonAscii = ToMask(chunks);
+	}
+#else
+	enum CharacterClass : uint8_t
+	{
+		Quote = 1,
+		Backslash = 2,
+		Operator = 4,
+		Whitespace = 8,
+		Control = 16,
+		NonAscii = 32
+	};
+
+	static const uint8_t* GetClassTable() noexcept
+	{
+		struct ClassTable
+		{
+			ClassTable() noexcept
+			{
+				for (int c = 0; c < 256; ++c)
+				{
+					classes[c] = c < 0x20 ? Control : (c >= 0x80 ? NonAscii : 0);
+				}
+				classes[static_cast<uint8_t>('"')] = Quote;
+				classes[static_cast<uint8_t>('\\')] = Backslash;
+				for (char c : { '{', '}', '[', ']', ':', ',' })
+				{
+					classes[static_cast<uint8_t>(c)] = Operator;
+				}
+				classes[static_cast<uint8_t>(' ')] = Whitespace;
+				for (char c : { '\t', '\n', '\r' })
+				{
+					classes[static_cast<uint8_t>(c)] = Whitespace | Control;
+				}
+			}
+
+			uint8_t classes[256];
+		};
+		static const ClassTable table;
+		return table.classes;
+	}
+
+	static void Classify(const uint8_t* pBlock, BlockMasks& masks) noexcept
+	{
+		const uint8_t* pClasses{ GetClassTable() };
+		masks = BlockMasks{ 0, 0, 0, 0, 0, 0 };
+		for (std::size_t i = 0; i < c_blockSize; ++i)
+		{
+			uint8_t characterClass{ pClasses[pBlock[i]] };
+			if (characterClass == 0)
+			{
+				continue;
+			}
+			uint64_t bit{ uint64_t{ 1 } << i };
+			masks.quote |= (characterClass & Quote) != 0 ? bit : 0;
+			masks.backslash |= (characterClass & Backslash) != 0 ? bit : 0;
+			masks.operators |= (characterClass & Operator) != 0 ? bit : 0;
+			masks.whitespace |= (characterClass & Whitespace) != 0 ? bit : 0;
+			masks.control |= (characterClass & Control) != 0 ? bit : 0;
+			masks.nonAscii |= (characterClass & NonAscii) != 0 ? bit : 0;
+		}
+	}
+#endif
+
+	std::unique_ptr<uint32_t[]> m_spPositions;
+	std::size_t m_size;
+	std::size_t m_capacity;
+};
+
+}}}
+
+#endif
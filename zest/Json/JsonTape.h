@@ -0,0 +1,612 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONTAPE_H
+#define ZEST_LIB_JSONTAPE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Dynamics.h"
+#include "../Error.h"
+#include "JsonError.h"
+#include "JsonNumber.h"
+#include "JsonString.h"
+#include "JsonStructuralIndex.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+class JsonTape;
+
+/*! Read only view of a value in JsonTape, with the getters of Dynamic and same conversions:
+	integers which fit int32 are Int32, numbers convert to each other, GetInt32 and GetInt64
+	saturate when number is out of their range and double is truncated toward zero,
+	missing property or element is Null, getters of another type throw AcessDenied error.
+	View is two words and is valid while its tape is not parsed again.
+*/
+class JsonTapeValue
+{
+public:
+	JsonTapeValue() noexcept = default;
+
+	ValueMap::Type GetType() const noexcept;
+	ValueMap::Bool GetBool() const;
+	ValueMap::Int32 GetInt32() const;
+	ValueMap::Int64 GetInt64() const;
+	ValueMap::Double GetDouble() const;
+	ValueMap::StringView GetString() const;
+
+	// Count of elements or properties, stored in container word.
+	std::size_t Size() const;
+	JsonTapeValue operator[](std::string_view propertyName) const;
+	JsonTapeValue operator[](std::size_t index) const;
+
+	template<typename TFunc>
+	void ForEachProperty(TFunc&& func) const;
+
+	template<typename TFunc>
+	void ForEachElement(TFunc&& func) const;
+
+	// Dynamic with same content, for code which needs to modify it.
+	Dynamic ToDynamic() const;
+
+private:
+	friend class JsonTape;
+
+	JsonTapeValue(const JsonTape* pTape, uint32_t word) noexcept
+		: m_pTape{ pTape }, m_word{ word }
+	{
+	}
+
+	char GetTag() const noexcept;
+	uint64_t GetPayload() const noexcept;
+	uint64_t GetNumberBits() const noexcept;
+	// Word after the last word of value.
+	uint32_t GetNext() const noexcept;
+	void CheckContainer(char tag) const;
+	Dynamic ToDynamic(DynamicKeyCache& keyCache) const;
+	// Casting double out of range of integer is undefined, so it is clamped first.
+	static ValueMap::Int64 SaturateToInt64(ValueMap::Double value) noexcept;
+
+	const JsonTape* m_pTape{ nullptr };
+	uint32_t m_word{ 0 };
+};
+
+/*! Parsed json in two contiguous buffers instead of a node per value.
+	Tape has 64 bit words in document order, tag in high byte and payload in low 56 bits:
+		'n' 't' 'f'    literals.
+		'l' 'd'        integer or double, next word holds its bits.
+		'"'            string, payload is offset in string buffer of 32 bit length, characters and zero.
+		'{' '['        payload is word after matching end in low 32 bits, member count in high 24 bits.
+		'}' ']'        payload is word of matching start.
+	Property is key string word followed by value words, so containers are jumped over in constant time.
+	Buffers are reused when tape parses the next document.
+*/
+class JsonTape
+{
+public:
+	static constexpr std::size_t c_maxDepth{ 1024 };
+
+	JsonTape() = default;
+	JsonTape(const JsonTape&) = delete;
+	JsonTape& operator=(const JsonTape&) = delete;
+
+	JsonTapeValue Parse(const std::string& jsonString)
+	{
+		return Parse(jsonString.data(), jsonString.size());
+	}
+
+	JsonTapeValue Parse(const char* jsonString, std::size_t size)
+	{
+		m_index.Build(jsonString, size);
+		if (m_index.Size() == 0)
+		{
+			throw JsonError{ JsonErrorCode::Parse_EmptyBody, "Json Input is empty." };
+		}
+
+		m_pInput = jsonString;
+		m_inputSize = size;
+		m_next = 0;
+		m_tape.clear();
+		m_strings.clear();
+		// About a word per index entry, unescaped strings are never longer than input.
+		m_tape.reserve(m_index.Size() + 1);
+		m_strings.reserve(size + m_index.Size() * 3);
+		try
+		{
+			ParseValue(0);
+			if (m_next != m_index.Size())
+			{
+				throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected content after value", m_index[m_next]);
+			}
+		}
+		catch (...)
+		{
+			m_tape.clear();
+			throw;
+		}
+		return GetRoot();
+	}
+
+	// Empty view before first Parse.
+	JsonTapeValue GetRoot() const noexcept
+	{
+		return m_tape.empty() ? JsonTapeValue{} : JsonTapeValue{ this, 0 };
+	}
+
+	// Bytes used by tape and strings, without the reusable index.
+	std::size_t GetMemorySize() const noexcept
+	{
+		return m_tape.size() * sizeof(uint64_t) + m_strings.size();
+	}
+
+private:
+	friend class JsonTapeValue;
+
+	static constexpr uint64_t c_payloadMask{ (uint64_t{ 1 } << 56) - 1 };
+	static constexpr uint64_t c_maxCount{ 0xFFFFFF };
+
+	static uint64_t MakeWord(char tag, uint64_t payload) noexcept
+	{
+		return (static_cast<uint64_t>(static_cast<uint8_t>(tag)) << 56) | payload;
+	}
+
+	uint32_t NextPosition()
+	{
+		if (m_next == m_index.Size())
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected end", m_inputSize);
+		}
+		return m_index[m_next++];
+	}
+
+	char PeekCharacter() const noexcept
+	{
+		return m_next < m_index.Size() ? m_pInput[m_index[m_next]] : '\0';
+	}
+
+	[[noreturn]] static void ThrowUnexpected(std::size_t position)
+	{
+		throw JsonError::AtOffset(JsonErrorCode::Parse_Malformat, "Unexpected character", position);
+	}
+
+	void ParseValue(std::size_t depth)
+	{
+		uint32_t position{ NextPosition() };
+		switch (m_pInput[position])
+		{
+			case '{':
+				ParseContainer(position, depth + 1, '{', '}');
+				break;
+			case '[':
+				ParseContainer(position, depth + 1, '[', ']');
+				break;
+			case '"':
+				AppendString(position);
+				break;
+			case 't':
+				ParseLiteral(position, "true", 4);
+				m_tape.push_back(MakeWord('t', 0));
+				break;
+			case 'f':
+				ParseLiteral(position, "false", 5);
+				m_tape.push_back(MakeWord('f', 0));
+				break;
+			case 'n':
+				ParseLiteral(position, "null", 4);
+				m_tape.push_back(MakeWord('n', 0));
+				break;
+			default:
+				ParseNumber(position);
+				break;
+		}
+	}
+
+	// Object and array share the loop, object member starts with key and colon.
+	void ParseContainer(uint32_t position, std::size_t depth, char open, char close)
+	{
+		if (depth > c_maxDepth)
+		{
+			throw JsonError::AtOffset(JsonErrorCode::Parse_TooDeep, "Json nested too deep", position);
+		}
+
+		std::size_t start{ m_tape.size() };
+		m_tape.push_back(0);
+		uint64_t count{ 0 };
+		if (PeekCharacter() == close)
+		{
+			++m_next;
+		}
+		else
+		{
+			for (;;)
+			{
+				if (open == '{')
+				{
+					position = NextPosition();
+					if (m_pInput[position] != '"')
+					{
+						ThrowUnexpected(position);
+					}
+					AppendString(position);
+					position = NextPosition();
+					if (m_pInput[position] != ':')
+					{
+						ThrowUnexpected(position);
+					}
+				}
+				ParseValue(depth);
+				++count;
+
+				position = NextPosition();
+				if (m_pInput[position] == close)
+				{
+					break;
+				}
+				if (m_pInput[position] != ',')
+				{
+					ThrowUnexpected(position);
+				}
+			}
+		}
+
+		m_tape.push_back(MakeWord(close, start));
+		if (m_tape.size() > std::numeric_limits<uint32_t>::max())
+		{
+			throw JsonError{ JsonErrorCode::Parse_Malformat, "Json input has too many values." };
+		}
+		m_tape[start] = MakeWord(open, (std::min(count, c_maxCount) << 32) | m_tape.size());
+	}
+
+	// Opening quote at position, closing quote is the next index entry.
+	void AppendString(uint32_t position)
+	{
+		uint32_t end{ NextPosition() };
+		std::string_view raw{ m_pInput + position + 1, end - position - 1 };
+		std::size_t offset{ m_strings.size() };
+		m_strings.append(sizeof(uint32_t), '\0');
+		if (std::memchr(raw.data(), '\\', raw.size()) == nullptr)
+		{
+			m_strings.append(raw);
+		}
+		else
+		{
+			JsonString::Unescape(raw, position + 1, m_strings);
+		}
+		uint32_t length{ static_cast<uint32_t>(m_strings.size() - offset - sizeof(uint32_t)) };
+		std::memcpy(&m_strings[offset], &length, sizeof(length));
+		m_strings.push_back('\0');
+		m_tape.push_back(MakeWord('"', offset));
+	}
+
+	// Number or literal must end at whitespace, operator or end of input.
+	bool IsTokenEnd(std::size_t position) const noexcept
+	{
+		if (position >= m_inputSize)
+		{
+			return true;
+		}
+		switch (m_pInput[position])
+		{
+			case ' ': case '\t': case '\n': case '\r':
+			case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void ParseLiteral(uint32_t position, const char* literal, std::size_t length) const
+	{
+		if (m_inputSize - position < length || std::memcmp(m_pInput + position, literal, length) != 0 || !IsTokenEnd(position + length))
+		{
+			ThrowUnexpected(position);
+		}
+	}
+
+	void ParseNumber(uint32_t position)
+	{
+		JsonNumber number;
+		const char* pEnd{ JsonNumber::Parse(m_pInput + position, m_pInput + m_inputSize, position, number) };
+		if (!IsTokenEnd(static_cast<std::size_t>(pEnd - m_pInput)))
+		{
+			ThrowUnexpected(static_cast<std::size_t>(pEnd - m_pInput));
+		}
+
+		uint64_t bits;
+		if (number.isInteger)
+		{
+			bits = static_cast<uint64_t>(number.integer);
+		}
+		else
+		{
+			std::memcpy(&bits, &number.value, sizeof(bits));
+		}
+		m_tape.push_back(MakeWord(number.isInteger ? 'l' : 'd', 0));
+		m_tape.push_back(bits);
+	}
+
+	JsonStructuralIndex m_index;
+	const char* m_pInput{ nullptr };
+	std::size_t m_inputSize{ 0 };
+	std::size_t m_next{ 0 };
+	std::vector<uint64_t> m_tape;
+	std::string m_strings;
+};
+
+inline char JsonTapeValue::GetTag() const noexcept
+{
+	return m_pTape != nullptr ? static_cast<char>(m_pTape->m_tape[m_word] >> 56) : 'n';
+}
+
+inline uint64_t JsonTapeValue::GetPayload() const noexcept
+{
+	return m_pTape->m_tape[m_word] & JsonTape::c_payloadMask;
+}
+
+inline uint64_t JsonTapeValue::GetNumberBits() const noexcept
+{
+	return m_pTape->m_tape[m_word + 1];
+}
+
+inline uint32_t JsonTapeValue::GetNext() const noexcept
+{
+	switch (GetTag())
+	{
+		case '{':
+		case '[':
+			return static_cast<uint32_t>(GetPayload());
+		case 'l':
+		case 'd':
+			return m_word + 2;
+		default:
+			return m_word + 1;
+	}
+}
+
+inline void JsonTapeValue::CheckContainer(char tag) const
+{
+	if (GetTag() != tag)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+}
+
+inline ValueMap::Type JsonTapeValue::GetType() const noexcept
+{
+	switch (GetTag())
+	{
+		case '{':
+			return ValueMap::Type::Object;
+		case '[':
+			return ValueMap::Type::Array;
+		case '"':
+			return ValueMap::Type::String;
+		case 't':
+		case 'f':
+			return ValueMap::Type::Bool;
+		case 'd':
+			return ValueMap::Type::Double;
+		case 'l':
+		{
+			int64_t value{ static_cast<int64_t>(GetNumberBits()) };
+			bool isInt32{ value >= std::numeric_limits<ValueMap::Int32>::min() && value <= std::numeric_limits<ValueMap::Int32>::max() };
+			return isInt32 ? ValueMap::Type::Int32 : ValueMap::Type::Int64;
+		}
+		default:
+			return ValueMap::Type::Null;
+	}
+}
+
+inline ValueMap::Bool JsonTapeValue::GetBool() const
+{
+	char tag{ GetTag() };
+	if (tag != 't' && tag != 'f')
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return tag == 't';
+}
+
+inline ValueMap::Int32 JsonTapeValue::GetInt32() const
+{
+	ValueMap::Int64 value{ GetInt64() };
+	value = std::max<ValueMap::Int64>(value, std::numeric_limits<ValueMap::Int32>::min());
+	value = std::min<ValueMap::Int64>(value, std::numeric_limits<ValueMap::Int32>::max());
+	return static_cast<ValueMap::Int32>(value);
+}
+
+inline ValueMap::Int64 JsonTapeValue::GetInt64() const
+{
+	switch (GetTag())
+	{
+		case 'l':
+			return static_cast<ValueMap::Int64>(GetNumberBits());
+		case 'd':
+			return SaturateToInt64(GetDouble());
+		default:
+			Error::ThrowAcessDeniedErrorException();
+	}
+}
+
+inline ValueMap::Int64 JsonTapeValue::SaturateToInt64(ValueMap::Double value) noexcept
+{
+	// 2^63 is exact in double, largest Int64 is not.
+	constexpr ValueMap::Double c_limit{ 9223372036854775808.0 };
+	if (value != value)
+	{
+		return 0;
+	}
+	if (value >= c_limit)
+	{
+		return std::numeric_limits<ValueMap::Int64>::max();
+	}
+	if (value < -c_limit)
+	{
+		return std::numeric_limits<ValueMap::Int64>::min();
+	}
+	return static_cast<ValueMap::Int64>(value);
+}
+
+inline ValueMap::Double JsonTapeValue::GetDouble() const
+{
+	switch (GetTag())
+	{
+		case 'l':
+			return static_cast<ValueMap::Double>(static_cast<ValueMap::Int64>(GetNumberBits()));
+		case 'd':
+		{
+			uint64_t bits{ GetNumberBits() };
+			ValueMap::Double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		default:
+			Error::ThrowAcessDeniedErrorException();
+	}
+}
+
+inline ValueMap::StringView JsonTapeValue::GetString() const
+{
+	if (GetTag() != '"')
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	const char* pString{ m_pTape->m_strings.data() + GetPayload() };
+	uint32_t length;
+	std::memcpy(&length, pString, sizeof(length));
+	return ValueMap::StringView{ pString + sizeof(length), length };
+}
+
+inline std::size_t JsonTapeValue::Size() const
+{
+	char tag{ GetTag() };
+	if (tag != '{' && tag != '[')
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	std::size_t count{ static_cast<std::size_t>(GetPayload() >> 32) };
+	if (count < JsonTape::c_maxCount)
+	{
+		return count;
+	}
+	// Count is saturated, members are counted by jumping over them.
+	count = 0;
+	if (tag == '{')
+	{
+		ForEachProperty([&count](std::string_view, const JsonTapeValue&) { ++count; });
+	}
+	else
+	{
+		ForEachElement([&count](const JsonTapeValue&) { ++count; });
+	}
+	return count;
+}
+
+inline JsonTapeValue JsonTapeValue::operator[](std::string_view propertyName) const
+{
+	CheckContainer('{');
+	uint32_t end{ static_cast<uint32_t>(GetPayload()) - 1 };
+	for (uint32_t word = m_word + 1; word != end;)
+	{
+		JsonTapeValue value{ m_pTape, word + 1 };
+		if (JsonTapeValue{ m_pTape, word }.GetString() == propertyName)
+		{
+			return value;
+		}
+		word = value.GetNext();
+	}
+	return JsonTapeValue{};
+}
+
+inline JsonTapeValue JsonTapeValue::operator[](std::size_t index) const
+{
+	CheckContainer('[');
+	uint32_t end{ static_cast<uint32_t>(GetPayload()) - 1 };
+	for (JsonTapeValue element{ m_pTape, m_word + 1 }; element.m_word != end; element.m_word = element.GetNext(), --index)
+	{
+		if (index == 0)
+		{
+			return element;
+		}
+	}
+	return JsonTapeValue{};
+}
+
+template<typename TFunc>
+inline void JsonTapeValue::ForEachProperty(TFunc&& func) const
+{
+	CheckContainer('{');
+	uint32_t end{ static_cast<uint32_t>(GetPayload()) - 1 };
+	for (uint32_t word = m_word + 1; word != end;)
+	{
+		JsonTapeValue key{ m_pTape, word };
+		JsonTapeValue value{ m_pTape, word + 1 };
+		func(key.GetString(), value);
+		word = value.GetNext();
+	}
+}
+
+template<typename TFunc>
+inline void JsonTapeValue::ForEachElement(TFunc&& func) const
+{
+	CheckContainer('[');
+	uint32_t end{ static_cast<uint32_t>(GetPayload()) - 1 };
+	for (JsonTapeValue element{ m_pTape, m_word + 1 }; element.m_word != end; element.m_word = element.GetNext())
+	{
+		func(element);
+	}
+}
+
+inline Dynamic JsonTapeValue::ToDynamic() const
+{
+	// Names come from input, so they are not added to the global key table.
+	DynamicKeyCache keyCache;
+	return ToDynamic(keyCache);
+}
+
+inline Dynamic JsonTapeValue::ToDynamic(DynamicKeyCache& keyCache) const
+{
+	switch (GetType())
+	{
+		case ValueMap::Type::Object:
+		{
+			Dynamic object = Dynamic::MakeObject();
+			ValueMap::ObjectMap& objectMap{ object.GetObjectMap() };
+			ForEachProperty([&objectMap, &keyCache](std::string_view name, const JsonTapeValue& value)
+			{
+				objectMap.Set(keyCache.Get(name.data(), name.size()), value.ToDynamic(keyCache));
+			});
+			return object;
+		}
+		case ValueMap::Type::Array:
+		{
+			ValueMap::Array array;
+			array.reserve(Size());
+			ForEachElement([&array, &keyCache](const JsonTapeValue& element)
+			{
+				array.push_back(element.ToDynamic(keyCache));
+			});
+			return Dynamic(std::move(array));
+		}
+		case ValueMap::Type::Bool:
+			return Dynamic(GetBool());
+		case ValueMap::Type::Int32:
+			return Dynamic(GetInt32());
+		case ValueMap::Type::Int64:
+			return Dynamic(GetInt64());
+		case ValueMap::Type::Double:
+			return Dynamic(GetDouble());
+		case ValueMap::Type::String:
+			return Dynamic(GetString());
+		default:
+			return Dynamic();
+	}
+}
+
+}}}
+
+#endif
@@ -0,0 +1,425 @@
+#pragma once
+
+#ifndef ZEST_LIB_JSONWRITER_H
+#define ZEST_LIB_JSONWRITER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "../Dynamics.h"
+#include "../Platform.h"
+#include "../Stream.h"
+#include "JsonNumber.h"
+
+namespace Zest { namespace Lib { namespace Json {
+
+/*! Serializer of Dynamic or of events, mirror of JsonReader.
+	Text goes to an internal buffer which grows and is reused after Clear, or with a stream
+	the buffer is written to the stream whenever it is full and by Flush.
+	Values written at top level are separated by new line, so several documents make NDJSON.
+	Strings must be UTF-8, they are copied 16 or 32 bytes at a time until a character
+	which needs escape, non-ASCII characters are written as is.
+*/
+class JsonWriter
+{
+public:
+	explicit JsonWriter(std::size_t initialCapacity = DEFAULT_READ_SIZE)
+		: m_spBuffer{ std::make_unique<char[]>(std::max<std::size_t>(initialCapacity, 1)) },
+		m_size{ 0 },
+		m_capacity{ std::max<std::size_t>(initialCapacity, 1) },
+		m_pStream{ nullptr }
+	{
+	}
+
+	/*! Buffer of bufferSize bytes is written to stream when full, call Flush after the last value.
+		Stream must outlive writer.
+	*/
+	explicit JsonWriter(IStream& stream, std::size_t bufferSize = DEFAULT_READ_SIZE)
+		: JsonWriter{ bufferSize }
+	{
+		m_pStream = &stream;
+	}
+
+	// Spaces per nesting level with line per value, 0 writes compact text.
+	void SetIndent(std::size_t indentSize) noexcept
+	{
+		m_indentSize = indentSize;
+	}
+
+	void StartObject()
+	{
+		StartContainer('{');
+	}
+
+	// Name of next property, value follows as next event.
+	void Key(std::string_view name)
+	{
+		WriteQuoted(name);
+		char* p{ Reserve(2) };
+		*p++ = ':';
+		if (m_indentSize != 0)
+		{
+			*p++ = ' ';
+		}
+		Commit(p);
+		m_isAfterKey = true;
+	}
+
+	void EndObject()
+	{
+		EndContainer('}');
+	}
+
+	void StartArray()
+	{
+		StartContainer('[');
+	}
+
+	void EndArray()
+	{
+		EndContainer(']');
+	}
+
+	void String(std::string_view value)
+	{
+		WriteQuoted(value);
+	}
+
+	void Int(int64_t value)
+	{
+		char* p{ WriteSeparator(JsonNumber::c_maxWriteLength) };
+		Commit(JsonNumber::Write(value, p));
+	}
+
+	// NaN and infinity are written as null.
+	void Double(double value)
+	{
+		char* p{ WriteSeparator(JsonNumber::c_maxWriteLength) };
+		Commit(JsonNumber::Write(value, p));
+	}
+
+	void Bool(bool value)
+	{
+		WriteLiteral(value ? std::string_view{ "true" } : std::string_view{ "false" });
+	}
+
+	void Null()
+	{
+		WriteLiteral("null");
+	}
+
+	void Write(const Dynamic& value)
+	{
+		switch (value.GetType())
+		{
+		case ValueMap::Type::Null:
+			Null();
+			break;
+		case ValueMap::Type::Object:
+			StartObject();
+			for (const auto& entry : value.GetObjectMap())
+			{
+				Key(entry.first.GetName());
+				Write(entry.second);
+			}
+			EndObject();
+			break;
+		case ValueMap::Type::Array:
+			StartArray();
+			for (const Dynamic& element : value.GetArray())
+			{
+				Write(element);
+			}
+			EndArray();
+			break;
+		case ValueMap::Type::Bool:
+			Bool(value.GetBool());
+			break;
+		case ValueMap::Type::Int32:
+		case ValueMap::Type::Int64:
+			Int(value.GetInt64());
+			break;
+		case ValueMap::Type::Double:
+			Double(value.GetDouble());
+			break;
+		case ValueMap::Type::String:
+			String(value.GetString());
+			break;
+		}
+	}
+
+	// Text written so far, without text already written to stream.
+	std::string_view GetString() const noexcept
+	{
+		return std::string_view{ m_spBuffer.get(), m_size };
+	}
+
+	// Start a new document, buffer keeps its capacity.
+	void Clear() noexcept
+	{
+		m_size = 0;
+		m_depth = 0;
+		m_isFirst = true;
+		m_isAfterKey = false;
+	}
+
+	void Flush()
+	{
+		if (m_pStream != nullptr && m_size != 0)
+		{
+			m_pStream->Write(m_spBuffer.get(), m_size);
+			m_size = 0;
+		}
+	}
+
+	static std::string ToString(const Dynamic& value, std::size_t indentSize = 0)
+	{
+		JsonWriter writer;
+		writer.SetIndent(indentSize);
+		writer.Write(value);
+		return std::string{ writer.GetString() };
+	}
+
+private:
+	// Input bytes escaped per reservation, output of a block is at most 6 times longer.
+	static constexpr std::size_t c_stringBlockSize{ 256 };
+	static constexpr std::size_t c_maxEscapeLength{ 6 };
+
+	// Pointer to at least size free bytes, valid until next Reserve.
+	char* Reserve(std::size_t size)
+	{
+		if (m_capacity - m_size < size)
+		{
+			Grow(size);
+		}
+		return m_spBuffer.get() + m_size;
+	}
+
+	void Commit(char* pEnd) noexcept
+	{
+		m_size = static_cast<std::size_t>(pEnd - m_spBuffer.get());
+		assert(m_size <= m_capacity);
+	}
+
+	void Grow(std::size_t size)
+	{
+		Flush();
+		if (m_capacity - m_size >= size)
+		{
+			return;
+		}
+		std::size_t capacity{ std::max(m_capacity * 2, m_size + size) };
+		std::unique_ptr<char[]> spBuffer{ std::make_unique<char[]>(capacity) };
+		std::memcpy(spBuffer.get(), m_spBuffer.get(), m_size);
+		m_spBuffer = std::move(spBuffer);
+		m_capacity = capacity;
+	}
+
+	// Writes comma or new line with indent before a value, returns pointer with valueSize free bytes.
+	char* WriteSeparator(std::size_t valueSize)
+	{
+		char* p{ Reserve(valueSize + 2 + m_indentSize * m_depth) };
+		if (m_isAfterKey)
+		{
+			m_isAfterKey = false;
+			return p;
+		}
+		if (!m_isFirst)
+		{
+			*p++ = m_depth == 0 ? '\n' : ',';
+		}
+		m_isFirst = false;
+		return m_depth != 0 ? WriteIndent(p, m_depth) : p;
+	}
+
+	char* WriteIndent(char* p, std::size_t depth) const noexcept
+	{
+		if (m_indentSize == 0)
+		{
+			return p;
+		}
+		*p++ = '\n';
+		std::memset(p, ' ', m_indentSize * depth);
+		return p + m_indentSize * depth;
+	}
+
+	void WriteLiteral(std::string_view literal)
+	{
+		char* p{ WriteSeparator(literal.size()) };
+		std::memcpy(p, literal.data(), literal.size());
+		Commit(p + literal.size());
+	}
+
+	void StartContainer(char open)
+	{
+		char* p{ WriteSeparator(1) };
+		*p++ = open;
+		Commit(p);
+		++m_depth;
+		m_isFirst = true;
+	}
+
+	// Empty container stays on one line.
+	void EndContainer(char close)
+	{
+		assert(m_depth != 0 && !m_isAfterKey);
+		--m_depth;
+		char* p{ Reserve(2 + m_indentSize * m_depth) };
+		if (!m_isFirst)
+		{
+			p = WriteIndent(p, m_depth);
+		}
+		*p++ = close;
+		Commit(p);
+		m_isFirst = false;
+	}
+
+	void WriteQuoted(std::string_view value)
+	{
+		char* p{ WriteSeparator(1) };
+		*p++ = '"';
+		Commit(p);
+
+		const char* pInput{ value.data() };
+		const char* pInputEnd{ pInput + value.size() };
+		while (pInput != pInputEnd)
+		{
+			std::size_t blockSize{ std::min(static_cast<std::size_t>(pInputEnd - pInput), c_stringBlockSize) };
+			Commit(WriteEscaped(pInput, pInput + blockSize, Reserve(blockSize * c_maxEscapeLength)));
+			pInput += blockSize;
+		}
+
+		p = Reserve(1);
+		*p++ = '"';
+		Commit(p);
+	}
+
+	/*! Copies pInput to pOutput with escapes, pOutput has 6 bytes per input byte.
+		Whole chunks are stored before looking for escapes, output space is enough for that
+		because at least a chunk of input is left, which reserved as much.
+	*/
+	static char* WriteEscaped(const char* pInput, const char* pInputEnd, char* pOutput) noexcept
+	{
+		const char* pEscapes{ GetEscapeTable() };
+#if defined(ZEST_LIB_AVX2)
+		const __m256i quote32{ _mm256_set1_epi8('"') };
+		const __m256i backslash32{ _mm256_set1_epi8('\\') };
+		const __m256i control32{ _mm256_set1_epi8(0x1F) };
+		while (pInputEnd - pInput >= 32)
+		{
+			__m256i chunk{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pInput)) };
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutput), chunk);
+			__m256i escapes{ _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(chunk, control32), chunk)) };
+			uint32_t mask{ static_cast<uint32_t>(_mm256_movemask_epi8(escapes)) };
+			if (mask == 0)
+			{
+				pInput += 32;
+				pOutput += 32;
+				continue;
+			}
+			uint32_t count{ Platform::CountTrailingZeros(mask) };
+			pInput += count;
+			pOutput = WriteEscape(static_cast<uint8_t>(*pInput), pEscapes, pOutput + count);
+			++pInput;
+		}
+#endif
+#if defined(ZEST_LIB_SSE2)
+		const __m128i quote{ _mm_set1_epi8('"') };
+		const __m128i backslash{ _mm_set1_epi8('\\') };
+		const __m128i control{ _mm_set1_epi8(0x1F) };
+		while (pInputEnd - pInput >= 16)
+		{
+			__m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pInput)) };
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOutput), chunk);
+			// Unsigned c <= 0x1F is min(c, 0x1F) == c.
+			__m128i escapes{ _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+				_mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk)) };
+			uint32_t mask{ static_cast<uint32_t>(_mm_movemask_epi8(escapes)) };
+			if (mask == 0)
+			{
+				pInput += 16;
+				pOutput += 16;
+				continue;
+			}
+			uint32_t count{ Platform::CountTrailingZeros(mask) };
+			pInput += count;
+			pOutput = WriteEscape(static_cast<uint8_t>(*pInput), pEscapes, pOutput + count);
+			++pInput;
+		}
+#endif
+		for (; pInput != pInputEnd; ++pInput)
+		{
+			uint8_t c{ static_cast<uint8_t>(*pInput) };
+			if (pEscapes[c] == 0)
+			{
+				*pOutput++ = static_cast<char>(c);
+			}
+			else
+			{
+				pOutput = WriteEscape(c, pEscapes, pOutput);
+			}
+		}
+		return pOutput;
+	}
+
+	static char* WriteEscape(uint8_t c, const char* pEscapes, char* pOutput) noexcept
+	{
+		static constexpr char c_hexDigits[]{ "0123456789ABCDEF" };
+		*pOutput++ = '\\';
+		*pOutput++ = pEscapes[c];
+		if (pEscapes[c] == 'u')
+		{
+			*pOutput++ = '0';
+			*pOutput++ = '0';
+			*pOutput++ = c_hexDigits[c >> 4];
+			*pOutput++ = c_hexDigits[c & 0xF];
+		}
+		return pOutput;
+	}
+
+	// Character after backslash for every byte, 0 when byte is written as is.
+	static const char* GetEscapeTable() noexcept
+	{
+		struct EscapeTable
+		{
+			EscapeTable() noexcept
+				: escapes{}
+			{
+				for (std::size_t i = 0; i < 0x20; ++i)
+				{
+					escapes[i] = 'u';
+				}
+				escapes[static_cast<uint8_t>('\b')] = 'b';
+				escapes[static_cast<uint8_t>('\f')] = 'f';
+				escapes[static_cast<uint8_t>('\n')] = 'n';
+				escapes[static_cast<uint8_t>('\r')] = 'r';
+				escapes[static_cast<uint8_t>('\t')] = 't';
+				escapes[static_cast<uint8_t>('"')] = '"';
+				escapes[static_cast<uint8_t>('\\')] = '\\';
+			}
+
+			char escapes[256];
+		};
+		static const EscapeTable table;
+		return table.escapes;
+	}
+
+	std::unique_ptr<char[]> m_spBuffer;
+	std::size_t m_size;
+	std::size_t m_capacity;
+	IStream* m_pStream;
+	std::size_t m_indentSize{ 0 };
+	std::size_t m_depth{ 0 };
+	// No value written yet at this depth, so no comma before next one.
+	bool m_isFirst{ true };
+	bool m_isAfterKey{ false };
+};
+
+}}}
+
+#endif
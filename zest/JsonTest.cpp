@@ -1,11 +1,114 @@
 #include "CommonTest.h"
 
 #include <gtest/gtest.h>
+#include <cstdlib>
+#include <random>
 
 #include "json/json.h"
+#include "json/JsonDocument.h"
+#include "json/JsonLinesReader.h"
+#include "json/JsonNumber.h"
+#include "json/JsonPushParser.h"
+#include "json/JsonReader.h"
+#include "json/JsonReflect.h"
+#include "json/JsonSchema.h"
+#include "json/JsonTape.h"
+#include "json/JsonWriter.h"
 
 namespace Zest { namespace Lib {
 
+namespace {
+
+// Gives at most chunkSize bytes per read, like a socket or file.
+class ChunkedStream: public IStream
+{
+public:
+	ChunkedStream(const std::string& data, std::size_t chunkSize)
+		: m_data{ data }, m_chunkSize{ chunkSize }
+	{
+	}
+
+	std::size_t Read(char* pBuffer, std::size_t size) override
+	{
+		std::size_t readSize{ std::min({ size, m_chunkSize, m_data.size() - m_position }) };
+		m_data.copy(pBuffer, readSize, m_position);
+		m_position += readSize;
+		return readSize;
+	}
+
+private:
+	const std::string& m_data;
+	std::size_t m_chunkSize;
+	std::size_t m_position{ 0 };
+};
+
+// Collects written bytes and counts writes.
+struct StringSink: public IStream
+{
+	void Write(const char* pBuffer, std::size_t size) override
+	{
+		data.append(pBuffer, size);
+		++writeCount;
+	}
+
+	std::string data;
+	std::size_t writeCount{ 0 };
+};
+
+enum class Role: uint8_t
+{
+	Guest,
+	Admin = 7
+};
+
+#define ZEST_ROLE_VALUES(value) value(Guest) value(Admin)
+ZEST_JSON_REFLECT_ENUM(Role, ZEST_ROLE_VALUES)
+
+struct Address
+{
+	std::string city;
+	std::optional<int32_t> zip;
+};
+
+#define ZEST_ADDRESS_FIELDS(field) field(city) field(zip)
+ZEST_JSON_REFLECT(Address, ZEST_ADDRESS_FIELDS)
+
+struct User
+{
+	int64_t id{ 0 };
+	std::string name;
+	bool isActive{ false };
+	double score{ 0.0 };
+	uint16_t level{ 0 };
+	Role role{ Role::Guest };
+	std::vector<std::string> tags;
+	std::vector<Address> addresses;
+	std::optional<Address> home;
+	std::map<std::string, int32_t> counters;
+};
+
+#define ZEST_USER_FIELDS(field) field(id) field(name) field(isActive) field(score) field(level) field(role) field(tags) field(addresses) field(home) field(counters)
+ZEST_JSON_REFLECT(User, ZEST_USER_FIELDS)
+
+// Writes every event as text.
+struct RecordingHandler: Json::JsonHandler
+{
+	Json::JsonReadAction StartObject() { events += '{'; return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction Key(std::string_view key) { events.append(key).append(":"); return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction EndObject() { events += '}'; return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction StartArray() { events += '['; return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction EndArray() { events += ']'; return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction String(std::string_view value) { events.append("s(").append(value).append(")"); return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction Int(int64_t value) { events.append("i(" + std::to_string(value) + ")"); return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction Double(double value) { events.append("d(" + std::to_string(value) + ")"); return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction Bool(bool value) { events.append(value ? "true" : "false"); return Json::JsonReadAction::Continue; }
+	Json::JsonReadAction Null() { events.append("null"); return Json::JsonReadAction::Continue; }
+
+	std::string events;
+};
+
+}
+
 TEST(JsonTest, NormalTest)
 {
 	using namespace Json;
@@ -37,5 +140,1129 @@ TEST(JsonTest, NormalTest)
 	EXPECT_EQ(ss2.str(), jsonString2);
 }
 
-}}
+TEST(JsonTest, JsonParser_Document_AllValueTypes)
+{
+	using namespace Json;
+	Dynamic document = JsonParser::ParseJson(
+		" {\"name\": \"zest\", \"count\": 3, \"big\": 12345678901, \"huge\": 123456789012345678901,\n"
+		"\t\"ratio\": -2.5e-3, \"ok\": true, \"no\": false, \"none\": null,\r\n"
+		"\"list\": [1, [], {}, [\"a\", {\"b\": [null]}]], \"empty\": \"\"} ");
+
+	EXPECT_EQ(document["name"].GetString(), "zest");
+	EXPECT_EQ(document["count"].GetType(), ValueMap::Type::Int32);
+	EXPECT_EQ(document["big"].GetInt64(), 12345678901);
+	EXPECT_EQ(document["huge"].GetType(), ValueMap::Type::Double);
+	EXPECT_DOUBLE_EQ(document["ratio"].GetDouble(), -0.0025);
+	EXPECT_TRUE(document["ok"].GetBool());
+	EXPECT_FALSE(document["no"].GetBool());
+	EXPECT_EQ(document["none"].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(document["list"].GetArray().size(), 4u);
+	EXPECT_EQ(document["list"][1].GetArray().size(), 0u);
+	EXPECT_EQ(document["list"][2].GetObjectMap().Size(), 0u);
+	EXPECT_EQ(document["list"][3][1]["b"][0].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(document["empty"].GetString(), "");
+
+	EXPECT_EQ(JsonParser::ParseJson("-0").GetInt32(), 0);
+	EXPECT_EQ(JsonParser::ParseJson("1e-400").GetDouble(), 0.0);
+	EXPECT_EQ(JsonParser::ParseJson("\"\\u00e9\\ud83d\\ude00\\n\"").GetString(), "\xC3\xA9\xF0\x9F\x98\x80\n");
+
+	// Same parser reused for another document.
+	JsonParser parser;
+	std::string first{ "{\"id\": 1}" };
+	std::string second{ "[{\"id\": 2}, {\"id\": 3}]" };
+	EXPECT_EQ(parser.Parse(first.data(), first.size())["id"].GetInt32(), 1);
+	EXPECT_EQ(parser.Parse(second.data(), second.size())[1]["id"].GetInt32(), 3);
+}
+
+TEST(JsonTest, JsonParser_StringsAcrossBlockBoundaries_Unescaped)
+{
+	using namespace Json;
+	// Backslash runs and quotes land on every position around 64 byte blocks.
+	for (std::size_t padding = 0; padding < 140; ++padding)
+	{
+		std::string json(padding, ' ');
+		json += "[\"a\\\\\", \"\\\"q\\\"\", \"\\\\\\\\\", \"{[,:]}\", \"\xE2\x82\xAC\", 7, true]";
+		Dynamic value = JsonParser::ParseJson(json);
+		ASSERT_EQ(value.GetArray().size(), 7u) << padding;
+		EXPECT_EQ(value[0].GetString(), "a\\");
+		EXPECT_EQ(value[1].GetString(), "\"q\"");
+		EXPECT_EQ(value[2].GetString(), "\\\\");
+		EXPECT_EQ(value[3].GetString(), "{[,:]}");
+		EXPECT_EQ(value[4].GetString(), "\xE2\x82\xAC");
+		EXPECT_EQ(value[5].GetInt32(), 7);
+		EXPECT_TRUE(value[6].GetBool());
+	}
+
+	std::string longString(1000, 'x');
+	std::string json{ "{\"" + longString + "\":\"" + longString + "\\\"\"}" };
+	EXPECT_EQ(JsonParser::ParseJson(json)[longString].GetString(), longString + "\"");
+}
+
+TEST(JsonTest, JsonParser_BorrowString_ViewsInputUntilMadeOwned)
+{
+	using namespace Json;
+	std::string json{ "{\"name\": \"zest\", \"escaped\": \"a\\tb\\u00e9\", \"numbers\": [1, 2], \"list\": [\"x\", {\"y\": \"z\"}]}" };
+	Dynamic document = JsonParser::ParseJson(json.data(), json.size(), true);
+
+	ValueMap::StringView name{ document["name"].GetString() };
+	EXPECT_EQ(name, "zest");
+	EXPECT_TRUE(name.data() >= json.data() && name.data() < json.data() + json.size());
+	Dynamic escaped = document["escaped"];
+	EXPECT_EQ(escaped.GetString(), "a\tb\xC3\xA9");
+	// Decoded once, later reads return the same characters.
+	EXPECT_EQ(escaped.GetString().data(), document["escaped"].GetString().data());
+	EXPECT_TRUE(document == JsonParser::ParseJson(json));
+
+	Dynamic owned = Dynamic::MakeOwned(document);
+	EXPECT_TRUE(owned["numbers"].IsSameNode(document["numbers"]));
+	EXPECT_FALSE(owned["list"].IsSameNode(document["list"]));
+	std::fill(json.begin(), json.end(), '#');
+	EXPECT_EQ(owned["name"].GetString(), "zest");
+	EXPECT_EQ(owned["escaped"].GetString(), "a\tb\xC3\xA9");
+	EXPECT_EQ(owned["list"][1]["y"].GetString(), "z");
+	Dynamic ownedAgain = Dynamic::MakeOwned(owned);
+	EXPECT_TRUE(ownedAgain.IsSameNode(owned));
+
+	// Escapes are still checked while parsing.
+	std::string invalid{ "[\"a\\x\"]" };
+	EXPECT_THROW(JsonParser::ParseJson(invalid.data(), invalid.size(), true), JsonError);
+
+	// Arena nodes are not destructed, decoded strings are in arena so nothing leaks.
+	std::string longEscaped{ "[\"longer than small string \\u00e9\", \"second\\tlong escaped string\"]" };
+	DynamicArena arena;
+	{
+		ScopedDynamicArena scope{ arena };
+		Dynamic inArena = JsonParser::ParseJson(longEscaped.data(), longEscaped.size(), true);
+		EXPECT_EQ(inArena[0].GetString(), "longer than small string \xC3\xA9");
+		EXPECT_EQ(inArena[1].GetString(), "second\tlong escaped string");
+	}
+}
+
+TEST(JsonTest, JsonParser_InputKeys_TableNotGrown)
+{
+	using namespace Json;
+	DynamicKeyTable::GetInstance().Intern({ "known" });
+	std::string json{ "[" };
+	for (int i = 0; i < 1000; ++i)
+	{
+		json += "{\"known\": " + std::to_string(i) + ", \"parser key " + std::to_string(i) + "\": 1, \"esc\\u0061ped\": 2},";
+	}
+	json.back() = ']';
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	JsonParser parser;
+	Dynamic document = parser.Parse(json.data(), json.size());
+	{
+		DynamicArena arena;
+		ScopedDynamicArena scope{ arena };
+		Dynamic inArena = parser.Parse(json.data(), json.size());
+		EXPECT_TRUE(inArena == document);
+	}
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_EQ(document[999]["known"].GetInt32(), 999);
+	EXPECT_EQ(document[7]["parser key 7"].GetInt32(), 1);
+	EXPECT_EQ(document[7]["escaped"].GetInt32(), 2);
+	// Keys of freed arena are not reused by the parser.
+	EXPECT_TRUE(parser.Parse(json.data(), json.size()) == document);
+}
+
+TEST(JsonTest, JsonParser_InvalidInput_Throws)
+{
+	using namespace Json;
+	auto getErrorCode = [](const std::string& json)
+	{
+		try
+		{
+			JsonParser::ParseJson(json);
+		}
+		catch (const JsonError& error)
+		{
+			return static_cast<int>(error.GetErrorCode());
+		}
+		return -1;
+	};
+
+	const int malformat{ static_cast<int>(JsonErrorCode::Parse_Malformat) };
+	EXPECT_EQ(getErrorCode(" \n "), static_cast<int>(JsonErrorCode::Parse_EmptyBody));
+	for (const char* json : { "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "tru", "truex", "nul", "01", "1.",
+		"-", "1e", "\"abc", "\"a\\x\"", "\"\\ud800\"", "\"a\tb\"", "[1]]", "{1:2}", "1e999", "\\" })
+	{
+		EXPECT_EQ(getErrorCode(json), malformat) << json;
+	}
+	EXPECT_EQ(getErrorCode("\"\xC0\xAF\""), static_cast<int>(JsonErrorCode::Parse_InvalidEncoding));
+	EXPECT_EQ(getErrorCode("\"\xED\xA0\x80\""), static_cast<int>(JsonErrorCode::Parse_InvalidEncoding));
+	EXPECT_EQ(getErrorCode("[\"\xF0\x9F\x98\"]"), static_cast<int>(JsonErrorCode::Parse_InvalidEncoding));
+	EXPECT_EQ(getErrorCode(std::string(2000, '[') + std::string(2000, ']')), static_cast<int>(JsonErrorCode::Parse_TooDeep));
+}
+
+TEST(JsonTest, JsonReader_ChunkedStream_SameEventsAsInMemory)
+{
+	using namespace Json;
+	std::string json{
+		" {\"name\": \"zest\", \"list\": [1, -20, 18446744073709551616, 2.5e1, true, false, null, [], {}],\n"
+		"\"escaped\\n\": \"a\\\"b\\\\\\u00e9\\ud83d\\ude00\", \"utf8\": \"\xE2\x82\xAC\", \"long\": \"" + std::string(100, 'x') + "\"} " };
+	std::string expected{
+		"{name:s(zest)list:[i(1)i(-20)d(18446744073709551616.000000)d(25.000000)truefalsenull[]{}]"
+		"escaped\n:s(a\"b\\\xC3\xA9\xF0\x9F\x98\x80)utf8:s(\xE2\x82\xAC)long:s(" + std::string(100, 'x') + ")}" };
+
+	RecordingHandler inMemory;
+	JsonStringStream stream{ json };
+	EXPECT_TRUE(JsonReader{ stream }.Read(inMemory));
+	EXPECT_EQ(inMemory.events, expected);
+	EXPECT_TRUE(stream.IsEnd());
+
+	// Every token crosses a chunk boundary for some chunk and buffer size.
+	for (std::size_t chunkSize = 1; chunkSize < 20; ++chunkSize)
+	{
+		for (std::size_t bufferSize : { std::size_t{ 1 }, std::size_t{ 7 }, std::size_t{ DEFAULT_READ_SIZE } })
+		{
+			ChunkedStream chunked{ json, chunkSize };
+			RecordingHandler handler;
+			EXPECT_TRUE(JsonReader(chunked, bufferSize).Read(handler));
+			EXPECT_EQ(handler.events, expected) << chunkSize << " " << bufferSize;
+		}
+	}
+}
+
+TEST(JsonTest, JsonReader_SkipAndStop_NoValuesBuilt)
+{
+	using namespace Json;
+	// Sums amount of every record, payloads and nested audit objects are skipped.
+	struct SumHandler: JsonHandler
+	{
+		JsonReadAction StartObject()
+		{
+			if (depth == 1)
+			{
+				return JsonReadAction::Skip;
+			}
+			++depth;
+			return JsonReadAction::Continue;
+		}
+		JsonReadAction EndObject()
+		{
+			--depth;
+			++recordCount;
+			return recordCount == stopAfter ? JsonReadAction::Stop : JsonReadAction::Continue;
+		}
+		JsonReadAction Key(std::string_view key)
+		{
+			isAmount = key == "amount";
+			return key == "payload" ? JsonReadAction::Skip : JsonReadAction::Continue;
+		}
+		JsonReadAction Int(int64_t value)
+		{
+			sum += isAmount ? value : 0;
+			return JsonReadAction::Continue;
+		}
+		JsonReadAction String(std::string_view)
+		{
+			++stringCount;
+			return JsonReadAction::Continue;
+		}
+
+		int depth{ 0 };
+		int recordCount{ 0 };
+		int stopAfter{ -1 };
+		bool isAmount{ false };
+		int64_t sum{ 0 };
+		int stringCount{ 0 };
+	};
+
+	std::string json{ "[" };
+	for (int i = 0; i < 1000; ++i)
+	{
+		json += i == 0 ? "" : ",";
+		json += "{\"id\": \"r" + std::to_string(i) + "\", \"payload\": {\"blob\": [\"" + std::string(50, 'p') +
+			"\", {\"amount\": 1000}, \"]}\"]}, \"audit\": {\"amount\": 1000}, \"amount\": " + std::to_string(i) + "}";
+	}
+	json += "]";
+
+	ChunkedStream chunked{ json, 1000 };
+	SumHandler handler;
+	EXPECT_TRUE(JsonReader(chunked, 64).Read(handler));
+	EXPECT_EQ(handler.sum, 999 * 1000 / 2);
+	EXPECT_EQ(handler.recordCount, 1000);
+	EXPECT_EQ(handler.stringCount, 1000);
+
+	// Stopped reader leaves string stream right after the last event.
+	JsonStringStream stream{ json };
+	SumHandler stopping;
+	stopping.stopAfter = 2;
+	EXPECT_FALSE(JsonReader{ stream }.Read(stopping));
+	EXPECT_EQ(stopping.sum, 1);
+	EXPECT_EQ(stream.Read(), ',');
+}
+
+TEST(JsonTest, JsonReader_InvalidInput_Throws)
+{
+	using namespace Json;
+	auto getErrorCode = [](const std::string& json, bool isSkipped)
+	{
+		struct SkippingHandler: JsonHandler
+		{
+			JsonReadAction StartArray() { return isSkipped ? JsonReadAction::Skip : JsonReadAction::Continue; }
+			bool isSkipped;
+		};
+		SkippingHandler handler;
+		handler.isSkipped = isSkipped;
+		ChunkedStream chunked{ json, 2 };
+		try
+		{
+			JsonReader(chunked, 3).Read(handler);
+		}
+		catch (const JsonError& error)
+		{
+			return static_cast<int>(error.GetErrorCode());
+		}
+		return -1;
+	};
+
+	const int malformat{ static_cast<int>(JsonErrorCode::Parse_Malformat) };
+	EXPECT_EQ(getErrorCode(" \n ", false), static_cast<int>(JsonErrorCode::Parse_EmptyBody));
+	for (const char* json : { "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "tru", "truex", "nul", "01", "1.",
+		"-", "1e", "\"abc", "\"a\\x\"", "\"\\ud800\"", "\"a\tb\"", "[1]]", "{1:2}", "1e999", "\\" })
+	{
+		EXPECT_EQ(getErrorCode(json, false), malformat) << json;
+	}
+	// Skipping still matches brackets and finds string ends.
+	for (const char* json : { "[1, {]", "[\"]\"", "[[]", "[\"a\tb\"]", "[] 1" })
+	{
+		EXPECT_EQ(getErrorCode(json, true), malformat) << json;
+	}
+	EXPECT_EQ(getErrorCode("[\"]\\\"\"]", true), -1);
+	EXPECT_EQ(getErrorCode("\"\xC0\xAF\"", false), static_cast<int>(JsonErrorCode::Parse_InvalidEncoding));
+	EXPECT_EQ(getErrorCode("[\"\xF0\x9F\x98\"]", false), static_cast<int>(JsonErrorCode::Parse_InvalidEncoding));
+	EXPECT_EQ(getErrorCode(std::string(2000, '[') + std::string(2000, ']'), false), static_cast<int>(JsonErrorCode::Parse_TooDeep));
+}
+
+TEST(JsonTest, JsonDocument_Cursors_DecodeOnlyTouchedFields)
+{
+	using namespace Json;
+	std::string json{ "{" };
+	for (int i = 0; i < 200; ++i)
+	{
+		json += "\"field" + std::to_string(i) + "\": {\"values\": [" + std::to_string(i) + ", \"x\", [{}]], \"bad\": 01},";
+	}
+	json += "\"route\": {\"host\": \"example.org\", \"port\": 8080, \"weight\": 0.5, \"tls\": true, \"proxy\": null},"
+		"\"tab\\tkey\": \"a\\u00e9\\\"b\", \"list\": [10, 20, 30]}";
+
+	JsonDocument document;
+	JsonCursor root{ document.Parse(json) };
+	EXPECT_EQ(root.GetType(), JsonValueType::Object);
+	EXPECT_EQ(root.Size(), 203u);
+	JsonCursor route{ root["route"] };
+	EXPECT_EQ(route["host"].GetString(), "example.org");
+	EXPECT_EQ(route["port"].GetInt64(), 8080);
+	EXPECT_EQ(route["port"].GetType(), JsonValueType::Integer);
+	EXPECT_DOUBLE_EQ(route["weight"].GetDouble(), 0.5);
+	EXPECT_DOUBLE_EQ(route["port"].GetDouble(), 8080.0);
+	EXPECT_TRUE(route["tls"].GetBool());
+	EXPECT_TRUE(route["proxy"].IsNull());
+	EXPECT_EQ(root["field150"]["values"][std::size_t{ 0 }].GetInt64(), 150);
+	EXPECT_EQ(root["field150"]["values"].Size(), 3u);
+	EXPECT_EQ(root["field150"]["values"][2][std::size_t{ 0 }].Size(), 0u);
+
+	// Escaped strings point into document, escaped keys are found by their value.
+	EXPECT_EQ(root["tab\tkey"].GetString(), "a\xC3\xA9\"b");
+	EXPECT_EQ(root["tab\tkey"].GetString().data(), root["tab\tkey"].GetString().data());
+
+	// Missing values are empty, wrong types throw, malformed numbers only throw when read.
+	EXPECT_TRUE(root["missing"].IsEmpty());
+	EXPECT_TRUE(root["missing"].IsNull());
+	EXPECT_TRUE(root["list"][3].IsEmpty());
+	EXPECT_THROW(route["host"].GetInt64(), Error::Exception);
+	EXPECT_THROW(route["weight"].GetInt64(), Error::Exception);
+	EXPECT_THROW(root["list"]["key"], Error::Exception);
+	EXPECT_THROW(root["missing"].GetString(), Error::Exception);
+	EXPECT_THROW(root["field0"]["bad"].GetInt64(), JsonError);
+
+	int64_t sum{ 0 };
+	root["list"].ForEachElement([&sum](const JsonCursor& element) { sum += element.GetInt64(); });
+	EXPECT_EQ(sum, 60);
+	std::string keys;
+	route.ForEachProperty([&keys](std::string_view key, const JsonCursor&) { keys.append(key).append(","); });
+	EXPECT_EQ(keys, "host,port,weight,tls,proxy,");
+
+	// Document is reused for next input.
+	EXPECT_EQ(document.Parse("[1, \"two\"]")[1].GetString(), "two");
+	EXPECT_EQ(document.Parse(" 42 ").GetInt64(), 42);
+}
+
+TEST(JsonTest, JsonDocument_InvalidStructure_Throws)
+{
+	using namespace Json;
+	auto getErrorCode = [](const std::string& json)
+	{
+		try
+		{
+			JsonDocument document;
+			document.Parse(json);
+		}
+		catch (const JsonError& error)
+		{
+			return static_cast<int>(error.GetErrorCode());
+		}
+		return -1;
+	};
+
+	const int malformat{ static_cast<int>(JsonErrorCode::Parse_Malformat) };
+	EXPECT_EQ(getErrorCode(" \n "), static_cast<int>(JsonErrorCode::Parse_EmptyBody));
+	for (const char* json : { "{", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "tru", "truex", "nul", "\"abc",
+		"\"a\tb\"", "[1]]", "{1:2}", "\\", "[}", "{\"a\":1]", "[1:2]", "{\"a\",1}", "x", "[,1]", "1 2" })
+	{
+		EXPECT_EQ(getErrorCode(json), malformat) << json;
+	}
+	EXPECT_EQ(getErrorCode("[\"\xF0\x9F\x98\"]"), static_cast<int>(JsonErrorCode::Parse_InvalidEncoding));
+	EXPECT_EQ(getErrorCode(std::string(2000, '[') + std::string(2000, ']')), static_cast<int>(JsonErrorCode::Parse_TooDeep));
+	EXPECT_EQ(getErrorCode("[01, 1e999]"), -1);
+}
+
+TEST(JsonTest, JsonNumber_Parse_SameAsFromChars)
+{
+	using namespace Json;
+	auto parse = [](const std::string& text)
+	{
+		JsonNumber number;
+		const char* pEnd{ JsonNumber::Parse(text.data(), text.data() + text.size(), 0, number) };
+		EXPECT_EQ(pEnd, text.data() + text.size()) << text;
+		return number.isInteger ? static_cast<double>(number.integer) : number.value;
+	};
+	auto expectSame = [&parse](const std::string& text)
+	{
+		double expected{ 0.0 };
+		if (std::from_chars(text.data(), text.data() + text.size(), expected).ec == std::errc::result_out_of_range)
+		{
+			// Overflow must throw, underflow gives zero of same sign.
+			expected = std::strtod(text.c_str(), nullptr);
+			if (std::isinf(expected))
+			{
+				EXPECT_THROW(parse(text), JsonError) << text;
+				return;
+			}
+		}
+		double value{ parse(text) };
+		EXPECT_EQ(std::memcmp(&value, &expected, sizeof(value)), 0) << text;
+	};
+
+	for (const char* text : { "0", "-0.0", "0.1", "1e-400", "-1e-400", "4.9e-324", "2.4703282292062327e-324",
+		"2.4703282292062328e-324", "2.2250738585072011e-308", "1.7976931348623157e308", "9007199254740993",
+		"9007199254740993.0", "9223372036854775808", "18446744073709551615", "123456789012345678901234567890e-10",
+		"0.000000000000000000000000000001", "1.00000000000000000000000000001", "7.3177701707893310e+15" })
+	{
+		expectSame(text);
+	}
+
+	std::mt19937_64 random{ 42 };
+	char buffer[64];
+	for (int i = 0; i < 200000; ++i)
+	{
+		// Random bit patterns in shortest and 17 digit form, and random digits with any exponent.
+		uint64_t bits{ random() };
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		if (std::isfinite(value))
+		{
+			expectSame(std::string(buffer, JsonNumber::Write(value, buffer)));
+			expectSame(std::string(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific, 16).ptr));
+		}
+		std::string digits{ std::to_string(random() >> (random() % 64)) };
+		digits.insert(1 + random() % digits.size(), ".");
+		if (digits.back() == '.')
+		{
+			digits += '0';
+		}
+		expectSame(digits + "e" + std::to_string(static_cast<int>(random() % 680) - 350));
+	}
+
+	JsonNumber number;
+	std::string minimum{ "-9223372036854775808" };
+	JsonNumber::Parse(minimum.data(), minimum.data() + minimum.size(), 0, number);
+	EXPECT_TRUE(number.isInteger);
+	EXPECT_EQ(number.integer, INT64_MIN);
+	std::string overflow{ "1.8e308" };
+	EXPECT_THROW(JsonNumber::Parse(overflow.data(), overflow.data() + overflow.size(), 0, number), JsonError);
+	EXPECT_EQ(std::string(buffer, JsonNumber::Write(0.1, buffer)), "0.1");
+	// Integral doubles keep a fraction, so they are read back as Double and not as Int32 or Int64.
+	for (double value : { 0.0, -0.0, 2.0, -3.0, 1e15, 9007199254740992.0, 1e16, 1e22, 1e23, -1.7976931348623157e308 })
+	{
+		char* pEnd{ JsonNumber::Write(value, buffer) };
+		ASSERT_LE(static_cast<std::size_t>(pEnd - buffer), JsonNumber::c_maxWriteLength);
+		std::string text(buffer, pEnd);
+		Dynamic parsed = JsonParser::ParseJson(text);
+		EXPECT_EQ(parsed.GetType(), ValueMap::Type::Double) << text;
+		EXPECT_EQ(parsed.GetDouble(), value) << text;
+		EXPECT_EQ(std::signbit(parsed.GetDouble()), std::signbit(value)) << text;
+	}
+	EXPECT_EQ(std::string(buffer, JsonNumber::Write(2.0, buffer)), "2.0");
+	EXPECT_EQ(std::string(buffer, JsonNumber::Write(-0.0, buffer)), "-0.0");
+	EXPECT_EQ(std::string(buffer, JsonNumber::Write(1e100, buffer)), "1e+100");
+	EXPECT_EQ(std::string(buffer, JsonNumber::Write(std::nan(""), buffer)), "null");
+	EXPECT_EQ(std::string(buffer, JsonNumber::Write(int64_t{ -42 }, buffer)), "-42");
+}
+
+TEST(JsonTest, JsonWriter_Dynamic_RoundTripsThroughParser)
+{
+	using namespace Json;
+	std::string json{ "{\"name\":\"zest\",\"count\":3,\"big\":12345678901,\"ratio\":-0.0025,\"ok\":true,\"none\":null,"
+		"\"list\":[1,[],{},[\"a\",{\"b\":[null]}]],\"text\":\"q\\\"b\\\\n\\nt\\tc\\u0001\\u001F\xE2\x82\xAC/\"}" };
+	Dynamic document = JsonParser::ParseJson(json);
+	EXPECT_EQ(JsonWriter::ToString(document), json);
+	EXPECT_TRUE(JsonParser::ParseJson(JsonWriter::ToString(document, 4)) == document);
+
+	EXPECT_EQ(JsonWriter::ToString(JsonParser::ParseJson("{\"a\":[1,{\"b\":{}},[]],\"c\":\"d\"}"), 2),
+		"{\n"
+		"  \"a\": [\n"
+		"    1,\n"
+		"    {\n"
+		"      \"b\": {}\n"
+		"    },\n"
+		"    []\n"
+		"  ],\n"
+		"  \"c\": \"d\"\n"
+		"}");
+
+	// Writer keeps its buffer for the next document, top level values are lines.
+	JsonWriter writer{ 1 };
+	writer.Write(JsonParser::ParseJson("[0.1,1e+100]"));
+	writer.Double(std::nan(""));
+	writer.Int(-42);
+	EXPECT_EQ(writer.GetString(), "[0.1,1e+100]\nnull\n-42");
+	writer.Clear();
+	writer.StartObject();
+	writer.Key("k");
+	writer.Bool(false);
+	writer.EndObject();
+	EXPECT_EQ(writer.GetString(), "{\"k\":false}");
+}
+
+TEST(JsonTest, JsonWriter_EscapesAcrossChunks_SameAsScalar)
+{
+	using namespace Json;
+	// Characters which need escape land on every position of 16 and 32 byte chunks and 256 byte blocks.
+	for (std::size_t padding = 0; padding < 300; padding += 7)
+	{
+		std::string value(padding, 'x');
+		value += "\"\\\n\x1F\x7F\xC3\xA9";
+		value += std::string(padding % 41, 'y');
+		value += '\0';
+		value += "\b\f\r\t";
 
+		std::string expected{ "\"" };
+		for (char c : value)
+		{
+			static const char* const c_escapes[]{ "\\u0000", "\\u0001", "\\u0002", "\\u0003", "\\u0004", "\\u0005", "\\u0006", "\\u0007",
+				"\\b", "\\t", "\\n", "\\u000B", "\\f", "\\r", "\\u000E", "\\u000F", "\\u0010", "\\u0011", "\\u0012", "\\u0013",
+				"\\u0014", "\\u0015", "\\u0016", "\\u0017", "\\u0018", "\\u0019", "\\u001A", "\\u001B", "\\u001C", "\\u001D", "\\u001E", "\\u001F" };
+			uint8_t byte{ static_cast<uint8_t>(c) };
+			expected += byte < 0x20 ? c_escapes[byte] : c == '"' ? "\\\"" : c == '\\' ? "\\\\" : std::string(1, c);
+		}
+		expected += '"';
+
+		JsonWriter writer;
+		writer.String(value);
+		ASSERT_EQ(writer.GetString(), expected) << padding;
+		EXPECT_EQ(JsonParser::ParseJson(std::string{ writer.GetString() }).GetString(), value);
+	}
+}
+
+TEST(JsonTest, JsonWriter_Stream_FlushesWhenBufferIsFull)
+{
+	using namespace Json;
+	Dynamic document = JsonParser::ParseJson(
+		"{\"items\":[{\"id\":1,\"tags\":[\"a\",\"b\"]},{\"id\":2,\"name\":\"" + std::string(100, 'n') + "\"}],\"ok\":true}");
+	std::string expected{ JsonWriter::ToString(document, 1) };
+
+	for (std::size_t bufferSize : { std::size_t{ 1 }, std::size_t{ 16 }, std::size_t{ DEFAULT_READ_SIZE } })
+	{
+		StringSink sink;
+		JsonWriter writer{ sink, bufferSize };
+		writer.SetIndent(1);
+		writer.Write(document);
+		writer.Flush();
+		EXPECT_EQ(sink.data, expected) << bufferSize;
+		EXPECT_EQ(writer.GetString(), "");
+		EXPECT_EQ(sink.writeCount > 1, bufferSize < expected.size()) << bufferSize;
+	}
+
+	// Stream which can't read or write.
+	IStream stream;
+	char buffer[1];
+	EXPECT_THROW(stream.Read(buffer, 1), Error::Exception);
+	EXPECT_THROW(stream.Write(buffer, 1), Error::Exception);
+}
+
+TEST(JsonTest, JsonLinesReader_ChunksOnThreadPool_SameAsSequential)
+{
+	using namespace Json;
+	std::string input;
+	std::vector<std::size_t> offsets;
+	for (int i = 0; i < 2000; ++i)
+	{
+		offsets.push_back(input.size());
+		input += "{\"id\":" + std::to_string(i) + ",\"name\":\"n" + std::string(i % 13, 'x') + "\",\"list\":[" + std::to_string(i % 7) + "]}";
+		input += i % 5 == 0 ? "\r\n" : i % 11 == 0 ? "\n \n" : "\n";
+	}
+	// Last line without new line.
+	offsets.push_back(input.size());
+	input += "[true]";
+
+	ThreadPool pool{ 4 };
+	for (JsonLinesOrder order : { JsonLinesOrder::Ordered, JsonLinesOrder::Unordered })
+	{
+		for (std::size_t chunkSize : { std::size_t{ 7 }, std::size_t{ 100 }, std::size_t{ 4096 }, input.size() * 2 })
+		{
+			JsonLinesReader reader{ pool, input.data(), input.size() };
+			reader.SetOrder(order).SetChunkSize(chunkSize).SetMaxPendingChunks(chunkSize == 7 ? 1 : 3);
+			std::vector<JsonLine> lines;
+			JsonLine line;
+			while (reader.Read(line))
+			{
+				lines.push_back(line);
+			}
+			EXPECT_FALSE(reader.Read(line));
+			if (order == JsonLinesOrder::Unordered)
+			{
+				std::sort(lines.begin(), lines.end(), [](const JsonLine& left, const JsonLine& right) { return left.offset < right.offset; });
+			}
+
+			ASSERT_EQ(lines.size(), offsets.size()) << chunkSize;
+			for (std::size_t i = 0; i + 1 < lines.size(); ++i)
+			{
+				ASSERT_EQ(lines[i].offset, offsets[i]) << chunkSize;
+				ASSERT_EQ(lines[i].value["id"].GetInt32(), static_cast<int32_t>(i)) << chunkSize;
+				ASSERT_EQ(lines[i].value["name"].GetString().size(), 1 + i % 13) << chunkSize;
+			}
+			EXPECT_TRUE(lines.back().value[0].GetBool());
+		}
+	}
+}
+
+TEST(JsonTest, JsonLinesReader_InvalidLine_ThrowsAfterPreviousLines)
+{
+	using namespace Json;
+	std::string input;
+	for (int i = 0; i < 300; ++i)
+	{
+		input += i == 200 ? "{\"id\":}\n" : "{\"id\":" + std::to_string(i) + "}\n";
+	}
+	std::size_t errorOffset{ input.find("{\"id\":}") };
+
+	ThreadPool pool{ 2 };
+	JsonLinesReader reader{ pool, input.data(), input.size() };
+	reader.SetChunkSize(64).SetMaxPendingChunks(4);
+	JsonLine line;
+	for (int i = 0; i < 200; ++i)
+	{
+		ASSERT_TRUE(reader.Read(line));
+		ASSERT_EQ(line.value["id"].GetInt32(), i);
+	}
+	try
+	{
+		reader.Read(line);
+		FAIL() << "Invalid line was read";
+	}
+	catch (const JsonError& error)
+	{
+		EXPECT_EQ(error.GetErrorCode(), JsonErrorCode::Parse_Malformat);
+		EXPECT_NE(std::string{ error.what() }.find("of line at offset " + std::to_string(errorOffset)), std::string::npos) << error.what();
+	}
+	EXPECT_FALSE(reader.Read(line));
+
+	// Reader left early waits for its tasks.
+	for (int i = 0; i < 20; ++i)
+	{
+		JsonLinesReader abandoned{ pool, input.data(), input.size() };
+		abandoned.SetChunkSize(16).SetOrder(JsonLinesOrder::Unordered);
+		EXPECT_TRUE(abandoned.Read(line));
+	}
+}
+
+TEST(JsonTest, JsonSerializer_Struct_ReadAndWriteWithoutDom)
+{
+	using namespace Json;
+	User user{ JsonSerializer::Parse<User>(
+		"{\"name\": \"z\\u00e9st\", \"unknown\": {\"id\": [1, {\"x\": 2}]}, \"id\": 12345678901, \"isActive\": true,"
+		" \"score\": 2, \"level\": 65535, \"role\": 7, \"tags\": [\"a\", \"b\"],"
+		" \"addresses\": [{\"city\": \"Oslo\", \"zip\": 150}, {\"city\": \"Rome\", \"zip\": null}],"
+		" \"home\": null, \"counters\": {\"x\": 1, \"y\": -2}}") };
+	EXPECT_EQ(user.id, 12345678901);
+	EXPECT_EQ(user.name, "z\xC3\xA9st");
+	EXPECT_TRUE(user.isActive);
+	EXPECT_EQ(user.score, 2.0);
+	EXPECT_EQ(user.level, 65535);
+	EXPECT_EQ(user.role, Role::Admin);
+	EXPECT_EQ(user.tags, (std::vector<std::string>{ "a", "b" }));
+	ASSERT_EQ(user.addresses.size(), 2u);
+	EXPECT_EQ(user.addresses[0].zip, 150);
+	EXPECT_FALSE(user.addresses[1].zip.has_value());
+	EXPECT_FALSE(user.home.has_value());
+	EXPECT_EQ(user.counters["y"], -2);
+
+	user.home = Address{ "Kyiv", std::nullopt };
+	std::string json{ JsonSerializer::ToString(user) };
+	EXPECT_EQ(json, "{\"id\":12345678901,\"name\":\"z\xC3\xA9st\",\"isActive\":true,\"score\":2.0,\"level\":65535,\"role\":7,"
+		"\"tags\":[\"a\",\"b\"],\"addresses\":[{\"city\":\"Oslo\",\"zip\":150},{\"city\":\"Rome\",\"zip\":null}],"
+		"\"home\":{\"city\":\"Kyiv\",\"zip\":null},\"counters\":{\"x\":1,\"y\":-2}}");
+	EXPECT_EQ(JsonSerializer::ToString(JsonSerializer::Parse<User>(json)), json);
+
+	// Missing fields keep their value, wrong types and ranges throw.
+	EXPECT_EQ(JsonSerializer::Parse<User>("{}").level, 0);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"level\": 65536}"), JsonError);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"level\": -1}"), JsonError);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"name\": 1}"), Error::Exception);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"id\": 1.5}"), Error::Exception);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"id\": 1"), JsonError);
+
+	// Enums accept only registered enumerators.
+	EXPECT_EQ(JsonSerializer::Parse<User>("{\"role\": 0}").role, Role::Guest);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"role\": 3}"), JsonError);
+	EXPECT_THROW(JsonSerializer::Parse<User>("{\"role\": 256}"), JsonError);
+	EXPECT_EQ(JsonSerializer::Parse<std::vector<Role>>("[7, 0]"), (std::vector<Role>{ Role::Admin, Role::Guest }));
+
+	std::vector<bool> flags{ JsonSerializer::Parse<std::vector<bool>>("[true, false, true]") };
+	EXPECT_EQ(flags, (std::vector<bool>{ true, false, true }));
+	EXPECT_EQ(JsonSerializer::ToString(flags), "[true,false,true]");
+	EXPECT_THROW(JsonSerializer::Parse<std::vector<bool>>("[true, 1]"), Error::Exception);
+}
+
+TEST(JsonTest, JsonFieldTable_PerfectHash_FindsEveryFieldOnly)
+{
+	using namespace Json;
+	const auto& fields{ ZestJsonGetFields(static_cast<const User*>(nullptr)) };
+	std::size_t count{ 0 };
+	for (const JsonField<User>& field : fields)
+	{
+		EXPECT_EQ(fields.Find(field.name), &field);
+		++count;
+	}
+	EXPECT_EQ(count, 10u);
+	for (const char* name : { "", "i", "ids", "Id", "nam", "names", "unknown", "addresses2" })
+	{
+		EXPECT_EQ(fields.Find(name), nullptr) << name;
+	}
+}
+
+TEST(JsonTest, JsonTape_Views_SameAsDynamic)
+{
+	using namespace Json;
+	std::string json{ " {\"name\": \"zest\", \"count\": 3, \"big\": 12345678901, \"huge\": 123456789012345678901,\n"
+		"\t\"ratio\": -2.5e-3, \"ok\": true, \"no\": false, \"none\": null, \"esc\\u0041\": \"a\\n\\u00e9\",\r\n"
+		"\"list\": [1, [], {}, [\"a\", {\"b\": [null]}]], \"empty\": \"\"} " };
+	JsonTape tape;
+	JsonTapeValue root{ tape.Parse(json) };
+	Dynamic document = JsonParser::ParseJson(json);
+	EXPECT_TRUE(root.ToDynamic() == document);
+
+	EXPECT_EQ(root.GetType(), ValueMap::Type::Object);
+	EXPECT_EQ(root.Size(), 11u);
+	EXPECT_EQ(root["name"].GetString(), "zest");
+	EXPECT_EQ(root["count"].GetType(), ValueMap::Type::Int32);
+	EXPECT_EQ(root["big"].GetType(), ValueMap::Type::Int64);
+	EXPECT_EQ(root["big"].GetInt64(), 12345678901);
+	EXPECT_EQ(root["big"].GetInt32(), document["big"].GetInt32());
+	EXPECT_EQ(root["huge"].GetType(), ValueMap::Type::Double);
+	EXPECT_DOUBLE_EQ(root["ratio"].GetDouble(), -0.0025);
+	EXPECT_EQ(root["ratio"].GetInt64(), 0);
+	EXPECT_EQ(root["huge"].GetInt64(), std::numeric_limits<int64_t>::max());
+	EXPECT_EQ(root["huge"].GetInt32(), std::numeric_limits<int32_t>::max());
+	JsonTape numbers;
+	JsonTapeValue doubles{ numbers.Parse("[-1e300, 3e9, -2.7, 9223372036854775808.0, -9223372036854775808.0]") };
+	EXPECT_EQ(doubles[0].GetInt64(), std::numeric_limits<int64_t>::min());
+	EXPECT_EQ(doubles[0].GetInt32(), std::numeric_limits<int32_t>::min());
+	EXPECT_EQ(doubles[1].GetInt64(), 3000000000);
+	EXPECT_EQ(doubles[1].GetInt32(), std::numeric_limits<int32_t>::max());
+	EXPECT_EQ(doubles[2].GetInt32(), -2);
+	EXPECT_EQ(doubles[3].GetInt64(), std::numeric_limits<int64_t>::max());
+	EXPECT_EQ(doubles[4].GetInt64(), std::numeric_limits<int64_t>::min());
+	EXPECT_DOUBLE_EQ(root["count"].GetDouble(), 3.0);
+	EXPECT_TRUE(root["ok"].GetBool());
+	EXPECT_FALSE(root["no"].GetBool());
+	EXPECT_EQ(root["none"].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(root["escA"].GetString(), "a\n\xC3\xA9");
+	EXPECT_EQ(root["list"].Size(), 4u);
+	EXPECT_EQ(root["list"][1].Size(), 0u);
+	EXPECT_EQ(root["list"][2].GetType(), ValueMap::Type::Object);
+	EXPECT_EQ(root["list"][3][1]["b"][0].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(root["list"][4].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(root["missing"].GetType(), ValueMap::Type::Null);
+	EXPECT_EQ(root["empty"].GetString(), "");
+
+	std::string names;
+	root.ForEachProperty([&names](std::string_view name, const JsonTapeValue&) { names.append(name).append(","); });
+	EXPECT_EQ(names, "name,count,big,huge,ratio,ok,no,none,escA,list,empty,");
+	int64_t sum{ 0 };
+	tape.Parse("[1, [2, 3], {\"x\": 4}, 5]").ForEachElement([&sum](const JsonTapeValue& element)
+	{
+		sum += element.GetType() == ValueMap::Type::Int32 ? element.GetInt64() : 0;
+	});
+	EXPECT_EQ(sum, 6);
+
+	EXPECT_THROW(root.GetString(), Error::Exception);
+	EXPECT_THROW(root["name"].GetInt64(), Error::Exception);
+	EXPECT_THROW(root["list"]["a"], Error::Exception);
+
+	// Names from input are not added to the key table.
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	Dynamic unique = tape.Parse("[{\"tape key\": {\"tape key 2\": 1}}, {\"tape key\": 2}]").ToDynamic();
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_EQ(unique[0]["tape key"]["tape key 2"].GetInt32(), 1);
+}
+
+TEST(JsonTest, JsonTape_InvalidInput_ThrowsLikeParser)
+{
+	using namespace Json;
+	JsonTape tape;
+	for (const char* json : { "", "  ", "{", "[1,]", "{\"a\" 1}", "{\"a\":}", "[1 2]", "tru", "nul", "01", "1.", "\"\\x\"", "[] []", "{1:2}" })
+	{
+		EXPECT_THROW(tape.Parse(json, std::strlen(json)), JsonError) << json;
+		EXPECT_EQ(tape.GetRoot().GetType(), ValueMap::Type::Null) << json;
+	}
+	std::string deep(JsonTape::c_maxDepth + 1, '[');
+	deep += std::string(JsonTape::c_maxDepth + 1, ']');
+	EXPECT_THROW(tape.Parse(deep), JsonError);
+	deep = deep.substr(1, deep.size() - 2);
+	EXPECT_EQ(tape.Parse(deep).Size(), 1u);
+}
+
+TEST(JsonTest, JsonSchemaParser_Document_CheckedWhileParsing)
+{
+	using namespace Json;
+	JsonSchemaParser parser{ JsonSchema::Compile(std::string{ R"({
+		"$schema": "https://json-schema.org/draft/2020-12/schema",
+		"title": "user",
+		"type": "object",
+		"properties": {
+			"id": { "type": "integer", "minimum": 1 },
+			"name": { "type": "string", "minLength": 1, "maxLength": 4 },
+			"role": { "enum": ["admin", "user", null] },
+			"score": { "type": ["number", "null"], "exclusiveMaximum": 100 },
+			"tags": { "type": "array", "items": { "type": "string" }, "maxItems": 2 },
+			"extra": { "type": "object", "additionalProperties": { "type": "boolean" }, "maxProperties": 1 }
+		},
+		"required": ["id", "name", "created"],
+		"additionalProperties": false
+	})" }) };
+
+	std::string json{ R"({"id": 2.0, "name": "zést", "created": [1], "role": "user", "score": 99.5, "tags": ["a", "b"], "extra": {"x": true}})" };
+	Dynamic document = parser.Parse(json);
+	EXPECT_TRUE(document == JsonParser::ParseJson(json));
+	EXPECT_NO_THROW(parser.Validate(json));
+
+	// Names of additional properties are not added to the key table.
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	Dynamic additional = parser.Parse(R"({"id": 1, "name": "a", "created": 1, "extra": {"schema key": false}})");
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_FALSE(additional["extra"]["schema key"].GetBool());
+
+	struct Violation
+	{
+		const char* json;
+		const char* message;
+	};
+	for (const Violation& violation : std::vector<Violation>{
+		{ R"([])", "Expected type object at offset 0" },
+		{ R"({"id": 0, "name": "a", "created": 1})", "Number below minimum at offset 7" },
+		{ R"({"id": 1.5, "name": "a", "created": 1})", "Expected type integer at offset 7" },
+		{ R"({"id": 1, "name": "", "created": 1})", "String length out of range at offset 18" },
+		{ R"({"id": 1, "name": "abcde", "created": 1})", "String length out of range at offset 18" },
+		{ R"({"id": 1, "name": "a", "created": 1, "role": "root"})", "Value not in enum at offset 45" },
+		{ R"({"id": 1, "name": "a", "created": 1, "score": 100})", "Number above maximum at offset 46" },
+		{ R"({"id": 1, "name": "a", "created": 1, "score": "1"})", "Expected type null or number at offset 46" },
+		{ R"({"id": 1, "name": "a", "created": 1, "tags": ["a", 1]})", "Expected type string at offset 51" },
+		{ R"({"id": 1, "name": "a", "created": 1, "tags": ["a", "b", "c"]})", "Too many items at offset 56" },
+		{ R"({"id": 1, "name": "a", "created": 1, "extra": {"x": 1}})", "Expected type boolean at offset 52" },
+		{ R"({"id": 1, "name": "a", "created": 1, "extra": {"x": true, "y": true}})", "Too many properties at offset 58" },
+		{ R"({"id": 1, "name": "a", "created": 1, "other": 1})", "Property \"other\" not allowed at offset 37" },
+		{ R"({"id": 1, "name": "a"})", "Missing required property \"created\" at offset 21" },
+		// Violation comes before the malformed rest of the document.
+		{ R"({"id": "1", "name": )", "Expected type integer at offset 7" } })
+	{
+		for (bool isBuild : { true, false })
+		{
+			try
+			{
+				isBuild ? static_cast<void>(parser.Parse(violation.json)) : parser.Validate(violation.json);
+				ADD_FAILURE() << violation.json;
+			}
+			catch (const JsonError& error)
+			{
+				EXPECT_EQ(error.GetErrorCode(), JsonErrorCode::Schema_Violation) << violation.json;
+				EXPECT_STREQ(error.what(), violation.message) << violation.json;
+			}
+		}
+	}
+
+	for (const char* json : { "", "{", R"({"id": 1,})", R"({"id": 1]})" })
+	{
+		try
+		{
+			parser.Validate(json);
+			ADD_FAILURE() << json;
+		}
+		catch (const JsonError& error)
+		{
+			EXPECT_NE(error.GetErrorCode(), JsonErrorCode::Schema_Violation) << json;
+		}
+	}
+}
+
+TEST(JsonTest, JsonSchema_Compile_RejectsUnsupportedSchema)
+{
+	using namespace Json;
+	for (const char* schema : { "1", R"({"$ref": "#/a"})", R"({"type": "int"})", R"({"enum": [[1]]})", R"({"minLength": -1})", R"({"items": [{}]})", R"({"required": [1]})", R"({"properties": {"a": {"allOf": []}}})" })
+	{
+		try
+		{
+			JsonSchema::Compile(std::string{ schema });
+			ADD_FAILURE() << schema;
+		}
+		catch (const JsonError& error)
+		{
+			EXPECT_EQ(error.GetErrorCode(), JsonErrorCode::Schema_Invalid) << schema;
+		}
+	}
+
+	JsonSchemaParser anyParser{ JsonSchema::Compile(Dynamic(true)) };
+	EXPECT_EQ(anyParser.Parse("[1, {\"a\": null}]")[1]["a"].GetType(), ValueMap::Type::Null);
+	JsonSchemaParser noneParser{ JsonSchema::Compile(std::string{ R"({"items": false})" }) };
+	EXPECT_EQ(noneParser.Parse("[]").GetArray().size(), 0u);
+	EXPECT_THROW(noneParser.Parse("[null]"), JsonError);
+
+	// More properties and required ones than fit one mask word, all found by the perfect hash.
+	Dynamic properties = Dynamic::MakeObject();
+	ValueMap::Array required;
+	std::string json{ "{" };
+	for (int i = 0; i < 200; ++i)
+	{
+		std::string name{ "p" + std::to_string(i) };
+		Dynamic property = Dynamic::MakeObject();
+		property.GetObjectMap().Set(DynamicKey{ "const" }, Dynamic(i));
+		properties.GetObjectMap().Set(DynamicKey{ name }, std::move(property));
+		required.push_back(Dynamic(name));
+		json += (i == 0 ? "\"" : ", \"") + name + "\": " + std::to_string(i);
+	}
+	Dynamic schema = Dynamic::MakeObject();
+	schema.GetObjectMap().Set(DynamicKey{ "properties" }, std::move(properties));
+	schema.GetObjectMap().Set(DynamicKey{ "required" }, Dynamic(std::move(required)));
+	schema.GetObjectMap().Set(DynamicKey{ "additionalProperties" }, Dynamic(false));
+	JsonSchemaParser parser{ JsonSchema::Compile(schema) };
+	EXPECT_EQ(parser.Parse(json + "}").GetObjectMap().Size(), 200u);
+	EXPECT_THROW(parser.Validate(json + ", \"p200\": 1}"), JsonError);
+	std::string missing{ json };
+	missing.replace(missing.find("\"p150\": 150"), 11, "\"q\\u0031\": 0");
+	try
+	{
+		parser.Validate(missing + "}");
+		ADD_FAILURE();
+	}
+	catch (const JsonError& error)
+	{
+		EXPECT_NE(std::string{ error.what() }.find("Property \"q1\" not allowed"), std::string::npos) << error.what();
+	}
+	missing = json;
+	missing.replace(missing.find(", \"p150\": 150"), 13, "");
+	try
+	{
+		parser.Validate(missing + "}");
+		ADD_FAILURE();
+	}
+	catch (const JsonError& error)
+	{
+		EXPECT_NE(std::string{ error.what() }.find("Missing required property \"p150\""), std::string::npos) << error.what();
+	}
+}
+
+TEST(JsonTest, JsonPushParser_AnyChunking_SameEventsAsReader)
+{
+	using namespace Json;
+	std::string json{
+		" {\"name\": \"zest\", \"list\": [1, -20, 18446744073709551616, 2.5e1, true, false, null, [], {}],\n"
+		"\"escaped\\n\": \"a\\\"b\\\\\\u00e9\\ud83d\\ude00\", \"utf8\": \"\xE2\x82\xAC\", \"nested\": [[{\"a\": [0.5]}]]} " };
+	RecordingHandler expected;
+	JsonStringStream stream{ json };
+	ASSERT_TRUE(JsonReader{ stream }.Read(expected));
+
+	// Every boundary of every token is hit by some chunk size or split point.
+	auto feedInChunks = [&json](JsonPushParser& parser, RecordingHandler& handler, std::size_t firstSize, std::size_t chunkSize)
+	{
+		EXPECT_TRUE(parser.Feed(json.data(), firstSize, handler));
+		for (std::size_t position = firstSize; position < json.size(); position += chunkSize)
+		{
+			EXPECT_TRUE(parser.Feed(json.data() + position, std::min(chunkSize, json.size() - position), handler));
+		}
+		EXPECT_TRUE(parser.Finish(handler));
+	};
+	JsonPushParser parser;
+	for (std::size_t chunkSize = 1; chunkSize < 20; ++chunkSize)
+	{
+		RecordingHandler handler;
+		parser.Reset();
+		feedInChunks(parser, handler, 0, chunkSize);
+		EXPECT_EQ(handler.events, expected.events) << chunkSize;
+	}
+	for (std::size_t split = 0; split <= json.size(); ++split)
+	{
+		RecordingHandler handler;
+		parser.Reset();
+		feedInChunks(parser, handler, split, json.size());
+		EXPECT_EQ(handler.events, expected.events) << split;
+	}
+
+	// Top level number may continue in the next chunk until input ends.
+	RecordingHandler handler;
+	parser.Reset();
+	EXPECT_TRUE(parser.Feed("-12", handler));
+	EXPECT_TRUE(parser.Feed("5e1", handler));
+	EXPECT_EQ(handler.events, "");
+	EXPECT_FALSE(parser.IsComplete());
+	EXPECT_TRUE(parser.Finish(handler));
+	EXPECT_EQ(handler.events, "d(-1250.000000)");
+}
+
+TEST(JsonTest, JsonPushParser_ValueBuilder_EmitsBeforeInputEnds)
+{
+	using namespace Json;
+	std::string json{ "[" };
+	for (int i = 0; i < 100; ++i)
+	{
+		json += (i == 0 ? "" : ",") + std::string{ "{\"id\": " } + std::to_string(i) + ", \"name\": \"r\\u0031\", \"tags\": [true, null, 2.5]}";
+	}
+	json += "]";
+	Dynamic expected = JsonParser::ParseJson(json);
+
+	std::vector<Dynamic> records;
+	JsonValueBuilder builder{ 1, [&records](Dynamic&& record) { records.push_back(std::move(record)); } };
+	JsonPushParser parser;
+	std::size_t half{ json.size() / 2 };
+	EXPECT_TRUE(parser.Feed(json.data(), half, builder));
+	EXPECT_GT(records.size(), 40u);
+	EXPECT_LT(records.size(), 60u);
+	for (std::size_t position = half; position < json.size(); position += 13)
+	{
+		EXPECT_TRUE(parser.Feed(json.data() + position, std::min<std::size_t>(13, json.size() - position), builder));
+	}
+	EXPECT_TRUE(parser.Finish(builder));
+	ASSERT_EQ(records.size(), 100u);
+	for (std::size_t i = 0; i < records.size(); ++i)
+	{
+		EXPECT_TRUE(records[i] == expected[i]) << i;
+	}
+
+	Dynamic document;
+	JsonValueBuilder documentBuilder{ 0, [&document](Dynamic&& value) { document = std::move(value); } };
+	parser.Reset();
+	EXPECT_TRUE(parser.Feed(json, documentBuilder));
+	EXPECT_TRUE(parser.Finish(documentBuilder));
+	EXPECT_TRUE(document == expected);
+
+	// Names from input are not added to the key table.
+	std::string unique{ "{\"push key a\": 1, \"push key b\": {\"push key c\": 2}}" };
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	parser.Reset();
+	EXPECT_TRUE(parser.Feed(unique, documentBuilder));
+	EXPECT_TRUE(parser.Finish(documentBuilder));
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_EQ(document["push key b"]["push key c"].GetInt32(), 2);
+}
+
+TEST(JsonTest, JsonPushParser_SkipStopAndErrors)
+{
+	using namespace Json;
+	struct SkippingHandler: RecordingHandler
+	{
+		JsonReadAction StartObject()
+		{
+			events += '{';
+			return ++objectCount == 2 ? JsonReadAction::Skip : JsonReadAction::Continue;
+		}
+		JsonReadAction Key(std::string_view key)
+		{
+			events.append(key).append(":");
+			return key == "skip" ? JsonReadAction::Skip : JsonReadAction::Continue;
+		}
+		JsonReadAction Int(int64_t value)
+		{
+			events.append("i(" + std::to_string(value) + ")");
+			return value == stopAt ? JsonReadAction::Stop : JsonReadAction::Continue;
+		}
+
+		int objectCount{ 0 };
+		int64_t stopAt{ -1 };
+	};
+	std::string json{ "{\"a\": 1, \"skip\": {\"x\": [\"]}\\\"\", {}]}, \"b\": {\"c\": \"}\"}, \"skip\": 3, \"d\": [4, 5]}" };
+	SkippingHandler expected;
+	JsonStringStream stream{ json };
+	ASSERT_TRUE(JsonReader{ stream }.Read(expected));
+	EXPECT_EQ(expected.events, "{a:i(1)skip:b:{skip:d:[i(4)i(5)]}");
+
+	JsonPushParser parser;
+	SkippingHandler handler;
+	for (char c : json)
+	{
+		EXPECT_TRUE(parser.Feed(&c, 1, handler));
+	}
+	EXPECT_TRUE(parser.Finish(handler));
+	EXPECT_EQ(handler.events, expected.events);
+
+	SkippingHandler stopping;
+	stopping.stopAt = 4;
+	parser.Reset();
+	EXPECT_FALSE(parser.Feed(json, stopping));
+	EXPECT_FALSE(parser.Feed("]", stopping));
+	EXPECT_FALSE(parser.Finish(stopping));
+	EXPECT_EQ(stopping.events, "{a:i(1)skip:b:{skip:d:[i(4)");
+
+	// Same error wherever input is cut.
+	for (const char* invalid : { "{", "[1,]", "{\"a\" 1}", "{\"a\":}", "[1 2]", "tru", "trUe", "\"a", "01", "[] []", "{1:2}", "[}", "\"\\x\"", "\"\x01\"", "[\"\xC3\"]" })
+	{
+		std::string message;
+		try
+		{
+			RecordingHandler whole;
+			parser.Reset();
+			parser.Feed(invalid, whole);
+			parser.Finish(whole);
+			ADD_FAILURE() << invalid;
+		}
+		catch (const JsonError& error)
+		{
+			message = error.what();
+		}
+		try
+		{
+			RecordingHandler bytes;
+			parser.Reset();
+			for (const char* p = invalid; *p != '\0'; ++p)
+			{
+				parser.Feed(p, 1, bytes);
+			}
+			parser.Finish(bytes);
+			ADD_FAILURE() << invalid;
+		}
+		catch (const JsonError& error)
+		{
+			EXPECT_EQ(error.what(), message) << invalid;
+		}
+	}
+
+	for (const char* empty : { "", " \n" })
+	{
+		RecordingHandler emptyHandler;
+		parser.Reset();
+		parser.Feed(empty, emptyHandler);
+		try
+		{
+			parser.Finish(emptyHandler);
+			ADD_FAILURE();
+		}
+		catch (const JsonError& error)
+		{
+			EXPECT_EQ(error.GetErrorCode(), JsonErrorCode::Parse_EmptyBody);
+		}
+	}
+	std::string deep(JsonPushParser::c_maxDepth + 1, '[');
+	parser.Reset();
+	EXPECT_THROW(parser.Feed(deep, handler), JsonError);
+}
+
+}}
@@ -0,0 +1,338 @@
+#pragma once
+#ifndef ZEST_LIB_MAPPEDFILE_H
+#define ZEST_LIB_MAPPEDFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "Error.h"
+#include "Stream.h"
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#if !defined(WIN32_LEAN_AND_MEAN)
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Zest { namespace Lib {
+
+// How a mapped file is going to be read, given to the kernel as advice.
+enum class MappedFileHint : uint32_t
+{
+	Normal,
+	// Read ahead aggressively, pages behind can be dropped, e.g. parsing once at startup.
+	Sequential,
+	// Disable read ahead, e.g. lookups in an index.
+	Random,
+	// Sequential with transparent huge pages where the kernel supports them for files.
+	HugePage
+};
+
+/*! Read only file in memory without copying it into a string.
+	Data is followed by at least c_padding zero bytes, so it is null terminated and readers
+	may load whole SIMD registers past the end. Pages after the file are anonymous zero pages,
+	on Windows a file whose last page lacks room is read into padded memory instead.
+		MappedFile file{ "data.json" };
+		Dynamic document = Json::JsonParser::ParseJson(file.GetData(), file.GetSize());
+	As IStream it reads the file from start to end.
+*/
+class MappedFile: public IStream
+{
+public:
+	static constexpr std::size_t c_padding{ 64 };
+
+	MappedFile() noexcept
+		: m_pData{ GetEmptyData() }, m_size{ 0 }, m_pMapping{ nullptr }, m_mappingSize{ 0 }, m_isView{ false }, m_position{ 0 }
+	{
+	}
+
+	// Throws FileError when file can't be opened or mapped.
+	explicit MappedFile(const std::string& path, MappedFileHint hint = MappedFileHint::Sequential)
+		: MappedFile{}
+	{
+		Open(path, hint);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept
+		: MappedFile{}
+	{
+		Swap(other);
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			Swap(other);
+		}
+		return *this;
+	}
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	void Open(const std::string& path, MappedFileHint hint = MappedFileHint::Sequential)
+	{
+		Close();
+#if defined(_WIN32)
+		OpenWindows(path, hint);
+#else
+		OpenPosix(path, hint);
+#endif
+	}
+
+	void Close() noexcept
+	{
+		if (m_pMapping != nullptr)
+		{
+#if defined(_WIN32)
+			if (m_isView)
+			{
+				UnmapViewOfFile(m_pMapping);
+			}
+			else
+			{
+				VirtualFree(m_pMapping, 0, MEM_RELEASE);
+			}
+#else
+			munmap(m_pMapping, m_mappingSize);
+#endif
+		}
+		m_pData = GetEmptyData();
+		m_size = 0;
+		m_pMapping = nullptr;
+		m_mappingSize = 0;
+		m_isView = false;
+		m_position = 0;
+	}
+
+	// Valid until file is closed, followed by c_padding zero bytes.
+	const char* GetData() const noexcept
+	{
+		return m_pData;
+	}
+
+	std::size_t GetSize() const noexcept
+	{
+		return m_size;
+	}
+
+	std::size_t Read(char* pBuffer, std::size_t size) override
+	{
+		std::size_t readSize{ std::min(size, m_size - m_position) };
+		std::memcpy(pBuffer, m_pData + m_position, readSize);
+		m_position += readSize;
+		return readSize;
+	}
+
+private:
+	// Alignment of huge pages of x86-64 and arm64 with 4KB pages.
+	static constexpr std::size_t c_hugePageSize{ 2 << 20 };
+
+	static const char* GetEmptyData() noexcept
+	{
+		static const char emptyData[c_padding]{};
+		return emptyData;
+	}
+
+	static std::size_t RoundUp(std::size_t value, std::size_t alignment) noexcept
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void Swap(MappedFile& other) noexcept
+	{
+		std::swap(m_pData, other.m_pData);
+		std::swap(m_size, other.m_size);
+		std::swap(m_pMapping, other.m_pMapping);
+		std::swap(m_mappingSize, other.m_mappingSize);
+		std::swap(m_isView, other.m_isView);
+		std::swap(m_position, other.m_position);
+	}
+
+#if defined(_WIN32)
+	void OpenWindows(const std::string& path, MappedFileHint hint)
+	{
+		DWORD flags{ hint == MappedFileHint::Random ? FILE_FLAG_RANDOM_ACCESS : hint == MappedFileHint::Normal ? FILE_ATTRIBUTE_NORMAL : FILE_FLAG_SEQUENTIAL_SCAN };
+		HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			Error::ThrowFileErrorException();
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			Error::ThrowFileErrorException();
+		}
+		std::size_t size{ static_cast<std::size_t>(fileSize.QuadPart) };
+		if (size == 0)
+		{
+			CloseHandle(file);
+			return;
+		}
+
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		std::size_t pageSize{ systemInfo.dwPageSize };
+		void* pMapping{ nullptr };
+		bool isView{ RoundUp(size, pageSize) - size >= c_padding };
+		if (isView)
+		{
+			// Rest of last page is zero, and there is enough of it.
+			HANDLE mapping{ CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+			if (mapping != nullptr)
+			{
+				pMapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+			}
+		}
+		else
+		{
+			pMapping = VirtualAlloc(nullptr, size + c_padding, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+			if (pMapping != nullptr && !ReadAll(file, static_cast<char*>(pMapping), size))
+			{
+				VirtualFree(pMapping, 0, MEM_RELEASE);
+				pMapping = nullptr;
+			}
+		}
+		CloseHandle(file);
+		if (pMapping == nullptr)
+		{
+			Error::ThrowFileErrorException();
+		}
+
+		m_pData = static_cast<const char*>(pMapping);
+		m_size = size;
+		m_pMapping = pMapping;
+		m_mappingSize = isView ? RoundUp(size, pageSize) : size + c_padding;
+		m_isView = isView;
+	}
+
+	static bool ReadAll(HANDLE file, char* pBuffer, std::size_t size) noexcept
+	{
+		while (size != 0)
+		{
+			DWORD readSize;
+			DWORD requestSize{ static_cast<DWORD>(std::min<std::size_t>(size, 1 << 30)) };
+			if (!ReadFile(file, pBuffer, requestSize, &readSize, nullptr) || readSize == 0)
+			{
+				return false;
+			}
+			pBuffer += readSize;
+			size -= readSize;
+		}
+		return true;
+	}
+#else
+	void OpenPosix(const std::string& path, MappedFileHint hint)
+	{
+		int file{ open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+		if (file < 0)
+		{
+			Error::ThrowFileErrorException();
+		}
+		struct stat fileStatus;
+		if (fstat(file, &fileStatus) != 0 || !S_ISREG(fileStatus.st_mode))
+		{
+			close(file);
+			Error::ThrowFileErrorException();
+		}
+		std::size_t size{ static_cast<std::size_t>(fileStatus.st_size) };
+		if (size == 0)
+		{
+			close(file);
+			return;
+		}
+
+		// Anonymous zero pages are reserved first, file is mapped over their start.
+		std::size_t pageSize{ static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) };
+		std::size_t alignment{ hint == MappedFileHint::HugePage ? c_hugePageSize : pageSize };
+		std::size_t mappingSize{ RoundUp(size + c_padding, pageSize) };
+		std::size_t reservedSize{ mappingSize + alignment - pageSize };
+		void* pReserved{ mmap(nullptr, reservedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) };
+		if (pReserved == MAP_FAILED)
+		{
+			close(file);
+			Error::ThrowFileErrorException();
+		}
+		// Huge pages of a file need the same alignment in memory, rest of the reservation is returned.
+		char* pMapping{ reinterpret_cast<char*>(RoundUp(reinterpret_cast<std::uintptr_t>(pReserved), alignment)) };
+		std::size_t headSize{ static_cast<std::size_t>(pMapping - static_cast<char*>(pReserved)) };
+		if (headSize != 0)
+		{
+			munmap(pReserved, headSize);
+		}
+		if (reservedSize - headSize != mappingSize)
+		{
+			munmap(pMapping + mappingSize, reservedSize - headSize - mappingSize);
+		}
+
+		void* pFile{ mmap(pMapping, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, file, 0) };
+		close(file);
+		if (pFile == MAP_FAILED)
+		{
+			munmap(pMapping, mappingSize);
+			Error::ThrowFileErrorException();
+		}
+		Advise(pMapping, size, hint);
+
+		m_pData = pMapping;
+		m_size = size;
+		m_pMapping = pMapping;
+		m_mappingSize = mappingSize;
+	}
+
+	// Advice is only a hint, kernels which don't know it are ignored.
+	static void Advise(void* pMapping, std::size_t size, MappedFileHint hint) noexcept
+	{
+		switch (hint)
+		{
+		case MappedFileHint::Normal:
+			break;
+		case MappedFileHint::HugePage:
+#if defined(MADV_HUGEPAGE)
+			madvise(pMapping, size, MADV_HUGEPAGE);
+#endif
+			// Huge pages are read sequentially too.
+			[[fallthrough]];
+		case MappedFileHint::Sequential:
+			madvise(pMapping, size, MADV_SEQUENTIAL);
+			madvise(pMapping, size, MADV_WILLNEED);
+			break;
+		case MappedFileHint::Random:
+			madvise(pMapping, size, MADV_RANDOM);
+			break;
+		}
+	}
+#endif
+
+	const char* m_pData;
+	std::size_t m_size;
+	void* m_pMapping;
+	std::size_t m_mappingSize;
+	// Windows only, mapping is a view of file instead of memory it was read into.
+	bool m_isView;
+	// Position of IStream Read.
+	std::size_t m_position;
+};
+
+}}
+
+#endif
@@ -0,0 +1,107 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "MappedFile.h"
+#include "json/json.h"
+#include "json/JsonReader.h"
+
+namespace Zest { namespace Lib {
+
+namespace {
+
+// File in temp directory which is removed with the object.
+class TempFile
+{
+public:
+	TempFile(const std::string& name, const std::string& content)
+		: m_path{ (std::filesystem::temp_directory_path() / name).string() }
+	{
+		std::ofstream file{ m_path, std::ios::binary };
+		file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	}
+
+	~TempFile()
+	{
+		std::remove(m_path.c_str());
+	}
+
+	const std::string& GetPath() const noexcept
+	{
+		return m_path;
+	}
+
+private:
+	std::string m_path;
+};
+
+}
+
+TEST(MappedFileTest, Open_DataFollowedByZeroPadding)
+{
+	for (std::size_t size : { 0, 1, 63, 64, 4095, 4096, 4097, 3 * 4096 - 10, 65536 })
+	{
+		std::string content(size, 'a');
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			content[i] = static_cast<char>('a' + i % 26);
+		}
+		TempFile tempFile{ "zest_mappedfile_test.bin", content };
+
+		for (MappedFileHint hint : { MappedFileHint::Normal, MappedFileHint::Sequential, MappedFileHint::Random, MappedFileHint::HugePage })
+		{
+			MappedFile file{ tempFile.GetPath(), hint };
+			ASSERT_EQ(file.GetSize(), size);
+			ASSERT_EQ(std::string(file.GetData(), file.GetSize()), content) << size;
+			for (std::size_t i = 0; i < MappedFile::c_padding; ++i)
+			{
+				ASSERT_EQ(file.GetData()[size + i], '\0') << size;
+			}
+		}
+
+		// As stream in small reads, then moved.
+		MappedFile file{ tempFile.GetPath() };
+		std::string readContent;
+		char buffer[100];
+		for (std::size_t readSize = file.Read(buffer, sizeof(buffer)); readSize != 0; readSize = file.Read(buffer, sizeof(buffer)))
+		{
+			readContent.append(buffer, readSize);
+		}
+		EXPECT_EQ(readContent, content);
+		MappedFile movedFile{ std::move(file) };
+		EXPECT_EQ(file.GetSize(), 0u);
+		EXPECT_EQ(std::string(movedFile.GetData(), movedFile.GetSize()), content);
+	}
+
+	EXPECT_THROW(MappedFile{ "zest_mappedfile_test_missing.bin" }, Error::Exception);
+}
+
+TEST(MappedFileTest, Json_ParsedWithoutCopyIntoString)
+{
+	using namespace Json;
+	TempFile tempFile{ "zest_mappedfile_test.json", "{\"name\": \"zest\", \"list\": [1, 2.5, true, null]}\n" };
+	MappedFile file{ tempFile.GetPath() };
+
+	Dynamic document = JsonParser::ParseJson(file.GetData(), file.GetSize(), true);
+	EXPECT_EQ(document["name"].GetString(), "zest");
+	EXPECT_EQ(document["name"].GetString().data(), file.GetData() + 10);
+	EXPECT_DOUBLE_EQ(document["list"][1].GetDouble(), 2.5);
+
+	// Zero padding terminates data.
+	EXPECT_EQ(JsonParser::ParseJson(file.GetData())["list"].GetArray().size(), 4u);
+
+	struct CountHandler: JsonHandler
+	{
+		JsonReadAction Int(int64_t) { ++count; return JsonReadAction::Continue; }
+		int count{ 0 };
+	};
+	CountHandler handler;
+	JsonReader reader{ file, 8 };
+	EXPECT_TRUE(reader.Read(handler));
+	EXPECT_EQ(handler.count, 1);
+}
+
+}}
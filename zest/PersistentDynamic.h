@@ -0,0 +1,1078 @@
+#pragma once
+#ifndef ZEST_LIB_PERSISTENTDYNAMIC_H
+#define ZEST_LIB_PERSISTENTDYNAMIC_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Dynamics.h"
+#include "Error.h"
+#include "Hash.h"
+#include "Platform.h"
+
+namespace Zest { namespace Lib {
+
+// Immutable node of persistent containers, reference count is always atomic.
+class PersistentNode
+{
+public:
+	enum class Kind : uint32_t
+	{
+		Object,
+		Array
+	};
+
+	PersistentNode(const PersistentNode&) = delete;
+	PersistentNode& operator=(const PersistentNode&) = delete;
+
+	virtual ~PersistentNode()
+	{
+	}
+
+	Kind GetKind() const noexcept
+	{
+		return m_kind;
+	}
+
+	// Number of properties or elements under this node.
+	std::size_t GetSize() const noexcept
+	{
+		return m_size;
+	}
+
+	void AddRef() const noexcept
+	{
+		m_refCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Release() const noexcept
+	{
+		if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			delete this;
+		}
+	}
+
+protected:
+	PersistentNode(Kind kind, std::size_t size) noexcept
+		: m_refCount{ 0 }, m_kind{ kind }, m_size{ size }
+	{
+	}
+
+	mutable std::atomic<uint32_t> m_refCount;
+	const Kind m_kind;
+	// Only written while node is private to the writer which creates it.
+	std::size_t m_size;
+};
+
+class PersistentNodePtr
+{
+public:
+	PersistentNodePtr() noexcept
+		: m_pNode{ nullptr }
+	{
+	}
+
+	explicit PersistentNodePtr(const PersistentNode* pNode) noexcept
+		: m_pNode{ pNode }
+	{
+		if (m_pNode != nullptr)
+		{
+			m_pNode->AddRef();
+		}
+	}
+
+	PersistentNodePtr(const PersistentNodePtr& other) noexcept
+		: PersistentNodePtr(other.m_pNode)
+	{
+	}
+
+	PersistentNodePtr(PersistentNodePtr&& other) noexcept
+		: m_pNode{ other.m_pNode }
+	{
+		other.m_pNode = nullptr;
+	}
+
+	~PersistentNodePtr()
+	{
+		if (m_pNode != nullptr)
+		{
+			m_pNode->Release();
+		}
+	}
+
+	PersistentNodePtr& operator=(PersistentNodePtr other) noexcept
+	{
+		std::swap(m_pNode, other.m_pNode);
+		return *this;
+	}
+
+	const PersistentNode* Get() const noexcept
+	{
+		return m_pNode;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_pNode != nullptr;
+	}
+
+private:
+	const PersistentNode* m_pNode;
+};
+
+/*! Immutable Dynamic with structural sharing.
+	Objects are hash array mapped tries over interned keys, arrays are 32 way radix vectors.
+	Set, Remove, PushBack and PopBack return a new version and copy only the O(log n) nodes
+	on the path to the change, everything else is shared with the old version.
+	Versions are never mutated, so any number of threads can read them without lock.
+	Properties are iterated in hash order, not insertion order.
+*/
+class PersistentDynamic
+{
+public:
+	PersistentDynamic() = default;
+	PersistentDynamic(const ValueMap::Bool boolValue);
+	PersistentDynamic(const ValueMap::Int32 int32Value);
+	PersistentDynamic(const ValueMap::Int64 int64Value);
+	PersistentDynamic(const ValueMap::Double doubleValue);
+	PersistentDynamic(const char* charValue);
+	PersistentDynamic(const ValueMap::String& stringValue);
+	PersistentDynamic(const ValueMap::StringView stringValue);
+
+	static PersistentDynamic MakeObject();
+	static PersistentDynamic MakeArray();
+
+	// Deep copy, strings and keys which are not interned are copied to heap so result doesn't depend
+	// on arena or borrowed memory of value.
+	static PersistentDynamic FromDynamic(const Dynamic& value);
+	// Scalars are shared with result, containers are rebuilt.
+	Dynamic ToDynamic() const;
+
+	ValueMap::Type GetType() const noexcept;
+	ValueMap::Bool GetBool() const;
+	ValueMap::Int32 GetInt32() const;
+	ValueMap::Int64 GetInt64() const;
+	ValueMap::Double GetDouble() const;
+	ValueMap::StringView GetString() const;
+
+	// Number of properties or elements, 0 for scalars.
+	std::size_t Size() const noexcept;
+
+	// nullptr if property doesn't exist, lookup by name doesn't intern it.
+	const PersistentDynamic* Find(const DynamicKey& propertyKey) const;
+	const PersistentDynamic* Find(const ValueMap::String& propertyName) const;
+
+	// Null if property or element doesn't exist.
+	const PersistentDynamic& operator[](const DynamicKey& propertyKey) const;
+	const PersistentDynamic& operator[](const ValueMap::String& propertyName) const;
+	const PersistentDynamic& operator[](const std::size_t index) const;
+
+	// Set and Remove by name don't intern it.
+	PersistentDynamic Set(const DynamicKey& propertyKey, const PersistentDynamic& value) const;
+	PersistentDynamic Set(const ValueMap::String& propertyName, const PersistentDynamic& value) const;
+	PersistentDynamic Remove(const DynamicKey& propertyKey) const;
+	PersistentDynamic Remove(const ValueMap::String& propertyName) const;
+
+	PersistentDynamic Set(const std::size_t index, const PersistentDynamic& value) const;
+	PersistentDynamic PushBack(const PersistentDynamic& value) const;
+	PersistentDynamic PopBack() const;
+
+	// func(const DynamicKey&, const PersistentDynamic&) for every property.
+	template<typename TFunc>
+	void ForEachProperty(TFunc&& func) const;
+
+	// func(const PersistentDynamic&) for every element in order.
+	template<typename TFunc>
+	void ForEachElement(TFunc&& func) const;
+
+	// True if both refer to the same version of a container, or to the same scalar node.
+	bool IsSameNode(const PersistentDynamic& other) const noexcept;
+
+private:
+	PersistentDynamic(Dynamic scalar, PersistentNodePtr spNode) noexcept;
+
+	// Scalars and keys are released by reader threads, so they must be heap allocated with atomic reference count.
+	class SharedScalarScope
+	{
+	public:
+		SharedScalarScope() noexcept
+			: m_policy{ RefCountPolicy::Atomic },
+			m_pPreviousArena{ ScopedDynamicArena::GetCurrentArena() },
+			m_pPreviousMemoryResource{ ScopedDynamicArena::GetCurrentMemoryResource() }
+		{
+			ScopedDynamicArena::GetCurrentArena() = nullptr;
+			ScopedDynamicArena::GetCurrentMemoryResource() = nullptr;
+		}
+
+		SharedScalarScope(const SharedScalarScope&) = delete;
+		SharedScalarScope& operator=(const SharedScalarScope&) = delete;
+
+		~SharedScalarScope()
+		{
+			ScopedDynamicArena::GetCurrentArena() = m_pPreviousArena;
+			ScopedDynamicArena::GetCurrentMemoryResource() = m_pPreviousMemoryResource;
+		}
+
+	private:
+		ScopedRefCountPolicy m_policy;
+		DynamicArena* m_pPreviousArena;
+		std::pmr::memory_resource* m_pPreviousMemoryResource;
+	};
+
+	template<typename TValue>
+	static Dynamic MakeScalar(const TValue value)
+	{
+		SharedScalarScope scope;
+		return Dynamic(value);
+	}
+
+	// Interned key of name if there is one, else a heap key, so the key table doesn't grow.
+	static DynamicKey MakeKey(const ValueMap::StringView name);
+
+	const Dynamic& GetScalar() const;
+	void CheckType(ValueMap::Type type) const;
+
+	Dynamic m_scalar;
+	PersistentNodePtr m_spNode;
+};
+
+/*! Node of hash array mapped trie, each level consumes 5 bits of 32 bit key hash.
+	Properties which end at this level are in entries, deeper levels in children,
+	the two bitmaps map hash bits to positions. Keys whose hashes are fully equal
+	are kept in a collision node below the last level.
+*/
+class PersistentObjectNode : public PersistentNode
+{
+public:
+	using Entry = std::pair<DynamicKey, PersistentDynamic>;
+
+	static constexpr uint32_t c_bits{ 5 };
+	// Shift above this means all hash bits are consumed and node is a collision node.
+	static constexpr uint32_t c_maxShift{ 30 };
+
+	PersistentObjectNode() noexcept
+		: PersistentNode{ Kind::Object, 0 }, m_dataMap{ 0 }, m_nodeMap{ 0 }
+	{
+	}
+
+	PersistentObjectNode(const PersistentObjectNode& other)
+		: PersistentNode{ Kind::Object, other.m_size }, m_dataMap{ other.m_dataMap }, m_nodeMap{ other.m_nodeMap },
+		m_entries{ other.m_entries }, m_children{ other.m_children }
+	{
+	}
+
+	template<typename TMatch>
+	static const PersistentDynamic* Find(const PersistentObjectNode* pNode, uint32_t hash, TMatch&& match)
+	{
+		for (uint32_t shift = 0; ; shift += c_bits)
+		{
+			if (shift > c_maxShift)
+			{
+				for (const Entry& entry : pNode->m_entries)
+				{
+					if (match(entry.first))
+					{
+						return &entry.second;
+					}
+				}
+				return nullptr;
+			}
+
+			uint32_t bit{ GetBit(hash, shift) };
+			if ((pNode->m_dataMap & bit) != 0)
+			{
+				const Entry& entry{ pNode->m_entries[GetIndex(pNode->m_dataMap, bit)] };
+				return match(entry.first) ? &entry.second : nullptr;
+			}
+			if ((pNode->m_nodeMap & bit) == 0)
+			{
+				return nullptr;
+			}
+			pNode = Cast(pNode->m_children[GetIndex(pNode->m_nodeMap, bit)]);
+		}
+	}
+
+	static PersistentNodePtr Set(const PersistentObjectNode& node, uint32_t shift, const Entry& entry, bool& isAdded)
+	{
+		PersistentObjectNode* pCopy{ new PersistentObjectNode(node) };
+		PersistentNodePtr spCopy{ pCopy };
+		if (shift > c_maxShift)
+		{
+			for (Entry& existing : pCopy->m_entries)
+			{
+				if (existing.first == entry.first)
+				{
+					existing.second = entry.second;
+					return spCopy;
+				}
+			}
+			pCopy->m_entries.push_back(entry);
+			++pCopy->m_size;
+			isAdded = true;
+			return spCopy;
+		}
+
+		uint32_t bit{ GetBit(entry.first.GetHash(), shift) };
+		if ((node.m_dataMap & bit) != 0)
+		{
+			std::size_t index{ GetIndex(node.m_dataMap, bit) };
+			if (node.m_entries[index].first == entry.first)
+			{
+				pCopy->m_entries[index].second = entry.second;
+				return spCopy;
+			}
+
+			// Two keys share hash bits of this level, push both one level down.
+			PersistentNodePtr spChild{ MakePair(node.m_entries[index], entry, shift + c_bits) };
+			pCopy->m_entries.erase(pCopy->m_entries.begin() + static_cast<std::ptrdiff_t>(index));
+			pCopy->m_dataMap &= ~bit;
+			pCopy->m_nodeMap |= bit;
+			pCopy->m_children.insert(pCopy->m_children.begin() + static_cast<std::ptrdiff_t>(GetIndex(pCopy->m_nodeMap, bit)), std::move(spChild));
+			++pCopy->m_size;
+			isAdded = true;
+		}
+		else if ((node.m_nodeMap & bit) != 0)
+		{
+			PersistentNodePtr& spChild{ pCopy->m_children[GetIndex(node.m_nodeMap, bit)] };
+			spChild = Set(*Cast(spChild), shift + c_bits, entry, isAdded);
+			pCopy->m_size += isAdded ? 1 : 0;
+		}
+		else
+		{
+			pCopy->m_dataMap |= bit;
+			pCopy->m_entries.insert(pCopy->m_entries.begin() + static_cast<std::ptrdiff_t>(GetIndex(pCopy->m_dataMap, bit)), entry);
+			++pCopy->m_size;
+			isAdded = true;
+		}
+		return spCopy;
+	}
+
+	// Returns spNode itself if key doesn't exist.
+	static PersistentNodePtr Remove(const PersistentNodePtr& spNode, uint32_t shift, const DynamicKey& key)
+	{
+		const PersistentObjectNode& node{ *Cast(spNode) };
+		if (shift > c_maxShift)
+		{
+			for (std::size_t i = 0; i < node.m_entries.size(); ++i)
+			{
+				if (node.m_entries[i].first == key)
+				{
+					PersistentObjectNode* pCopy{ new PersistentObjectNode(node) };
+					PersistentNodePtr spCopy{ pCopy };
+					pCopy->m_entries.erase(pCopy->m_entries.begin() + static_cast<std::ptrdiff_t>(i));
+					--pCopy->m_size;
+					return spCopy;
+				}
+			}
+			return spNode;
+		}
+
+		uint32_t bit{ GetBit(key.GetHash(), shift) };
+		if ((node.m_dataMap & bit) != 0)
+		{
+			std::size_t index{ GetIndex(node.m_dataMap, bit) };
+			if (node.m_entries[index].first != key)
+			{
+				return spNode;
+			}
+			PersistentObjectNode* pCopy{ new PersistentObjectNode(node) };
+			PersistentNodePtr spCopy{ pCopy };
+			pCopy->m_entries.erase(pCopy->m_entries.begin() + static_cast<std::ptrdiff_t>(index));
+			pCopy->m_dataMap &= ~bit;
+			--pCopy->m_size;
+			return spCopy;
+		}
+		if ((node.m_nodeMap & bit) == 0)
+		{
+			return spNode;
+		}
+
+		std::size_t index{ GetIndex(node.m_nodeMap, bit) };
+		PersistentNodePtr spChild{ Remove(node.m_children[index], shift + c_bits, key) };
+		if (spChild.Get() == node.m_children[index].Get())
+		{
+			return spNode;
+		}
+
+		PersistentObjectNode* pCopy{ new PersistentObjectNode(node) };
+		PersistentNodePtr spCopy{ pCopy };
+		--pCopy->m_size;
+		const PersistentObjectNode& child{ *Cast(spChild) };
+		if (child.m_children.empty() && child.m_entries.size() == 1)
+		{
+			// Last property of child moves up, so trie doesn't keep chains of single entry nodes.
+			pCopy->m_children.erase(pCopy->m_children.begin() + static_cast<std::ptrdiff_t>(index));
+			pCopy->m_nodeMap &= ~bit;
+			pCopy->m_dataMap |= bit;
+			pCopy->m_entries.insert(pCopy->m_entries.begin() + static_cast<std::ptrdiff_t>(GetIndex(pCopy->m_dataMap, bit)), child.m_entries[0]);
+		}
+		else
+		{
+			pCopy->m_children[index] = std::move(spChild);
+		}
+		return spCopy;
+	}
+
+	template<typename TFunc>
+	static void ForEach(const PersistentObjectNode& node, TFunc& func)
+	{
+		for (const Entry& entry : node.m_entries)
+		{
+			func(entry.first, entry.second);
+		}
+		for (const PersistentNodePtr& spChild : node.m_children)
+		{
+			ForEach(*Cast(spChild), func);
+		}
+	}
+
+	static const PersistentObjectNode* Cast(const PersistentNodePtr& spNode) noexcept
+	{
+		return static_cast<const PersistentObjectNode*>(spNode.Get());
+	}
+
+private:
+	static uint32_t GetBit(uint32_t hash, uint32_t shift) noexcept
+	{
+		return 1u << ((hash >> shift) & 31);
+	}
+
+	// Position of bit among set bits of bitmap.
+	static std::size_t GetIndex(uint32_t bitmap, uint32_t bit) noexcept
+	{
+		return Platform::PopCount(static_cast<uint64_t>(bitmap & (bit - 1)));
+	}
+
+	static PersistentNodePtr MakePair(const Entry& first, const Entry& second, uint32_t shift)
+	{
+		PersistentObjectNode* pNode{ new PersistentObjectNode() };
+		PersistentNodePtr spNode{ pNode };
+		pNode->m_size = 2;
+		if (shift > c_maxShift)
+		{
+			pNode->m_entries.push_back(first);
+			pNode->m_entries.push_back(second);
+			return spNode;
+		}
+
+		uint32_t firstBit{ GetBit(first.first.GetHash(), shift) };
+		uint32_t secondBit{ GetBit(second.first.GetHash(), shift) };
+		if (firstBit == secondBit)
+		{
+			pNode->m_nodeMap = firstBit;
+			pNode->m_children.push_back(MakePair(first, second, shift + c_bits));
+		}
+		else
+		{
+			pNode->m_dataMap = firstBit | secondBit;
+			pNode->m_entries.push_back(firstBit < secondBit ? first : second);
+			pNode->m_entries.push_back(firstBit < secondBit ? second : first);
+		}
+		return spNode;
+	}
+
+	uint32_t m_dataMap;
+	uint32_t m_nodeMap;
+	std::vector<Entry> m_entries;
+	std::vector<PersistentNodePtr> m_children;
+};
+
+/*! Node of radix vector, leaves hold 32 elements and branches 32 children.
+	Tree is always filled from the left, so its height follows from the size alone.
+*/
+class PersistentArrayNode : public PersistentNode
+{
+public:
+	static constexpr uint32_t c_bits{ 5 };
+	static constexpr std::size_t c_width{ std::size_t{ 1 } << c_bits };
+	static constexpr std::size_t c_mask{ c_width - 1 };
+
+	PersistentArrayNode() noexcept
+		: PersistentNode{ Kind::Array, 0 }
+	{
+	}
+
+	PersistentArrayNode(const PersistentArrayNode& other)
+		: PersistentNode{ Kind::Array, other.m_size }, m_values{ other.m_values }, m_children{ other.m_children }
+	{
+	}
+
+	// Shift of root level for array of size elements.
+	static uint32_t GetRootShift(std::size_t size) noexcept
+	{
+		uint32_t shift{ 0 };
+		while (size > 0 && ((size - 1) >> shift) >= c_width)
+		{
+			shift += c_bits;
+		}
+		return shift;
+	}
+
+	static const PersistentDynamic& Get(const PersistentArrayNode* pRoot, std::size_t index) noexcept
+	{
+		const PersistentArrayNode* pNode{ pRoot };
+		for (uint32_t shift = GetRootShift(pRoot->m_size); shift > 0; shift -= c_bits)
+		{
+			pNode = Cast(pNode->m_children[(index >> shift) & c_mask]);
+		}
+		return pNode->m_values[index & c_mask];
+	}
+
+	static PersistentNodePtr Set(const PersistentArrayNode& node, uint32_t shift, std::size_t index, const PersistentDynamic& value)
+	{
+		PersistentArrayNode* pCopy{ new PersistentArrayNode(node) };
+		PersistentNodePtr spCopy{ pCopy };
+		if (shift == 0)
+		{
+			pCopy->m_values[index & c_mask] = value;
+		}
+		else
+		{
+			PersistentNodePtr& spChild{ pCopy->m_children[(index >> shift) & c_mask] };
+			spChild = Set(*Cast(spChild), shift - c_bits, index, value);
+		}
+		return spCopy;
+	}
+
+	// Append element at index, pNode is nullptr when the path doesn't exist yet.
+	static PersistentNodePtr Push(const PersistentArrayNode* pNode, uint32_t shift, std::size_t index, const PersistentDynamic& value)
+	{
+		PersistentArrayNode* pCopy{ pNode != nullptr ? new PersistentArrayNode(*pNode) : new PersistentArrayNode() };
+		PersistentNodePtr spCopy{ pCopy };
+		++pCopy->m_size;
+		if (shift == 0)
+		{
+			pCopy->m_values.push_back(value);
+			return spCopy;
+		}
+
+		std::size_t slot{ (index >> shift) & c_mask };
+		if (slot < pCopy->m_children.size())
+		{
+			pCopy->m_children[slot] = Push(Cast(pCopy->m_children[slot]), shift - c_bits, index, value);
+		}
+		else
+		{
+			pCopy->m_children.push_back(Push(nullptr, shift - c_bits, index, value));
+		}
+		return spCopy;
+	}
+
+	// Remove last element at index, returns empty pointer if node becomes empty.
+	static PersistentNodePtr Pop(const PersistentArrayNode& node, uint32_t shift, std::size_t index)
+	{
+		if (node.m_size == 1)
+		{
+			return PersistentNodePtr();
+		}
+
+		PersistentArrayNode* pCopy{ new PersistentArrayNode(node) };
+		PersistentNodePtr spCopy{ pCopy };
+		--pCopy->m_size;
+		if (shift == 0)
+		{
+			pCopy->m_values.pop_back();
+			return spCopy;
+		}
+
+		PersistentNodePtr spChild{ Pop(*Cast(pCopy->m_children.back()), shift - c_bits, index) };
+		if (spChild)
+		{
+			pCopy->m_children.back() = std::move(spChild);
+		}
+		else
+		{
+			pCopy->m_children.pop_back();
+		}
+		return spCopy;
+	}
+
+	// Build leaves bottom up, same shape as pushing elements one by one.
+	static PersistentNodePtr Build(std::vector<PersistentDynamic>&& values)
+	{
+		std::vector<PersistentNodePtr> level;
+		for (std::size_t begin = 0; begin < values.size(); begin += c_width)
+		{
+			PersistentArrayNode* pLeaf{ new PersistentArrayNode() };
+			level.emplace_back(pLeaf);
+			std::size_t end{ std::min(begin + c_width, values.size()) };
+			pLeaf->m_values.assign(std::make_move_iterator(values.begin() + static_cast<std::ptrdiff_t>(begin)),
+				std::make_move_iterator(values.begin() + static_cast<std::ptrdiff_t>(end)));
+			pLeaf->m_size = end - begin;
+		}
+		if (level.empty())
+		{
+			return PersistentNodePtr(new PersistentArrayNode());
+		}
+
+		while (level.size() > 1)
+		{
+			std::vector<PersistentNodePtr> parents;
+			for (std::size_t begin = 0; begin < level.size(); begin += c_width)
+			{
+				PersistentArrayNode* pBranch{ new PersistentArrayNode() };
+				parents.emplace_back(pBranch);
+				std::size_t end{ std::min(begin + c_width, level.size()) };
+				for (std::size_t i = begin; i < end; ++i)
+				{
+					pBranch->m_size += level[i].Get()->GetSize();
+					pBranch->m_children.push_back(std::move(level[i]));
+				}
+			}
+			level.swap(parents);
+		}
+		return level[0];
+	}
+
+	template<typename TFunc>
+	static void ForEach(const PersistentArrayNode& node, TFunc& func)
+	{
+		for (const PersistentDynamic& value : node.m_values)
+		{
+			func(value);
+		}
+		for (const PersistentNodePtr& spChild : node.m_children)
+		{
+			ForEach(*Cast(spChild), func);
+		}
+	}
+
+	static const PersistentArrayNode* Cast(const PersistentNodePtr& spNode) noexcept
+	{
+		return static_cast<const PersistentArrayNode*>(spNode.Get());
+	}
+
+	// Full root becomes first child of a new root, element at index goes to a new path beside it.
+	static PersistentNodePtr Grow(const PersistentNodePtr& spRoot, uint32_t shift, std::size_t index, const PersistentDynamic& value)
+	{
+		PersistentArrayNode* pRoot{ new PersistentArrayNode() };
+		PersistentNodePtr spNewRoot{ pRoot };
+		pRoot->m_size = index + 1;
+		pRoot->m_children.push_back(spRoot);
+		pRoot->m_children.push_back(Push(nullptr, shift, index, value));
+		return spNewRoot;
+	}
+
+	// Only child of root, used when array shrinks by a level.
+	const PersistentNodePtr& GetFirstChild() const noexcept
+	{
+		return m_children.front();
+	}
+
+private:
+	std::vector<PersistentDynamic> m_values;
+	std::vector<PersistentNodePtr> m_children;
+};
+
+/*! Published version of a PersistentDynamic shared between threads.
+	Load never blocks and never waits for writers: it only increments and decrements a reader count.
+	Store and Update are serialized among writers, and a writer frees the replaced version only
+	after all readers which might still be copying it have left, so readers never see freed memory.
+	Destructor doesn't wait for readers, it must not run while any thread may still call Load.
+	Usage:
+		AtomicPersistentDynamic config{ PersistentDynamic::FromDynamic(document) };
+		// Reader threads
+		PersistentDynamic current = config.Load();
+		// Writer thread
+		config.Update([](const PersistentDynamic& current) { return current.Set("timeout", 30); });
+*/
+class AtomicPersistentDynamic
+{
+public:
+	explicit AtomicPersistentDynamic(PersistentDynamic value = PersistentDynamic())
+		: m_epoch{ 0 }, m_pCurrent{ new PersistentDynamic(std::move(value)) }
+	{
+	}
+
+	AtomicPersistentDynamic(const AtomicPersistentDynamic&) = delete;
+	AtomicPersistentDynamic& operator=(const AtomicPersistentDynamic&) = delete;
+
+	// Notice: no reader may be inside Load when destructed.
+	~AtomicPersistentDynamic()
+	{
+		delete m_pCurrent.load();
+	}
+
+	PersistentDynamic Load() const
+	{
+		std::atomic<uint32_t>& readerCount{ m_readerCounts[m_epoch.load() & 1].count };
+		readerCount.fetch_add(1);
+		PersistentDynamic value = *m_pCurrent.load();
+		readerCount.fetch_sub(1, std::memory_order_release);
+		return value;
+	}
+
+	void Store(PersistentDynamic value)
+	{
+		std::unique_lock<std::mutex> lock{ m_writerMutex };
+		Publish(new PersistentDynamic(std::move(value)));
+	}
+
+	// Publish func(current), no other writer can publish in between. Returns the published version.
+	template<typename TFunc>
+	PersistentDynamic Update(TFunc&& func)
+	{
+		std::unique_lock<std::mutex> lock{ m_writerMutex };
+		PersistentDynamic value = func(*m_pCurrent.load());
+		Publish(new PersistentDynamic(value));
+		return value;
+	}
+
+private:
+	// Counts on separate cache lines, so readers of one epoch don't slow down the other.
+	struct alignas(64) ReaderCount
+	{
+		std::atomic<uint32_t> count{ 0 };
+	};
+
+	void Publish(PersistentDynamic* pValue)
+	{
+		PersistentDynamic* pPrevious{ m_pCurrent.exchange(pValue) };
+		/*  A reader which may still copy pPrevious has incremented a count before it loaded the pointer.
+			Flip epoch so new readers use the other count, wait until the old count drains, and do it
+			for both counts, because a reader may have read the epoch long before it incremented.
+			Count is loaded seq_cst: with acquire it could be read before the exchange is visible,
+			and miss a reader which incremented and then loaded the previous pointer.
+		*/
+		for (int i = 0; i < 2; ++i)
+		{
+			uint32_t epoch{ m_epoch.fetch_add(1) };
+			const std::atomic<uint32_t>& readerCount{ m_readerCounts[epoch & 1].count };
+			while (readerCount.load(std::memory_order_seq_cst) != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+		delete pPrevious;
+	}
+
+	mutable ReaderCount m_readerCounts[2];
+	std::atomic<uint32_t> m_epoch;
+	std::atomic<PersistentDynamic*> m_pCurrent;
+	std::mutex m_writerMutex;
+};
+
+inline PersistentDynamic::PersistentDynamic(const ValueMap::Bool boolValue)
+	: m_scalar(MakeScalar(boolValue))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(const ValueMap::Int32 int32Value)
+	: m_scalar(MakeScalar(int32Value))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(const ValueMap::Int64 int64Value)
+	: m_scalar(MakeScalar(int64Value))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(const ValueMap::Double doubleValue)
+	: m_scalar(MakeScalar(doubleValue))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(const char* charValue)
+	: m_scalar(MakeScalar(ValueMap::StringView{ charValue }))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(const ValueMap::String& stringValue)
+	: m_scalar(MakeScalar(ValueMap::StringView{ stringValue }))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(const ValueMap::StringView stringValue)
+	: m_scalar(MakeScalar(stringValue))
+{
+}
+
+inline PersistentDynamic::PersistentDynamic(Dynamic scalar, PersistentNodePtr spNode) noexcept
+	: m_scalar(std::move(scalar)), m_spNode(std::move(spNode))
+{
+}
+
+inline PersistentDynamic PersistentDynamic::MakeObject()
+{
+	return PersistentDynamic(Dynamic(), PersistentNodePtr(new PersistentObjectNode()));
+}
+
+inline PersistentDynamic PersistentDynamic::MakeArray()
+{
+	return PersistentDynamic(Dynamic(), PersistentNodePtr(new PersistentArrayNode()));
+}
+
+inline PersistentDynamic PersistentDynamic::FromDynamic(const Dynamic& value)
+{
+	switch (value.GetType())
+	{
+		case ValueMap::Type::Object:
+		{
+			PersistentDynamic result = MakeObject();
+			for (const auto& entry : value.GetObjectMap())
+			{
+				// Key which is not interned may be in arena of value.
+				const DynamicKey& key{ entry.first };
+				result = result.Set(key.IsInterned() ? key : MakeKey(key.GetName()), FromDynamic(entry.second));
+			}
+			return result;
+		}
+		case ValueMap::Type::Array:
+		{
+			std::vector<PersistentDynamic> values;
+			values.reserve(value.GetArray().size());
+			for (const Dynamic& element : value.GetArray())
+			{
+				values.push_back(FromDynamic(element));
+			}
+			return PersistentDynamic(Dynamic(), PersistentArrayNode::Build(std::move(values)));
+		}
+		case ValueMap::Type::Bool:
+			return PersistentDynamic(value.GetBool());
+		case ValueMap::Type::Int32:
+			return PersistentDynamic(value.GetInt32());
+		case ValueMap::Type::Int64:
+			return PersistentDynamic(value.GetInt64());
+		case ValueMap::Type::Double:
+			return PersistentDynamic(value.GetDouble());
+		case ValueMap::Type::String:
+			return PersistentDynamic(value.GetString());
+		default:
+			return PersistentDynamic();
+	}
+}
+
+inline Dynamic PersistentDynamic::ToDynamic() const
+{
+	switch (GetType())
+	{
+		case ValueMap::Type::Object:
+		{
+			Dynamic result = Dynamic::MakeObject();
+			ForEachProperty([&result](const DynamicKey& key, const PersistentDynamic& value)
+			{
+				result.SetObject(key, value.ToDynamic());
+			});
+			return result;
+		}
+		case ValueMap::Type::Array:
+		{
+			ValueMap::Array array;
+			array.reserve(Size());
+			ForEachElement([&array](const PersistentDynamic& value)
+			{
+				array.push_back(value.ToDynamic());
+			});
+			return Dynamic(std::move(array));
+		}
+		default:
+			return m_scalar;
+	}
+}
+
+inline ValueMap::Type PersistentDynamic::GetType() const noexcept
+{
+	if (m_spNode)
+	{
+		return m_spNode.Get()->GetKind() == PersistentNode::Kind::Object ? ValueMap::Type::Object : ValueMap::Type::Array;
+	}
+	return m_scalar.GetType();
+}
+
+inline DynamicKey PersistentDynamic::MakeKey(const ValueMap::StringView name)
+{
+	uint32_t hash{ Hash::HashString(name.data(), name.size()) };
+	DynamicKey key{ DynamicKeyTable::GetInstance().Find(name.data(), name.size(), hash) };
+	if (!key.IsEmpty())
+	{
+		return key;
+	}
+	SharedScalarScope scope;
+	return DynamicKeyTable::CreateUninterned(name.data(), name.size(), hash);
+}
+
+inline const Dynamic& PersistentDynamic::GetScalar() const
+{
+	if (m_spNode || m_scalar.GetType() == ValueMap::Type::Null)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+	return m_scalar;
+}
+
+inline void PersistentDynamic::CheckType(ValueMap::Type type) const
+{
+	if (GetType() != type)
+	{
+		Error::ThrowAcessDeniedErrorException();
+	}
+}
+
+inline ValueMap::Bool PersistentDynamic::GetBool() const
+{
+	return GetScalar().GetBool();
+}
+
+inline ValueMap::Int32 PersistentDynamic::GetInt32() const
+{
+	return GetScalar().GetInt32();
+}
+
+inline ValueMap::Int64 PersistentDynamic::GetInt64() const
+{
+	return GetScalar().GetInt64();
+}
+
+inline ValueMap::Double PersistentDynamic::GetDouble() const
+{
+	return GetScalar().GetDouble();
+}
+
+inline ValueMap::StringView PersistentDynamic::GetString() const
+{
+	return GetScalar().GetString();
+}
+
+inline std::size_t PersistentDynamic::Size() const noexcept
+{
+	return m_spNode ? m_spNode.Get()->GetSize() : 0;
+}
+
+inline const PersistentDynamic* PersistentDynamic::Find(const DynamicKey& propertyKey) const
+{
+	CheckType(ValueMap::Type::Object);
+	return PersistentObjectNode::Find(PersistentObjectNode::Cast(m_spNode), propertyKey.GetHash(),
+		[&propertyKey](const DynamicKey& key) { return key == propertyKey; });
+}
+
+inline const PersistentDynamic* PersistentDynamic::Find(const ValueMap::String& propertyName) const
+{
+	CheckType(ValueMap::Type::Object);
+	return PersistentObjectNode::Find(PersistentObjectNode::Cast(m_spNode), Hash::HashString(propertyName.data(), propertyName.size()),
+		[&propertyName](const DynamicKey& key) { return key.GetName() == propertyName; });
+}
+
+inline const PersistentDynamic& PersistentDynamic::operator[](const DynamicKey& propertyKey) const
+{
+	static const PersistentDynamic nullValue;
+	const PersistentDynamic* pValue{ Find(propertyKey) };
+	return pValue != nullptr ? *pValue : nullValue;
+}
+
+inline const PersistentDynamic& PersistentDynamic::operator[](const ValueMap::String& propertyName) const
+{
+	static const PersistentDynamic nullValue;
+	const PersistentDynamic* pValue{ Find(propertyName) };
+	return pValue != nullptr ? *pValue : nullValue;
+}
+
+inline const PersistentDynamic& PersistentDynamic::operator[](const std::size_t index) const
+{
+	static const PersistentDynamic nullValue;
+	CheckType(ValueMap::Type::Array);
+	if (index >= Size())
+	{
+		return nullValue;
+	}
+	return PersistentArrayNode::Get(PersistentArrayNode::Cast(m_spNode), index);
+}
+
+inline PersistentDynamic PersistentDynamic::Set(const DynamicKey& propertyKey, const PersistentDynamic& value) const
+{
+	CheckType(ValueMap::Type::Object);
+	bool isAdded{ false };
+	PersistentObjectNode::Entry entry{ propertyKey, value };
+	return PersistentDynamic(Dynamic(), PersistentObjectNode::Set(*PersistentObjectNode::Cast(m_spNode), 0, entry, isAdded));
+}
+
+inline PersistentDynamic PersistentDynamic::Set(const ValueMap::String& propertyName, const PersistentDynamic& value) const
+{
+	return Set(MakeKey(propertyName), value);
+}
+
+inline PersistentDynamic PersistentDynamic::Remove(const DynamicKey& propertyKey) const
+{
+	CheckType(ValueMap::Type::Object);
+	return PersistentDynamic(Dynamic(), PersistentObjectNode::Remove(m_spNode, 0, propertyKey));
+}
+
+inline PersistentDynamic PersistentDynamic::Remove(const ValueMap::String& propertyName) const
+{
+	return Remove(MakeKey(propertyName));
+}
+
+inline PersistentDynamic PersistentDynamic::Set(const std::size_t index, const PersistentDynamic& value) const
+{
+	CheckType(ValueMap::Type::Array);
+	if (index >= Size())
+	{
+		Error::ThrowUnexpectOperationErrorException();
+	}
+	const PersistentArrayNode& root{ *PersistentArrayNode::Cast(m_spNode) };
+	return PersistentDynamic(Dynamic(), PersistentArrayNode::Set(root, PersistentArrayNode::GetRootShift(Size()), index, value));
+}
+
+inline PersistentDynamic PersistentDynamic::PushBack(const PersistentDynamic& value) const
+{
+	CheckType(ValueMap::Type::Array);
+	std::size_t size{ Size() };
+	uint32_t shift{ PersistentArrayNode::GetRootShift(size) };
+	if (PersistentArrayNode::GetRootShift(size + 1) == shift)
+	{
+		return PersistentDynamic(Dynamic(), PersistentArrayNode::Push(PersistentArrayNode::Cast(m_spNode), shift, size, value));
+	}
+
+	return PersistentDynamic(Dynamic(), PersistentArrayNode::Grow(m_spNode, shift, size, value));
+}
+
+inline PersistentDynamic PersistentDynamic::PopBack() const
+{
+	CheckType(ValueMap::Type::Array);
+	std::size_t size{ Size() };
+	if (size == 0)
+	{
+		Error::ThrowUnexpectOperationErrorException();
+	}
+	if (size == 1)
+	{
+		return MakeArray();
+	}
+
+	uint32_t shift{ PersistentArrayNode::GetRootShift(size) };
+	PersistentNodePtr spRoot{ PersistentArrayNode::Pop(*PersistentArrayNode::Cast(m_spNode), shift, size - 1) };
+	if (PersistentArrayNode::GetRootShift(size - 1) < shift)
+	{
+		PersistentNodePtr spChild{ PersistentArrayNode::Cast(spRoot)->GetFirstChild() };
+		return PersistentDynamic(Dynamic(), std::move(spChild));
+	}
+	return PersistentDynamic(Dynamic(), std::move(spRoot));
+}
+
+template<typename TFunc>
+inline void PersistentDynamic::ForEachProperty(TFunc&& func) const
+{
+	CheckType(ValueMap::Type::Object);
+	PersistentObjectNode::ForEach(*PersistentObjectNode::Cast(m_spNode), func);
+}
+
+template<typename TFunc>
+inline void PersistentDynamic::ForEachElement(TFunc&& func) const
+{
+	CheckType(ValueMap::Type::Array);
+	PersistentArrayNode::ForEach(*PersistentArrayNode::Cast(m_spNode), func);
+}
+
+inline bool PersistentDynamic::IsSameNode(const PersistentDynamic& other) const noexcept
+{
+	return m_spNode.Get() == other.m_spNode.Get() && m_scalar.IsSameNode(other.m_scalar);
+}
+
+}}
+
+#endif
@@ -0,0 +1,272 @@
+#include "CommonTest.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PersistentDynamic.h"
+
+namespace Zest { namespace Lib {
+
+TEST(PersistentDynamicTest, Object_SetAndRemove_OldVersionsUnchanged)
+{
+	PersistentDynamic empty = PersistentDynamic::MakeObject();
+	PersistentDynamic object = empty;
+	for (int i = 0; i < 5000; ++i)
+	{
+		object = object.Set("key" + std::to_string(i), i);
+	}
+	PersistentDynamic full = object;
+	for (int i = 0; i < 5000; i += 2)
+	{
+		object = object.Remove("key" + std::to_string(i));
+	}
+	PersistentDynamic replaced = object.Set("key1", "one");
+
+	EXPECT_EQ(empty.Size(), 0u);
+	ASSERT_EQ(full.Size(), 5000u);
+	EXPECT_EQ(object.Size(), 2500u);
+	for (int i = 0; i < 5000; ++i)
+	{
+		std::string name{ "key" + std::to_string(i) };
+		ASSERT_NE(full.Find(name), nullptr);
+		EXPECT_EQ(full[name].GetInt32(), i);
+		EXPECT_EQ(object.Find(DynamicKey{ name }) != nullptr, i % 2 == 1);
+	}
+	EXPECT_EQ(object["key1"].GetInt32(), 1);
+	EXPECT_EQ(replaced["key1"].GetString(), "one");
+	EXPECT_EQ(replaced.Size(), 2500u);
+	EXPECT_EQ(full["missing"].GetType(), ValueMap::Type::Null);
+	EXPECT_TRUE(object.Remove("missing").IsSameNode(object));
+
+	std::size_t count{ 0 };
+	object.ForEachProperty([&count](const DynamicKey&, const PersistentDynamic&) { ++count; });
+	EXPECT_EQ(count, 2500u);
+	EXPECT_THROW(object.PushBack(1), Error::Exception);
+}
+
+TEST(PersistentDynamicTest, FromDynamic_ArenaKeys_OutliveArena)
+{
+	PersistentDynamic persistent;
+	{
+		DynamicArena arena;
+		ScopedDynamicArena scope{ arena };
+		DynamicKeyCache keyCache;
+		Dynamic document = Dynamic::MakeObject();
+		document.SetObject(keyCache.Get("arena name", 10), Dynamic(1));
+		document.SetObject(DynamicKey{ "id" }, Dynamic(2));
+		persistent = PersistentDynamic::FromDynamic(document);
+	}
+	std::string names;
+	persistent.ForEachProperty([&names](const DynamicKey& key, const PersistentDynamic&) { names += key.GetName() + ";"; });
+	EXPECT_TRUE(names == "arena name;id;" || names == "id;arena name;");
+	EXPECT_EQ(persistent["arena name"].GetInt32(), 1);
+	EXPECT_EQ(persistent["id"].GetInt32(), 2);
+
+	std::size_t tableSize{ DynamicKeyTable::GetInstance().Size() };
+	PersistentDynamic updated = persistent.Set("persistent only name", 3).Remove("arena name");
+	EXPECT_EQ(DynamicKeyTable::GetInstance().Size(), tableSize);
+	EXPECT_EQ(updated["persistent only name"].GetInt32(), 3);
+	EXPECT_EQ(updated.Find("arena name"), nullptr);
+	EXPECT_EQ(updated.Size(), 2u);
+}
+
+TEST(PersistentDynamicTest, Array_PushSetPop_StructuralSharing)
+{
+	PersistentDynamic array = PersistentDynamic::MakeArray();
+	std::vector<PersistentDynamic> versions;
+	for (int i = 0; i < 1100; ++i)
+	{
+		versions.push_back(array);
+		array = array.PushBack(i);
+	}
+	ASSERT_EQ(array.Size(), 1100u);
+	for (int i = 0; i < 1100; ++i)
+	{
+		EXPECT_EQ(array[i].GetInt32(), i);
+	}
+	EXPECT_EQ(versions[33].Size(), 33u);
+	EXPECT_EQ(versions[33][32].GetInt32(), 32);
+	EXPECT_EQ(array[1100].GetType(), ValueMap::Type::Null);
+
+	PersistentDynamic changed = array.Set(1030, "changed");
+	EXPECT_EQ(changed[1030].GetString(), "changed");
+	EXPECT_EQ(array[1030].GetInt32(), 1030);
+	EXPECT_THROW(array.Set(1100, 0), Error::Exception);
+
+	PersistentDynamic popped = array;
+	for (int i = 1100; i > 0; --i)
+	{
+		popped = popped.PopBack();
+		ASSERT_EQ(popped.Size(), static_cast<std::size_t>(i - 1));
+		if (i > 1)
+		{
+			EXPECT_EQ(popped[i - 2].GetInt32(), i - 2);
+		}
+	}
+	EXPECT_THROW(popped.PopBack(), Error::Exception);
+
+	Dynamic document{
+		Property{ "name", "zest" },
+		Property{ "values", Dynamic{ 1, 2.5, true, Dynamic(), "text" } },
+		Property{ "nested", Dynamic{ Property{ "empty", Dynamic::MakeObject() } } }
+	};
+	PersistentDynamic persistent = PersistentDynamic::FromDynamic(document);
+	EXPECT_EQ(persistent["values"][4].GetString(), "text");
+	EXPECT_TRUE(persistent.ToDynamic() == document);
+}
+
+TEST(PersistentDynamicTest, Atomic_ConcurrentReadersAndWriter_ReadersSeeWholeVersions)
+{
+	AtomicPersistentDynamic published{ PersistentDynamic::MakeObject().Set("first", 0).Set("second", 0) };
+	const int c_versionCount{ 2000 };
+
+	std::vector<std::thread> readers;
+	std::atomic<bool> isDone{ false };
+	std::atomic<int> tornCount{ 0 };
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.emplace_back([&]()
+		{
+			while (!isDone.load())
+			{
+				PersistentDynamic current = published.Load();
+				if (current["first"].GetInt32() != current["second"].GetInt32())
+				{
+					++tornCount;
+				}
+			}
+		});
+	}
+
+	for (int i = 1; i <= c_versionCount; ++i)
+	{
+		published.Update([i](const PersistentDynamic& current)
+		{
+			return current.Set("first", i).Set("second", i);
+		});
+	}
+	isDone = true;
+	for (std::thread& reader : readers)
+	{
+		reader.join();
+	}
+
+	EXPECT_EQ(tornCount.load(), 0);
+	EXPECT_EQ(published.Load()["second"].GetInt32(), c_versionCount);
+	published.Store(PersistentDynamic(1.5));
+	EXPECT_EQ(published.Load().GetDouble(), 1.5);
+}
+TEST(PersistentDynamicTest, Object_HashCollisions_KeptApart)
+{
+	// Keys with fully equal hashes end in a collision node, keys differing only in the top bits in its neighbors.
+	const uint32_t c_hash{ 0x12345678 };
+	std::vector<DynamicKey> keys;
+	for (int i = 0; i < 6; ++i)
+	{
+		std::string name{ "collide" + std::to_string(i) };
+		keys.push_back(DynamicKeyTable::CreateUninterned(name.data(), name.size(), c_hash));
+	}
+	for (uint32_t topBits = 1; topBits < 4; ++topBits)
+	{
+		std::string name{ "top" + std::to_string(topBits) };
+		keys.push_back(DynamicKeyTable::CreateUninterned(name.data(), name.size(), c_hash ^ (topBits << 30)));
+	}
+
+	PersistentDynamic object = PersistentDynamic::MakeObject();
+	std::vector<PersistentDynamic> versions;
+	for (std::size_t i = 0; i < keys.size(); ++i)
+	{
+		versions.push_back(object);
+		object = object.Set(keys[i], static_cast<int>(i));
+	}
+	ASSERT_EQ(object.Size(), keys.size());
+	for (std::size_t i = 0; i < keys.size(); ++i)
+	{
+		ASSERT_NE(object.Find(keys[i]), nullptr);
+		EXPECT_EQ(object[keys[i]].GetInt32(), static_cast<int>(i));
+		EXPECT_EQ(versions[i].Size(), i);
+		EXPECT_EQ(versions[i].Find(keys[i]), nullptr);
+	}
+	std::string other{ "collide9" };
+	EXPECT_EQ(object.Find(DynamicKeyTable::CreateUninterned(other.data(), other.size(), c_hash)), nullptr);
+
+	PersistentDynamic replaced = object.Set(keys[2], "two");
+	EXPECT_EQ(replaced.Size(), keys.size());
+	EXPECT_EQ(replaced[keys[2]].GetString(), "two");
+	EXPECT_EQ(object[keys[2]].GetInt32(), 2);
+
+	PersistentDynamic removed = object;
+	for (std::size_t i = 0; i < keys.size(); i += 2)
+	{
+		removed = removed.Remove(keys[i]);
+	}
+	EXPECT_EQ(removed.Size(), keys.size() / 2);
+	for (std::size_t i = 0; i < keys.size(); ++i)
+	{
+		EXPECT_EQ(removed.Find(keys[i]) != nullptr, i % 2 == 1);
+		EXPECT_NE(object.Find(keys[i]), nullptr);
+	}
+	for (std::size_t i = 1; i < keys.size(); i += 2)
+	{
+		removed = removed.Remove(keys[i]);
+	}
+	EXPECT_EQ(removed.Size(), 0u);
+}
+
+TEST(PersistentDynamicTest, Atomic_ConcurrentWritersAndReaders_NoUpdateLost)
+{
+	AtomicPersistentDynamic published{ PersistentDynamic::MakeObject().Set("count", 0) };
+	const int c_writerCount{ 3 };
+	const int c_updateCount{ 1000 };
+
+	std::atomic<bool> isDone{ false };
+	std::atomic<int> backwardCount{ 0 };
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 3; ++i)
+	{
+		readers.emplace_back([&]()
+		{
+			int last{ 0 };
+			while (!isDone.load())
+			{
+				int count{ published.Load()["count"].GetInt32() };
+				if (count < last)
+				{
+					++backwardCount;
+				}
+				last = count;
+			}
+		});
+	}
+
+	std::vector<std::thread> writers;
+	for (int i = 0; i < c_writerCount; ++i)
+	{
+		writers.emplace_back([&published, i]()
+		{
+			for (int j = 0; j < c_updateCount; ++j)
+			{
+				published.Update([i](const PersistentDynamic& current)
+				{
+					return current.Set("count", current["count"].GetInt32() + 1).Set("writer", i);
+				});
+			}
+		});
+	}
+	for (std::thread& writer : writers)
+	{
+		writer.join();
+	}
+	isDone = true;
+	for (std::thread& reader : readers)
+	{
+		reader.join();
+	}
+
+	EXPECT_EQ(backwardCount.load(), 0);
+	EXPECT_EQ(published.Load()["count"].GetInt32(), c_writerCount * c_updateCount);
+}
+
+}}
@@ -0,0 +1,142 @@
+#pragma once
+#ifndef ZEST_LIB_PLATFORM_H
+#define ZEST_LIB_PLATFORM_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SIMD instruction sets which are enabled at compile time, define ZEST_LIB_NO_SIMD to use scalar code only.
+#if !defined(ZEST_LIB_NO_SIMD)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZEST_LIB_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define ZEST_LIB_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__PCLMUL__) && (defined(__x86_64__) || defined(_M_X64))
+#define ZEST_LIB_PCLMUL
+#include <wmmintrin.h>
+#endif
+
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ZEST_LIB_BIG_ENDIAN
+#endif
+
+namespace Zest { namespace Lib { namespace Platform {
+
+// Index of lowest set bit, value must not be 0.
+inline uint32_t CountTrailingZeros(uint32_t value) noexcept
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+// Index of lowest set bit, value must not be 0.
+inline uint32_t CountTrailingZeros(uint64_t value) noexcept
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+	uint32_t low{ static_cast<uint32_t>(value) };
+	return low != 0 ? CountTrailingZeros(low) : 32 + CountTrailingZeros(static_cast<uint32_t>(value >> 32));
+#else
+	return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+// Count of zero bits above highest set bit, value must not be 0.
+inline uint32_t CountLeadingZeros(uint64_t value) noexcept
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return 63 - static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	uint32_t high{ static_cast<uint32_t>(value >> 32) };
+	if (high != 0)
+	{
+		_BitScanReverse(&index, high);
+		return 31 - static_cast<uint32_t>(index);
+	}
+	_BitScanReverse(&index, static_cast<uint32_t>(value));
+	return 63 - static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+inline uint32_t PopCount(uint64_t value) noexcept
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<uint32_t>(__popcnt64(value));
+#elif defined(_MSC_VER)
+	return static_cast<uint32_t>(__popcnt(static_cast<uint32_t>(value)) + __popcnt(static_cast<uint32_t>(value >> 32)));
+#else
+	return static_cast<uint32_t>(__builtin_popcountll(value));
+#endif
+}
+
+// Full 128 bit product of 64 bit values, returns high half and stores low half.
+inline uint64_t MultiplyHigh(uint64_t left, uint64_t right, uint64_t& low) noexcept
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	uint64_t high;
+	low = _umul128(left, right, &high);
+	return high;
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 product{ static_cast<unsigned __int128>(left) * right };
+	low = static_cast<uint64_t>(product);
+	return static_cast<uint64_t>(product >> 64);
+#else
+	uint64_t leftLow{ left & 0xFFFFFFFF };
+	uint64_t leftHigh{ left >> 32 };
+	uint64_t rightLow{ right & 0xFFFFFFFF };
+	uint64_t rightHigh{ right >> 32 };
+	uint64_t lowLow{ leftLow * rightLow };
+	uint64_t highLow{ leftHigh * rightLow };
+	uint64_t lowHigh{ leftLow * rightHigh };
+	uint64_t middle{ (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh };
+	low = (middle << 32) | (lowLow & 0xFFFFFFFF);
+	return leftHigh * rightHigh + (highLow >> 32) + (middle >> 32);
+#endif
+}
+
+// Bit i of result is xor of bits 0..i of value.
+inline uint64_t PrefixXor(uint64_t value) noexcept
+{
+#if defined(ZEST_LIB_PCLMUL)
+	// Carry-less multiplication by all ones computes every prefix at once.
+	__m128i product{ _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(value)), _mm_set1_epi8(-1), 0) };
+	return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+#else
+	value ^= value << 1;
+	value ^= value << 2;
+	value ^= value << 4;
+	value ^= value << 8;
+	value ^= value << 16;
+	value ^= value << 32;
+	return value;
+#endif
+}
+
+}}}
+
+#endif
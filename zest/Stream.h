@@ -2,15 +2,125 @@
 #ifndef ZEST_LIB_STREAM_H
 #define ZEST_LIB_STREAM_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
 #include <vector>
 #include "Encoding.h"
+#include "Error.h"
 
 namespace Zest { namespace Lib {
 
 #define DEFAULT_READ_SIZE 4096
 
+/*! Byte stream, a source implements Read, a sink implements Write.
+	The other operation throws UnexpectOperationError.
+*/
 struct IStream
 {
+	virtual ~IStream() = default;
+
+	// Read at most size bytes into pBuffer, returns count of bytes read, 0 at end of stream.
+	virtual std::size_t Read(char*, std::size_t)
+	{
+		Error::ThrowUnexpectOperationErrorException();
+	}
+
+	// Write all size bytes of pBuffer.
+	virtual void Write(const char*, std::size_t)
+	{
+		Error::ThrowUnexpectOperationErrorException();
+	}
+};
+
+/*! Source which reads text of another source as UTF-8, e.g. UTF-16 files of Windows tools
+	given to JsonReader. Encoding is given, or detected from the byte order mark or the zero
+	bytes of the first character, see Encoding::DetectType. A byte order mark is not passed on.
+	Source is read a buffer at a time and converted with Encoding::Transcode, a character cut by
+	the end of a buffer is kept for the next one. Throws MalFormatError for invalid text.
+*/
+class TranscodeStream: public IStream
+{
+public:
+	explicit TranscodeStream(IStream& source, std::size_t bufferSize = DEFAULT_READ_SIZE)
+		: m_source{ source }, m_bufferSize{ std::max<std::size_t>(bufferSize, Encoding::c_maxUtf8Length) }
+	{
+	}
+
+	TranscodeStream(IStream& source, Encoding::Type type, std::size_t bufferSize = DEFAULT_READ_SIZE)
+		: TranscodeStream{ source, bufferSize }
+	{
+		m_type = type;
+		m_isTypeKnown = true;
+	}
+
+	// Encoding of source, detected by first Read when it wasn't given.
+	Encoding::Type GetType() const noexcept
+	{
+		return m_type;
+	}
+
+	std::size_t Read(char* pBuffer, std::size_t size) override
+	{
+		while (m_position == m_output.size())
+		{
+			if (!Fill())
+			{
+				return 0;
+			}
+		}
+		std::size_t readSize{ std::min(size, m_output.size() - m_position) };
+		std::memcpy(pBuffer, m_output.data() + m_position, readSize);
+		m_position += readSize;
+		return readSize;
+	}
+
+private:
+	// Converts next buffer of source, false at end of source.
+	bool Fill()
+	{
+		std::size_t carried{ m_input.size() };
+		m_input.resize(carried + m_bufferSize);
+		std::size_t readSize{ m_source.Read(&m_input[carried], m_bufferSize) };
+		m_input.resize(carried + readSize);
+		if (!m_isTypeKnown)
+		{
+			// Byte order mark and first character take at most 4 bytes.
+			while (readSize != 0 && m_input.size() < 4)
+			{
+				std::size_t size{ m_input.size() };
+				m_input.resize(size + m_bufferSize);
+				readSize = m_source.Read(&m_input[size], m_bufferSize);
+				m_input.resize(size + readSize);
+			}
+			std::size_t bomLength;
+			m_type = Encoding::DetectType(m_input.data(), m_input.size(), bomLength);
+			m_input.erase(0, bomLength);
+			m_isTypeKnown = true;
+		}
+
+		m_output.clear();
+		m_position = 0;
+		std::size_t end{ Encoding::Transcode(m_type, m_input.data(), m_input.size(), Encoding::Type::UTF8, m_output) };
+		bool isEnd{ readSize == 0 };
+		// Error in the last bytes may be a character which continues in the next buffer.
+		if (end != m_input.size() && (isEnd || m_input.size() - end >= Encoding::c_maxUtf8Length))
+		{
+			Error::ThrowMalFormatErrorException();
+		}
+		m_input.erase(0, end);
+		return !isEnd || !m_output.empty();
+	}
+
+	IStream& m_source;
+	std::size_t m_bufferSize;
+	Encoding::Type m_type{ Encoding::Type::UTF8 };
+	bool m_isTypeKnown{ false };
+	// Bytes of source not converted yet, and converted bytes not read yet.
+	std::string m_input;
+	std::string m_output;
+	std::size_t m_position{ 0 };
 };
 
 }}
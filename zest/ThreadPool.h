@@ -2,10 +2,15 @@
 #ifndef ZEST_LIB_THREADPOOL_H
 #define ZEST_LIB_THREADPOOL_H
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <thread>
 #include <vector>
 #include <type_traits>
 
@@ -134,6 +139,7 @@ private:
 template <typename T>
 struct ITaskQueue
 {
+	virtual ~ITaskQueue() = default;
 	virtual void Push(T& item) noexcept = 0;
 	virtual void Push(const T& item) noexcept = 0;
 	virtual void Pop() noexcept = 0;
@@ -223,9 +229,8 @@ public:
 	}
 
 	ThreadPool(uint32_t poolSize)
-		: m_taskQueue{ std::make_unique<TaskQueue<std::shared_ptr<Task>>>() }
+		: m_isDone{ false }, m_isStop{ false }, m_taskQueue{ std::make_unique<TaskQueue<std::shared_ptr<Task>>>() }
 	{
-		;
 		for (uint32_t i = 0; i < poolSize; i++)
 		{
 			AddThread();
@@ -254,7 +259,7 @@ public:
 	auto Post(TFunc&& func)
 		-> std::future<std::result_of_t<TFunc()>>
 	{
-		std::shared_ptr<std::promise<std::result_of_t<TFunc()>>> spPromise{ std::make_shared<std::promise<std::result_of_t<TFunc(TArgs...)>>>() };
+		std::shared_ptr<std::promise<std::result_of_t<TFunc()>>> spPromise{ std::make_shared<std::promise<std::result_of_t<TFunc()>>>() };
 		auto task = std::bind(std::forward<TFunc>(func));
 		auto taskWrapper = std::make_shared<Task>( [task, spPromise]() noexcept
 		{
@@ -357,17 +362,32 @@ private:
 		Stop,
 	};
 
+	// Exception of task is passed to its future.
 	template<typename TFunc, typename TResult>
-	static void SetPromise(std::shared_ptr<std::promise<TResult>>& spPromise, TFunc && func) noexcept
+	static void SetPromise(const std::shared_ptr<std::promise<TResult>>& spPromise, TFunc && func) noexcept
 	{
-		spPromise->set_value(func());
+		try
+		{
+			spPromise->set_value(func());
+		}
+		catch (...)
+		{
+			spPromise->set_exception(std::current_exception());
+		}
 	}
 
 	template<typename TFunc>
-	static void SetPromise(std::shared_ptr<std::promise<void>>& spPromise, TFunc && func) noexcept
+	static void SetPromise(const std::shared_ptr<std::promise<void>>& spPromise, TFunc && func) noexcept
 	{
-		func();
-		spPromise->set_value();
+		try
+		{
+			func();
+			spPromise->set_value();
+		}
+		catch (...)
+		{
+			spPromise->set_exception(std::current_exception());
+		}
 	}
 
 	std::atomic<bool> m_isDone;